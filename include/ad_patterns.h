@@ -4,6 +4,13 @@
 #include <string>
 #include <vector>
 #include <regex>
+#include <memory>
+#include <cstdint>
+
+namespace PatternEngine {
+    class Regex;
+    class LiteralMatcher;
+}
 
 namespace AdPatterns {
     // 广告模式类型
@@ -23,15 +30,49 @@ namespace AdPatterns {
         bool enabled;
     };
     
+    // 正则表达式引擎
+    enum class Engine {
+        AUTO,           // 优先使用DFA引擎，模式中有它不支持的语法时使用std::regex
+        DFA,            // 只使用DFA引擎（线性时间，按UTF-8字符匹配）
+        STD_REGEX       // 只使用std::regex
+    };
+    
+    // 解析引擎名称（auto、dfa、std）
+    bool parseEngine(const std::string& name, Engine& engine);
+    const char* engineName(Engine engine);
+    
     // 获取所有内置广告模式
     std::vector<AdPattern> getBuiltinPatterns();
     
     // 从文件加载广告模式
     std::vector<std::regex> loadPatternsFromFile(const std::string& filePath);
     
+    // 读取模式文件中的模式字符串（不编译）
+    std::vector<std::string> loadPatternStringsFromFile(const std::string& filePath);
+    
     // 从字符串列表创建正则表达式
     std::vector<std::regex> createPatterns(const std::vector<std::string>& patternStrings);
     
+    class PatternSet;
+    
+    // 从文件加载广告模式并按engine编译；文件是预编译模式包时直接加载，忽略engine
+    PatternSet loadPatternSetFromFile(const std::string& filePath, Engine engine = Engine::AUTO);
+    
+    // 从字符串列表创建模式集合（忽略大小写），无效的模式输出警告后跳过
+    PatternSet createPatternSet(const std::vector<std::string>& patternStrings, Engine engine = Engine::AUTO);
+    
+    // 启用的内置模式按engine编译的集合；每种引擎只编译一次，之后返回同一份共享的集合
+    const PatternSet& builtinPatternSet(Engine engine = Engine::AUTO);
+    
+    // 预编译模式包：保存编译后的NFA程序和预过滤表，加载时mmap映射文件，
+    // 校验版本和校验和后直接使用，不再解析和编译（std::regex模式只能保存源字符串，加载时编译）。
+    // 所有整数按小端序定长存储，不含指针，文件与加载地址无关
+    const uint32_t PATTERN_BUNDLE_VERSION = 2;
+    
+    bool isPatternBundle(const std::string& filePath);
+    bool savePatternBundle(const PatternSet& patterns, const std::string& filePath, std::string* error = nullptr);
+    bool loadPatternBundle(const std::string& filePath, PatternSet& patterns, std::string* error = nullptr);
+    
     // 获取默认广告模式（作为正则表达式）
     std::vector<std::regex> getDefaultPatterns();
     
@@ -41,6 +82,212 @@ namespace AdPatterns {
     // 转义正则表达式特殊字符
     std::string escapeRegex(const std::string& input);
     
+    // 一处匹配：offset/length为字节范围，patternIndex为匹配的模式在集合中的序号
+    struct MatchSpan {
+        size_t offset = 0;
+        size_t length = 0;
+        size_t patternIndex = 0;
+    };
+    
+    // 单个模式的性能计数
+    struct PatternCounters {
+        uint64_t invocations = 0;   // 调用正则引擎搜索的次数
+        uint64_t matches = 0;       // 被选中并移除的匹配数
+        uint64_t bytesScanned = 0;  // 搜索经过的字节数（从搜索起点到匹配终点或搜索范围末尾）
+        uint64_t bytesRemoved = 0;  // 移除的字节数
+        uint64_t nanoseconds = 0;   // 搜索的累计耗时
+        
+        PatternCounters& operator+=(const PatternCounters& other);
+    };
+    
+    // 一次扫描的统计
+    struct ScanStats {
+        size_t errors = 0;          // 出错（被跳过）的模式数
+        size_t bytesSkipped = 0;    // 预过滤判定不可能有匹配开始、没有交给正则引擎的字节数
+        
+        // profile为true时按模式累加计数（每次搜索都要计时，默认关闭），patterns按模式序号对应
+        bool profile = false;
+        std::vector<PatternCounters> patterns;
+    };
+    
+    // 按模式汇总的计数，各线程扫描后把自己的计数合并进来：每个计数是独立的原子变量，
+    // 合并只做relaxed的原子加，不加锁。每个模式的计数单独占一个缓存行，避免伪共享
+    class PatternProfile {
+    public:
+        // 按patterns的模式建立计数，记录各模式的源字符串
+        explicit PatternProfile(const PatternSet& patterns);
+        ~PatternProfile();
+        
+        PatternProfile(const PatternProfile&) = delete;
+        PatternProfile& operator=(const PatternProfile&) = delete;
+        
+        size_t size() const { return sources.size(); }
+        const std::string& source(size_t index) const { return sources[index]; }
+        
+        // 合并一组计数（counters[i]对应第i个模式，超出的部分忽略）
+        void merge(const std::vector<PatternCounters>& counters);
+        
+        // 读取当前的累计值（其他线程仍在合并时，各字段可能不是同一时刻的值）
+        PatternCounters get(size_t index) const;
+        
+        void reset();
+        
+    private:
+        struct Slot;
+        std::vector<std::string> sources;
+        std::unique_ptr<Slot[]> slots;
+    };
+    
+    class CompiledPatternSet;
+    
+    // 模式集合的静态分析结果，index均为模式在集合中的序号
+    struct PatternAnalysis {
+        // 冗余模式：它匹配的每一处都会被coveredBy（或按集合规则先于它的其他模式）以相同的内容移除，
+        // 删去后扫描结果不变
+        struct Redundant {
+            size_t index;
+            size_t coveredBy;
+        };
+        
+        // 在回溯引擎（std::regex）上最坏情况超线性的写法；DFA引擎执行时匹配时间仍是线性的
+        struct Hazard {
+            size_t index;
+            std::string description;
+        };
+        
+        std::vector<Redundant> redundant;
+        std::vector<Hazard> hazards;
+    };
+    
+    // 分析模式之间的包含关系和各模式的回溯隐患。只有DFA执行的模式参与包含关系分析，
+    // std::regex执行的模式（按字节匹配，结果与DFA不同）不会被判为冗余，也不用来覆盖其他模式。
+    // 冗余按集合顺序逐个判断，删去全部冗余模式后结果仍不变
+    PatternAnalysis analyzePatternSet(const PatternSet& patterns);
+    
+    // 扫描时的可变状态：各模式的DFA缓存、候选位置和字面量命中。编译好的集合只读，
+    // 可被多个线程同时扫描，每个线程各用一个ScanScratch；同一个ScanScratch可以先后用于不同的集合
+    class ScanScratch {
+    public:
+        ScanScratch();
+        ~ScanScratch();
+        
+        ScanScratch(const ScanScratch&) = delete;
+        ScanScratch& operator=(const ScanScratch&) = delete;
+        
+    private:
+        friend class CompiledPatternSet;
+        struct State;
+        std::unique_ptr<State> state;
+    };
+    
+    // 编译完成的模式集合：创建后只读，通过shared_ptr引用计数在线程和处理器之间共享。
+    // 一次扫描找出所有模式的不重叠匹配：总是选择起点最靠前的匹配，
+    // 起点相同时选择排在前面的模式，然后从该匹配结束处继续；空匹配不计。
+    // DFA引擎编译的模式带有必需字面量，扫描前先用多字面量查找定位候选位置：
+    // 没有候选的模式不再搜索，长度有界的模式只搜索候选位置附近的窗口
+    class CompiledPatternSet : public std::enable_shared_from_this<CompiledPatternSet> {
+    public:
+        size_t size() const { return entries.size(); }
+        
+        // 第index个模式实际使用的引擎（DFA或STD_REGEX）
+        Engine engineOf(size_t index) const;
+        
+        // 从start开始扫描[data, data+size)，只报告起点在limit之前的匹配并追加到matches；
+        // partial为true表示数据之后还有内容（末尾不视为行尾或单词边界）。返回下一次扫描的起点。
+        // 不加锁，所有可变状态都在scratch中
+        size_t scan(const char* data, size_t size, size_t start, size_t limit, bool partial,
+                    std::vector<MatchSpan>& matches, ScanScratch& scratch, ScanStats* stats = nullptr) const;
+        
+    private:
+        friend class PatternSet;
+        friend class ScanScratch;
+        friend bool savePatternBundle(const PatternSet&, const std::string&, std::string*);
+        friend bool loadPatternBundle(const std::string&, PatternSet&, std::string*);
+        friend PatternAnalysis analyzePatternSet(const PatternSet&);
+        
+        struct Entry {
+            std::string source;
+            std::shared_ptr<const std::regex> regex;
+            std::shared_ptr<const PatternEngine::Regex> dfa;
+        };
+        
+        // 所有模式的必需字面量合在一起的预过滤器
+        struct Prefilter {
+            std::shared_ptr<const PatternEngine::LiteralMatcher> matcher;
+            std::vector<std::vector<size_t>> literalEntries;    // 字面量编号 -> 模式序号
+            std::vector<bool> filtered;                         // 模式是否有必需字面量
+            std::vector<size_t> minLiteralLength;               // 模式最短必需字面量的长度
+            size_t filteredCount = 0;
+        };
+        
+        // 预过滤器在第一次扫描时构建，之后由ScanScratch缓存，扫描时不再访问
+        std::shared_ptr<const Prefilter> currentPrefilter() const;
+        
+        std::vector<Entry> entries;
+        mutable std::shared_ptr<const Prefilter> prefilter;
+    };
+    
+    // 模式集合：用于构建和持有CompiledPatternSet。复制只增加引用计数，不复制也不重新编译模式；
+    // 修改时如果编译结果正被其他集合或扫描共享，先复制一份再改（写时复制）
+    class PatternSet {
+    public:
+        PatternSet() = default;
+        explicit PatternSet(std::vector<std::regex> patterns);
+        
+        // 添加已编译的std::regex（没有源字符串，不能切换引擎）
+        void add(const std::regex& pattern);
+        
+        // 按engine编译并添加模式（忽略大小写）；失败时写入error并返回false
+        bool add(const std::string& pattern, Engine engine = Engine::AUTO, std::string* error = nullptr);
+        
+        void clear();
+        
+        size_t size() const { return data ? data->size() : 0; }
+        bool empty() const { return size() == 0; }
+        
+        // 第index个模式实际使用的引擎（DFA或STD_REGEX）
+        Engine engineOf(size_t index) const { return data->engineOf(index); }
+        
+        // 第index个模式的源字符串（由已编译的std::regex添加的模式为空）
+        const std::string& sourceOf(size_t index) const;
+        
+        // 按另一种引擎重新编译所有带源字符串的模式；无法编译的模式保留原来的引擎
+        PatternSet withEngine(Engine engine) const;
+        
+        // 删去indices中的模式（如analyzePatternSet找出的冗余模式），其余模式共享原来的编译结果
+        PatternSet without(const std::vector<size_t>& indices) const;
+        
+        // 只读的编译结果，可交给其他线程使用
+        std::shared_ptr<const CompiledPatternSet> compiled() const { return data; }
+        
+        // 查找content中的所有匹配；stats不为空时累加扫描统计。
+        // 不带scratch的版本使用临时状态，DFA缓存不能在多次调用之间复用
+        std::vector<MatchSpan> findAll(const std::string& content, ScanStats* stats = nullptr) const;
+        std::vector<MatchSpan> findAll(const std::string& content, ScanScratch& scratch,
+                                       ScanStats* stats = nullptr) const;
+        
+        // 见CompiledPatternSet::scan
+        size_t scan(const char* data, size_t size, size_t start, size_t limit, bool partial,
+                    std::vector<MatchSpan>& matches, ScanStats* stats = nullptr) const;
+        size_t scan(const char* data, size_t size, size_t start, size_t limit, bool partial,
+                    std::vector<MatchSpan>& matches, ScanScratch& scratch, ScanStats* stats = nullptr) const;
+        
+        // 删除所有匹配的内容，结果只复制一次
+        static std::string removeMatches(const std::string& content, const std::vector<MatchSpan>& matches);
+        
+        // 原地删除所有匹配：保留的片段依次前移，不分配新的缓冲区
+        static void eraseMatches(std::string& content, const std::vector<MatchSpan>& matches);
+        
+    private:
+        friend bool savePatternBundle(const PatternSet&, const std::string&, std::string*);
+        friend bool loadPatternBundle(const std::string&, PatternSet&, std::string*);
+        
+        // 返回可修改的编译结果，与其他对象共享时先复制
+        CompiledPatternSet& mutableData();
+        
+        std::shared_ptr<CompiledPatternSet> data;
+    };
+    
     // 广告模式匹配器类
     class PatternMatcher {
     public:
@@ -54,21 +301,62 @@ namespace AdPatterns {
         // 匹配并替换广告内容
         std::string cleanContent(const std::string& content);
         
+        // 按模式统计调用次数、扫描字节数和耗时（每次搜索都要计时，默认关闭）；
+        // 匹配数和移除字节数总是统计
+        void setProfiling(bool enabled) { profiling = enabled; }
+        
         // 检查是否包含广告
         bool containsAds(const std::string& content);
         
         // 获取匹配统计
         struct MatchStats {
-            int totalMatches = 0;
-            std::vector<std::string> matchedPatterns;
+            int totalMatches = 0;       // 移除的匹配总数（每处匹配计一次）
+            std::vector<std::string> matchedPatterns;   // 有过匹配的模式（源字符串），按第一次匹配的顺序
+            std::vector<PatternCounters> patterns;      // 每个模式的计数，按添加顺序
         };
         
         MatchStats getMatchStats() const { return matchStats; }
         void resetMatchStats();
         
     private:
-        std::vector<std::regex> patterns;
+        PatternSet patterns;
         MatchStats matchStats;
+        bool profiling = false;
+    };
+    
+    // 流式清理器：数据分块输入，按PatternSet的规则移除匹配；保留window字节的尾部
+    // 等待后续数据，长度不超过window的匹配跨越块边界时也能被移除
+    class StreamingCleaner {
+    public:
+        // patterns需在清理器使用期间保持有效
+        StreamingCleaner(const PatternSet& patterns, size_t window);
+        
+        // 输入一块数据，清理结果追加到out；last为true时输出所有剩余数据
+        void write(const char* data, size_t size, bool last, std::string& out);
+        
+        // 每个模式移除的匹配次数
+        const std::vector<size_t>& removalCounts() const { return removals; }
+        bool modified() const;
+        
+        // 扫描中出现正则表达式错误的次数
+        size_t errorCount() const { return scanStats.errors; }
+        
+        // 预过滤跳过的字节数
+        size_t bytesSkipped() const { return scanStats.bytesSkipped; }
+        
+        // 按模式统计（见ScanStats::profile）
+        void setProfiling(bool enabled) { scanStats.profile = enabled; }
+        const std::vector<PatternCounters>& patternCounters() const { return scanStats.patterns; }
+        
+    private:
+        const PatternSet& patterns;
+        size_t window;
+        std::string pending;        // 尚未输出的数据（开头可能保留1字节已输出的上下文）
+        size_t lead = 0;            // pending开头已输出的上下文长度
+        std::vector<MatchSpan> matches;
+        std::vector<size_t> removals;
+        ScanStats scanStats;
+        ScanScratch scratch;
     };
 }
 
@@ -0,0 +1,50 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <string>
+#include <string_view>
+#include <initializer_list>
+#include <filesystem>
+#include <cstddef>
+
+namespace fs = std::filesystem;
+
+// 整个文件的读、写和复制。Linux上可使用io_uring：一个文件拆成多个块同时提交，
+// 保持较深的设备队列；每个线程一个环，注册的缓冲区在处理多本书时重复使用。
+// io_uring不可用（旧内核、被seccomp禁止、非Linux）时使用同步读写
+namespace AsyncIO {
+    enum class Backend {
+        AUTO,       // io_uring可用时使用，否则同步读写
+        SYNC,       // 只使用同步读写
+        IO_URING    // 要求io_uring，不可用时仍回退到同步读写
+    };
+
+    struct Config {
+        Backend backend = Backend::AUTO;
+        unsigned queueDepth = 32;           // 每个环同时在途的请求数（也是注册缓冲区的个数）
+        size_t bufferSize = 128 * 1024;     // 每个注册缓冲区的大小，即单个请求的最大长度
+    };
+
+    // 获取全局配置；修改后新的请求按新配置建立环
+    Config& getConfig();
+
+    bool parseBackend(const std::string& name, Backend& backend);
+    const char* backendName(Backend backend);
+
+    // 按配置实际使用的后端（SYNC或IO_URING）
+    Backend activeBackend();
+
+    // 读取整个文件（原样，不处理BOM）
+    bool readFile(const fs::path& path, std::string& content);
+
+    // 依次写出各段数据，覆盖已有文件
+    bool writeFile(const fs::path& path, std::initializer_list<std::string_view> parts);
+    inline bool writeFile(const fs::path& path, std::string_view content) {
+        return writeFile(path, {content});
+    }
+
+    // 复制文件内容，覆盖已有文件
+    bool copyFile(const fs::path& src, const fs::path& dst);
+}
+
+#endif // ASYNC_IO_H
@@ -5,36 +5,126 @@
 #include <vector>
 #include <regex>
 #include <filesystem>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <iostream>
+#include <functional>
+#include "ad_patterns.h"
 
 namespace fs = std::filesystem;
 
+class ThreadPool;
+
+namespace ZipUtils {
+    class ZipReader;
+    class ZipWriter;
+    struct ArchiveEntry;
+}
+
 class EpubProcessor {
 public:
         // 构造函数
     EpubProcessor(bool verbose = false, bool createBackup = true, bool preserveEncoding = false);
     
+    // 处理模式
+    enum class ProcessingMode {
+        EXTRACT,    // 解压到临时目录，清理后重新打包
+        REWRITE,    // ZIP到ZIP重写，未修改的条目直接复制压缩数据
+        MEMORY,     // 解码为内存条目表，在内存中清理后重新输出
+        PIPELINE    // 分阶段流水线：读取、解压、清理、压缩、写出各由一组线程执行，
+                    // 阶段之间用有界队列连接；批量处理时预读后续的书
+    };
+    
+    // 流水线各阶段的线程数（0为setJobs的线程数）和队列容量
+    struct PipelineOptions {
+        size_t readThreads = 1;         // 把整本书读入内存
+        size_t decodeThreads = 1;       // 解析目录、解压内容文档
+        size_t cleanThreads = 0;        // 清理内容文档
+        size_t compressThreads = 0;     // 压缩修改过的文档
+        size_t writeThreads = 1;        // 写出归档
+        size_t readAhead = 2;           // 已读入、等待解压的书数上限；同时驻留内存的书数
+                                        // 不超过readAhead + 解压线程数 + 写出线程数
+        size_t queueCapacity = 64;      // 清理、压缩队列的容量（按文档计）
+    };
+    
+    void setPipelineOptions(const PipelineOptions& options) { pipelineOptions = options; }
+    const PipelineOptions& getPipelineOptions() const { return pipelineOptions; }
+    
+    // 设置处理模式（REWRITE/MEMORY需要内置ZIP支持，不可用时回退到EXTRACT）
+    void setProcessingMode(ProcessingMode mode);
+    ProcessingMode getProcessingMode() const { return processingMode; }
+    
+    // 设置重新压缩条目的线程数（0为硬件并发数）和大条目分块压缩的块大小（0为不分块）
+    void setCompressionThreads(size_t threads) { compressionThreads = threads; }
+    void setCompressionChunkSize(size_t bytes) { compressionChunkSize = bytes; }
+    
+    // 超过threshold字节的内容文档流式清理（0为不使用流式处理）；
+    // window为跨块匹配保留的字节数，流式处理时单个广告的长度不能超过该值
+    void setStreamingThreshold(uint64_t bytes) { streamingThreshold = bytes; }
+    void setStreamingWindow(size_t bytes) { streamingWindow = bytes; }
+    
+    // 每个内容文档开始清理时调用（参数为文件名，流式清理的文档除外），可用于显示进度；
+    // 并行清理时在工作线程中调用，回调需要线程安全
+    using DocumentCallback = std::function<void(const std::string& name)>;
+    void setDocumentCallback(DocumentCallback callback) { documentCallback = std::move(callback); }
+    
     // 处理单个EPUB文件
     bool processFile(const fs::path& inputPath, const fs::path& outputPath);
     
+    // 处理内存中的EPUB数据，结果写入output（不访问磁盘，需要内置ZIP支持）
+    bool processBuffer(const std::string& input, std::string& output);
+    
     // 批量处理目录
     bool processDirectory(const fs::path& inputDir, const fs::path& outputDir);
     
-    // 设置广告模式
+    // 并行线程数（0为硬件并发数）：批量处理时同时处理多个文件（最大的先开始），
+    // 同一本书的内容文档也分给这些线程清理（rewrite模式按批分发，流式处理的大文档仍在调用线程中清理；
+    // 流水线模式有自己的清理线程，不使用这个设置）。两者共用一个工作窃取线程池，
+    // 一本很大的书拆出的文档任务可以被其他书处理完后空闲的线程窃取。
+    // 每个工作线程使用自己的处理器副本，共享已编译的模式；每个文件的控制台输出缓冲后整体写出
+    void setJobs(size_t count) { jobs = count; workerPool.reset(); borrowedPool = nullptr; }
+    
+    // 设置广告模式（复制PatternSet只共享编译结果，不重新编译）
     void setAdPatterns(const std::vector<std::regex>& patterns);
+    void setAdPatterns(const AdPatterns::PatternSet& patterns);
+    
+    // 设置正则表达式引擎，已有的模式按新引擎重新编译
+    void setRegexEngine(AdPatterns::Engine engine);
     
     // 添加自定义广告模式
     void addAdPattern(const std::string& pattern);
     
+    // 清理时使用的模式集合；使用内置模式时在第一次调用时编译（耗时记入StartupProfile）
+    const AdPatterns::PatternSet& getAdPatterns() { return resolvePatterns(); }
+    
+    // 按模式统计扫描计数，合并到profile（可由多个处理器共享）；profile应按清理时使用的模式集合建立。
+    // 为空时不统计
+    void setPatternProfile(std::shared_ptr<AdPatterns::PatternProfile> profile) { patternProfile = std::move(profile); }
+    
     // 获取统计信息
     struct Stats {
         int filesProcessed = 0;
-        int adsRemoved = 0;
+        int adsRemoved = 0;             // 移除的广告处数（每处匹配计一次）
         int errors = 0;
+        int documentsSkipped = 0;       // 预过滤判定没有广告、未交给正则引擎的内容文档数
+        uint64_t bytesSkipped = 0;      // 预过滤跳过的字节数（含部分跳过的文档）
         std::vector<std::string> processedFiles;
+        
+        Stats& operator+=(const Stats& other);
     };
     
     const Stats& getStats() const { return stats; }
     
+    // 启动阶段的耗时，用于分析每次调用的固定开销
+    struct StartupProfile {
+        double patternCompileMs = 0;                            // 首次使用时编译内置模式的耗时
+        bool documentStarted = false;                           // 是否已开始清理内容文档
+        std::chrono::steady_clock::time_point firstDocument;    // 模式就绪、开始清理第一个内容文档的时刻
+    };
+    
+    const StartupProfile& getStartupProfile() const { return startupProfile; }
+    
     // 重置统计信息
     void resetStats();
     
@@ -48,24 +138,109 @@ private:
     // 重新打包为EPUB
     bool repackEpub(const fs::path& extractDir, const fs::path& epubPath);
     
+    // 解压-清理-打包流程（使用临时目录）
+    bool processExtracted(const fs::path& inputPath, const fs::path& outputPath);
+    
+    // ZIP到ZIP重写流程（不使用临时目录）
+    bool rewriteEpub(const fs::path& inputPath, const fs::path& outputPath);
+    
+    // 内存流程：整个输入读入内存，只在最终输出时写盘
+    bool processInMemory(const fs::path& inputPath, const fs::path& outputPath);
+    
+    // 流水线流程：处理inputs[i] -> outputs[i]，succeeded记录每本书是否成功。
+    // beforeBook在读取阶段调用（返回false时跳过该书，不再调用afterBook），afterBook在写出阶段
+    // 调用（返回最终结果），
+    // 两者收到的处理器的统计和控制台输出只属于这本书
+    using BookHook = std::function<bool(EpubProcessor& worker, size_t index, bool processed)>;
+    void runPipeline(const std::vector<fs::path>& inputs, const std::vector<fs::path>& outputs,
+                     std::vector<char>& succeeded, const BookHook& beforeBook = nullptr,
+                     const BookHook& afterBook = nullptr);
+    
+    // 处理单个文件的前后步骤：输出信息并检查输入；创建备份并更新统计
+    bool beginFile(const fs::path& inputPath, const fs::path& outputPath);
+    void finishFile(const fs::path& inputPath, const fs::path& outputPath);
+    
+    // 将reader中的归档解码为条目表，清理内容文档后通过writer输出
+    bool cleanArchive(const ZipUtils::ZipReader& reader, ZipUtils::ZipWriter& writer);
+    
+    // 清理条目表中已载入的内容文档（多个文档时分给线程池），修改过的条目设置modified，
+    // cleanedCount累加被修改的文档数；返回是否全部清理成功
+    bool cleanDocuments(std::vector<ZipUtils::ArchiveEntry*>& documents, int& cleanedCount);
+    
+    // 清理归档中的一个内容文档（处理BOM），返回内容是否被修改
+    bool cleanDocumentEntry(const std::string& name, std::string& content);
+    
     // 清理单个XHTML文件
     bool cleanXhtmlFile(const fs::path& filePath);
     
-    // 应用所有广告模式
-    std::string applyAdPatterns(const std::string& content);
+    // 在线程池中并行执行task(worker, 0..count-1)（清理解压出的文件或内存中的文档），
+    // succeeded记录每项的返回值；各项的统计和输出按下标顺序合并
+    using ItemTask = std::function<bool(EpubProcessor& worker, size_t index)>;
+    void runInParallel(size_t count, ThreadPool& pool, const ItemTask& task, std::vector<char>& succeeded);
+    
+    // 流式清理大文件，streamed为false表示文件不能流式处理
+    bool streamCleanFile(const fs::path& filePath, bool& streamed);
+    
+    // 清理XHTML内容，返回内容是否被修改
+    bool cleanXhtmlContent(std::string& content, const std::string& displayName);
+    
+    // 判断条目是否为需要清理的内容文档
+    static bool isContentDocument(const fs::path& name);
+    
+    // 一次扫描应用所有广告模式，返回内容是否被修改
+    bool applyAdPatterns(std::string& content);
     
     // 创建备份
     bool createBackup(const fs::path& filePath);
     
+    // 输出路径与输入相同时，先写入同目录下的临时文件，完成后再替换
+    static fs::path stagingPath(const fs::path& inputPath, const fs::path& outputPath, bool& inPlace);
+    
+    // 按文件大小从大到小排列的下标（大小相同时保持原顺序）
+    static std::vector<size_t> largestFirstOrder(const std::vector<fs::path>& files);
+    
+    // 创建并行处理用的工作处理器：复制设置，共享模式集合和按模式统计，借用（不持有）线程池
+    std::unique_ptr<EpubProcessor> createWorker() const;
+    
+    // 批量处理和书内并行清理共用的线程池，第一次使用时创建；只有一个线程时返回nullptr
+    ThreadPool* sharedPool();
+    
+    // 控制台输出（批量并行处理时指向每个文件的缓冲）
+    std::ostream& outStream() { return *outTarget; }
+    std::ostream& errStream() { return *errTarget; }
+    
         // 成员变量
-    std::vector<std::regex> adPatterns;
+    AdPatterns::PatternSet adPatterns;
+    AdPatterns::Engine regexEngine = AdPatterns::Engine::AUTO;
+    bool builtinPatterns = true;        // adPatterns是否为共享的内置模式集合
+    bool patternsResolved = false;      // 内置模式延迟到第一次使用时再取得（可能需要编译）
+    AdPatterns::ScanScratch scanScratch;
+    std::shared_ptr<AdPatterns::PatternProfile> patternProfile;
+    StartupProfile startupProfile;
     Stats stats;
     bool verbose;
     bool createBackupFiles;
     bool preserveEncoding;  // 新增：保持原始编码
+    ProcessingMode processingMode;
+    size_t compressionThreads = 0;
+    size_t compressionChunkSize = 0;
+    uint64_t streamingThreshold = 64 * 1024 * 1024;
+    size_t streamingWindow = 64 * 1024;
+    size_t jobs = 0;
+    PipelineOptions pipelineOptions;
+    std::shared_ptr<ThreadPool> workerPool;
+    // 工作处理器借用创建者的线程池：工作处理器可能在线程池的线程中析构，
+    // 持有线程池会让最后一个引用在池内线程释放，析构时join自己
+    ThreadPool* borrowedPool = nullptr;
+    DocumentCallback documentCallback;
+    std::ostream* outTarget = &std::cout;
+    std::ostream* errTarget = &std::cerr;
+    
+    // 取得当前模式，需要时编译内置模式
+    const AdPatterns::PatternSet& resolvePatterns();
     
-    // 内置广告模式
-    void initializeDefaultPatterns();
+    // 清理内容文档时使用的模式（同时记录第一个文档开始的时刻）
+    const AdPatterns::PatternSet& documentPatterns();
 };
 
 #endif // EPUB_PROCESSOR_H
\ No newline at end of file
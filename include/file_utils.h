@@ -50,6 +50,35 @@ namespace FileUtils {
         fs::path path;
     };
     
+    // 只读文件映射：优先使用mmap，无法映射时（管道、特殊文件）回退到缓冲读取
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+        
+        bool open(const fs::path& path);
+        void close();
+        
+        bool isOpen() const { return opened; }
+        bool isMapped() const { return mapping != nullptr; }
+        const unsigned char* data() const;
+        size_t size() const { return length; }
+        
+        // 禁止拷贝
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        
+        // 允许移动
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+        
+    private:
+        void* mapping = nullptr;
+        size_t length = 0;
+        std::string buffer;
+        bool opened = false;
+    };
+    
     // ZIP压缩/解压（现在通过ZipUtils模块处理）
     bool extractZip(const fs::path& zipPath, const fs::path& extractDir);
     bool createZip(const fs::path& sourceDir, const fs::path& zipPath);
@@ -33,6 +33,60 @@ namespace Logger {
     // 设置日志级别
     void setLevel(Level level);
     
+    // 在日志锁内整体写出一段已格式化的文本，不与其他线程的日志交错
+    void writeBlock(const std::string& text, bool error = false);
+    
+    // 缓冲一个任务的控制台输出，flush()或析构时通过writeBlock整体写出；
+    // 并行处理多个文件时，每个文件的输出连续出现
+    class BufferedOutput {
+    public:
+        BufferedOutput() = default;
+        ~BufferedOutput();
+        
+        BufferedOutput(const BufferedOutput&) = delete;
+        BufferedOutput& operator=(const BufferedOutput&) = delete;
+        
+        std::ostream& out() { return outBuffer; }
+        std::ostream& err() { return errBuffer; }
+        
+        void flush();
+        
+    private:
+        std::ostringstream outBuffer;
+        std::ostringstream errBuffer;
+    };
+    
+    // 当前线程的错误输出目标：工作线程处理一本书时指向这本书的缓冲，
+    // 库函数（文件操作、模式匹配）报告的错误随这本书的输出整体写出。作用域结束时恢复之前的目标
+    class ScopedErrorTarget {
+    public:
+        explicit ScopedErrorTarget(std::ostream& target);
+        ~ScopedErrorTarget();
+        
+        ScopedErrorTarget(const ScopedErrorTarget&) = delete;
+        ScopedErrorTarget& operator=(const ScopedErrorTarget&) = delete;
+        
+    private:
+        std::ostream* previous;
+    };
+    
+    // 一行错误信息（不加时间戳和级别），析构时写入当前线程的错误输出目标；
+    // 没有设置目标时通过writeBlock整体写到errorOutput
+    class ErrorLine {
+    public:
+        ErrorLine() = default;
+        ~ErrorLine();
+        
+        template<typename T>
+        ErrorLine& operator<<(const T& value) {
+            buffer << value;
+            return *this;
+        }
+        
+    private:
+        std::ostringstream buffer;
+    };
+    
     // 日志流类
     class LogStream {
     public:
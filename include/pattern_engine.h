@@ -0,0 +1,207 @@
+#ifndef PATTERN_ENGINE_H
+#define PATTERN_ENGINE_H
+
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "simd_scan.h"
+
+// 广告模式的正则表达式引擎：把ECMAScript语法的常用子集编译为按UTF-8字节匹配的NFA，
+// 匹配时按需构造DFA。不回溯也不递归，匹配时间与文本长度成线性关系
+namespace PatternEngine {
+
+    struct Program;
+    class LazyDfa;
+    class Regex;
+
+    // 二进制序列化：整数一律按小端序定长写入，不含指针和对齐填充，结果与加载地址无关
+    class BinaryWriter {
+    public:
+        void u8(uint8_t value);
+        void u32(uint32_t value);
+        void u64(uint64_t value);
+        void bytes(const void* data, size_t size);
+        void str(const std::string& value);     // u32长度 + 内容
+        void u32Array(const uint32_t* values, size_t count);
+
+        const std::string& buffer() const { return out; }
+
+    private:
+        std::string out;
+    };
+
+    // 从只读内存（如mmap映射的文件）中按BinaryWriter的格式读取，不要求对齐；
+    // 越界后进入失败状态，之后的读取都返回false
+    class BinaryReader {
+    public:
+        BinaryReader(const unsigned char* data, size_t size) : cursor(data), end(data + size) {}
+
+        bool u8(uint8_t& value);
+        bool u32(uint32_t& value);
+        bool u64(uint64_t& value);
+        bool bytes(void* data, size_t size);
+        bool str(std::string& value);
+        bool u32Array(uint32_t* values, size_t count);     // 小端序主机上直接整块复制
+
+        bool ok() const { return !failed; }
+        bool atEnd() const { return cursor == end; }
+
+    private:
+        bool take(size_t size);
+
+        const unsigned char* cursor;
+        const unsigned char* end;
+        bool failed = false;
+    };
+
+    // 匹配时按需生成的DFA状态。编译后的Regex只读，可被多个线程同时使用，
+    // 每个线程各用一个缓存；缓存第一次用于另一个Regex时自动重建
+    class MatchCache {
+    public:
+        MatchCache();
+        ~MatchCache();
+        MatchCache(MatchCache&&) noexcept;
+        MatchCache& operator=(MatchCache&&) noexcept;
+
+    private:
+        friend class Regex;
+        const Regex* owner = nullptr;
+        std::unique_ptr<LazyDfa> forward;   // 非锚定、最左优先：求最左匹配的终点
+        std::unique_ptr<LazyDfa> reverse;   // 从终点向左锚定：求该匹配的起点
+    };
+
+    class Regex {
+    public:
+        ~Regex();
+
+        Regex(const Regex&) = delete;
+        Regex& operator=(const Regex&) = delete;
+
+        // 编译模式（icase只对ASCII字母生效）。支持字面量（含UTF-8字符）、字符类、
+        // 取反字符类、分组、选择、重复（含非贪婪）、^、$、\b、\B；反向引用、前瞻，
+        // 以及次数可变且循环体能匹配空串的重复（如(?:a|\b)+）不支持，返回nullptr并写入error
+        static std::unique_ptr<Regex> compile(const std::string& pattern, bool icase, std::string& error);
+
+        // 在[data, data+size)中查找起点位于[from, limit)的最左非空匹配；
+        // 同一起点上的匹配结果与ECMAScript回溯引擎一致（贪婪/非贪婪、选择的先后顺序；
+        // 能匹配空串的循环体已在编译时拒绝，不涉及规范中空循环的特殊规则）。
+        // partial为true表示数据之后还有内容（末尾不视为文本结束）。不加锁，DFA状态保存在cache中
+        bool search(const char* data, size_t size, size_t from, size_t limit, bool partial,
+                    size_t& matchStart, size_t& matchEnd, MatchCache& cache) const;
+
+        // 同上，使用临时缓存（每次调用都重新生成DFA状态，只适合偶尔调用）
+        bool search(const char* data, size_t size, size_t from, size_t limit, bool partial,
+                    size_t& matchStart, size_t& matchEnd) const;
+
+        const std::string& pattern() const { return source; }
+
+        // 必需字面量：任何匹配都至少包含其中一个（ASCII字母为小写，应按忽略ASCII大小写比较）；
+        // 为空表示没有可用的必需字面量
+        const std::vector<std::string>& requiredLiterals() const { return literals; }
+
+        // 匹配的最大字节长度，UNBOUNDED表示不限
+        static const size_t UNBOUNDED = static_cast<size_t>(-1);
+        size_t maxMatchLength() const { return maxLength; }
+
+        // 保存编译结果（NFA程序、字面量分析等），加载时不再解析和编译；
+        // 加载时检查所有下标，数据损坏时返回nullptr并写入error
+        void serialize(BinaryWriter& out) const;
+        static std::unique_ptr<Regex> deserialize(BinaryReader& in, std::string& error);
+
+    private:
+        friend class MatchComparer;
+
+        Regex();
+
+        std::string source;
+        std::vector<std::string> literals;
+        size_t maxLength = UNBOUNDED;
+
+        // 形如[...]+（贪婪、码点不多）的模式不经过DFA：用字节扫描内核找到候选，
+        // 再逐个码点验证并向后延伸
+        bool charRun = false;
+        std::vector<std::string> runMembers;    // 每个码点的UTF-8编码
+        SimdScan::PrefixSet runPrefixes;
+        size_t runLength(const char* data, size_t size, size_t pos) const;
+        std::unique_ptr<Program> forwardProgram;
+        std::unique_ptr<Program> reverseProgram;
+    };
+
+    // 模式集合静态分析用：同时模拟两个模式从同一起点开始的匹配（各自按最左优先规则，不计空匹配），
+    // 判断在任意文本、任意起点上两者的匹配关系。各模式的DFA在多次比较之间复用
+    class MatchComparer {
+    public:
+        enum class Result { YES, NO, UNKNOWN };     // UNKNOWN：状态数超过上限，未能判断
+
+        // patterns中可以有nullptr，对应的模式不能参与比较
+        explicit MatchComparer(std::vector<const Regex*> patterns);
+        ~MatchComparer();
+
+        // covers：第a个模式有匹配的起点上第b个模式一定也有匹配；
+        // sameEnd：两者在同一起点都有匹配时终点一定相同。要求的条件都成立时返回YES
+        Result check(size_t a, size_t b, bool covers, bool sameEnd);
+
+    private:
+        // 由语法树生成的模式的一个最短匹配（起点左侧的上下文和文本）。先在它上面模拟两个模式，
+        // 多数不成立的比较可以直接找到反例，不必搜索乘积自动机
+        struct Witness {
+            bool built = false;
+            bool found = false;
+            uint8_t context = 0;
+            std::string text;
+        };
+
+        LazyDfa& dfaOf(size_t index);
+        const Witness& witnessOf(size_t index);
+        size_t matchEnd(size_t index, const Witness& witness);     // 在witness上锚定匹配的终点
+
+        std::vector<const Regex*> patterns;
+        std::vector<std::unique_ptr<LazyDfa>> dfas;    // 锚定、最左优先，按需创建
+        std::vector<Witness> witnesses;
+    };
+
+    // 回溯引擎（std::regex）上最坏情况超线性的写法：嵌套的量词、多段可匹配相同字符的无界重复、
+    // 以无界重复开头。每种隐患写入一条说明；模式无法解析时返回false
+    bool findBacktrackingHazards(const std::string& pattern, std::vector<std::string>& hazards);
+
+    // 多字面量查找（Aho-Corasick自动机），一遍扫描找出所有字面量的所有出现位置；
+    // ASCII字母不区分大小写
+    class LiteralMatcher {
+    public:
+        struct Hit {
+            size_t position;    // 字面量在数据中的起点
+            uint32_t literal;   // 字面量编号（add的返回值）
+        };
+
+        // 添加字面量，返回编号；添加完毕后调用build
+        uint32_t add(const std::string& literal);
+        void build();
+
+        size_t size() const { return lengths.size(); }
+        size_t literalLength(uint32_t literal) const { return lengths[literal]; }
+
+        // 查找[data, data+size)中的所有出现位置，按终点顺序追加到hits
+        void findAll(const char* data, size_t size, std::vector<Hit>& hits) const;
+
+        // 保存build之后的转移表，加载后可直接查找；数据损坏时返回nullptr
+        void serialize(BinaryWriter& out) const;
+        static std::unique_ptr<LiteralMatcher> deserialize(BinaryReader& in);
+
+    private:
+        // 根据heads设置初始状态下的跳过条件
+        void buildPrefixes();
+
+        std::vector<int32_t> transitions;       // 状态*256+字节 -> 下一状态
+        std::vector<int32_t> failure;
+        std::vector<std::vector<uint32_t>> outputs;
+        std::vector<size_t> lengths;
+        std::vector<std::string> heads;         // 每个字面量开头的几个字节（小写）
+        SimdScan::PrefixSet prefixes;           // 所有字面量的开头，初始状态下用于跳过无关数据
+        bool skipping = false;
+        bool built = false;
+    };
+}
+
+#endif // PATTERN_ENGINE_H
@@ -0,0 +1,63 @@
+#ifndef SIMD_SCAN_H
+#define SIMD_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 字节扫描内核：按16/32字节块查找候选位置，运行时根据CPU选择SSE2或AVX2实现，
+// 其他平台使用逐字节的标量实现
+namespace SimdScan {
+
+    enum class Level {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    // CPU支持的最高级别
+    Level detectedLevel();
+
+    // 当前使用的级别
+    Level activeLevel();
+
+    // 指定使用的级别（不超过CPU支持的级别），主要用于测试和性能对比
+    void setLevel(Level level);
+
+    const char* levelName(Level level);
+
+    // 1~3字节前缀的集合，查找以其中任一前缀开头的位置；ASCII小写字母同时匹配大写
+    class PrefixSet {
+    public:
+        static const size_t MAX_PREFIXES = 16;
+
+        static const size_t MAX_LENGTH = 3;
+
+        // 添加前缀（length为1~3）；集合已满或参数无效时返回false
+        bool add(const char* bytes, size_t length);
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        
+        // 第index个前缀（按add时的字节），用于保存后重新添加
+        std::string prefix(size_t index) const;
+
+        // 返回[from, size)中第一个以某个前缀开头的位置，没有时返回size
+        size_t find(const char* data, size_t size, size_t from) const;
+
+        // 第k个字节的比较条件：(字节 | fold[k]) == value[k]；
+        // 前缀较短时多出的位置fold和value都为0xFF，任何字节都满足
+        struct Table {
+            uint8_t value[MAX_LENGTH][MAX_PREFIXES];
+            uint8_t fold[MAX_LENGTH][MAX_PREFIXES];
+            uint8_t length[MAX_PREFIXES];
+            bool leads[256];                    // 标量实现的快速排除表
+        };
+
+    private:
+        Table table = {};
+        size_t count = 0;
+    };
+}
+
+#endif // SIMD_SCAN_H
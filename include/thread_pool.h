@@ -0,0 +1,60 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+// 固定大小的工作窃取线程池。外部线程提交的任务进入共享队列，按提交顺序执行；
+// 工作线程提交的任务（例如一本书拆出的文档任务）放入该线程自己的队列，由它后进先出地执行。
+// 线程空闲时依次查看自己的队列、共享队列，最后从其他线程队列的另一端窃取任务
+class ThreadPool {
+public:
+    // threads为0时使用硬件并发数
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+    
+    // 禁止拷贝
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    // 提交任务，通过future获取结果（任务中的异常在get()时重新抛出）
+    template<typename F>
+    auto submit(F&& task) -> std::future<decltype(task())> {
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        push([packaged]() { (*packaged)(); });
+        return result;
+    }
+    
+    size_t size() const { return workers.size(); }
+    
+    // 解析线程数设置：0表示硬件并发数（至少为1）
+    static size_t resolveThreadCount(size_t requested);
+    
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+    
+    void push(std::function<void()> task);
+    bool popTask(size_t self, std::function<void()>& task);
+    void workerLoop(size_t index);
+    
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> localQueues;   // 每个工作线程一个
+    std::deque<std::function<void()>> tasks;                // 外部线程提交的任务
+    std::mutex queueMutex;
+    std::condition_variable available;
+    size_t pending = 0;         // 所有队列中尚未取出的任务数，受queueMutex保护
+    bool stopping = false;
+};
+
+#endif // THREAD_POOL_H
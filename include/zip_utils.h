@@ -4,9 +4,18 @@
 #include <string>
 #include <filesystem>
 #include <vector>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <memory>
+#include <deque>
+#include "file_utils.h"
 
 namespace fs = std::filesystem;
 
+class ThreadPool;
+
 namespace ZipUtils {
     // ZIP文件操作状态
     enum class ZipStatus {
@@ -15,6 +24,8 @@ namespace ZipUtils {
         DIRECTORY_NOT_FOUND,
         PERMISSION_DENIED,
         SYSTEM_COMMAND_FAILED,
+        INVALID_ARCHIVE,
+        UNSUPPORTED_FEATURE,
         UNKNOWN_ERROR
     };
     
@@ -34,27 +45,414 @@ namespace ZipUtils {
     // 创建ZIP文件
     ZipResult createZip(const fs::path& sourceDir, const fs::path& zipPath);
     
-    // 列出ZIP文件内容
+    // 列出ZIP文件内容（条目名称）
     std::vector<std::string> listZipContents(const fs::path& zipPath);
     
     // 检查文件是否为有效的ZIP文件
     bool isValidZipFile(const fs::path& zipPath);
     
-    // 获取ZIP文件信息
+    // ZIP条目信息（来自中央目录）
+    struct ZipEntry {
+        std::string name;
+        uint16_t method = 0;            // 0=存储, 8=deflate
+        uint16_t flags = 0;
+        uint16_t modTime = 0;
+        uint16_t modDate = 0;
+        uint32_t crc32 = 0;
+        uint64_t compressedSize = 0;
+        uint64_t uncompressedSize = 0;
+        uint64_t localHeaderOffset = 0;
+        uint32_t externalAttributes = 0;
+        
+        bool isDirectory() const { return !name.empty() && name.back() == '/'; }
+        bool isEncrypted() const { return (flags & 0x0001) != 0; }
+    };
+    
+    // 获取ZIP文件信息（内置实现只读取中央目录）
     struct ZipFileInfo {
-        uint64_t compressedSize;
-        uint64_t uncompressedSize;
-        uint32_t fileCount;
+        uint64_t compressedSize = 0;
+        uint64_t uncompressedSize = 0;
+        uint64_t fileCount = 0;
         std::string comment;
+        std::vector<ZipEntry> entries;  // 各条目的大小、CRC32和压缩方法
     };
     
     ZipFileInfo getZipFileInfo(const fs::path& zipPath);
     
+    // 流式条目过滤器：逐块接收解压后的数据，把转换结果追加到out
+    class EntryStreamFilter {
+    public:
+        virtual ~EntryStreamFilter() = default;
+        
+        // last为true表示输入结束，需输出所有剩余数据；返回false表示该条目不能流式处理
+        virtual bool write(const char* data, size_t size, bool last, std::string& out) = 0;
+        
+        // 到目前为止内容是否被修改
+        virtual bool modified() const = 0;
+        
+        // 转换结果已成功写出后调用（只扫描不输出的过滤器不会被调用）
+        virtual void commit() {}
+    };
+    
+    using StreamFilterFactory = std::function<std::unique_ptr<EntryStreamFilter>(const ZipEntry& entry)>;
+    
+#ifdef HAVE_ZLIB
+    // 原生ZIP读取器：解析中央目录，使用zlib解压条目，不依赖外部命令
+    class ZipReader {
+    public:
+        ZipReader() = default;
+        
+        // 打开ZIP文件并解析中央目录（优先内存映射，所有读取直接访问映射区）
+        ZipResult open(const fs::path& zipPath);
+        
+        // 从内存缓冲区打开（不复制数据，调用者需保证缓冲区在读取期间有效）
+        ZipResult openMemory(const void* data, size_t size);
+        
+        bool isOpen() const { return opened; }
+        const std::vector<ZipEntry>& entries() const { return entryList; }
+        const std::string& comment() const { return archiveComment; }
+        
+        // 按名称查找条目
+        const ZipEntry* findEntry(const std::string& name) const;
+        
+        // 解压单个条目到内存（校验CRC32）
+        ZipResult readEntry(const ZipEntry& entry, std::string& content) const;
+        
+        // 分块解压条目，每块交给sink处理（sink返回false时中止），结束时校验CRC32
+        ZipResult streamEntry(const ZipEntry& entry,
+                              const std::function<bool(const char*, size_t)>& sink) const;
+        
+        // 解压单个条目到文件（流式写出，不在内存中保留整个条目）
+        ZipResult extractEntry(const ZipEntry& entry, const fs::path& destPath) const;
+        
+        // 解压所有条目到目录
+        ZipResult extractAll(const fs::path& extractDir) const;
+        
+        // 定位条目的原始压缩数据（解析本地文件头），用于直通复制
+        ZipResult rawData(const ZipEntry& entry, const unsigned char*& data) const;
+        
+    private:
+        ZipResult parseCentralDirectory();
+        
+        FileUtils::MappedFile mappedFile;
+        const unsigned char* base = nullptr;
+        size_t length = 0;
+        std::vector<ZipEntry> entryList;
+        std::string archiveComment;
+        bool opened = false;
+    };
+    
+    // ZIP写入选项
+    struct WriterOptions {
+        int compressionLevel = -1;      // 0-9，-1为zlib默认值
+        size_t threads = 1;             // 压缩线程数，0为硬件并发数
+        size_t chunkSize = 0;           // 大条目拆分压缩的块大小，0为不拆分
+    };
+    
+    // 预先压缩的条目：由ZipWriter::precompress在任意线程中生成，再交给addPrecompressed按顺序写出
+    struct PrecompressedEntry {
+        std::string content;            // 以存储方式写出的内容（已压缩时为空，不再占用内存）
+        std::string deflated;           // 原始deflate数据（各块拼接）
+        size_t size = 0;                // 解压后的大小
+        uint32_t crc32 = 0;
+        bool compressed = false;        // 是否以deflate写出（压缩无收益时为false）
+        bool ok = true;                 // 压缩是否成功
+    };
+    
+    // 以std::string为存储的输出流缓冲区：支持tellp/seekp回写已写出的内容，
+    // 写完后整块移出字符串，不像ostringstream::str()那样复制
+    class StringOutputBuffer : public std::streambuf {
+    public:
+        void reset(size_t capacity = 0);
+        std::string take();
+        
+    protected:
+        std::streamsize xsputn(const char* data, std::streamsize size) override;
+        int_type overflow(int_type ch) override;
+        pos_type seekoff(off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+        
+    private:
+        std::string buffer;
+        size_t position = 0;
+    };
+    
+    // 原生ZIP写入器：直接写入目标文件，边写边计算CRC32，不依赖外部命令
+    class ZipWriter {
+    public:
+        ZipWriter();
+        ~ZipWriter();
+        
+        // 禁止拷贝
+        ZipWriter(const ZipWriter&) = delete;
+        ZipWriter& operator=(const ZipWriter&) = delete;
+        
+        // 创建输出文件
+        ZipResult open(const fs::path& zipPath);
+        
+        // 输出到内存缓冲区（close()后通过takeBuffer()取出，不复制）；
+        // expectedSize为预计的归档大小，用于预先分配缓冲区
+        ZipResult openMemory(size_t expectedSize = 0);
+        std::string takeBuffer();
+        
+        bool isOpen() const { return output != nullptr; }
+        
+        // 添加内存中的数据作为条目（compress=false时以存储方式写入）
+        ZipResult addEntry(const std::string& name, const char* data, size_t size,
+                           bool compress = true);
+        
+        // 接管内容并添加条目；启用多线程时在线程池中压缩，条目仍按添加顺序写出
+        ZipResult addEntry(const std::string& name, std::string&& content, bool compress = true);
+        
+        // 以流方式添加磁盘文件（分块读取、压缩和计算CRC32）
+        ZipResult addFile(const std::string& name, const fs::path& sourcePath,
+                          bool compress = true);
+        
+        // 分块添加条目：beginStream后多次writeStream，最后finishStream（边压缩边写出）
+        // sizeHint为预计的解压后大小，用于决定是否预留ZIP64字段
+        ZipResult beginStream(const std::string& name, uint64_t sizeHint, bool compress = true);
+        ZipResult writeStream(const char* data, size_t size);
+        ZipResult finishStream();
+        
+        // 在调用线程中压缩内容（与addEntry相同的分块方式和压缩结果），不需要打开的写入器
+        static PrecompressedEntry precompress(std::string&& content, bool compress = true,
+                                              int level = -1, size_t chunkSize = 0);
+        
+        // 写出precompress生成的条目（deflate数据移入写入器）
+        ZipResult addPrecompressed(const std::string& name, PrecompressedEntry&& entry);
+        
+        // 原样复制另一个ZIP中的条目（压缩数据和CRC32不变，无需解压/重新压缩）
+        // 前面有未写出的后台压缩条目时会延后写出，compressedData需在close()前保持有效
+        ZipResult addRawEntry(const ZipEntry& source, const unsigned char* compressedData);
+        
+        // 添加目录条目（名称以'/'结尾）
+        ZipResult addDirectory(const std::string& name);
+        
+        // 写入中央目录并关闭文件
+        ZipResult close();
+        
+        // 放弃输出并删除不完整的文件
+        void abort();
+        
+        // 设置deflate压缩级别（0-9，-1为zlib默认值）
+        void setCompressionLevel(int level) { compressionLevel = level; }
+        
+        // 设置压缩线程数（0为硬件并发数，1为在调用线程中压缩）；先写出排队的条目，
+        // 写出失败时错误由之后的添加和close()返回
+        void setCompressionThreads(size_t threads);
+        
+        // 超过该大小的条目拆分为独立压缩的块再拼接（0为不拆分）
+        void setChunkSize(size_t bytes) { chunkSize = bytes; }
+        
+        void setOptions(const WriterOptions& options);
+        
+    private:
+        struct PendingEntry;
+        struct DeflatedChunk;
+        struct QueuedEntry;
+        
+        ZipResult beginEntry(const std::string& name, uint16_t method, bool zip64, PendingEntry& entry);
+        ZipResult finishEntry(PendingEntry& entry);
+        ZipResult writeChunk(PendingEntry& entry, const char* data, size_t size, bool last);
+        ZipResult writeEntryData(const std::string& name, const char* data, size_t size,
+                                 const std::vector<DeflatedChunk>& chunks);
+        ZipResult writeRawEntry(const ZipEntry& source, const unsigned char* compressedData);
+        ZipResult flushQueue(size_t keep);
+        std::vector<std::pair<size_t, size_t>> chunkRanges(size_t size) const;
+        static std::vector<std::pair<size_t, size_t>> chunkRanges(size_t size, size_t chunkSize);
+        static DeflatedChunk deflateChunk(const char* data, size_t size, size_t dictSize,
+                                          bool last, int level);
+        
+        std::ofstream fileOutput;
+        StringOutputBuffer memoryBuffer;
+        std::ostream memoryOutput{&memoryBuffer};
+        std::ostream* output = nullptr;
+        fs::path outputPath;
+        std::vector<ZipEntry> written;
+        int compressionLevel = -1;
+        uint16_t dosTime = 0;
+        uint16_t dosDate = 0;
+        size_t chunkSize = 0;
+        size_t poolThreads = 1;             // 压缩线程数，大于1时按需创建pool
+        std::unique_ptr<ThreadPool> pool;
+        std::unique_ptr<PendingEntry> streaming;
+        std::vector<char> streamBuffer;     // 流式压缩的输出缓冲区，各条目复用
+        std::deque<std::unique_ptr<QueuedEntry>> queue;
+        ZipResult queueError{ZipStatus::SUCCESS, "", 0};    // 写出排队条目时的第一个错误，之后的添加和close()都返回它
+    };
+    
+    // 内存条目表中的条目
+    struct ArchiveEntry {
+        ZipEntry info;
+        std::string content;    // 解压后的内容（仅当loaded为true时有效）
+        bool loaded = false;
+        bool modified = false;  // 为true时写出时重新压缩content
+        bool precompressed = false;     // 为true时直接写出compressed（content已移入其中）
+        PrecompressedEntry compressed;
+    };
+    
+    // 归档重写回调：needsContent决定是否解压条目交给transform处理，
+    // transform返回true表示content已被修改
+    using EntryFilter = std::function<bool(const ZipEntry& entry)>;
+    using EntryTransform = std::function<bool(const ZipEntry& entry, std::string& content)>;
+    
+    // 批量变换：一次处理多个已载入的条目（可以并行），修改过的条目把modified设为true
+    using BatchTransform = std::function<void(std::vector<ArchiveEntry*>& entries)>;
+    
+    // 批量变换设置：选中的条目每攒够size个交给transform一起处理，再按原顺序写出；
+    // 同时驻留内存的条目数受size限制
+    struct BatchOptions {
+        BatchTransform transform;
+        size_t size = 0;                // 0为逐条调用EntryTransform
+    };
+    
+    // 流式处理设置：解压后超过threshold的条目逐块解压、过滤、压缩，不整体载入内存
+    struct StreamingOptions {
+        StreamFilterFactory filterFactory;
+        uint64_t threshold = 0;         // 0为不使用流式处理
+    };
+    
+    // 重写统计
+    struct RewriteStats {
+        size_t entriesCopied = 0;       // 原样复制的条目
+        size_t entriesRecompressed = 0; // 修改后重新压缩的条目
+        size_t entriesStreamed = 0;     // 其中流式处理的条目
+        uint64_t bytesCopied = 0;       // 直通复制的压缩字节数
+    };
+    
+    // ZIP到ZIP重写：未修改的条目直接复制压缩数据，只有被修改的条目重新压缩；
+    // 设置了batch时选中的条目交给batch.transform而不是transform
+    ZipResult rewriteZip(const fs::path& inputPath, const fs::path& outputPath,
+                         const EntryFilter& needsContent, const EntryTransform& transform,
+                         RewriteStats* stats = nullptr,
+                         const WriterOptions& options = WriterOptions(),
+                         const StreamingOptions& streaming = StreamingOptions(),
+                         const BatchOptions& batch = BatchOptions());
+    
+    // 将归档解码为内存条目表（mimetype在前，其余保持原顺序；只解压needsContent选中的条目）
+    ZipResult loadEntries(const ZipReader& reader, const EntryFilter& needsContent,
+                          std::vector<ArchiveEntry>& entries);
+    
+    // 输出条目表：修改过的条目重新压缩，其余条目直接复制原始压缩数据；
+    // 重新压缩的条目内容移交给writer，返回后不再有效
+    ZipResult writeEntries(const ZipReader& reader, std::vector<ArchiveEntry>& entries,
+                           ZipWriter& writer, RewriteStats* stats = nullptr);
+    
+    // 压缩流格式：RAW为ZIP条目使用的原始deflate流（无头和校验），ZLIB带zlib头和Adler-32
+    enum class StreamFormat {
+        RAW,
+        ZLIB
+    };
+    
+    // 流式压缩/解压的处理结果
+    enum class CodecStatus {
+        OK,             // 已处理，可以继续提供输入或输出空间
+        STREAM_END,     // 流已结束
+        FAILED          // 数据损坏或zlib内部错误
+    };
+    
+    // 池化的zlib状态（内部使用z_stream，头文件不依赖zlib.h）
+    struct CodecStream;
+    
+    // 流式压缩器：z_stream取自当前线程的缓存池，归还时用deflateReset复位，
+    // 重复压缩时不再分配zlib状态
+    class Deflater {
+    public:
+        enum class Flush {
+            NONE,       // 尽量缓存输入以获得更好的压缩率
+            SYNC,       // 输出到字节边界，可以与后续独立压缩的数据拼接
+            FINISH      // 结束流
+        };
+        
+        explicit Deflater(int level = -1, StreamFormat format = StreamFormat::RAW);
+        ~Deflater();
+        
+        Deflater(const Deflater&) = delete;
+        Deflater& operator=(const Deflater&) = delete;
+        Deflater(Deflater&& other) noexcept;
+        Deflater& operator=(Deflater&& other) noexcept;
+        
+        // zlib初始化失败时为false
+        bool valid() const { return stream != nullptr; }
+        
+        // 压缩[in, in+inSize)到[out, out+outSize)，两段区间随处理前移；
+        // 输出空间用尽时返回OK并保留剩余输入，输出空间有剩余说明输入已全部处理（含刷新）
+        CodecStatus process(const char*& in, size_t& inSize, char*& out, size_t& outSize, Flush flush);
+        
+        // 压缩data并把结果追加到output
+        bool write(const char* data, size_t size, Flush flush, std::string& output);
+        
+        // 设置预设字典（通常是紧邻本段输入之前的32KB数据），只能在写入数据之前调用
+        bool setDictionary(const char* data, size_t size);
+        
+        // 丢弃当前流，开始新的流（保留压缩级别和格式）
+        void reset();
+        
+        // size字节输入压缩后的最大长度（不含SYNC刷新追加的空块）
+        size_t bound(size_t size) const;
+        
+        uint64_t totalIn() const;
+        uint64_t totalOut() const;
+        
+    private:
+        CodecStream* stream = nullptr;
+    };
+    
+    // 流式解压器：与Deflater共用每线程缓存池，复位使用inflateReset
+    class Inflater {
+    public:
+        explicit Inflater(StreamFormat format = StreamFormat::RAW);
+        ~Inflater();
+        
+        Inflater(const Inflater&) = delete;
+        Inflater& operator=(const Inflater&) = delete;
+        Inflater(Inflater&& other) noexcept;
+        Inflater& operator=(Inflater&& other) noexcept;
+        
+        bool valid() const { return stream != nullptr; }
+        
+        // 解压[in, in+inSize)到[out, out+outSize)，两段区间随处理前移；
+        // 输入用尽或输出空间用尽时返回OK，到达流末尾时返回STREAM_END
+        CodecStatus process(const char*& in, size_t& inSize, char*& out, size_t& outSize);
+        
+        // 解压data并把结果追加到output
+        CodecStatus write(const char* data, size_t size, std::string& output);
+        
+        void reset();
+        
+        uint64_t totalIn() const;
+        uint64_t totalOut() const;
+        
+    private:
+        CodecStream* stream = nullptr;
+    };
+    
+    // 原始deflate数据解压（无zlib头，用于ZIP条目）
+    bool inflateRaw(const unsigned char* data, size_t size, 
+                    std::string& output, uint64_t expectedSize);
+    
+    // 计算任意长度数据的CRC32（zlib单次调用的长度受uInt限制）
+    uint32_t updateCRC32(uint32_t crc, const void* data, size_t size);
+    
+    // 检查条目名称是否可以安全地解压到目标目录（防止路径穿越）
+    bool isSafeEntryName(const std::string& name);
+#endif
+    
     // 平台特定的ZIP实现
     namespace Platform {
+#ifdef HAVE_ZLIB
+        // 内置解压实现（基于zlib）
+        ZipResult extractZipNative(const fs::path& zipPath, const fs::path& extractDir);
+#endif
+        
         // 后备解压实现
         ZipResult extractZipFallback(const fs::path& zipPath, const fs::path& extractDir);
         
+#ifdef HAVE_ZLIB
+        // 内置压缩实现（基于zlib，mimetype作为第一个存储条目）
+        ZipResult createZipNative(const fs::path& sourceDir, const fs::path& zipPath);
+#endif
+        
         // 后备压缩实现
         ZipResult createZipFallback(const fs::path& sourceDir, const fs::path& zipPath);
         
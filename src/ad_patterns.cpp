@@ -1,9 +1,15 @@
 #include "ad_patterns.h"
+#include "pattern_engine.h"
 #include "file_utils.h"
+#include "logger.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 
 using namespace std;
 
@@ -15,8 +21,8 @@ namespace AdPatterns {
                 PatternType::GITHUB_PROJECT,
                 "github_project_ad",
                 R"([\s\r\n]*【[^】]*使用[^】]*项目[^】]*进行[^】]*下载[^】]*：[^】]*】[\s\r\n]*)",
-                "GitHub项目推广广告，包含'使用'、'项目'、'进行'、'下载'等关键词",
-                true
+                "GitHub项目推广广告，包含'使用'、'项目'、'进行'、'下载'等关键词（已被download_ad覆盖，默认不启用）",
+                false
             },
             {
                 PatternType::GITHUB_PROJECT,
@@ -57,25 +63,46 @@ namespace AdPatterns {
                 PatternType::GENERAL_AD,
                 "project_download_ad",
                 R"([\s\r\n]*【[^】]*项目[^】]*下载[^】]*】[\s\r\n]*)",
-                "同时包含'项目'和'下载'的广告",
-                true
+                "同时包含'项目'和'下载'的广告（已被download_ad覆盖，默认不启用）",
+                false
             }
         };
     }
     
-    vector<regex> loadPatternsFromFile(const string& filePath) {
-        vector<regex> patterns;
-        
+    bool parseEngine(const string& name, Engine& engine) {
+        if (name == "auto") {
+            engine = Engine::AUTO;
+        } else if (name == "dfa") {
+            engine = Engine::DFA;
+        } else if (name == "std") {
+            engine = Engine::STD_REGEX;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    
+    const char* engineName(Engine engine) {
+        switch (engine) {
+            case Engine::AUTO: return "auto";
+            case Engine::DFA: return "dfa";
+            case Engine::STD_REGEX: return "std";
+        }
+        return "auto";
+    }
+    
+    // 读取模式文件中的有效行（去除首尾空白，跳过空行和注释），附带行号
+    static bool readPatternLines(const string& filePath, vector<pair<int, string>>& lines) {
         if (!FileUtils::fileExists(filePath)) {
             cerr << "错误: 模式文件不存在: " << filePath << endl;
-            return patterns;
+            return false;
         }
         
         try {
             ifstream file(filePath);
             if (!file.is_open()) {
                 cerr << "错误: 无法打开模式文件: " << filePath << endl;
-                return patterns;
+                return false;
             }
             
             string line;
@@ -96,27 +123,101 @@ namespace AdPatterns {
                     continue;
                 }
                 
-                // 验证并添加模式
-                if (validatePattern(line)) {
-                    try {
-                        patterns.emplace_back(line, regex::optimize | regex::icase);
-                    } catch (const regex_error& e) {
-                        cerr << "警告: 第 " << lineNum << " 行无效的正则表达式: " << line << endl;
-                        cerr << "错误信息: " << e.what() << endl;
-                    }
-                } else {
-                    cerr << "警告: 第 " << lineNum << " 行无效的模式: " << line << endl;
-                }
+                lines.emplace_back(lineNum, line);
             }
             
             file.close();
             
-            cout << "从文件加载了 " << patterns.size() << " 个广告模式" << endl;
-            
         } catch (const exception& e) {
             cerr << "读取模式文件时发生异常: " << e.what() << endl;
+            return false;
+        }
+        
+        return true;
+    }
+    
+    vector<regex> loadPatternsFromFile(const string& filePath) {
+        vector<regex> patterns;
+        
+        vector<pair<int, string>> lines;
+        if (!readPatternLines(filePath, lines)) {
+            return patterns;
         }
         
+        for (const auto& entry : lines) {
+            // 编译本身就是验证，每个模式只编译一次
+            try {
+                patterns.emplace_back(entry.second, regex::optimize | regex::icase);
+            } catch (const regex_error& e) {
+                cerr << "警告: 第 " << entry.first << " 行无效的正则表达式: " << entry.second << endl;
+                cerr << "错误信息: " << e.what() << endl;
+            }
+        }
+        
+        cout << "从文件加载了 " << patterns.size() << " 个广告模式" << endl;
+        
+        return patterns;
+    }
+    
+    vector<string> loadPatternStringsFromFile(const string& filePath) {
+        vector<string> patterns;
+        vector<pair<int, string>> lines;
+        if (readPatternLines(filePath, lines)) {
+            for (auto& entry : lines) {
+                patterns.push_back(std::move(entry.second));
+            }
+        }
+        return patterns;
+    }
+    
+    PatternSet loadPatternSetFromFile(const string& filePath, Engine engine) {
+        PatternSet patterns;
+        
+        if (isPatternBundle(filePath)) {
+            string error;
+            if (!loadPatternBundle(filePath, patterns, &error)) {
+                cerr << "错误: 无法加载预编译模式包: " << filePath << endl;
+                cerr << "错误信息: " << error << endl;
+                return PatternSet();
+            }
+            cout << "从预编译模式包加载了 " << patterns.size() << " 个广告模式" << endl;
+            return patterns;
+        }
+        
+        vector<pair<int, string>> lines;
+        if (!readPatternLines(filePath, lines)) {
+            return patterns;
+        }
+        
+        vector<int> entryLines;
+        for (const auto& entry : lines) {
+            string error;
+            if (patterns.add(entry.second, engine, &error)) {
+                entryLines.push_back(entry.first);
+            } else {
+                cerr << "警告: 第 " << entry.first << " 行无效的正则表达式: " << entry.second << endl;
+                cerr << "错误信息: " << error << endl;
+            }
+        }
+        
+        // 回溯隐患只对std::regex执行的模式是实际风险
+        PatternAnalysis analysis = analyzePatternSet(patterns);
+        for (const auto& hazard : analysis.hazards) {
+            if (patterns.engineOf(hazard.index) == Engine::STD_REGEX) {
+                cerr << "警告: 第 " << entryLines[hazard.index] << " 行的模式使用std::regex执行，最坏情况可能很慢: "
+                     << hazard.description << endl;
+            }
+        }
+        vector<size_t> redundant;
+        for (const auto& item : analysis.redundant) {
+            cout << "跳过冗余模式: 第 " << entryLines[item.index] << " 行（被第 "
+                 << entryLines[item.coveredBy] << " 行的模式覆盖）" << endl;
+            redundant.push_back(item.index);
+        }
+        patterns = patterns.without(redundant);
+        
+        cout << "从文件加载了 " << patterns.size() << " 个广告模式" << endl;
+        
         return patterns;
     }
     
@@ -136,6 +237,36 @@ namespace AdPatterns {
         return patterns;
     }
     
+    PatternSet createPatternSet(const vector<string>& patternStrings, Engine engine) {
+        PatternSet patterns;
+        for (const auto& patternStr : patternStrings) {
+            string error;
+            if (!patterns.add(patternStr, engine, &error)) {
+                cerr << "警告: 无效的正则表达式模式: " << patternStr << endl;
+                cerr << "错误信息: " << error << endl;
+            }
+        }
+        return patterns;
+    }
+    
+    const PatternSet& builtinPatternSet(Engine engine) {
+        static once_flag compiledOnce[3];
+        static PatternSet compiled[3];
+        size_t slot = static_cast<size_t>(engine);
+        call_once(compiledOnce[slot], [engine, slot]() {
+            vector<string> patternStrings;
+            for (const auto& pattern : getBuiltinPatterns()) {
+                if (pattern.enabled) {
+                    patternStrings.push_back(pattern.pattern);
+                }
+            }
+            // 被其他模式覆盖的内置模式已在getBuiltinPatterns()中停用（由测试保证），
+            // 启动时不再做冗余分析
+            compiled[slot] = createPatternSet(patternStrings, engine);
+        });
+        return compiled[slot];
+    }
+    
     vector<regex> getDefaultPatterns() {
         auto builtinPatterns = getBuiltinPatterns();
         vector<string> patternStrings;
@@ -177,6 +308,756 @@ namespace AdPatterns {
         return result;
     }
     
+    // ==================== 模式集合 ====================
+    
+    struct ScanScratch::State {
+        // 每个模式缓存下一处匹配，只有被前面选中的匹配越过时才重新搜索
+        struct Candidate {
+            size_t offset = 0;
+            size_t length = 0;
+            bool searched = false;
+            bool exhausted = false;
+        };
+        
+        // 当前绑定的集合：持有引用，保证缓存中的DFA所属的模式不会被释放
+        shared_ptr<const CompiledPatternSet> set;
+        shared_ptr<const CompiledPatternSet::Prefilter> prefilter;
+        vector<PatternEngine::MatchCache> caches;
+        vector<Candidate> next;
+        vector<PatternEngine::LiteralMatcher::Hit> found;
+        vector<vector<size_t>> hits;
+        vector<size_t> hitIndex;
+    };
+    
+    ScanScratch::ScanScratch() : state(new State()) {}
+    ScanScratch::~ScanScratch() = default;
+    
+    Engine CompiledPatternSet::engineOf(size_t index) const {
+        return entries[index].dfa ? Engine::DFA : Engine::STD_REGEX;
+    }
+    
+    PatternSet::PatternSet(vector<regex> patterns) {
+        if (patterns.empty()) {
+            return;
+        }
+        CompiledPatternSet& target = mutableData();
+        target.entries.reserve(patterns.size());
+        for (auto& pattern : patterns) {
+            target.entries.push_back({string(), make_shared<const regex>(std::move(pattern)), nullptr});
+        }
+    }
+    
+    CompiledPatternSet& PatternSet::mutableData() {
+        if (!data) {
+            data = make_shared<CompiledPatternSet>();
+        } else if (data.use_count() > 1) {
+            auto copy = make_shared<CompiledPatternSet>();
+            copy->entries = data->entries;
+            data = std::move(copy);
+        }
+        data->prefilter.reset();
+        return *data;
+    }
+    
+    void PatternSet::add(const regex& pattern) {
+        mutableData().entries.push_back({string(), make_shared<const regex>(pattern), nullptr});
+    }
+    
+    bool PatternSet::add(const string& pattern, Engine engine, string* error) {
+        if (pattern.empty()) {
+            if (error) {
+                *error = "空模式";
+            }
+            return false;
+        }
+        
+        CompiledPatternSet::Entry entry;
+        entry.source = pattern;
+        if (engine != Engine::STD_REGEX) {
+            string message;
+            auto compiled = PatternEngine::Regex::compile(pattern, true, message);
+            if (compiled) {
+                entry.dfa = std::move(compiled);
+                mutableData().entries.push_back(std::move(entry));
+                return true;
+            }
+            if (engine == Engine::DFA) {
+                if (error) {
+                    *error = message;
+                }
+                return false;
+            }
+        }
+        
+        try {
+            entry.regex = make_shared<const regex>(pattern, regex::optimize | regex::icase);
+        } catch (const regex_error& e) {
+            if (error) {
+                *error = e.what();
+            }
+            return false;
+        }
+        mutableData().entries.push_back(std::move(entry));
+        return true;
+    }
+    
+    void PatternSet::clear() {
+        data.reset();
+    }
+    
+    PatternSet PatternSet::withEngine(Engine engine) const {
+        PatternSet result;
+        if (!data) {
+            return result;
+        }
+        for (const auto& entry : data->entries) {
+            if (entry.source.empty() || !result.add(entry.source, engine)) {
+                result.mutableData().entries.push_back(entry);
+            }
+        }
+        return result;
+    }
+    
+    PatternSet PatternSet::without(const vector<size_t>& indices) const {
+        if (indices.empty() || !data) {
+            return *this;
+        }
+        PatternSet result;
+        CompiledPatternSet& target = result.mutableData();
+        for (size_t i = 0; i < data->entries.size(); ++i) {
+            if (find(indices.begin(), indices.end(), i) == indices.end()) {
+                target.entries.push_back(data->entries[i]);
+            }
+        }
+        return result;
+    }
+    
+    const string& PatternSet::sourceOf(size_t index) const {
+        return data->entries[index].source;
+    }
+    
+    // ==================== 按模式计数 ====================
+    
+    PatternCounters& PatternCounters::operator+=(const PatternCounters& other) {
+        invocations += other.invocations;
+        matches += other.matches;
+        bytesScanned += other.bytesScanned;
+        bytesRemoved += other.bytesRemoved;
+        nanoseconds += other.nanoseconds;
+        return *this;
+    }
+    
+    struct alignas(64) PatternProfile::Slot {
+        atomic<uint64_t> invocations{0};
+        atomic<uint64_t> matches{0};
+        atomic<uint64_t> bytesScanned{0};
+        atomic<uint64_t> bytesRemoved{0};
+        atomic<uint64_t> nanoseconds{0};
+    };
+    
+    PatternProfile::PatternProfile(const PatternSet& patterns) : slots(new Slot[patterns.size()]) {
+        for (size_t i = 0; i < patterns.size(); ++i) {
+            sources.push_back(patterns.sourceOf(i));
+        }
+    }
+    
+    PatternProfile::~PatternProfile() = default;
+    
+    void PatternProfile::merge(const vector<PatternCounters>& counters) {
+        size_t count = min(counters.size(), sources.size());
+        for (size_t i = 0; i < count; ++i) {
+            const PatternCounters& delta = counters[i];
+            if (delta.invocations == 0 && delta.matches == 0) {
+                continue;
+            }
+            Slot& slot = slots[i];
+            slot.invocations.fetch_add(delta.invocations, memory_order_relaxed);
+            slot.matches.fetch_add(delta.matches, memory_order_relaxed);
+            slot.bytesScanned.fetch_add(delta.bytesScanned, memory_order_relaxed);
+            slot.bytesRemoved.fetch_add(delta.bytesRemoved, memory_order_relaxed);
+            slot.nanoseconds.fetch_add(delta.nanoseconds, memory_order_relaxed);
+        }
+    }
+    
+    PatternCounters PatternProfile::get(size_t index) const {
+        const Slot& slot = slots[index];
+        PatternCounters counters;
+        counters.invocations = slot.invocations.load(memory_order_relaxed);
+        counters.matches = slot.matches.load(memory_order_relaxed);
+        counters.bytesScanned = slot.bytesScanned.load(memory_order_relaxed);
+        counters.bytesRemoved = slot.bytesRemoved.load(memory_order_relaxed);
+        counters.nanoseconds = slot.nanoseconds.load(memory_order_relaxed);
+        return counters;
+    }
+    
+    void PatternProfile::reset() {
+        for (size_t i = 0; i < sources.size(); ++i) {
+            Slot& slot = slots[i];
+            slot.invocations.store(0, memory_order_relaxed);
+            slot.matches.store(0, memory_order_relaxed);
+            slot.bytesScanned.store(0, memory_order_relaxed);
+            slot.bytesRemoved.store(0, memory_order_relaxed);
+            slot.nanoseconds.store(0, memory_order_relaxed);
+        }
+    }
+    
+    PatternAnalysis analyzePatternSet(const PatternSet& patterns) {
+        PatternAnalysis analysis;
+        shared_ptr<const CompiledPatternSet> compiled = patterns.compiled();
+        if (!compiled) {
+            return analysis;
+        }
+        const auto& entries = compiled->entries;
+        size_t count = entries.size();
+        
+        // 只有DFA执行的模式参与包含关系分析。std::regex按字节匹配（如[^】]匹配】的UTF-8编码以外的
+        // 任意单个字节，会匹配到其他汉字中间的字节），与DFA按码点匹配的结果不同，不能用DFA证明
+        vector<const PatternEngine::Regex*> regexes(count, nullptr);
+        for (size_t i = 0; i < count; ++i) {
+            regexes[i] = entries[i].dfa.get();
+            
+            vector<string> hazards;
+            if (!entries[i].source.empty() && PatternEngine::findBacktrackingHazards(entries[i].source, hazards)) {
+                for (auto& description : hazards) {
+                    analysis.hazards.push_back({i, std::move(description)});
+                }
+            }
+        }
+        
+        // 集合规则：起点最靠前的匹配优先，起点相同时排在前面的模式优先。
+        // 每次只删去一个模式，判断都基于删去之前的模式后剩下的集合
+        using Result = PatternEngine::MatchComparer::Result;
+        PatternEngine::MatchComparer comparer(regexes);
+        vector<bool> removed(count, false);
+        for (size_t i = 0; i < count; ++i) {
+            if (!regexes[i]) {
+                continue;
+            }
+            // 排在前面的模式在它匹配的每个起点上都有匹配：它永远不会被选中
+            for (size_t j = 0; j < i && !removed[i]; ++j) {
+                if (!removed[j] && regexes[j] && comparer.check(i, j, true, false) == Result::YES) {
+                    analysis.redundant.push_back({i, j});
+                    removed[i] = true;
+                }
+            }
+            // 排在后面的模式在它匹配的每个起点上都有终点相同的匹配，且两者之间的模式
+            // 与它在同一起点都有匹配时终点也相同：删去后同一处由后面的模式移除，内容不变
+            for (size_t j = i + 1; j < count && !removed[i]; ++j) {
+                if (!regexes[j]) {
+                    break;
+                }
+                if (comparer.check(i, j, true, true) != Result::YES) {
+                    continue;
+                }
+                bool agreed = true;
+                for (size_t k = i + 1; k < j && agreed; ++k) {
+                    agreed = comparer.check(i, k, false, true) == Result::YES;
+                }
+                if (!agreed) {
+                    break;
+                }
+                analysis.redundant.push_back({i, j});
+                removed[i] = true;
+            }
+        }
+        return analysis;
+    }
+    
+    shared_ptr<const CompiledPatternSet::Prefilter> CompiledPatternSet::currentPrefilter() const {
+        // 多个线程同时构建时结果相同，保留任意一个即可
+        shared_ptr<const Prefilter> current = atomic_load(&prefilter);
+        if (current) {
+            return current;
+        }
+        
+        auto built = make_shared<Prefilter>();
+        auto matcher = make_shared<PatternEngine::LiteralMatcher>();
+        built->filtered.assign(entries.size(), false);
+        built->minLiteralLength.assign(entries.size(), 0);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (!entries[i].dfa || entries[i].dfa->requiredLiterals().empty()) {
+                continue;
+            }
+            size_t shortest = string::npos;
+            for (const auto& literal : entries[i].dfa->requiredLiterals()) {
+                uint32_t id = matcher->add(literal);
+                built->literalEntries.resize(id + 1);
+                built->literalEntries[id].push_back(i);
+                shortest = min(shortest, literal.size());
+            }
+            built->filtered[i] = true;
+            built->minLiteralLength[i] = shortest;
+            built->filteredCount++;
+        }
+        matcher->build();
+        built->matcher = std::move(matcher);
+        
+        current = std::move(built);
+        atomic_store(&prefilter, current);
+        return current;
+    }
+    
+    vector<MatchSpan> PatternSet::findAll(const string& content, ScanStats* stats) const {
+        ScanScratch scratch;
+        return findAll(content, scratch, stats);
+    }
+    
+    vector<MatchSpan> PatternSet::findAll(const string& content, ScanScratch& scratch, ScanStats* stats) const {
+        vector<MatchSpan> matches;
+        scan(content.data(), content.size(), 0, content.size(), false, matches, scratch, stats);
+        return matches;
+    }
+    
+    size_t PatternSet::scan(const char* data, size_t size, size_t start, size_t limit, bool partial,
+                            vector<MatchSpan>& matches, ScanStats* stats) const {
+        ScanScratch scratch;
+        return scan(data, size, start, limit, partial, matches, scratch, stats);
+    }
+    
+    size_t PatternSet::scan(const char* data, size_t size, size_t start, size_t limit, bool partial,
+                            vector<MatchSpan>& matches, ScanScratch& scratch, ScanStats* stats) const {
+        if (!this->data) {
+            return max(start, limit);
+        }
+        return this->data->scan(data, size, start, limit, partial, matches, scratch, stats);
+    }
+    
+    size_t CompiledPatternSet::scan(const char* data, size_t size, size_t start, size_t limit, bool partial,
+                                    vector<MatchSpan>& matches, ScanScratch& scratch, ScanStats* stats) const {
+        using Candidate = ScanScratch::State::Candidate;
+        ScanScratch::State& local = *scratch.state;
+        if (local.set.get() != this) {
+            local.set = shared_from_this();
+            local.prefilter.reset();
+            local.caches.clear();
+            local.caches.resize(entries.size());
+        }
+        
+        // 每个模式大致只扫描文档一遍
+        vector<Candidate>& next = local.next;
+        next.assign(entries.size(), Candidate());
+        
+        PatternCounters* counters = nullptr;
+        if (stats && stats->profile) {
+            if (stats->patterns.size() < entries.size()) {
+                stats->patterns.resize(entries.size());
+            }
+            counters = stats->patterns.data();
+        }
+        
+        // 预过滤：找出所有必需字面量的位置。任何匹配都包含某个字面量，
+        // 所以匹配的起点不晚于该模式最后一个字面量的起点
+        vector<vector<size_t>>& hits = local.hits;
+        vector<size_t>& hitIndex = local.hitIndex;
+        hits.clear();
+        const Prefilter* filter = nullptr;
+        if (start < limit && !entries.empty()) {
+            if (!local.prefilter) {
+                local.prefilter = currentPrefilter();
+            }
+            filter = local.prefilter.get();
+        }
+        if (filter && filter->filteredCount > 0) {
+            vector<PatternEngine::LiteralMatcher::Hit>& found = local.found;
+            found.clear();
+            filter->matcher->findAll(data + start, size - start, found);
+            hits.resize(entries.size());
+            for (auto& positions : hits) {
+                positions.clear();
+            }
+            hitIndex.assign(entries.size(), 0);
+            for (const auto& hit : found) {
+                for (size_t entry : filter->literalEntries[hit.literal]) {
+                    hits[entry].push_back(start + hit.position);
+                }
+            }
+            
+            size_t candidateEnd = start;
+            for (size_t i = 0; i < entries.size(); ++i) {
+                if (!filter->filtered[i]) {
+                    candidateEnd = limit;
+                } else if (hits[i].empty()) {
+                    next[i].exhausted = true;
+                } else {
+                    sort(hits[i].begin(), hits[i].end());
+                    candidateEnd = max(candidateEnd, min(limit, hits[i].back() + 1));
+                }
+            }
+            if (stats) {
+                stats->bytesSkipped += limit - candidateEnd;
+            }
+        }
+        
+        // 在有字面量的位置附近搜索模式i从pos开始的第一个匹配
+        auto searchFiltered = [&](size_t i, size_t pos, Candidate& candidate) {
+            const auto& positions = hits[i];
+            size_t& k = hitIndex[i];
+            size_t maxLength = entries[i].dfa->maxMatchLength();
+            size_t searchLimit = min(limit, positions.back() + 1);
+            size_t cursor = pos;
+            while (true) {
+                while (k < positions.size() && positions[k] < cursor) {
+                    k++;
+                }
+                if (k == positions.size()) {
+                    return false;
+                }
+                size_t from = cursor;
+                size_t windowLimit = searchLimit;
+                if (maxLength != PatternEngine::Regex::UNBOUNDED) {
+                    // 包含positions[k]处字面量的匹配起点不早于该字面量结束处减去最大长度
+                    size_t literalEnd = positions[k] + filter->minLiteralLength[i];
+                    if (literalEnd > maxLength) {
+                        from = max(cursor, literalEnd - maxLength);
+                    }
+                    windowLimit = min(searchLimit, positions[k] + 1);
+                }
+                size_t matchStart = 0;
+                size_t matchEnd = 0;
+                if (entries[i].dfa->search(data, size, from, windowLimit, partial, matchStart, matchEnd,
+                                           local.caches[i])) {
+                    candidate.offset = matchStart;
+                    candidate.length = matchEnd - matchStart;
+                    return true;
+                }
+                if (windowLimit >= searchLimit) {
+                    return false;
+                }
+                cursor = windowLimit;
+            }
+        };
+        
+        auto baseFlags = regex_constants::match_not_null;
+        if (partial) {
+            baseFlags |= regex_constants::match_not_eol | regex_constants::match_not_eow;
+        }
+        
+        const char* end = data + size;
+        size_t pos = start;
+        while (pos < limit) {
+            size_t best = entries.size();
+            for (size_t i = 0; i < entries.size(); ++i) {
+                Candidate& candidate = next[i];
+                if (candidate.exhausted) {
+                    continue;
+                }
+                if (!candidate.searched || candidate.offset < pos) {
+                    candidate.searched = true;
+                    chrono::steady_clock::time_point searchBegin;
+                    if (counters) {
+                        searchBegin = chrono::steady_clock::now();
+                    }
+                    if (!hits.empty() && filter->filtered[i]) {
+                        candidate.exhausted = !searchFiltered(i, pos, candidate);
+                    } else if (entries[i].dfa) {
+                        // DFA引擎只报告起点在limit之前的匹配
+                        size_t matchStart = 0;
+                        size_t matchEnd = 0;
+                        if (entries[i].dfa->search(data, size, pos, limit, partial, matchStart, matchEnd,
+                                               local.caches[i])) {
+                            candidate.offset = matchStart;
+                            candidate.length = matchEnd - matchStart;
+                        } else {
+                            candidate.exhausted = true;
+                        }
+                    } else {
+                        try {
+                            auto flags = baseFlags;
+                            if (pos > 0) {
+                                flags |= regex_constants::match_prev_avail;
+                            }
+                            cmatch match;
+                            if (regex_search(data + pos, end, match, *entries[i].regex, flags)) {
+                                candidate.offset = pos + static_cast<size_t>(match.position(0));
+                                candidate.length = static_cast<size_t>(match.length(0));
+                            } else {
+                                candidate.exhausted = true;
+                            }
+                        } catch (const regex_error& e) {
+                            Logger::ErrorLine() << "正则表达式错误: " << e.what();
+                            candidate.exhausted = true;
+                            if (stats) {
+                                stats->errors++;
+                            }
+                        }
+                    }
+                    if (counters) {
+                        PatternCounters& counter = counters[i];
+                        counter.invocations++;
+                        counter.nanoseconds += static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+                            chrono::steady_clock::now() - searchBegin).count());
+                        counter.bytesScanned += candidate.exhausted ? limit - pos
+                                                                    : candidate.offset + candidate.length - pos;
+                    }
+                    if (!candidate.exhausted && candidate.offset >= limit) {
+                        candidate.exhausted = true;
+                    }
+                    if (candidate.exhausted) {
+                        continue;
+                    }
+                }
+                if (best == entries.size() || candidate.offset < next[best].offset) {
+                    best = i;
+                }
+            }
+            
+            if (best == entries.size()) {
+                break;
+            }
+            matches.push_back({next[best].offset, next[best].length, best});
+            pos = next[best].offset + next[best].length;
+            if (counters) {
+                counters[best].matches++;
+                counters[best].bytesRemoved += next[best].length;
+            }
+        }
+        
+        return max(pos, limit);
+    }
+    
+    // ==================== 预编译模式包 ====================
+    
+    // 文件头：魔数(8) + 版本(4) + 载荷长度(8) + 载荷校验和(8)，之后是载荷
+    static const char BUNDLE_MAGIC[8] = {'E', 'P', 'C', 'P', 'A', 'T', 'S', '\0'};
+    static const size_t BUNDLE_HEADER_SIZE = 28;
+    
+    // 按小端序8字节分组的FNV-1a（与主机字节序无关），末尾不足8字节的部分逐字节处理
+    static uint64_t bundleChecksum(const unsigned char* data, size_t size) {
+        const uint64_t prime = 1099511628211ULL;
+        uint64_t hash = 14695981039346656037ULL;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word = 0;
+            for (int k = 0; k < 8; ++k) {
+                word |= static_cast<uint64_t>(data[i + k]) << (8 * k);
+            }
+            hash = (hash ^ word) * prime;
+        }
+        for (; i < size; ++i) {
+            hash = (hash ^ data[i]) * prime;
+        }
+        return hash;
+    }
+    
+    bool isPatternBundle(const string& filePath) {
+        ifstream file(filePath, ios::binary);
+        char magic[sizeof(BUNDLE_MAGIC)] = {};
+        return file.read(magic, sizeof(magic)) && memcmp(magic, BUNDLE_MAGIC, sizeof(magic)) == 0;
+    }
+    
+    bool savePatternBundle(const PatternSet& patterns, const string& filePath, string* error) {
+        auto fail = [&](const string& message) {
+            if (error) {
+                *error = message;
+            }
+            return false;
+        };
+        
+        // 载荷：模式列表（引擎、源字符串、DFA编译结果），然后是预过滤器
+        PatternEngine::BinaryWriter payload;
+        auto compiled = patterns.compiled();
+        size_t count = compiled ? compiled->entries.size() : 0;
+        payload.u32(static_cast<uint32_t>(count));
+        for (size_t i = 0; i < count; ++i) {
+            const auto& entry = compiled->entries[i];
+            if (entry.source.empty()) {
+                return fail("第 " + to_string(i + 1) + " 个模式没有源字符串，无法保存");
+            }
+            payload.u8(entry.dfa ? 1 : 0);
+            payload.str(entry.source);
+            if (entry.dfa) {
+                entry.dfa->serialize(payload);
+            }
+        }
+        
+        if (count > 0) {
+            auto filter = compiled->currentPrefilter();
+            filter->matcher->serialize(payload);
+            payload.u32(static_cast<uint32_t>(filter->literalEntries.size()));
+            for (const auto& owners : filter->literalEntries) {
+                payload.u32(static_cast<uint32_t>(owners.size()));
+                for (size_t owner : owners) {
+                    payload.u32(static_cast<uint32_t>(owner));
+                }
+            }
+            for (size_t i = 0; i < count; ++i) {
+                payload.u8(filter->filtered[i] ? 1 : 0);
+                payload.u64(filter->minLiteralLength[i]);
+            }
+        }
+        
+        const string& body = payload.buffer();
+        PatternEngine::BinaryWriter header;
+        header.bytes(BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC));
+        header.u32(PATTERN_BUNDLE_VERSION);
+        header.u64(body.size());
+        header.u64(bundleChecksum(reinterpret_cast<const unsigned char*>(body.data()), body.size()));
+        
+        ofstream file(filePath, ios::binary | ios::trunc);
+        if (!file.is_open()) {
+            return fail("无法创建文件: " + filePath);
+        }
+        file.write(header.buffer().data(), static_cast<streamsize>(header.buffer().size()));
+        file.write(body.data(), static_cast<streamsize>(body.size()));
+        file.close();
+        if (!file) {
+            return fail("写入文件失败: " + filePath);
+        }
+        return true;
+    }
+    
+    bool loadPatternBundle(const string& filePath, PatternSet& patterns, string* error) {
+        auto fail = [&](const string& message) {
+            if (error) {
+                *error = message;
+            }
+            return false;
+        };
+        
+        FileUtils::MappedFile file;
+        if (!file.open(filePath)) {
+            return fail("无法打开文件: " + filePath);
+        }
+        if (file.size() < BUNDLE_HEADER_SIZE) {
+            return fail("文件太小，不是预编译模式包");
+        }
+        
+        PatternEngine::BinaryReader header(file.data(), BUNDLE_HEADER_SIZE);
+        char magic[sizeof(BUNDLE_MAGIC)];
+        uint32_t version = 0;
+        uint64_t payloadSize = 0;
+        uint64_t checksum = 0;
+        header.bytes(magic, sizeof(magic));
+        header.u32(version);
+        header.u64(payloadSize);
+        header.u64(checksum);
+        if (memcmp(magic, BUNDLE_MAGIC, sizeof(magic)) != 0) {
+            return fail("不是预编译模式包");
+        }
+        if (version != PATTERN_BUNDLE_VERSION) {
+            return fail("不支持的模式包版本: " + to_string(version) + "（当前版本 " +
+                        to_string(PATTERN_BUNDLE_VERSION) + "），请重新编译模式文件");
+        }
+        const unsigned char* body = file.data() + BUNDLE_HEADER_SIZE;
+        if (payloadSize != file.size() - BUNDLE_HEADER_SIZE) {
+            return fail("文件长度与记录的不符，文件可能被截断");
+        }
+        if (bundleChecksum(body, static_cast<size_t>(payloadSize)) != checksum) {
+            return fail("校验和不匹配，文件已损坏");
+        }
+        
+        PatternEngine::BinaryReader in(body, static_cast<size_t>(payloadSize));
+        auto compiled = make_shared<CompiledPatternSet>();
+        uint32_t count = 0;
+        if (!in.u32(count)) {
+            return fail("数据不完整");
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            uint8_t isDfa = 0;
+            CompiledPatternSet::Entry entry;
+            if (!in.u8(isDfa) || !in.str(entry.source)) {
+                return fail("数据不完整");
+            }
+            if (isDfa) {
+                string message;
+                auto dfa = PatternEngine::Regex::deserialize(in, message);
+                if (!dfa) {
+                    return fail("第 " + to_string(i + 1) + " 个模式: " + message);
+                }
+                entry.dfa = std::move(dfa);
+            } else {
+                // std::regex没有可保存的内部表示，只能重新编译
+                try {
+                    entry.regex = make_shared<const regex>(entry.source, regex::optimize | regex::icase);
+                } catch (const regex_error& e) {
+                    return fail("第 " + to_string(i + 1) + " 个模式: " + e.what());
+                }
+            }
+            compiled->entries.push_back(std::move(entry));
+        }
+        
+        if (count > 0) {
+            auto filter = make_shared<CompiledPatternSet::Prefilter>();
+            filter->matcher = PatternEngine::LiteralMatcher::deserialize(in);
+            uint32_t literalCount = 0;
+            if (!filter->matcher || !in.u32(literalCount) || literalCount != filter->matcher->size()) {
+                return fail("无效的预过滤表");
+            }
+            filter->literalEntries.resize(literalCount);
+            for (auto& owners : filter->literalEntries) {
+                uint32_t ownerCount = 0;
+                if (!in.u32(ownerCount)) {
+                    return fail("数据不完整");
+                }
+                for (uint32_t k = 0; k < ownerCount; ++k) {
+                    uint32_t owner = 0;
+                    if (!in.u32(owner) || owner >= count || !compiled->entries[owner].dfa) {
+                        return fail("无效的预过滤表");
+                    }
+                    owners.push_back(owner);
+                }
+            }
+            filter->filtered.assign(count, false);
+            filter->minLiteralLength.assign(count, 0);
+            for (uint32_t i = 0; i < count; ++i) {
+                uint8_t filtered = 0;
+                uint64_t minLength = 0;
+                if (!in.u8(filtered) || !in.u64(minLength)) {
+                    return fail("数据不完整");
+                }
+                if (filtered && !compiled->entries[i].dfa) {
+                    return fail("无效的预过滤表");
+                }
+                filter->filtered[i] = filtered != 0;
+                filter->minLiteralLength[i] = static_cast<size_t>(minLength);
+                if (filtered) {
+                    filter->filteredCount++;
+                }
+            }
+            compiled->prefilter = std::move(filter);
+        }
+        if (!in.atEnd()) {
+            return fail("文件末尾有多余数据");
+        }
+        
+        patterns.data = std::move(compiled);
+        return true;
+    }
+    
+    string PatternSet::removeMatches(const string& content, const vector<MatchSpan>& matches) {
+        size_t removed = 0;
+        for (const auto& match : matches) {
+            removed += match.length;
+        }
+        
+        string result;
+        result.reserve(content.size() - removed);
+        size_t pos = 0;
+        for (const auto& match : matches) {
+            result.append(content, pos, match.offset - pos);
+            pos = match.offset + match.length;
+        }
+        result.append(content, pos, string::npos);
+        return result;
+    }
+    
+    void PatternSet::eraseMatches(string& content, const vector<MatchSpan>& matches) {
+        if (matches.empty()) {
+            return;
+        }
+        char* data = &content[0];
+        size_t write = matches.front().offset;
+        for (size_t i = 0; i < matches.size(); ++i) {
+            size_t keepBegin = matches[i].offset + matches[i].length;
+            size_t keepEnd = i + 1 < matches.size() ? matches[i + 1].offset : content.size();
+            if (keepEnd > keepBegin) {
+                memmove(data + write, data + keepBegin, keepEnd - keepBegin);
+                write += keepEnd - keepBegin;
+            }
+        }
+        content.resize(write);
+    }
+    
     // PatternMatcher 实现
     PatternMatcher::PatternMatcher() {
         resetMatchStats();
@@ -188,55 +1069,105 @@ namespace AdPatterns {
     }
     
     void PatternMatcher::addPattern(const regex& pattern) {
-        patterns.push_back(pattern);
+        patterns.add(pattern);
     }
     
     void PatternMatcher::addPattern(const string& pattern) {
-        try {
-            patterns.emplace_back(pattern, regex::optimize | regex::icase);
-        } catch (const regex_error& e) {
+        // 保留源字符串，匹配统计中可以按模式报告
+        string error;
+        if (!patterns.add(pattern, Engine::AUTO, &error)) {
             cerr << "错误: 无效的正则表达式模式: " << pattern << endl;
-            cerr << "错误信息: " << e.what() << endl;
+            cerr << "错误信息: " << error << endl;
         }
     }
     
     string PatternMatcher::cleanContent(const string& content) {
-        string result = content;
+        ScanStats scanStats;
+        scanStats.profile = profiling;
+        vector<MatchSpan> matches = patterns.findAll(content, &scanStats);
         
-        for (const auto& pattern : patterns) {
-            try {
-                string previous = result;
-                result = regex_replace(result, pattern, "");
-                
-                // 统计匹配
-                if (result != previous) {
-                    matchStats.totalMatches++;
-                    // 可以在这里记录匹配的详细信息
-                }
-                
-            } catch (const regex_error& e) {
-                cerr << "正则表达式错误: " << e.what() << endl;
+        // 不计时的时候只从匹配结果得到每个模式的匹配数和移除字节数
+        if (!profiling) {
+            scanStats.patterns.assign(patterns.size(), PatternCounters{});
+            for (const auto& match : matches) {
+                scanStats.patterns[match.patternIndex].matches++;
+                scanStats.patterns[match.patternIndex].bytesRemoved += match.length;
             }
         }
         
-        return result;
-    }
-    
-    bool PatternMatcher::containsAds(const string& content) {
-        for (const auto& pattern : patterns) {
-            try {
-                if (regex_search(content, pattern)) {
-                    return true;
-                }
-            } catch (const regex_error& e) {
-                cerr << "正则表达式错误: " << e.what() << endl;
+        matchStats.patterns.resize(patterns.size());
+        for (size_t i = 0; i < scanStats.patterns.size(); ++i) {
+            bool firstMatch = matchStats.patterns[i].matches == 0 && scanStats.patterns[i].matches > 0;
+            matchStats.patterns[i] += scanStats.patterns[i];
+            if (firstMatch) {
+                const string& source = patterns.sourceOf(i);
+                matchStats.matchedPatterns.push_back(source.empty() ? "#" + to_string(i) : source);
             }
         }
+        if (matches.empty()) {
+            return content;
+        }
         
-        return false;
+        matchStats.totalMatches += static_cast<int>(matches.size());
+        
+        return PatternSet::removeMatches(content, matches);
+    }
+    
+    bool PatternMatcher::containsAds(const string& content) {
+        return !patterns.findAll(content).empty();
     }
     
     void PatternMatcher::resetMatchStats() {
         matchStats = MatchStats{};
     }
-}
\ No newline at end of file
+    
+    // ==================== 流式清理 ====================
+    
+    StreamingCleaner::StreamingCleaner(const PatternSet& patterns, size_t window)
+        : patterns(patterns), window(max<size_t>(window, 1)), removals(patterns.size(), 0) {}
+    
+    void StreamingCleaner::write(const char* data, size_t size, bool last, string& out) {
+        if (data && size > 0) {
+            pending.append(data, size);
+        }
+        
+        // 攒够两个窗口再处理，保证每次至少输出一个窗口的数据
+        if (!last && pending.size() < lead + 2 * window) {
+            return;
+        }
+        
+        // 末尾window字节之后开始的匹配可能因后续数据而改变，留到下次处理
+        size_t limit = last ? pending.size() : pending.size() - window;
+        matches.clear();
+        size_t resume = patterns.scan(pending.data(), pending.size(), lead, limit, !last, matches, scratch, &scanStats);
+        
+        size_t pos = lead;
+        for (const auto& match : matches) {
+            out.append(pending, pos, match.offset - pos);
+            pos = match.offset + match.length;
+            removals[match.patternIndex]++;
+        }
+        if (pos < resume) {
+            out.append(pending, pos, resume - pos);
+        }
+        
+        if (last) {
+            pending.clear();
+            lead = 0;
+            return;
+        }
+        
+        // 保留1字节已输出的数据，供^、\b等断言判断前一个字符
+        lead = resume > 0 ? 1 : 0;
+        pending.erase(0, resume - lead);
+    }
+    
+    bool StreamingCleaner::modified() const {
+        for (size_t count : removals) {
+            if (count > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
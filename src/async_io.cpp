@@ -0,0 +1,566 @@
+#include "async_io.h"
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <system_error>
+
+#ifdef HAVE_IO_URING
+    #include <linux/io_uring.h>
+    #include <sys/syscall.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/uio.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace AsyncIO {
+    Config& getConfig() {
+        static Config config;
+        return config;
+    }
+
+    bool parseBackend(const string& name, Backend& backend) {
+        if (name == "auto") {
+            backend = Backend::AUTO;
+        } else if (name == "sync") {
+            backend = Backend::SYNC;
+        } else if (name == "uring") {
+            backend = Backend::IO_URING;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    const char* backendName(Backend backend) {
+        switch (backend) {
+            case Backend::AUTO: return "auto";
+            case Backend::SYNC: return "sync";
+            case Backend::IO_URING: return "uring";
+        }
+        return "auto";
+    }
+
+    // ==================== 同步读写 ====================
+
+    static bool readFileSync(const fs::path& path, string& content) {
+        ifstream file(path, ios::binary | ios::ate);
+        if (!file.is_open()) {
+            return false;
+        }
+        streamsize size = file.tellg();
+        if (size < 0) {
+            return false;
+        }
+        file.seekg(0, ios::beg);
+        content.assign(static_cast<size_t>(size), '\0');
+        if (size > 0 && !file.read(&content[0], size)) {
+            content.clear();
+            return false;
+        }
+        return true;
+    }
+
+    static bool writeFileSync(const fs::path& path, initializer_list<string_view> parts) {
+        ofstream file(path, ios::binary | ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        for (string_view part : parts) {
+            file.write(part.data(), static_cast<streamsize>(part.size()));
+        }
+        file.close();
+        return !file.fail();
+    }
+
+    static bool copyFileSync(const fs::path& src, const fs::path& dst) {
+        error_code error;
+        fs::copy_file(src, dst, fs::copy_options::overwrite_existing, error);
+        if (error) {
+            errno = error.value();
+        }
+        return !error;
+    }
+
+#ifdef HAVE_IO_URING
+    // ==================== io_uring ====================
+    // 直接使用系统调用和<linux/io_uring.h>，不依赖liburing
+
+    namespace {
+        // 一个io_uring实例及其注册的缓冲区，只在创建它的线程中使用
+        class Ring {
+        public:
+            Ring() = default;
+            ~Ring();
+
+            Ring(const Ring&) = delete;
+            Ring& operator=(const Ring&) = delete;
+
+            bool setup(unsigned depth, size_t bufferSize);
+
+            unsigned slots() const { return slotCount; }
+            size_t slotSize() const { return bufferSize; }
+            char* buffer(unsigned slot) { return buffers + static_cast<size_t>(slot) * bufferSize; }
+            bool isBroken() const { return broken; }
+
+            // 准备一个读或写请求：使用slot号缓冲区中[bufferOffset, bufferOffset+length)的部分
+            void prepare(bool write, int fd, unsigned slot, size_t bufferOffset, size_t length, uint64_t fileOffset);
+
+            // 提交已准备的请求，并等待至少minComplete个完成；失败时放弃环
+            bool submitAndWait(unsigned minComplete);
+
+            // 取出一个完成事件
+            bool nextCompletion(unsigned& slot, int32_t& result);
+
+        private:
+            // 关闭环，由内核取消或完成在途请求。内核可能仍在访问缓冲区，所以缓冲区不再释放
+            void abandon();
+
+            int fd = -1;
+            void* sqRing = nullptr;
+            void* cqRing = nullptr;
+            size_t sqRingSize = 0;
+            size_t cqRingSize = 0;
+            io_uring_sqe* sqes = nullptr;
+            size_t sqesSize = 0;
+            unsigned* sqTail = nullptr;
+            unsigned* sqMask = nullptr;
+            unsigned* sqArray = nullptr;
+            unsigned* cqHead = nullptr;
+            unsigned* cqTail = nullptr;
+            unsigned* cqMask = nullptr;
+            io_uring_cqe* cqes = nullptr;
+            unsigned toSubmit = 0;
+
+            char* buffers = nullptr;
+            size_t bufferSize = 0;
+            unsigned slotCount = 0;
+            vector<iovec> vectors;      // 未能注册缓冲区时READV/WRITEV使用
+            bool registered = false;
+            bool broken = false;
+        };
+
+        Ring::~Ring() {
+            // 先关闭环：内核结束在途请求后才释放映射和缓冲区
+            if (fd >= 0) ::close(fd);
+            if (sqes) munmap(sqes, sqesSize);
+            if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+            if (sqRing) munmap(sqRing, sqRingSize);
+            if (buffers) munmap(buffers, static_cast<size_t>(slotCount) * bufferSize);
+        }
+
+        bool Ring::setup(unsigned depth, size_t size) {
+            io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+            if (fd < 0) {
+                return false;
+            }
+
+            sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (singleMap) {
+                sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+            }
+            void* mapped = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                fd, IORING_OFF_SQ_RING);
+            if (mapped == MAP_FAILED) {
+                return false;
+            }
+            sqRing = mapped;
+            if (singleMap) {
+                cqRing = sqRing;
+            } else {
+                mapped = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              fd, IORING_OFF_CQ_RING);
+                if (mapped == MAP_FAILED) {
+                    return false;
+                }
+                cqRing = mapped;
+            }
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            mapped = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd, IORING_OFF_SQES);
+            if (mapped == MAP_FAILED) {
+                return false;
+            }
+            sqes = static_cast<io_uring_sqe*>(mapped);
+
+            char* sq = static_cast<char*>(sqRing);
+            char* cq = static_cast<char*>(cqRing);
+            sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+            // 每个在途请求一个缓冲区；注册后内核不必每次请求都映射用户页
+            slotCount = min(depth, params.sq_entries);
+            bufferSize = size;
+            mapped = mmap(nullptr, static_cast<size_t>(slotCount) * bufferSize, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapped == MAP_FAILED) {
+                return false;
+            }
+            buffers = static_cast<char*>(mapped);
+            vectors.resize(slotCount);
+            for (unsigned i = 0; i < slotCount; ++i) {
+                vectors[i].iov_base = buffer(i);
+                vectors[i].iov_len = bufferSize;
+            }
+            // 锁定内存额度不足时注册失败，仍可用READV/WRITEV
+            registered = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+                                 vectors.data(), slotCount) == 0;
+            return true;
+        }
+
+        void Ring::prepare(bool write, int file, unsigned slot, size_t bufferOffset, size_t length,
+                           uint64_t fileOffset) {
+            unsigned tail = *sqTail;
+            unsigned index = tail & *sqMask;
+            io_uring_sqe* sqe = &sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->fd = file;
+            sqe->off = fileOffset;
+            if (registered) {
+                sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+                sqe->addr = reinterpret_cast<uint64_t>(buffer(slot) + bufferOffset);
+                sqe->len = static_cast<uint32_t>(length);
+                sqe->buf_index = static_cast<uint16_t>(slot);
+            } else {
+                vectors[slot].iov_base = buffer(slot) + bufferOffset;
+                vectors[slot].iov_len = length;
+                sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+                sqe->addr = reinterpret_cast<uint64_t>(&vectors[slot]);
+                sqe->len = 1;
+            }
+            sqe->user_data = slot;
+            sqArray[index] = index;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+            toSubmit++;
+        }
+
+        bool Ring::submitAndWait(unsigned minComplete) {
+            for (;;) {
+                long submitted = syscall(__NR_io_uring_enter, fd, toSubmit, minComplete,
+                                         IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (submitted >= 0) {
+                    toSubmit -= static_cast<unsigned>(submitted);
+                    if (toSubmit == 0) {
+                        return true;
+                    }
+                    continue;
+                }
+                if (errno != EINTR) {
+                    abandon();
+                    return false;
+                }
+            }
+        }
+
+        void Ring::abandon() {
+            int error = errno;
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+            buffers = nullptr;
+            broken = true;
+            errno = error;
+        }
+
+        bool Ring::nextCompletion(unsigned& slot, int32_t& result) {
+            unsigned head = *cqHead;
+            if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                return false;
+            }
+            const io_uring_cqe& cqe = cqes[head & *cqMask];
+            slot = static_cast<unsigned>(cqe.user_data);
+            result = cqe.res;
+            __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        // 一次分块传输：源为文件或内存片段，目标为文件或内存。
+        // 每块占用一个缓冲区，源为文件时先读入缓冲区，目标为文件时再从缓冲区写出
+        struct Transfer {
+            int sourceFd = -1;
+            initializer_list<string_view> sourceParts;
+            int targetFd = -1;
+            char* target = nullptr;
+            uint64_t size = 0;
+        };
+
+        // 把源片段拼接后[offset, offset+length)的部分复制到out
+        void copyFromParts(initializer_list<string_view> parts, uint64_t offset, char* out, size_t length) {
+            for (string_view part : parts) {
+                if (length == 0) {
+                    break;
+                }
+                if (offset >= part.size()) {
+                    offset -= part.size();
+                    continue;
+                }
+                size_t count = min<size_t>(length, part.size() - static_cast<size_t>(offset));
+                memcpy(out, part.data() + offset, count);
+                out += count;
+                length -= count;
+                offset = 0;
+            }
+        }
+
+        bool runTransfer(Ring& ring, const Transfer& transfer) {
+            struct Slot {
+                bool busy = false;
+                bool writing = false;
+                uint64_t offset = 0;    // 块在文件中的位置
+                size_t length = 0;
+                size_t done = 0;        // 当前阶段已完成的字节数（短读写时继续提交剩余部分）
+            };
+            vector<Slot> slots(ring.slots());
+            uint64_t next = 0;
+            unsigned inflight = 0;
+            bool failed = false;
+
+            auto issue = [&](unsigned index) {
+                Slot& slot = slots[index];
+                int fd = slot.writing ? transfer.targetFd : transfer.sourceFd;
+                ring.prepare(slot.writing, fd, index, slot.done, slot.length - slot.done, slot.offset + slot.done);
+                inflight++;
+            };
+
+            while (!failed) {
+                for (unsigned index = 0; index < slots.size() && next < transfer.size; ++index) {
+                    Slot& slot = slots[index];
+                    if (slot.busy) {
+                        continue;
+                    }
+                    slot.busy = true;
+                    slot.offset = next;
+                    slot.length = static_cast<size_t>(min<uint64_t>(ring.slotSize(), transfer.size - next));
+                    slot.done = 0;
+                    next += slot.length;
+                    slot.writing = transfer.sourceFd < 0;
+                    if (slot.writing) {
+                        copyFromParts(transfer.sourceParts, slot.offset, ring.buffer(index), slot.length);
+                    }
+                    issue(index);
+                }
+                if (inflight == 0) {
+                    break;
+                }
+                if (!ring.submitAndWait(1)) {
+                    return false;
+                }
+
+                unsigned index;
+                int32_t result;
+                while (ring.nextCompletion(index, result)) {
+                    inflight--;
+                    Slot& slot = slots[index];
+                    if (result == -EINTR || result == -EAGAIN) {
+                        issue(index);
+                        continue;
+                    }
+                    if (result <= 0) {
+                        // 读到文件末尾（文件被截短）或写入失败
+                        errno = result < 0 ? -result : EIO;
+                        failed = true;
+                        slot.busy = false;
+                        continue;
+                    }
+                    slot.done += static_cast<size_t>(result);
+                    if (failed) {
+                        slot.busy = false;
+                    } else if (slot.done < slot.length) {
+                        issue(index);
+                    } else if (!slot.writing && transfer.targetFd >= 0) {
+                        slot.writing = true;
+                        slot.done = 0;
+                        issue(index);
+                    } else {
+                        if (!slot.writing) {
+                            memcpy(transfer.target + slot.offset, ring.buffer(index), slot.length);
+                        }
+                        slot.busy = false;
+                    }
+                }
+            }
+
+            // 失败时等待已提交的请求完成，缓冲区才能用于下一次传输
+            while (inflight > 0) {
+                if (!ring.submitAndWait(1)) {
+                    return false;
+                }
+                unsigned index;
+                int32_t result;
+                while (ring.nextCompletion(index, result)) {
+                    inflight--;
+                }
+            }
+            return !failed;
+        }
+
+        atomic<bool> ringUnavailable{false};
+
+        // 当前线程的环，按当前配置创建；无法创建时以后不再尝试
+        Ring* threadRing() {
+            thread_local unique_ptr<Ring> ring;
+            thread_local unsigned ringDepth = 0;
+            thread_local size_t ringBufferSize = 0;
+
+            const Config& config = getConfig();
+            if (config.backend == Backend::SYNC) {
+                return nullptr;
+            }
+            unsigned depth = min(max(config.queueDepth, 1u), 4096u);
+            size_t bufferSize = max<size_t>(config.bufferSize, 4096);
+            if (ring && ring->isBroken()) {
+                // 被放弃的环泄漏了缓冲区，不再创建新环
+                ring.reset();
+                ringUnavailable = true;
+            }
+            if (ring && (ringDepth != depth || ringBufferSize != bufferSize)) {
+                ring.reset();
+            }
+            if (!ring && !ringUnavailable.load(memory_order_relaxed)) {
+                auto created = make_unique<Ring>();
+                if (created->setup(depth, bufferSize)) {
+                    ring = std::move(created);
+                    ringDepth = depth;
+                    ringBufferSize = bufferSize;
+                } else {
+                    ringUnavailable = true;
+                }
+            }
+            return ring.get();
+        }
+
+        int openTarget(const fs::path& path, mode_t mode) {
+            return ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+        }
+
+        // 返回值：1成功，0失败，-1环不可用（调用者改用同步读写）。
+        // 写入时环出错不返回-1：被放弃的环可能仍有写入目标文件的请求，不能再同步重写同一个文件
+        int readWithRing(Ring& ring, const fs::path& path, string& content) {
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return 0;
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+                ::close(fd);
+                return -1;
+            }
+            content.assign(static_cast<size_t>(info.st_size), '\0');
+            Transfer transfer;
+            transfer.sourceFd = fd;
+            transfer.target = &content[0];
+            transfer.size = static_cast<uint64_t>(info.st_size);
+            bool ok = runTransfer(ring, transfer);
+            ::close(fd);
+            if (!ok) {
+                content.clear();
+                return ring.isBroken() ? -1 : 0;
+            }
+            return 1;
+        }
+
+        int writeWithRing(Ring& ring, const fs::path& path, initializer_list<string_view> parts) {
+            int fd = openTarget(path, 0666);
+            if (fd < 0) {
+                return 0;
+            }
+            Transfer transfer;
+            transfer.sourceParts = parts;
+            transfer.targetFd = fd;
+            for (string_view part : parts) {
+                transfer.size += part.size();
+            }
+            bool ok = runTransfer(ring, transfer);
+            ok = ::close(fd) == 0 && ok;
+            return ok ? 1 : 0;
+        }
+
+        int copyWithRing(Ring& ring, const fs::path& src, const fs::path& dst) {
+            int source = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+            if (source < 0) {
+                return 0;
+            }
+            struct stat info;
+            if (fstat(source, &info) != 0 || !S_ISREG(info.st_mode)) {
+                ::close(source);
+                return -1;
+            }
+            int target = openTarget(dst, info.st_mode & 07777);
+            if (target < 0) {
+                ::close(source);
+                return 0;
+            }
+            Transfer transfer;
+            transfer.sourceFd = source;
+            transfer.targetFd = target;
+            transfer.size = static_cast<uint64_t>(info.st_size);
+            bool ok = runTransfer(ring, transfer);
+            ::close(source);
+            ok = ::close(target) == 0 && ok;
+            return ok ? 1 : 0;
+        }
+    }
+#endif
+
+    Backend activeBackend() {
+#ifdef HAVE_IO_URING
+        if (threadRing() != nullptr) {
+            return Backend::IO_URING;
+        }
+#endif
+        return Backend::SYNC;
+    }
+
+    bool readFile(const fs::path& path, string& content) {
+#ifdef HAVE_IO_URING
+        if (Ring* ring = threadRing()) {
+            int result = readWithRing(*ring, path, content);
+            if (result >= 0) {
+                return result == 1;
+            }
+        }
+#endif
+        return readFileSync(path, content);
+    }
+
+    bool writeFile(const fs::path& path, initializer_list<string_view> parts) {
+#ifdef HAVE_IO_URING
+        if (Ring* ring = threadRing()) {
+            int result = writeWithRing(*ring, path, parts);
+            if (result >= 0) {
+                return result == 1;
+            }
+        }
+#endif
+        return writeFileSync(path, parts);
+    }
+
+    bool copyFile(const fs::path& src, const fs::path& dst) {
+#ifdef HAVE_IO_URING
+        if (Ring* ring = threadRing()) {
+            int result = copyWithRing(*ring, src, dst);
+            if (result >= 0) {
+                return result == 1;
+            }
+        }
+#endif
+        return copyFileSync(src, dst);
+    }
+}
@@ -0,0 +1,422 @@
+#include "epub_processor.h"
+#include "async_io.h"
+#include "bounded_queue.h"
+#include "file_utils.h"
+#include "logger.h"
+#include "thread_pool.h"
+#include "zip_utils.h"
+#include <iostream>
+#include <sstream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <algorithm>
+
+using namespace std;
+
+#if defined(HAVE_ZLIB) && !defined(USE_SYSTEM_ZIP)
+#define EPUB_NATIVE_ZIP 1
+#endif
+
+#ifdef EPUB_NATIVE_ZIP
+
+namespace {
+    // 流水线中的一本书：依次经过读取、解压、（按文档）清理和压缩、写出阶段
+    struct PipelineBook {
+        size_t index = 0;
+        string data;                                // 整本书的原始数据，ZipReader直接引用
+        ZipUtils::ZipReader reader;
+        vector<ZipUtils::ArchiveEntry> entries;
+        vector<string> documentOutput;              // 每个条目清理时的输出，写出时按条目顺序合并
+        vector<string> documentErrors;
+        unique_ptr<EpubProcessor> worker;           // 这本书的统计和控制台输出
+        Logger::BufferedOutput output;
+        mutex statsMutex;                           // 清理线程向worker累加统计
+        atomic<size_t> pending{0};                  // 未完成的文档数，另加1个由解压阶段持有
+        bool rejected = false;                      // beforeBook拒绝处理
+        bool skipped = false;                       // 读取或解压失败
+        bool cleanFailed = false;                   // 有文档清理时发生异常（仍然写出）
+        int cleanedCount = 0;
+    };
+
+    using BookPtr = shared_ptr<PipelineBook>;
+
+    struct PipelineDocument {
+        BookPtr book;
+        size_t entry = 0;
+    };
+
+    // 流水线中驻留内存的书数上限：读取一本书前取得许可，写出阶段处理完这本书后归还
+    class BookPermits {
+    public:
+        explicit BookPermits(size_t count) : available(count) {}
+
+        void acquire() {
+            unique_lock<mutex> lock(permitMutex);
+            permitReleased.wait(lock, [this] { return available > 0; });
+            available--;
+        }
+
+        void release() {
+            {
+                lock_guard<mutex> lock(permitMutex);
+                available++;
+            }
+            permitReleased.notify_one();
+        }
+
+    private:
+        size_t available;
+        mutex permitMutex;
+        condition_variable permitReleased;
+    };
+
+    // 启动count个线程执行同一个阶段函数
+    void startStage(vector<thread>& threads, size_t count, const function<void()>& stage) {
+        for (size_t i = 0; i < count; ++i) {
+            threads.emplace_back(stage);
+        }
+    }
+
+    void joinStage(vector<thread>& threads) {
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        threads.clear();
+    }
+}
+
+void EpubProcessor::runPipeline(const vector<fs::path>& inputs, const vector<fs::path>& outputs,
+                                vector<char>& succeeded, const BookHook& beforeBook, const BookHook& afterBook) {
+    succeeded.assign(inputs.size(), 0);
+    if (inputs.empty()) {
+        return;
+    }
+
+    // 分发前取得模式并记录第一个文档开始的时刻，各阶段的处理器共享同一份编译结果
+    documentPatterns();
+
+    auto threadsFor = [this](size_t requested) {
+        return requested > 0 ? requested : ThreadPool::resolveThreadCount(jobs);
+    };
+    const PipelineOptions& options = pipelineOptions;
+    size_t documentCapacity = max<size_t>(1, options.queueCapacity);
+    size_t readAhead = max<size_t>(1, options.readAhead);
+
+    // 解压线程取出书后就开始分发文档，readQueue只限制等待解压的书。从开始读取到写出完成，
+    // 同时驻留内存的书（原始数据、解压的文档和压缩结果）不超过：预读的书数 + 解压线程数 + 写出线程数
+    size_t decodeThreads = threadsFor(options.decodeThreads);
+    size_t writeThreads = threadsFor(options.writeThreads);
+    size_t booksInFlight = readAhead + decodeThreads + writeThreads;
+    BookPermits permits(booksInFlight);
+
+    BoundedQueue<BookPtr> readQueue(readAhead);
+    BoundedQueue<PipelineDocument> cleanQueue(documentCapacity);
+    BoundedQueue<PipelineDocument> compressQueue(documentCapacity);
+    BoundedQueue<BookPtr> writeQueue(booksInFlight);
+
+    vector<size_t> order = largestFirstOrder(inputs);
+    atomic<size_t> nextBook{0};
+    vector<Stats> bookStats(inputs.size());
+
+    auto needsContent = [](const ZipUtils::ZipEntry& entry) {
+        return !entry.isDirectory() && isContentDocument(fs::u8path(entry.name));
+    };
+
+    // 文档完成（清理后未修改或已压缩）；最后一个完成的文档把书交给写出阶段
+    auto finishDocument = [&writeQueue](const BookPtr& book) {
+        if (--book->pending == 0) {
+            writeQueue.push(book);
+        }
+    };
+
+    // 各阶段的线程中异常不能传出（否则std::terminate）。读取或解压一本书时发生异常（如内存不足）
+    // 就放弃这本书，交给写出阶段记为失败；还没有建立处理器时只能直接输出并计入统计
+    auto abandonBook = [&](const BookPtr& book, size_t index, const exception& e) {
+        if (!book || !book->worker) {
+            cerr << "处理文件时发生异常: " << inputs[index] << " - " << e.what() << endl;
+            bookStats[index].errors++;
+            permits.release();
+            return;
+        }
+        book->worker->errStream() << "处理EPUB时发生异常: " << e.what() << endl;
+        book->skipped = true;
+        writeQueue.push(book);
+    };
+
+    // 读取：按从大到小的顺序把整本书读入内存，readQueue的容量限制预读的书数，
+    // 许可限制还没有写出完成的书数
+    auto readStage = [&]() {
+        for (size_t position = nextBook++; position < order.size(); position = nextBook++) {
+            permits.acquire();
+            BookPtr book;
+            try {
+                book = make_shared<PipelineBook>();
+                book->index = order[position];
+                book->worker = createWorker();
+                book->worker->outTarget = &book->output.out();
+                book->worker->errTarget = &book->output.err();
+                Logger::ScopedErrorTarget errorTarget(book->output.err());
+
+                if (beforeBook && !beforeBook(*book->worker, book->index, true)) {
+                    book->rejected = true;
+                    writeQueue.push(book);
+                    continue;
+                }
+                if (book->worker->verbose) book->worker->outStream() << "1. 读取EPUB到内存..." << endl;
+                if (!AsyncIO::readFile(inputs[book->index], book->data) || book->data.empty()) {
+                    book->worker->errStream() << "读取EPUB失败: " << inputs[book->index] << endl;
+                    book->skipped = true;
+                    writeQueue.push(book);
+                    continue;
+                }
+                readQueue.push(book);
+            } catch (const exception& e) {
+                abandonBook(book, order[position], e);
+            }
+        }
+    };
+
+    // 解压：解析中央目录并解压内容文档，每个文档交给清理阶段
+    auto decodeStage = [&]() {
+        BookPtr book;
+        while (readQueue.pop(book)) {
+            EpubProcessor& worker = *book->worker;
+            vector<size_t> documents;
+            size_t queued = 0;
+            bool dispatching = false;
+            try {
+                auto result = book->reader.openMemory(book->data.data(), book->data.size());
+                if (result.success()) {
+                    result = ZipUtils::loadEntries(book->reader, needsContent, book->entries);
+                }
+                if (!result.success()) {
+                    worker.errStream() << "解码EPUB失败: " << result.message << endl;
+                    book->skipped = true;
+                    writeQueue.push(book);
+                    continue;
+                }
+
+                if (worker.verbose) worker.outStream() << "2. 在内存中清理广告内容..." << endl;
+                book->documentOutput.resize(book->entries.size());
+                book->documentErrors.resize(book->entries.size());
+                for (size_t i = 0; i < book->entries.size(); ++i) {
+                    if (book->entries[i].loaded && needsContent(book->entries[i].info)) {
+                        documents.push_back(i);
+                    }
+                }
+                book->pending = documents.size() + 1;
+                dispatching = true;
+                for (size_t entry : documents) {
+                    cleanQueue.push(PipelineDocument{book, entry});
+                    ++queued;
+                }
+            } catch (const exception& e) {
+                if (!dispatching) {
+                    abandonBook(book, book->index, e);
+                    continue;
+                }
+                // 已有文档交给了清理阶段：未交出的文档按原样写出，这本书记为失败
+                lock_guard<mutex> lock(book->statsMutex);
+                worker.errStream() << "处理EPUB时发生异常: " << e.what() << endl;
+                worker.stats.errors++;
+                book->cleanFailed = true;
+                book->pending -= documents.size() - queued;
+            }
+            finishDocument(book);
+        }
+    };
+
+    // 清理：每个线程使用自己的处理器，每个文档的统计累加到所属的书
+    auto cleanStage = [&]() {
+        unique_ptr<EpubProcessor> worker = createWorker();
+        PipelineDocument document;
+        while (cleanQueue.pop(document)) {
+            PipelineBook& book = *document.book;
+            ZipUtils::ArchiveEntry& item = book.entries[document.entry];
+            ostringstream output, errors;
+            worker->outTarget = &output;
+            worker->errTarget = &errors;
+            worker->stats = Stats{};
+            Logger::ScopedErrorTarget errorTarget(errors);
+            bool modified = false;
+            try {
+                modified = worker->cleanDocumentEntry(item.info.name, item.content);
+                book.documentOutput[document.entry] = output.str();
+                book.documentErrors[document.entry] = errors.str();
+                lock_guard<mutex> lock(book.statsMutex);
+                book.worker->stats += worker->stats;
+                book.cleanedCount += modified ? 1 : 0;
+            } catch (const exception& e) {
+                // 文档按原样写出（复制原始压缩数据），这本书记为失败
+                modified = false;
+                lock_guard<mutex> lock(book.statsMutex);
+                book.worker->errStream() << "清理文件时发生异常: " << item.info.name << " - " << e.what() << endl;
+                book.worker->stats.errors++;
+                book.cleanFailed = true;
+            }
+
+            if (modified) {
+                item.modified = true;
+                try {
+                    compressQueue.push(document);
+                    continue;
+                } catch (const exception&) {
+                    // 交不出去时留给写出阶段压缩
+                }
+            }
+            finishDocument(document.book);
+        }
+    };
+
+    // 压缩：修改过的文档在这里压缩，写出阶段只按顺序写入
+    auto compressStage = [&]() {
+        PipelineDocument document;
+        while (compressQueue.pop(document)) {
+            PipelineBook& book = *document.book;
+            ZipUtils::ArchiveEntry& item = book.entries[document.entry];
+            try {
+                item.compressed = ZipUtils::ZipWriter::precompress(std::move(item.content), true, -1,
+                                                                    compressionChunkSize);
+                item.precompressed = true;
+            } catch (const exception& e) {
+                // 内容可能已被移走：改为复制原始数据，这本书记为失败
+                item.modified = false;
+                lock_guard<mutex> lock(book.statsMutex);
+                book.worker->errStream() << "压缩文件时发生异常: " << item.info.name << " - " << e.what() << endl;
+                book.worker->stats.errors++;
+                book.cleanFailed = true;
+            }
+            finishDocument(document.book);
+        }
+    };
+
+    // 写出一本书：按原条目顺序输出归档，未修改的条目直接复制原始压缩数据
+    auto writeBook = [&](PipelineBook& book) {
+        EpubProcessor& worker = *book.worker;
+        size_t index = book.index;
+        for (size_t i = 0; i < book.entries.size(); ++i) {
+            worker.outStream() << book.documentOutput[i];
+            worker.errStream() << book.documentErrors[i];
+        }
+
+        if (worker.verbose) worker.outStream() << "3. 输出EPUB..." << endl;
+        bool inPlace = false;
+        fs::path targetPath = stagingPath(inputs[index], outputs[index], inPlace);
+        // 归档先在内存中生成（按输入大小预先分配），再整体移出写出（io_uring可用时多个块同时在途）
+        ZipUtils::ZipWriter writer;
+        ZipUtils::RewriteStats rewriteStats;
+        auto result = writer.openMemory(book.data.size());
+        if (result.success()) {
+            result = ZipUtils::writeEntries(book.reader, book.entries, writer, &rewriteStats);
+        }
+        if (result.success()) {
+            result = writer.close();
+        }
+        fs::path parentDir = targetPath.parent_path();
+        if (result.success() && ((!parentDir.empty() && !FileUtils::createDirectory(parentDir)) ||
+                                 !AsyncIO::writeFile(targetPath, writer.takeBuffer()))) {
+            result = {ZipUtils::ZipStatus::UNKNOWN_ERROR, "写入文件失败: " + targetPath.string(), 0};
+        }
+
+        if (!result.success()) {
+            worker.errStream() << "输出EPUB失败: " << result.message << endl;
+            return false;
+        }
+        if (inPlace && !FileUtils::moveFile(targetPath, outputs[index])) {
+            FileUtils::removeFile(targetPath);
+            worker.errStream() << "错误: 无法替换输出文件: " << outputs[index] << endl;
+            return false;
+        }
+        if (worker.verbose) {
+            worker.outStream() << "  已清理文件: " << book.cleanedCount << " 个" << endl;
+            worker.outStream() << "  直接复制条目: " << rewriteStats.entriesCopied << " 个 ("
+                 << rewriteStats.bytesCopied << " 字节)" << endl;
+            worker.outStream() << "  重新压缩条目: " << rewriteStats.entriesRecompressed << " 个" << endl;
+        }
+        return !book.cleanFailed;
+    };
+
+    auto writeStage = [&]() {
+        BookPtr book;
+        while (writeQueue.pop(book)) {
+            EpubProcessor& worker = *book->worker;
+            size_t index = book->index;
+            bool processed = false;
+            {
+                Logger::ScopedErrorTarget errorTarget(book->output.err());
+                try {
+                    if (!book->rejected && !book->skipped) {
+                        processed = writeBook(*book);
+                    }
+                } catch (const exception& e) {
+                    worker.errStream() << "输出EPUB时发生异常: " << e.what() << endl;
+                }
+
+                // 释放这本书的数据，只保留统计
+                book->entries.clear();
+                book->reader = ZipUtils::ZipReader();
+                string().swap(book->data);
+                permits.release();
+
+                if (afterBook && !book->rejected) {
+                    try {
+                        processed = afterBook(worker, index, processed);
+                    } catch (const exception& e) {
+                        worker.errStream() << "处理文件时发生异常: " << e.what() << endl;
+                        worker.stats.errors++;
+                        processed = false;
+                    }
+                }
+            }
+            succeeded[index] = processed;
+            book->output.flush();
+            worker.outTarget = &cout;
+            worker.errTarget = &cerr;
+            bookStats[index] = std::move(worker.stats);
+        }
+    };
+
+    vector<thread> readers, decoders, cleaners, compressors, writers;
+    startStage(writers, writeThreads, writeStage);
+    startStage(compressors, threadsFor(options.compressThreads), compressStage);
+    startStage(cleaners, threadsFor(options.cleanThreads), cleanStage);
+    startStage(decoders, decodeThreads, decodeStage);
+    startStage(readers, threadsFor(options.readThreads), readStage);
+
+    // 每个队列在它的所有生产者结束后关闭；写出队列的生产者包括之前的所有阶段
+    joinStage(readers);
+    readQueue.close();
+    joinStage(decoders);
+    cleanQueue.close();
+    joinStage(cleaners);
+    compressQueue.close();
+    joinStage(compressors);
+    writeQueue.close();
+    joinStage(writers);
+
+    for (const Stats& item : bookStats) {
+        stats += item;
+    }
+}
+
+#else
+
+void EpubProcessor::runPipeline(const vector<fs::path>& inputs, const vector<fs::path>& outputs,
+                                vector<char>& succeeded, const BookHook& beforeBook, const BookHook& afterBook) {
+    // 没有内置ZIP支持时逐本使用解压流程
+    succeeded.assign(inputs.size(), 0);
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        bool processed = false;
+        if (!beforeBook || beforeBook(*this, i, true)) {
+            processed = processExtracted(inputs[i], outputs[i]);
+        }
+        if (afterBook) {
+            processed = afterBook(*this, i, processed);
+        }
+        succeeded[i] = processed;
+    }
+}
+
+#endif
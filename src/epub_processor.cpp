@@ -2,74 +2,275 @@
 #include "ad_patterns.h"
 #include "file_utils.h"
 #include "zip_utils.h"
+#include "thread_pool.h"
+#include "logger.h"
 #include <iostream>
+#include <chrono>
 #include <fstream>
 #include <sstream>
 #include <regex>
 #include <algorithm>
 #include <iomanip>
 #include <cctype>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <condition_variable>
 
 using namespace std;
 
-EpubProcessor::EpubProcessor(bool verbose, bool createBackup, bool preserveEncoding) 
-    : verbose(verbose), createBackupFiles(createBackup), preserveEncoding(preserveEncoding) {
-    initializeDefaultPatterns();
-    resetStats();
+#if defined(HAVE_ZLIB) && !defined(USE_SYSTEM_ZIP)
+#define EPUB_NATIVE_ZIP 1
+#endif
+
+// 读取XML声明中的编码属性（没有声明时默认为UTF-8）
+static string declaredEncoding(const string& content) {
+    size_t xmlDeclStart = content.find("<?xml");
+    if (xmlDeclStart == string::npos) {
+        return "UTF-8";
+    }
+    size_t xmlDeclEnd = content.find("?>", xmlDeclStart);
+    if (xmlDeclEnd == string::npos) {
+        return "UTF-8";
+    }
+    
+    string xmlDecl = content.substr(xmlDeclStart, xmlDeclEnd - xmlDeclStart + 2);
+    size_t encodingPos = xmlDecl.find("encoding=");
+    if (encodingPos == string::npos) {
+        return "UTF-8";
+    }
+    size_t quoteStart = xmlDecl.find_first_of("'\"", encodingPos + 9);
+    if (quoteStart == string::npos) {
+        return "UTF-8";
+    }
+    size_t quoteEnd = xmlDecl.find_first_of("'\"", quoteStart + 1);
+    if (quoteEnd == string::npos) {
+        return "UTF-8";
+    }
+    return xmlDecl.substr(quoteStart + 1, quoteEnd - quoteStart - 1);
 }
 
-void EpubProcessor::initializeDefaultPatterns() {
-    // 清空现有模式
-    adPatterns.clear();
+static bool isUtf8Encoding(const string& encoding) {
+    string encodingUpper = encoding;
+    transform(encodingUpper.begin(), encodingUpper.end(), encodingUpper.begin(),
+              [](unsigned char c) { return static_cast<char>(::toupper(c)); });
+    return encodingUpper == "UTF-8" || encodingUpper == "UTF8";
+}
+
+// 将XML声明中的编码属性设为UTF-8（没有编码属性时添加）
+static void normalizeXmlDeclaration(string& content) {
+    size_t xmlDeclStart = content.find("<?xml");
+    if (xmlDeclStart != string::npos) {
+        size_t xmlDeclEnd = content.find("?>", xmlDeclStart);
+        if (xmlDeclEnd != string::npos) {
+            string xmlDecl = content.substr(xmlDeclStart, xmlDeclEnd - xmlDeclStart + 2);
+            
+            // 检查并更新编码属性
+            size_t encodingPos = xmlDecl.find("encoding=");
+            if (encodingPos != string::npos) {
+                // 更新为UTF-8
+                string newXmlDecl = xmlDecl;
+                size_t quoteStart = newXmlDecl.find_first_of("'\"", encodingPos + 9);
+                if (quoteStart != string::npos) {
+                    size_t quoteEnd = newXmlDecl.find_first_of("'\"", quoteStart + 1);
+                    if (quoteEnd != string::npos) {
+                        newXmlDecl.replace(quoteStart + 1, quoteEnd - quoteStart - 1, "UTF-8");
+                        content.replace(xmlDeclStart, xmlDeclEnd - xmlDeclStart + 2, newXmlDecl);
+                    }
+                }
+            } else {
+                // 如果没有编码属性，添加一个
+                size_t versionEnd = xmlDecl.find("version=");
+                if (versionEnd != string::npos) {
+                    size_t versionQuoteEnd = xmlDecl.find_first_of("'\"", versionEnd + 8);
+                    if (versionQuoteEnd != string::npos) {
+                        versionQuoteEnd = xmlDecl.find_first_of("'\"", versionQuoteEnd + 1);
+                        if (versionQuoteEnd != string::npos) {
+                            string newXmlDecl = xmlDecl.substr(0, versionQuoteEnd + 1) + 
+                                                " encoding=\"UTF-8\"" + 
+                                                xmlDecl.substr(versionQuoteEnd + 1);
+                            content.replace(xmlDeclStart, xmlDeclEnd - xmlDeclStart + 2, newXmlDecl);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// 内容文档的流式清理器：先缓冲文件开头以检查编码和BOM，之后逐块交给StreamingCleaner
+class DocumentStreamCleaner : public ZipUtils::EntryStreamFilter {
+public:
+    DocumentStreamCleaner(const AdPatterns::PatternSet& patterns, size_t window, bool preserveEncoding,
+                          EpubProcessor::Stats& stats, AdPatterns::PatternProfile* profile,
+                          string displayName, ostream* verboseOut)
+        : cleaner(patterns, window), preserveEncoding(preserveEncoding), stats(stats), profile(profile),
+          displayName(std::move(displayName)), verboseOut(verboseOut) {
+        cleaner.setProfiling(profile != nullptr);
+    }
     
-    // 添加内置广告模式
-    vector<string> patternStrings = {
-        // 模式1: GitHub项目推广广告
-        R"([\s\r\n]*【[^】]*使用[^】]*项目[^】]*进行[^】]*下载[^】]*：[^】]*】[\s\r\n]*)",
-        
-        // 模式2: 包含github链接的广告
-        R"([\s\r\n]*【[^】]*https?://[^】]*github[^】]*】[\s\r\n]*)",
+    bool write(const char* data, size_t size, bool last, string& out) override {
+        if (headerDone) {
+            cleaner.write(data, size, last, out);
+            documentBytes += size;
+            return true;
+        }
         
-        // 模式3: 特定项目名称
-        R"([\s\r\n]*【[^】]*POf-L/Fanqie-novel-Downloader[^】]*】[\s\r\n]*)",
+        header.append(data ? data : "", data ? size : 0);
+        if (!last && header.size() < HEADER_SIZE) {
+            return true;
+        }
+        headerDone = true;
         
-        // 模式4: 通用下载广告
-        R"([\s\r\n]*【[^】]*下载[^】]*】[\s\r\n]*)",
+        // BOM不参与清理，输出时保持原有BOM状态
+        bool hasBom = header.size() >= 3 && header.compare(0, 3, "\xEF\xBB\xBF") == 0;
+        if (hasBom) {
+            header.erase(0, 3);
+        }
         
-        // 模式5: 特殊Unicode字符
-        R"([‌᠎⁠﻿\u200b\u200c\u200d\u2060\ufeff]+)",
+        // 需要转换编码的文件不能逐块处理，交给调用者整体处理
+        if (!preserveEncoding) {
+            if (!isUtf8Encoding(declaredEncoding(header))) {
+                return false;
+            }
+            normalizeXmlDeclaration(header);
+        }
         
-        // 模式6: 空方括号（可能包含空白字符）
-        R"([\s\r\n]*【[\s]*】[\s\r\n]*)",
+        if (hasBom) {
+            out.append("\xEF\xBB\xBF");
+        }
+        cleaner.write(header.data(), header.size(), last, out);
+        documentBytes += header.size();
+        string().swap(header);
+        return true;
+    }
+    
+    bool modified() const override {
+        return cleaner.modified();
+    }
+    
+    void commit() override {
+        int removed = 0;
+        for (size_t count : cleaner.removalCounts()) {
+            removed += static_cast<int>(count);
+        }
+        stats.adsRemoved += removed;
+        stats.errors += static_cast<int>(cleaner.errorCount());
+        stats.bytesSkipped += cleaner.bytesSkipped();
+        if (documentBytes > 0 && cleaner.bytesSkipped() == documentBytes) {
+            stats.documentsSkipped++;
+        }
+        if (profile) {
+            profile->merge(cleaner.patternCounters());
+        }
         
-        // 模式7: 包含"项目"和"下载"的广告
-        R"([\s\r\n]*【[^】]*项目[^】]*下载[^】]*】[\s\r\n]*)"
-    };
+        if (verboseOut) {
+            *verboseOut << "    已流式清理文件: " << displayName << endl;
+            if (removed > 0) {
+                *verboseOut << "      移除广告: " << removed << " 处" << endl;
+            }
+        }
+    }
     
-    // 转换为正则表达式
-    adPatterns = AdPatterns::createPatterns(patternStrings);
+private:
+    static constexpr size_t HEADER_SIZE = 4096;
     
-    if (verbose) {
-        cout << "已初始化 " << adPatterns.size() << " 个默认广告模式" << endl;
+    AdPatterns::StreamingCleaner cleaner;
+    bool preserveEncoding;
+    EpubProcessor::Stats& stats;
+    AdPatterns::PatternProfile* profile;
+    string displayName;
+    ostream* verboseOut;     // 为空时不输出详细信息
+    string header;
+    bool headerDone = false;
+    uint64_t documentBytes = 0;     // 交给清理器的字节数，用于判断整个文档是否被预过滤跳过
+};
+
+EpubProcessor::EpubProcessor(bool verbose, bool createBackup, bool preserveEncoding) 
+    : verbose(verbose), createBackupFiles(createBackup), preserveEncoding(preserveEncoding),
+#ifdef EPUB_NATIVE_ZIP
+      processingMode(ProcessingMode::REWRITE) {
+#else
+      processingMode(ProcessingMode::EXTRACT) {
+#endif
+    resetStats();
+}
+
+void EpubProcessor::setProcessingMode(ProcessingMode mode) {
+#ifndef EPUB_NATIVE_ZIP
+    if (mode != ProcessingMode::EXTRACT) {
+        errStream() << "警告: 当前构建不支持内置ZIP重写，使用解压模式" << endl;
+        mode = ProcessingMode::EXTRACT;
+    }
+#endif
+    processingMode = mode;
+}
+
+const AdPatterns::PatternSet& EpubProcessor::resolvePatterns() {
+    if (!patternsResolved) {
+        // 内置模式每种引擎只编译一次，所有处理器共享；指定了自定义模式时不会走到这里
+        auto begin = chrono::steady_clock::now();
+        adPatterns = AdPatterns::builtinPatternSet(regexEngine);
+        patternsResolved = true;
+        startupProfile.patternCompileMs =
+            chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        
+        if (verbose) {
+            outStream() << "已初始化 " << adPatterns.size() << " 个默认广告模式" << endl;
+        }
     }
+    return adPatterns;
+}
+
+const AdPatterns::PatternSet& EpubProcessor::documentPatterns() {
+    const AdPatterns::PatternSet& patterns = resolvePatterns();
+    if (!startupProfile.documentStarted) {
+        startupProfile.documentStarted = true;
+        startupProfile.firstDocument = chrono::steady_clock::now();
+    }
+    return patterns;
 }
 
 void EpubProcessor::setAdPatterns(const vector<regex>& patterns) {
+    adPatterns = AdPatterns::PatternSet(patterns);
+    builtinPatterns = false;
+    patternsResolved = true;
+    if (verbose) {
+        outStream() << "已设置 " << patterns.size() << " 个自定义广告模式" << endl;
+    }
+}
+
+void EpubProcessor::setAdPatterns(const AdPatterns::PatternSet& patterns) {
     adPatterns = patterns;
+    builtinPatterns = false;
+    patternsResolved = true;
     if (verbose) {
-        cout << "已设置 " << patterns.size() << " 个自定义广告模式" << endl;
+        outStream() << "已设置 " << patterns.size() << " 个自定义广告模式" << endl;
+    }
+}
+
+void EpubProcessor::setRegexEngine(AdPatterns::Engine engine) {
+    regexEngine = engine;
+    if (builtinPatterns) {
+        // 内置模式在第一次使用时按新引擎取得
+        adPatterns.clear();
+        patternsResolved = false;
+    } else {
+        adPatterns = adPatterns.withEngine(engine);
     }
 }
 
 void EpubProcessor::addAdPattern(const string& pattern) {
-    try {
-        adPatterns.emplace_back(pattern, regex::optimize | regex::icase);
+    string error;
+    resolvePatterns();
+    if (adPatterns.add(pattern, regexEngine, &error)) {
+        builtinPatterns = false;
         if (verbose) {
-            cout << "已添加广告模式: " << pattern << endl;
+            outStream() << "已添加广告模式: " << pattern << endl;
         }
-    } catch (const regex_error& e) {
-        cerr << "错误: 无效的正则表达式模式: " << pattern << endl;
-        cerr << "错误信息: " << e.what() << endl;
+    } else {
+        errStream() << "错误: 无效的正则表达式模式: " << pattern << endl;
+        errStream() << "错误信息: " << error << endl;
         stats.errors++;
     }
 }
@@ -78,16 +279,97 @@ void EpubProcessor::resetStats() {
     stats = Stats{};
 }
 
+EpubProcessor::Stats& EpubProcessor::Stats::operator+=(const Stats& other) {
+    filesProcessed += other.filesProcessed;
+    adsRemoved += other.adsRemoved;
+    errors += other.errors;
+    documentsSkipped += other.documentsSkipped;
+    bytesSkipped += other.bytesSkipped;
+    processedFiles.insert(processedFiles.end(), other.processedFiles.begin(), other.processedFiles.end());
+    return *this;
+}
+
+unique_ptr<EpubProcessor> EpubProcessor::createWorker() const {
+    unique_ptr<EpubProcessor> worker(new EpubProcessor(verbose, createBackupFiles, preserveEncoding));
+    worker->adPatterns = adPatterns;
+    worker->regexEngine = regexEngine;
+    worker->builtinPatterns = builtinPatterns;
+    worker->patternsResolved = patternsResolved;
+    worker->patternProfile = patternProfile;
+    worker->processingMode = processingMode;
+    worker->compressionThreads = compressionThreads;
+    worker->compressionChunkSize = compressionChunkSize;
+    worker->streamingThreshold = streamingThreshold;
+    worker->streamingWindow = streamingWindow;
+    worker->jobs = jobs;
+    worker->borrowedPool = borrowedPool ? borrowedPool : workerPool.get();
+    worker->documentCallback = documentCallback;
+    return worker;
+}
+
+ThreadPool* EpubProcessor::sharedPool() {
+    if (borrowedPool) {
+        return borrowedPool;
+    }
+    if (!workerPool) {
+        size_t threads = ThreadPool::resolveThreadCount(jobs);
+        if (threads <= 1) {
+            return nullptr;
+        }
+        workerPool = make_shared<ThreadPool>(threads);
+    }
+    return workerPool.get();
+}
+
 bool EpubProcessor::processFile(const fs::path& inputPath, const fs::path& outputPath) {
+    if (!beginFile(inputPath, outputPath)) {
+        return false;
+    }
+    
+    try {
+        bool processed = false;
+        switch (processingMode) {
+            case ProcessingMode::REWRITE:
+                processed = rewriteEpub(inputPath, outputPath);
+                break;
+            case ProcessingMode::MEMORY:
+                processed = processInMemory(inputPath, outputPath);
+                break;
+            case ProcessingMode::EXTRACT:
+                processed = processExtracted(inputPath, outputPath);
+                break;
+            case ProcessingMode::PIPELINE: {
+                vector<char> succeeded;
+                runPipeline({inputPath}, {outputPath}, succeeded);
+                processed = succeeded[0] != 0;
+                break;
+            }
+        }
+        if (!processed) {
+            stats.errors++;
+            return false;
+        }
+        
+        finishFile(inputPath, outputPath);
+        return true;
+        
+    } catch (const exception& e) {
+        errStream() << "处理文件时发生异常: " << e.what() << endl;
+        stats.errors++;
+        return false;
+    }
+}
+
+bool EpubProcessor::beginFile(const fs::path& inputPath, const fs::path& outputPath) {
     if (verbose) {
-        cout << "\n=== 开始处理文件 ===" << endl;
-        cout << "输入文件: " << inputPath << endl;
-        cout << "输出文件: " << outputPath << endl;
+        outStream() << "\n=== 开始处理文件 ===" << endl;
+        outStream() << "输入文件: " << inputPath << endl;
+        outStream() << "输出文件: " << outputPath << endl;
     }
     
     // 检查输入文件是否存在
     if (!FileUtils::fileExists(inputPath)) {
-        cerr << "错误: 输入文件不存在: " << inputPath << endl;
+        errStream() << "错误: 输入文件不存在: " << inputPath << endl;
         stats.errors++;
         return false;
     }
@@ -95,84 +377,378 @@ bool EpubProcessor::processFile(const fs::path& inputPath, const fs::path& outpu
     // 验证文件扩展名
     string ext = FileUtils::getFileExtension(inputPath);
     if (ext != ".epub") {
-        cerr << "警告: 文件扩展名不是.epub: " << inputPath << endl;
+        errStream() << "警告: 文件扩展名不是.epub: " << inputPath << endl;
+    }
+    return true;
+}
+
+void EpubProcessor::finishFile(const fs::path& inputPath, const fs::path& outputPath) {
+    // 步骤4: 创建备份（如果需要）
+    if (createBackupFiles) {
+        if (verbose) outStream() << "4. 创建备份文件..." << endl;
+        if (!createBackup(inputPath)) {
+            errStream() << "警告: 创建备份文件失败" << endl;
+            stats.errors++;
+        }
     }
     
+    stats.filesProcessed++;
+    stats.processedFiles.push_back(inputPath.string());
+    
+    if (verbose) {
+        outStream() << "\n=== 文件处理完成 ===" << endl;
+        outStream() << "输出文件: " << outputPath << endl;
+        outStream() << "文件大小: " << FileUtils::getFileSize(outputPath) << " 字节" << endl;
+        outStream() << "移除广告: " << stats.adsRemoved << " 处" << endl;
+        outStream() << "预过滤跳过: " << stats.documentsSkipped << " 个文档, " << stats.bytesSkipped << " 字节" << endl;
+    }
+}
+
+bool EpubProcessor::processExtracted(const fs::path& inputPath, const fs::path& outputPath) {
     // 创建临时目录
     FileUtils::TempDirectory tempDir;
     if (!tempDir.isValid()) {
-        cerr << "错误: 无法创建临时目录" << endl;
-        stats.errors++;
+        errStream() << "错误: 无法创建临时目录" << endl;
         return false;
     }
     
     if (verbose) {
-        cout << "临时目录: " << tempDir.getPath() << endl;
+        outStream() << "临时目录: " << tempDir.getPath() << endl;
+    }
+    
+    // 步骤1: 解压EPUB文件
+    if (verbose) outStream() << "1. 解压EPUB文件..." << endl;
+    if (!extractEpub(inputPath, tempDir.getPath())) {
+        errStream() << "错误: 解压EPUB文件失败" << endl;
+        return false;
+    }
+    
+    // 步骤2: 清理解压后的文件
+    if (verbose) outStream() << "2. 清理文件中的广告内容..." << endl;
+    if (!cleanExtractedFiles(tempDir.getPath())) {
+        errStream() << "错误: 清理文件失败" << endl;
+        return false;
+    }
+    
+    // 步骤3: 重新打包为EPUB
+    if (verbose) outStream() << "3. 重新打包为EPUB..." << endl;
+    if (!repackEpub(tempDir.getPath(), outputPath)) {
+        errStream() << "错误: 重新打包EPUB失败" << endl;
+        return false;
     }
     
+    return true;
+}
+
+fs::path EpubProcessor::stagingPath(const fs::path& inputPath, const fs::path& outputPath, bool& inPlace) {
+    inPlace = false;
     try {
-        // 步骤1: 解压EPUB文件
-        if (verbose) cout << "1. 解压EPUB文件..." << endl;
-        if (!extractEpub(inputPath, tempDir.getPath())) {
-            cerr << "错误: 解压EPUB文件失败" << endl;
+        inPlace = fs::exists(outputPath) && fs::equivalent(inputPath, outputPath);
+    } catch (const fs::filesystem_error&) {
+        inPlace = false;
+    }
+    return inPlace ? fs::path(outputPath.string() + ".tmp") : outputPath;
+}
+
+bool EpubProcessor::rewriteEpub(const fs::path& inputPath, const fs::path& outputPath) {
+#ifdef EPUB_NATIVE_ZIP
+    if (verbose) outStream() << "1. 重写EPUB文件（未修改的条目直接复制）..." << endl;
+    
+    bool inPlace = false;
+    fs::path targetPath = stagingPath(inputPath, outputPath, inPlace);
+    
+    int cleanedCount = 0;
+    int failedCount = 0;
+    
+    auto needsContent = [](const ZipUtils::ZipEntry& entry) {
+        return !entry.isDirectory() && isContentDocument(fs::u8path(entry.name));
+    };
+    
+    auto transform = [&](const ZipUtils::ZipEntry& entry, string& content) {
+        try {
+            if (!cleanDocumentEntry(entry.name, content)) {
+                return false;
+            }
+            cleanedCount++;
+            return true;
+        } catch (const exception& e) {
+            errStream() << "清理文件时发生异常: " << entry.name << " - " << e.what() << endl;
+            failedCount++;
             stats.errors++;
             return false;
         }
-        
-        // 步骤2: 清理解压后的文件
-        if (verbose) cout << "2. 清理文件中的广告内容..." << endl;
-        if (!cleanExtractedFiles(tempDir.getPath())) {
-            cerr << "错误: 清理文件失败" << endl;
-            stats.errors++;
-            return false;
+    };
+    
+    ZipUtils::RewriteStats rewriteStats;
+    ZipUtils::WriterOptions options;
+    options.threads = compressionThreads;
+    options.chunkSize = compressionChunkSize;
+    ZipUtils::StreamingOptions streaming;
+    streaming.threshold = streamingThreshold;
+    streaming.filterFactory = [&](const ZipUtils::ZipEntry& entry) {
+        return unique_ptr<ZipUtils::EntryStreamFilter>(new DocumentStreamCleaner(
+            documentPatterns(), streamingWindow, preserveEncoding, stats, patternProfile.get(),
+            fs::u8path(entry.name).filename().string(), verbose ? &outStream() : nullptr));
+    };
+    
+    // 有线程池时选中的文档按批分给线程池并行清理，每批的数量与压缩队列一样受线程数限制
+    ZipUtils::BatchOptions batch;
+    if (ThreadPool* pool = sharedPool()) {
+        batch.size = 4 * pool->size();
+        batch.transform = [&](vector<ZipUtils::ArchiveEntry*>& documents) {
+            if (!cleanDocuments(documents, cleanedCount)) {
+                failedCount++;
+            }
+        };
+    }
+    auto result = ZipUtils::rewriteZip(inputPath, targetPath, needsContent, transform,
+                                       &rewriteStats, options, streaming, batch);
+    if (!result.success()) {
+        errStream() << "重写EPUB失败: " << result.message << endl;
+        return false;
+    }
+    
+    if (inPlace && !FileUtils::moveFile(targetPath, outputPath)) {
+        FileUtils::removeFile(targetPath);
+        errStream() << "错误: 无法替换输出文件: " << outputPath << endl;
+        return false;
+    }
+    
+    if (verbose) {
+        outStream() << "  已清理文件: " << cleanedCount << " 个" << endl;
+        outStream() << "  直接复制条目: " << rewriteStats.entriesCopied << " 个 ("
+             << rewriteStats.bytesCopied << " 字节)" << endl;
+        outStream() << "  重新压缩条目: " << rewriteStats.entriesRecompressed << " 个" << endl;
+        if (rewriteStats.entriesStreamed > 0) {
+            outStream() << "  流式处理条目: " << rewriteStats.entriesStreamed << " 个" << endl;
         }
-        
-        // 步骤3: 重新打包为EPUB
-        if (verbose) cout << "3. 重新打包为EPUB..." << endl;
-        if (!repackEpub(tempDir.getPath(), outputPath)) {
-            cerr << "错误: 重新打包EPUB失败" << endl;
+    }
+    
+    return failedCount == 0;
+#else
+    return processExtracted(inputPath, outputPath);
+#endif
+}
+
+bool EpubProcessor::processInMemory(const fs::path& inputPath, const fs::path& outputPath) {
+#ifdef EPUB_NATIVE_ZIP
+    if (verbose) outStream() << "1. 读取EPUB到内存..." << endl;
+    
+    ZipUtils::ZipReader reader;
+    auto result = reader.open(inputPath);
+    if (!result.success()) {
+        errStream() << "读取EPUB失败: " << result.message << endl;
+        return false;
+    }
+    
+    bool inPlace = false;
+    fs::path targetPath = stagingPath(inputPath, outputPath, inPlace);
+    
+    ZipUtils::ZipWriter writer;
+    writer.setCompressionThreads(compressionThreads);
+    writer.setChunkSize(compressionChunkSize);
+    result = writer.open(targetPath);
+    if (!result.success()) {
+        errStream() << "创建输出文件失败: " << result.message << endl;
+        return false;
+    }
+    
+    if (!cleanArchive(reader, writer)) {
+        writer.abort();
+        return false;
+    }
+    
+    result = writer.close();
+    if (!result.success()) {
+        errStream() << "写入EPUB失败: " << result.message << endl;
+        return false;
+    }
+    
+    if (inPlace && !FileUtils::moveFile(targetPath, outputPath)) {
+        FileUtils::removeFile(targetPath);
+        errStream() << "错误: 无法替换输出文件: " << outputPath << endl;
+        return false;
+    }
+    
+    return true;
+#else
+    return processExtracted(inputPath, outputPath);
+#endif
+}
+
+bool EpubProcessor::processBuffer(const string& input, string& output) {
+#ifdef EPUB_NATIVE_ZIP
+    ZipUtils::ZipReader reader;
+    auto result = reader.openMemory(input.data(), input.size());
+    if (!result.success()) {
+        errStream() << "解析EPUB数据失败: " << result.message << endl;
+        stats.errors++;
+        return false;
+    }
+    
+    ZipUtils::ZipWriter writer;
+    writer.setCompressionThreads(compressionThreads);
+    writer.setChunkSize(compressionChunkSize);
+    writer.openMemory();
+    
+    try {
+        if (!cleanArchive(reader, writer)) {
+            writer.abort();
             stats.errors++;
             return false;
         }
-        
-        // 步骤4: 创建备份（如果需要）
-        if (createBackupFiles) {
-            if (verbose) cout << "4. 创建备份文件..." << endl;
-            if (!createBackup(inputPath)) {
-                cerr << "警告: 创建备份文件失败" << endl;
-                stats.errors++;
-            }
-        }
-        
-        stats.filesProcessed++;
-        stats.processedFiles.push_back(inputPath.string());
-        
-        if (verbose) {
-            cout << "\n=== 文件处理完成 ===" << endl;
-            cout << "输出文件: " << outputPath << endl;
-            cout << "文件大小: " << FileUtils::getFileSize(outputPath) << " 字节" << endl;
-            cout << "移除广告: " << stats.adsRemoved << " 处" << endl;
-        }
-        
-        return true;
-        
     } catch (const exception& e) {
-        cerr << "处理文件时发生异常: " << e.what() << endl;
+        errStream() << "处理EPUB数据时发生异常: " << e.what() << endl;
+        writer.abort();
         stats.errors++;
         return false;
     }
+    
+    result = writer.close();
+    if (!result.success()) {
+        errStream() << "写入EPUB数据失败: " << result.message << endl;
+        stats.errors++;
+        return false;
+    }
+    
+    output = writer.takeBuffer();
+    stats.filesProcessed++;
+    return true;
+#else
+    errStream() << "错误: 当前构建不支持内存处理（需要内置ZIP支持）" << endl;
+    stats.errors++;
+    return false;
+#endif
+}
+
+bool EpubProcessor::cleanArchive(const ZipUtils::ZipReader& reader, ZipUtils::ZipWriter& writer) {
+#ifdef EPUB_NATIVE_ZIP
+    // 步骤1: 解码为内存条目表（只解压内容文档）
+    vector<ZipUtils::ArchiveEntry> entries;
+    auto needsContent = [](const ZipUtils::ZipEntry& entry) {
+        return !entry.isDirectory() && isContentDocument(fs::u8path(entry.name));
+    };
+    auto result = ZipUtils::loadEntries(reader, needsContent, entries);
+    if (!result.success()) {
+        errStream() << "解码EPUB失败: " << result.message << endl;
+        return false;
+    }
+    
+    // 步骤2: 在内存中清理
+    if (verbose) outStream() << "2. 在内存中清理广告内容..." << endl;
+    vector<ZipUtils::ArchiveEntry*> documents;
+    for (auto& item : entries) {
+        if (item.loaded && needsContent(item.info)) {
+            documents.push_back(&item);
+        }
+    }
+    int cleanedCount = 0;
+    bool allSuccess = cleanDocuments(documents, cleanedCount);
+    
+    // 步骤3: 重新输出（未修改条目直接复制）
+    if (verbose) outStream() << "3. 输出EPUB..." << endl;
+    ZipUtils::RewriteStats rewriteStats;
+    result = ZipUtils::writeEntries(reader, entries, writer, &rewriteStats);
+    if (!result.success()) {
+        errStream() << "输出EPUB失败: " << result.message << endl;
+        return false;
+    }
+    
+    if (verbose) {
+        outStream() << "  已清理文件: " << cleanedCount << " 个" << endl;
+        outStream() << "  直接复制条目: " << rewriteStats.entriesCopied << " 个 ("
+             << rewriteStats.bytesCopied << " 字节)" << endl;
+        outStream() << "  重新压缩条目: " << rewriteStats.entriesRecompressed << " 个" << endl;
+    }
+    
+    return allSuccess;
+#else
+    return false;
+#endif
+}
+
+bool EpubProcessor::cleanDocuments(vector<ZipUtils::ArchiveEntry*>& documents, int& cleanedCount) {
+#ifdef EPUB_NATIVE_ZIP
+    vector<char> modified(documents.size(), 0);
+    auto cleanOne = [&documents, &modified](EpubProcessor& worker, size_t index) {
+        ZipUtils::ArchiveEntry& item = *documents[index];
+        try {
+            modified[index] = worker.cleanDocumentEntry(item.info.name, item.content);
+            return true;
+        } catch (const exception& e) {
+            worker.errStream() << "清理文件时发生异常: " << item.info.name << " - " << e.what() << endl;
+            return false;
+        }
+    };
+    
+    // 多个文档时与解压流程一样分给线程池并行清理
+    vector<char> succeeded(documents.size(), 0);
+    ThreadPool* pool = documents.size() > 1 ? sharedPool() : nullptr;
+    if (pool) {
+        runInParallel(documents.size(), *pool, cleanOne, succeeded);
+    } else {
+        for (size_t i = 0; i < documents.size(); ++i) {
+            succeeded[i] = cleanOne(*this, i);
+        }
+    }
+    
+    bool allSuccess = true;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (!succeeded[i]) {
+            allSuccess = false;
+            stats.errors++;
+        } else if (modified[i]) {
+            documents[i]->modified = true;
+            cleanedCount++;
+        }
+    }
+    return allSuccess;
+#else
+    return false;
+#endif
+}
+
+bool EpubProcessor::cleanDocumentEntry(const string& name, string& content) {
+    // BOM不参与清理，修改后保持原有BOM状态
+    bool hasBom = content.size() >= 3 && content.compare(0, 3, "\xEF\xBB\xBF") == 0;
+    if (hasBom) {
+        content.erase(0, 3);
+    }
+    
+    bool modified = !content.empty() && cleanXhtmlContent(content, fs::u8path(name).filename().string());
+    
+    if (hasBom) {
+        content.insert(0, "\xEF\xBB\xBF");
+    }
+    return modified;
+}
+
+bool EpubProcessor::isContentDocument(const fs::path& name) {
+    string ext = name.extension().string();
+    return ext == ".xhtml" || ext == ".html";
+}
+
+vector<size_t> EpubProcessor::largestFirstOrder(const vector<fs::path>& files) {
+    vector<uint64_t> sizes(files.size());
+    vector<size_t> order(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        sizes[i] = FileUtils::getFileSize(files[i]);
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+    return order;
 }
 
 bool EpubProcessor::processDirectory(const fs::path& inputDir, const fs::path& outputDir) {
     if (verbose) {
-        cout << "\n=== 开始批量处理目录 ===" << endl;
-        cout << "输入目录: " << inputDir << endl;
-        cout << "输出目录: " << outputDir << endl;
+        outStream() << "\n=== 开始批量处理目录 ===" << endl;
+        outStream() << "输入目录: " << inputDir << endl;
+        outStream() << "输出目录: " << outputDir << endl;
     }
     
     // 确保输出目录存在
     if (!FileUtils::createDirectory(outputDir)) {
-        cerr << "错误: 无法创建输出目录: " << outputDir << endl;
+        errStream() << "错误: 无法创建输出目录: " << outputDir << endl;
         return false;
     }
     
@@ -185,50 +761,154 @@ bool EpubProcessor::processDirectory(const fs::path& inputDir, const fs::path& o
             }
         }
     } catch (const fs::filesystem_error& e) {
-        cerr << "错误: 无法读取目录: " << e.what() << endl;
+        errStream() << "错误: 无法读取目录: " << e.what() << endl;
         return false;
     }
     
     if (epubFiles.empty()) {
-        cout << "未找到EPUB文件" << endl;
+        outStream() << "未找到EPUB文件" << endl;
         return true;
     }
     
     if (verbose) {
-        cout << "找到 " << epubFiles.size() << " 个EPUB文件" << endl;
+        outStream() << "找到 " << epubFiles.size() << " 个EPUB文件" << endl;
     }
     
-    // 处理每个文件
+    // 按文件名排序，处理顺序和统计结果不依赖目录遍历顺序
+    sort(epubFiles.begin(), epubFiles.end());
+    
+    // 生成输出文件路径
+    vector<fs::path> outputFiles;
+    for (const auto& inputFile : epubFiles) {
+        outputFiles.push_back(outputDir / inputFile.filename());
+    }
+    
+    auto printHeading = [&](EpubProcessor& worker, size_t index) {
+        if (worker.verbose) {
+            worker.outStream() << "\n--- 处理文件 " << (index + 1) << "/" << epubFiles.size() << " ---" << endl;
+            worker.outStream() << "文件名: " << epubFiles[index].filename() << endl;
+        }
+    };
+    
+    auto processOne = [&](EpubProcessor& worker, size_t index) {
+        printHeading(worker, index);
+        
+        // 处理文件
+        if (worker.processFile(epubFiles[index], outputFiles[index])) {
+            return true;
+        }
+        worker.errStream() << "文件处理失败: " << epubFiles[index] << endl;
+        return false;
+    };
+    
     int successCount = 0;
     int failCount = 0;
+    size_t workerCount = min(ThreadPool::resolveThreadCount(jobs), epubFiles.size());
+    ThreadPool* pool = workerCount > 1 && processingMode != ProcessingMode::PIPELINE ? sharedPool() : nullptr;
     
-    for (size_t i = 0; i < epubFiles.size(); ++i) {
-        const auto& inputFile = epubFiles[i];
+    if (processingMode == ProcessingMode::PIPELINE) {
+        // 流水线模式：各阶段由自己的线程执行，读取阶段预读后续的书
+        vector<char> succeeded;
+        runPipeline(epubFiles, outputFiles, succeeded,
+            [&](EpubProcessor& worker, size_t index, bool) {
+                printHeading(worker, index);
+                if (worker.beginFile(epubFiles[index], outputFiles[index])) {
+                    return true;
+                }
+                worker.errStream() << "文件处理失败: " << epubFiles[index] << endl;
+                return false;
+            },
+            [&](EpubProcessor& worker, size_t index, bool processed) {
+                if (processed) {
+                    worker.finishFile(epubFiles[index], outputFiles[index]);
+                    return true;
+                }
+                worker.stats.errors++;
+                worker.errStream() << "文件处理失败: " << epubFiles[index] << endl;
+                return false;
+            });
+        sort(stats.processedFiles.begin(), stats.processedFiles.end());
+        for (char ok : succeeded) {
+            if (ok) {
+                successCount++;
+            } else {
+                failCount++;
+            }
+        }
+    } else if (pool == nullptr) {
+        for (size_t i = 0; i < epubFiles.size(); ++i) {
+            if (processOne(*this, i)) {
+                successCount++;
+            } else {
+                failCount++;
+            }
+        }
+    } else {
+        // 内置模式在分发前取得，所有工作处理器共享同一份编译结果
+        resolvePatterns();
         
-        if (verbose) {
-            cout << "\n--- 处理文件 " << (i + 1) << "/" << epubFiles.size() << " ---" << endl;
-            cout << "文件名: " << inputFile.filename() << endl;
+        // 未指定压缩线程数时按并行文件数分摊硬件线程，避免每个文件都启动满额的压缩线程
+        size_t workerCompressionThreads = compressionThreads;
+        if (workerCompressionThreads == 0) {
+            workerCompressionThreads = max<size_t>(1, ThreadPool::resolveThreadCount(0) / workerCount);
         }
         
-        // 生成输出文件路径
-        fs::path outputFile = outputDir / inputFile.filename();
+        // 最大的书最先开始：大书尽早占用线程并拆出可被窃取的文档任务，
+        // 批次末尾剩下的是小书，避免最后只有一个线程在处理最大的书
+        vector<size_t> order = largestFirstOrder(epubFiles);
         
-        // 处理文件
-        if (processFile(inputFile, outputFile)) {
-            successCount++;
-        } else {
-            failCount++;
-            cerr << "文件处理失败: " << inputFile << endl;
+        // 每本书一个任务，使用自己的处理器累加统计，全部完成后按文件名顺序合并
+        vector<unique_ptr<EpubProcessor>> workers(epubFiles.size());
+        vector<char> succeeded(epubFiles.size(), 0);
+        {
+            vector<future<void>> done;
+            for (size_t i : order) {
+                done.push_back(pool->submit([&, i]() {
+                    unique_ptr<EpubProcessor> worker = createWorker();
+                    worker->compressionThreads = workerCompressionThreads;
+                    Logger::BufferedOutput output;
+                    worker->outTarget = &output.out();
+                    worker->errTarget = &output.err();
+                    Logger::ScopedErrorTarget errorTarget(output.err());
+                    succeeded[i] = processOne(*worker, i);
+                    output.flush();
+                    worker->outTarget = &cout;
+                    worker->errTarget = &cerr;
+                    workers[i] = std::move(worker);
+                }));
+            }
+            for (auto& task : done) {
+                task.get();
+            }
+        }
+        
+        for (const auto& worker : workers) {
+            stats += worker->stats;
+            const StartupProfile& profile = worker->startupProfile;
+            if (profile.documentStarted &&
+                (!startupProfile.documentStarted || profile.firstDocument < startupProfile.firstDocument)) {
+                startupProfile.documentStarted = true;
+                startupProfile.firstDocument = profile.firstDocument;
+            }
+        }
+        sort(stats.processedFiles.begin(), stats.processedFiles.end());
+        for (char ok : succeeded) {
+            if (ok) {
+                successCount++;
+            } else {
+                failCount++;
+            }
         }
     }
     
     if (verbose) {
-        cout << "\n=== 目录处理完成 ===" << endl;
-        cout << "成功: " << successCount << " 个文件" << endl;
-        cout << "失败: " << failCount << " 个文件" << endl;
-        cout << "总共移除广告: " << stats.adsRemoved << " 处" << endl;
+        outStream() << "\n=== 目录处理完成 ===" << endl;
+        outStream() << "成功: " << successCount << " 个文件" << endl;
+        outStream() << "失败: " << failCount << " 个文件" << endl;
+        outStream() << "总共移除广告: " << stats.adsRemoved << " 处" << endl;
+        outStream() << "预过滤跳过: " << stats.documentsSkipped << " 个文档, " << stats.bytesSkipped << " 字节" << endl;
         if (stats.errors > 0) {
-            cout << "警告: 处理过程中遇到 " << stats.errors << " 个错误" << endl;
+            outStream() << "警告: 处理过程中遇到 " << stats.errors << " 个错误" << endl;
         }
     }
     
@@ -240,20 +920,20 @@ bool EpubProcessor::extractEpub(const fs::path& epubPath, const fs::path& extrac
     auto result = ZipUtils::extractZip(epubPath, extractDir);
     
     if (!result.success()) {
-        cerr << "解压EPUB失败: " << result.message << endl;
+        errStream() << "解压EPUB失败: " << result.message << endl;
         return false;
     }
     
     if (verbose) {
-        cout << "  解压成功: " << extractDir << endl;
+        outStream() << "  解压成功: " << extractDir << endl;
         
         // 列出解压的文件
         auto contents = ZipUtils::listZipContents(epubPath);
         if (!contents.empty()) {
-            cout << "  包含文件: " << contents.size() << " 个" << endl;
+            outStream() << "  包含文件: " << contents.size() << " 个" << endl;
             if (contents.size() <= 10) { // 只显示前10个文件
                 for (const auto& file : contents) {
-                    cout << "    - " << file << endl;
+                    outStream() << "    - " << file << endl;
                 }
             }
         }
@@ -274,22 +954,34 @@ bool EpubProcessor::cleanExtractedFiles(const fs::path& extractDir) {
     
     if (allFiles.empty()) {
         if (verbose) {
-            cout << "  未找到HTML/XHTML文件" << endl;
+            outStream() << "  未找到HTML/XHTML文件" << endl;
         }
         return true;
     }
     
     if (verbose) {
-        cout << "  找到 " << allFiles.size() << " 个HTML/XHTML文件需要清理" << endl;
+        outStream() << "  找到 " << allFiles.size() << " 个HTML/XHTML文件需要清理" << endl;
+    }
+    
+    // 清理每个文件，多个文件时分给线程池并行清理
+    vector<char> succeeded(allFiles.size(), 0);
+    ThreadPool* pool = allFiles.size() > 1 ? sharedPool() : nullptr;
+    if (pool) {
+        runInParallel(allFiles.size(), *pool, [&allFiles](EpubProcessor& worker, size_t index) {
+            return worker.cleanXhtmlFile(allFiles[index]);
+        }, succeeded);
+    } else {
+        for (size_t i = 0; i < allFiles.size(); ++i) {
+            succeeded[i] = cleanXhtmlFile(allFiles[i]);
+        }
     }
     
-    // 清理每个文件
     bool allSuccess = true;
     int cleanedCount = 0;
     
-    for (const auto& file : allFiles) {
-        if (!cleanXhtmlFile(file)) {
-            cerr << "警告: 清理文件失败: " << file << endl;
+    for (size_t i = 0; i < allFiles.size(); ++i) {
+        if (!succeeded[i]) {
+            errStream() << "警告: 清理文件失败: " << allFiles[i] << endl;
             allSuccess = false;
             stats.errors++;
         } else {
@@ -298,24 +990,97 @@ bool EpubProcessor::cleanExtractedFiles(const fs::path& extractDir) {
     }
     
     if (verbose) {
-        cout << "  已清理文件: " << cleanedCount << " 个" << endl;
+        outStream() << "  已清理文件: " << cleanedCount << " 个" << endl;
     }
     
     return allSuccess;
 }
 
+// 调用线程和线程池中的线程一起按顺序领取任务。调用线程只等待已被领取、正在执行的任务，
+// 不等待还在排队的线程池任务，所以调用线程本身是线程池中的线程（批量处理）时也不会死锁；
+// 排队的线程池任务开始运行时如果已经领取不到任务就直接返回，不再访问处理器和task
+void EpubProcessor::runInParallel(size_t count, ThreadPool& pool, const ItemTask& task, vector<char>& succeeded) {
+    struct ItemResult {
+        bool success = false;
+        Stats stats;
+        string output;
+        string errors;
+    };
+    struct Job {
+        ItemTask task;
+        vector<ItemResult> results;
+        atomic<size_t> next{0};
+        mutex doneMutex;
+        condition_variable allDone;
+        size_t done = 0;
+    };
+    
+    // 记录第一个文档开始的时刻，并在分发前取得模式，工作处理器共享同一份
+    documentPatterns();
+    
+    auto job = make_shared<Job>();
+    job->task = task;
+    job->results.resize(count);
+    
+    auto work = [this, job]() {
+        size_t index = job->next++;
+        if (index >= job->results.size()) {
+            return;
+        }
+        unique_ptr<EpubProcessor> worker = createWorker();
+        for (; index < job->results.size(); index = job->next++) {
+            ItemResult& result = job->results[index];
+            ostringstream output, errors;
+            worker->outTarget = &output;
+            worker->errTarget = &errors;
+            worker->stats = Stats{};
+            {
+                Logger::ScopedErrorTarget errorTarget(errors);
+                result.success = job->task(*worker, index);
+            }
+            result.stats = std::move(worker->stats);
+            result.output = output.str();
+            result.errors = errors.str();
+            {
+                lock_guard<mutex> lock(job->doneMutex);
+                job->done++;
+            }
+            job->allDone.notify_all();
+        }
+    };
+    
+    size_t helpers = min(pool.size(), count) - 1;
+    for (size_t i = 0; i < helpers; ++i) {
+        pool.submit(work);
+    }
+    work();
+    {
+        unique_lock<mutex> lock(job->doneMutex);
+        job->allDone.wait(lock, [&job]() { return job->done == job->results.size(); });
+    }
+    
+    succeeded.assign(count, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const ItemResult& result = job->results[i];
+        succeeded[i] = result.success;
+        stats += result.stats;
+        outStream() << result.output;
+        errStream() << result.errors;
+    }
+}
+
 bool EpubProcessor::repackEpub(const fs::path& extractDir, const fs::path& epubPath) {
     // 使用新的ZipUtils模块打包
     auto result = ZipUtils::createZip(extractDir, epubPath);
     
     if (!result.success()) {
-        cerr << "重新打包EPUB失败: " << result.message << endl;
+        errStream() << "重新打包EPUB失败: " << result.message << endl;
         return false;
     }
     
     if (verbose) {
-        cout << "  打包成功: " << epubPath << endl;
-        cout << "  文件大小: " << FileUtils::getFileSize(epubPath) << " 字节" << endl;
+        outStream() << "  打包成功: " << epubPath << endl;
+        outStream() << "  文件大小: " << FileUtils::getFileSize(epubPath) << " 字节" << endl;
     }
     
     return true;
@@ -323,155 +1088,164 @@ bool EpubProcessor::repackEpub(const fs::path& extractDir, const fs::path& epubP
 
 bool EpubProcessor::cleanXhtmlFile(const fs::path& filePath) {
     try {
+        // 大文件流式清理，不整体读入内存
+        if (streamingThreshold > 0 && FileUtils::getFileSize(filePath) > streamingThreshold) {
+            bool streamed = false;
+            bool success = streamCleanFile(filePath, streamed);
+            if (streamed) {
+                return success;
+            }
+        }
+        
         // 读取文件内容
         string content = FileUtils::readFileToString(filePath);
         if (content.empty()) {
             if (verbose) {
-                cout << "    跳过空文件: " << filePath.filename() << endl;
+                outStream() << "    跳过空文件: " << filePath.filename() << endl;
             }
             return true;
         }
         
-        // 检测文件编码
-        // 检查XML声明中的编码属性
-        string encoding = "UTF-8"; // 默认假设为UTF-8
-        
-        // 查找XML声明
-        size_t xmlDeclStart = content.find("<?xml");
-        if (xmlDeclStart != string::npos) {
-            size_t xmlDeclEnd = content.find("?>", xmlDeclStart);
-            if (xmlDeclEnd != string::npos) {
-                string xmlDecl = content.substr(xmlDeclStart, xmlDeclEnd - xmlDeclStart + 2);
-                
-                // 查找encoding属性
-                size_t encodingPos = xmlDecl.find("encoding=");
-                if (encodingPos != string::npos) {
-                    size_t quoteStart = xmlDecl.find_first_of("'\"", encodingPos + 9);
-                    if (quoteStart != string::npos) {
-                        size_t quoteEnd = xmlDecl.find_first_of("'\"", quoteStart + 1);
-                        if (quoteEnd != string::npos) {
-                            encoding = xmlDecl.substr(quoteStart + 1, quoteEnd - quoteStart - 1);
-                            
-                            // 转换为大写以便比较
-                            string encodingUpper = encoding;
-                            transform(encodingUpper.begin(), encodingUpper.end(), encodingUpper.begin(), 
-                                     [](unsigned char c) { return static_cast<char>(::toupper(c)); });
-                            
-                            // 如果不保持原始编码，且不是UTF-8，则转换为UTF-8
-                            if (!preserveEncoding && encodingUpper != "UTF-8" && encodingUpper != "UTF8") {
-                                if (verbose) {
-                                    cout << "    检测到编码: " << encoding << ", 将转换为UTF-8" << endl;
-                                }
-                                // 转换为UTF-8
-                                content = FileUtils::toUtf8(content, encoding);
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        
-        // 应用广告模式
-        string cleanedContent = applyAdPatterns(content);
-        
-        // 检查是否有变化
-        if (content == cleanedContent) {
-            if (verbose) {
-                cout << "    未发现广告内容: " << filePath.filename() << endl;
-            }
+        if (!cleanXhtmlContent(content, filePath.filename().string())) {
             return true;
         }
         
-        // 如果不保持原始编码，确保XML声明中的编码是UTF-8
-        if (!preserveEncoding) {
-            size_t xmlDeclStart2 = cleanedContent.find("<?xml");
-            if (xmlDeclStart2 != string::npos) {
-                size_t xmlDeclEnd2 = cleanedContent.find("?>", xmlDeclStart2);
-                if (xmlDeclEnd2 != string::npos) {
-                    string xmlDecl = cleanedContent.substr(xmlDeclStart2, xmlDeclEnd2 - xmlDeclStart2 + 2);
-                    
-                    // 检查并更新编码属性
-                    size_t encodingPos = xmlDecl.find("encoding=");
-                    if (encodingPos != string::npos) {
-                        // 更新为UTF-8
-                        string newXmlDecl = xmlDecl;
-                        size_t quoteStart = newXmlDecl.find_first_of("'\"", encodingPos + 9);
-                        if (quoteStart != string::npos) {
-                            size_t quoteEnd = newXmlDecl.find_first_of("'\"", quoteStart + 1);
-                            if (quoteEnd != string::npos) {
-                                newXmlDecl.replace(quoteStart + 1, quoteEnd - quoteStart - 1, "UTF-8");
-                                cleanedContent.replace(xmlDeclStart2, xmlDeclEnd2 - xmlDeclStart2 + 2, newXmlDecl);
-                            }
-                        }
-                    } else {
-                        // 如果没有编码属性，添加一个
-                        size_t versionEnd = xmlDecl.find("version=");
-                        if (versionEnd != string::npos) {
-                            size_t versionQuoteEnd = xmlDecl.find_first_of("'\"", versionEnd + 8);
-                            if (versionQuoteEnd != string::npos) {
-                                versionQuoteEnd = xmlDecl.find_first_of("'\"", versionQuoteEnd + 1);
-                                if (versionQuoteEnd != string::npos) {
-                                    string newXmlDecl = xmlDecl.substr(0, versionQuoteEnd + 1) + 
-                                                        " encoding=\"UTF-8\"" + 
-                                                        xmlDecl.substr(versionQuoteEnd + 1);
-                                    cleanedContent.replace(xmlDeclStart2, xmlDeclEnd2 - xmlDeclStart2 + 2, newXmlDecl);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        
         // 写入清理后的内容
-        if (!FileUtils::writeStringToFile(filePath, cleanedContent)) {
-            cerr << "错误: 无法写入文件: " << filePath << endl;
+        if (!FileUtils::writeStringToFile(filePath, content)) {
+            errStream() << "错误: 无法写入文件: " << filePath << endl;
             return false;
         }
         
         if (verbose) {
-            cout << "    已清理文件: " << filePath.filename() << endl;
+            outStream() << "    已清理文件: " << filePath.filename() << endl;
         }
         
         return true;
         
     } catch (const exception& e) {
-        cerr << "清理文件时发生异常: " << filePath << " - " << e.what() << endl;
+        errStream() << "清理文件时发生异常: " << filePath << " - " << e.what() << endl;
         return false;
     }
 }
 
-string EpubProcessor::applyAdPatterns(const string& content) {
-    string result = content;
-    int adsRemovedInThisFile = 0;
+bool EpubProcessor::streamCleanFile(const fs::path& filePath, bool& streamed) {
+    streamed = true;
+    fs::path tempPath = filePath.string() + ".tmp";
     
-    for (const auto& pattern : adPatterns) {
-        try {
-            // 使用regex_replace替换匹配的内容
-            string previous = result;
-            result = regex_replace(result, pattern, "");
-            
-            // 统计移除的广告数量
-            if (result != previous) {
-                adsRemovedInThisFile++;
-                stats.adsRemoved++;
-                
-                if (verbose) {
-                    // 可以在这里记录更详细的信息
-                }
-            }
-            
-        } catch (const regex_error& e) {
-            cerr << "正则表达式错误: " << e.what() << endl;
-            stats.errors++;
+    ifstream input(filePath, ios::binary);
+    ofstream output(tempPath, ios::binary | ios::trunc);
+    if (!input || !output) {
+        errStream() << "错误: 无法打开文件: " << filePath << endl;
+        return false;
+    }
+    
+    DocumentStreamCleaner cleaner(documentPatterns(), streamingWindow, preserveEncoding, stats,
+                                  patternProfile.get(), filePath.filename().string(),
+                                  verbose ? &outStream() : nullptr);
+    vector<char> buffer(64 * 1024);
+    string out;
+    bool last = false;
+    while (!last) {
+        input.read(buffer.data(), static_cast<streamsize>(buffer.size()));
+        size_t got = static_cast<size_t>(input.gcount());
+        last = got < buffer.size();
+        if (input.bad()) {
+            output.close();
+            FileUtils::removeFile(tempPath);
+            errStream() << "错误: 读取文件失败: " << filePath << endl;
+            return false;
+        }
+        
+        out.clear();
+        if (!cleaner.write(buffer.data(), got, last, out)) {
+            output.close();
+            FileUtils::removeFile(tempPath);
+            streamed = false;
+            return false;
+        }
+        output.write(out.data(), static_cast<streamsize>(out.size()));
+    }
+    input.close();
+    output.close();
+    
+    if (!output || !cleaner.modified()) {
+        FileUtils::removeFile(tempPath);
+        if (!output) {
+            errStream() << "错误: 无法写入文件: " << filePath << endl;
+            return false;
+        }
+        if (verbose) {
+            outStream() << "    未发现广告内容: " << filePath.filename() << endl;
+        }
+        return true;
+    }
+    
+    if (!FileUtils::moveFile(tempPath, filePath)) {
+        FileUtils::removeFile(tempPath);
+        errStream() << "错误: 无法写入文件: " << filePath << endl;
+        return false;
+    }
+    cleaner.commit();
+    return true;
+}
+
+bool EpubProcessor::cleanXhtmlContent(string& content, const string& displayName) {
+    if (documentCallback) {
+        documentCallback(displayName);
+    }
+    
+    // 检测文件编码，如果不保持原始编码且不是UTF-8，则转换为UTF-8
+    string encoding = declaredEncoding(content);
+    if (!preserveEncoding && !isUtf8Encoding(encoding)) {
+        if (verbose) {
+            outStream() << "    检测到编码: " << encoding << ", 将转换为UTF-8" << endl;
+        }
+        content = FileUtils::toUtf8(content, encoding);
+    }
+    
+    // 应用广告模式
+    if (!applyAdPatterns(content)) {
+        if (verbose) {
+            outStream() << "    未发现广告内容: " << displayName << endl;
         }
+        return false;
     }
     
-    if (verbose && adsRemovedInThisFile > 0) {
-        cout << "      移除广告: " << adsRemovedInThisFile << " 处" << endl;
+    // 如果不保持原始编码，确保XML声明中的编码是UTF-8
+    if (!preserveEncoding) {
+        normalizeXmlDeclaration(content);
     }
     
-    return result;
+    return true;
+}
+
+bool EpubProcessor::applyAdPatterns(string& content) {
+    // 一次扫描找出所有模式的匹配，再一次性删除
+    AdPatterns::ScanStats scanStats;
+    scanStats.profile = patternProfile != nullptr;
+    vector<AdPatterns::MatchSpan> matches = documentPatterns().findAll(content, scanScratch, &scanStats);
+    if (patternProfile) {
+        patternProfile->merge(scanStats.patterns);
+    }
+    stats.errors += static_cast<int>(scanStats.errors);
+    stats.bytesSkipped += scanStats.bytesSkipped;
+    if (!content.empty() && scanStats.bytesSkipped == content.size()) {
+        stats.documentsSkipped++;
+    }
+    if (matches.empty()) {
+        return false;
+    }
+    
+    // 每处匹配计一次：匹配互不重叠，数量就是实际移除的广告数
+    int adsRemovedInThisFile = static_cast<int>(matches.size());
+    stats.adsRemoved += adsRemovedInThisFile;
+    
+    if (verbose) {
+        outStream() << "      移除广告: " << adsRemovedInThisFile << " 处" << endl;
+    }
+    
+    AdPatterns::PatternSet::eraseMatches(content, matches);
+    return true;
 }
 
 bool EpubProcessor::createBackup(const fs::path& filePath) {
@@ -479,9 +1253,9 @@ bool EpubProcessor::createBackup(const fs::path& filePath) {
     
     if (verbose) {
         if (success) {
-            cout << "  备份创建成功: " << filePath.string() << ".bak" << endl;
+            outStream() << "  备份创建成功: " << filePath.string() << ".bak" << endl;
         } else {
-            cout << "  备份创建失败" << endl;
+            outStream() << "  备份创建失败" << endl;
         }
     }
     
@@ -1,11 +1,14 @@
 #include "file_utils.h"
 #include "zip_utils.h"
+#include "async_io.h"
 #include "iconv_wrapper.h"
+#include "logger.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <cstring>
+#include <cerrno>
 #include <random>
 #include <chrono>
 
@@ -20,6 +23,8 @@
     #endif
 #else
     #include <unistd.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
     #include <sys/stat.h>
     #include <dirent.h>
     #include <limits.h>
@@ -54,7 +59,7 @@ namespace FileUtils {
             }
             return fs::create_directories(path);
         } catch (const fs::filesystem_error& e) {
-            cerr << "创建目录失败: " << path << " - " << e.what() << endl;
+            Logger::ErrorLine() << "创建目录失败: " << path << " - " << e.what();
             return false;
         }
     }
@@ -66,7 +71,7 @@ namespace FileUtils {
             }
             return fs::remove(path);
         } catch (const fs::filesystem_error& e) {
-            cerr << "删除文件失败: " << path << " - " << e.what() << endl;
+            Logger::ErrorLine() << "删除文件失败: " << path << " - " << e.what();
             return false;
         }
     }
@@ -78,7 +83,7 @@ namespace FileUtils {
             }
             return fs::remove_all(path) > 0;
         } catch (const fs::filesystem_error& e) {
-            cerr << "删除目录失败: " << path << " - " << e.what() << endl;
+            Logger::ErrorLine() << "删除目录失败: " << path << " - " << e.what();
             return false;
         }
     }
@@ -86,17 +91,23 @@ namespace FileUtils {
     bool copyFile(const fs::path& src, const fs::path& dst) {
         try {
             if (!fileExists(src)) {
-                cerr << "源文件不存在: " << src << endl;
+                Logger::ErrorLine() << "源文件不存在: " << src;
                 return false;
             }
             
-            // 确保目标目录存在
-            createDirectory(dst.parent_path());
+            // 确保目标目录存在（只有文件名时为当前目录）
+            fs::path parentDir = dst.parent_path();
+            if (!parentDir.empty()) {
+                createDirectory(parentDir);
+            }
             
-            fs::copy_file(src, dst, fs::copy_options::overwrite_existing);
+            if (!AsyncIO::copyFile(src, dst)) {
+                Logger::ErrorLine() << "复制文件失败: " << src << " -> " << dst << " - " << strerror(errno);
+                return false;
+            }
             return true;
         } catch (const fs::filesystem_error& e) {
-            cerr << "复制文件失败: " << src << " -> " << dst << " - " << e.what() << endl;
+            Logger::ErrorLine() << "复制文件失败: " << src << " -> " << dst << " - " << e.what();
             return false;
         }
     }
@@ -104,12 +115,15 @@ namespace FileUtils {
     bool moveFile(const fs::path& src, const fs::path& dst) {
         try {
             if (!fileExists(src)) {
-                cerr << "源文件不存在: " << src << endl;
+                Logger::ErrorLine() << "源文件不存在: " << src;
                 return false;
             }
             
-            // 确保目标目录存在
-            createDirectory(dst.parent_path());
+            // 确保目标目录存在（只有文件名时为当前目录）
+            fs::path parentDir = dst.parent_path();
+            if (!parentDir.empty()) {
+                createDirectory(parentDir);
+            }
             
             fs::rename(src, dst);
             return true;
@@ -118,7 +132,7 @@ namespace FileUtils {
             if (copyFile(src, dst)) {
                 return removeFile(src);
             }
-            cerr << "移动文件失败: " << src << " -> " << dst << " - " << e.what() << endl;
+            Logger::ErrorLine() << "移动文件失败: " << src << " -> " << dst << " - " << e.what();
             return false;
         }
     }
@@ -127,42 +141,27 @@ namespace FileUtils {
     
     string readFileToString(const fs::path& path) {
         if (!fileExists(path)) {
-            cerr << "文件不存在: " << path << endl;
+            Logger::ErrorLine() << "文件不存在: " << path;
             return "";
         }
         
         try {
-            ifstream file(path, ios::binary | ios::ate);
-            if (!file.is_open()) {
-                cerr << "无法打开文件: " << path << endl;
-                return "";
-            }
-            
-            streamsize size = file.tellg();
-            file.seekg(0, ios::beg);
-            
-            // 读取原始二进制数据
-            vector<char> buffer(static_cast<size_t>(size));
-            if (!file.read(buffer.data(), size)) {
-                cerr << "读取文件失败: " << path << endl;
+            // 直接读取到结果字符串，不经过中间缓冲区
+            string content;
+            if (!AsyncIO::readFile(path, content)) {
+                Logger::ErrorLine() << "读取文件失败: " << path;
                 return "";
             }
             
             // 检查UTF-8 BOM (EF BB BF)
-            string content;
-            if (size >= 3 && 
-                static_cast<unsigned char>(buffer[0]) == 0xEF &&
-                static_cast<unsigned char>(buffer[1]) == 0xBB &&
-                static_cast<unsigned char>(buffer[2]) == 0xBF) {
+            if (content.compare(0, 3, "\xEF\xBB\xBF") == 0) {
                 // 跳过BOM
-                content.assign(buffer.begin() + 3, buffer.end());
-            } else {
-                content.assign(buffer.begin(), buffer.end());
+                content.erase(0, 3);
             }
             
             return content;
         } catch (const exception& e) {
-            cerr << "读取文件时发生异常: " << path << " - " << e.what() << endl;
+            Logger::ErrorLine() << "读取文件时发生异常: " << path << " - " << e.what();
             return "";
         }
     }
@@ -170,12 +169,9 @@ namespace FileUtils {
     bool writeStringToFile(const fs::path& path, const string& content) {
         try {
             // 确保目录存在
-            createDirectory(path.parent_path());
-            
-            ofstream file(path, ios::binary);
-            if (!file.is_open()) {
-                cerr << "无法创建文件: " << path << endl;
-                return false;
+            fs::path parentDir = path.parent_path();
+            if (!parentDir.empty()) {
+                createDirectory(parentDir);
             }
             
             // 检查是否需要添加UTF-8 BOM
@@ -188,19 +184,23 @@ namespace FileUtils {
             }
             
             // 对于包含非ASCII字符的文本文件，添加UTF-8 BOM
+            string_view bom;
             if (hasNonAscii) {
                 // 检查文件扩展名，只对文本文件添加BOM
                 string ext = getFileExtension(path);
                 if (ext == ".xhtml" || ext == ".html" || ext == ".xml" || 
                     ext == ".opf" || ext == ".ncx" || ext == ".css") {
-                    file.write("\xEF\xBB\xBF", 3);
+                    bom = "\xEF\xBB\xBF";
                 }
             }
             
-            file.write(content.data(), static_cast<streamsize>(content.size()));
-            return file.good();
+            if (!AsyncIO::writeFile(path, {bom, content})) {
+                Logger::ErrorLine() << "写入文件失败: " << path;
+                return false;
+            }
+            return true;
         } catch (const exception& e) {
-            cerr << "写入文件时发生异常: " << path << " - " << e.what() << endl;
+            Logger::ErrorLine() << "写入文件时发生异常: " << path << " - " << e.what();
             return false;
         }
     }
@@ -208,18 +208,21 @@ namespace FileUtils {
     bool appendToFile(const fs::path& path, const string& content) {
         try {
             // 确保目录存在
-            createDirectory(path.parent_path());
+            fs::path parentDir = path.parent_path();
+            if (!parentDir.empty()) {
+                createDirectory(parentDir);
+            }
             
             ofstream file(path, ios::binary | ios::app);
             if (!file.is_open()) {
-                cerr << "无法打开文件: " << path << endl;
+                Logger::ErrorLine() << "无法打开文件: " << path;
                 return false;
             }
             
             file.write(content.data(), static_cast<streamsize>(content.size()));
             return file.good();
         } catch (const exception& e) {
-            cerr << "追加文件时发生异常: " << path << " - " << e.what() << endl;
+            Logger::ErrorLine() << "追加文件时发生异常: " << path << " - " << e.what();
             return false;
         }
     }
@@ -230,7 +233,7 @@ namespace FileUtils {
         vector<fs::path> files;
         
         if (!directoryExists(directory)) {
-            cerr << "目录不存在: " << directory << endl;
+            Logger::ErrorLine() << "目录不存在: " << directory;
             return files;
         }
         
@@ -242,7 +245,7 @@ namespace FileUtils {
                 }
             }
         } catch (const fs::filesystem_error& e) {
-            cerr << "搜索文件时发生异常: " << directory << " - " << e.what() << endl;
+            Logger::ErrorLine() << "搜索文件时发生异常: " << directory << " - " << e.what();
         }
         
         return files;
@@ -252,7 +255,7 @@ namespace FileUtils {
         vector<fs::path> files;
         
         if (!directoryExists(directory)) {
-            cerr << "目录不存在: " << directory << endl;
+            Logger::ErrorLine() << "目录不存在: " << directory;
             return files;
         }
         
@@ -264,7 +267,7 @@ namespace FileUtils {
                 }
             }
         } catch (const fs::filesystem_error& e) {
-            cerr << "递归搜索文件时发生异常: " << directory << " - " << e.what() << endl;
+            Logger::ErrorLine() << "递归搜索文件时发生异常: " << directory << " - " << e.what();
         }
         
         return files;
@@ -318,7 +321,7 @@ namespace FileUtils {
     bool extractZip(const fs::path& zipPath, const fs::path& extractDir) {
         auto result = ZipUtils::extractZip(zipPath, extractDir);
         if (!result.success()) {
-            cerr << "解压ZIP失败: " << result.message << endl;
+            Logger::ErrorLine() << "解压ZIP失败: " << result.message;
         }
         return result.success();
     }
@@ -326,7 +329,7 @@ namespace FileUtils {
     bool createZip(const fs::path& sourceDir, const fs::path& zipPath) {
         auto result = ZipUtils::createZip(sourceDir, zipPath);
         if (!result.success()) {
-            cerr << "创建ZIP失败: " << result.message << endl;
+            Logger::ErrorLine() << "创建ZIP失败: " << result.message;
         }
         return result.success();
     }
@@ -379,6 +382,130 @@ namespace FileUtils {
         }
     }
     
+    // ==================== 文件映射 ====================
+    
+    MappedFile::~MappedFile() {
+        close();
+    }
+    
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+        : mapping(other.mapping), length(other.length),
+          buffer(std::move(other.buffer)), opened(other.opened) {
+        other.mapping = nullptr;
+        other.length = 0;
+        other.opened = false;
+    }
+    
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            mapping = other.mapping;
+            length = other.length;
+            buffer = std::move(other.buffer);
+            opened = other.opened;
+            other.mapping = nullptr;
+            other.length = 0;
+            other.opened = false;
+        }
+        return *this;
+    }
+    
+    const unsigned char* MappedFile::data() const {
+        if (mapping) {
+            return static_cast<const unsigned char*>(mapping);
+        }
+        return reinterpret_cast<const unsigned char*>(buffer.data());
+    }
+    
+    bool MappedFile::open(const fs::path& path) {
+        close();
+        
+#ifdef _WIN32
+        HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file != INVALID_HANDLE_VALUE) {
+            LARGE_INTEGER fileSize;
+            if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &fileSize) &&
+                fileSize.QuadPart > 0) {
+                HANDLE mapHandle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapHandle) {
+                    // 视图独立于句柄存在，映射后即可关闭句柄
+                    mapping = MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+                    CloseHandle(mapHandle);
+                }
+                if (mapping) {
+                    length = static_cast<size_t>(fileSize.QuadPart);
+                }
+            }
+            CloseHandle(file);
+            if (mapping) {
+                opened = true;
+                return true;
+            }
+        }
+        
+        // 回退：缓冲读取
+        ifstream stream(path, ios::binary);
+        if (!stream.is_open()) {
+            return false;
+        }
+        ostringstream contents;
+        contents << stream.rdbuf();
+        buffer = contents.str();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void* addr = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                mapping = addr;
+                length = static_cast<size_t>(info.st_size);
+                ::close(fd);
+                opened = true;
+                return true;
+            }
+        }
+        
+        // 回退：管道和无法映射的文件使用缓冲读取
+        char chunk[64 * 1024];
+        ssize_t count;
+        while ((count = ::read(fd, chunk, sizeof(chunk))) != 0) {
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ::close(fd);
+                buffer.clear();
+                return false;
+            }
+            buffer.append(chunk, static_cast<size_t>(count));
+        }
+        ::close(fd);
+#endif
+        length = buffer.size();
+        opened = true;
+        return true;
+    }
+    
+    void MappedFile::close() {
+        if (mapping) {
+#ifdef _WIN32
+            UnmapViewOfFile(mapping);
+#else
+            munmap(mapping, length);
+#endif
+            mapping = nullptr;
+        }
+        buffer.clear();
+        buffer.shrink_to_fit();
+        length = 0;
+        opened = false;
+    }
+    
             // ==================== 编码转换 ====================
     
     string toUtf8(const string& str, const string& fromEncoding) {
@@ -413,7 +540,7 @@ namespace FileUtils {
     
     bool createBackup(const fs::path& filePath, const string& suffix) {
         if (!fileExists(filePath)) {
-            cerr << "无法备份不存在的文件: " << filePath << endl;
+            Logger::ErrorLine() << "无法备份不存在的文件: " << filePath;
             return false;
         }
         
@@ -431,7 +558,7 @@ namespace FileUtils {
         fs::path backupPath = filePath.string() + suffix;
         
         if (!fileExists(backupPath)) {
-            cerr << "备份文件不存在: " << backupPath << endl;
+            Logger::ErrorLine() << "备份文件不存在: " << backupPath;
             return false;
         }
         
@@ -17,6 +17,46 @@ namespace Logger {
         globalConfig.minLevel = level;
     }
     
+    void writeBlock(const string& text, bool error) {
+        if (text.empty()) {
+            return;
+        }
+        lock_guard<mutex> lock(logMutex);
+        ostream* output = error ? globalConfig.errorOutput : globalConfig.output;
+        *output << text;
+        output->flush();
+    }
+    
+    BufferedOutput::~BufferedOutput() {
+        flush();
+    }
+    
+    void BufferedOutput::flush() {
+        writeBlock(outBuffer.str());
+        writeBlock(errBuffer.str(), true);
+        outBuffer.str(string());
+        errBuffer.str(string());
+    }
+    
+    static thread_local ostream* errorTarget = nullptr;
+    
+    ScopedErrorTarget::ScopedErrorTarget(ostream& target) : previous(errorTarget) {
+        errorTarget = &target;
+    }
+    
+    ScopedErrorTarget::~ScopedErrorTarget() {
+        errorTarget = previous;
+    }
+    
+    ErrorLine::~ErrorLine() {
+        buffer << '\n';
+        if (errorTarget) {
+            *errorTarget << buffer.str();
+        } else {
+            writeBlock(buffer.str(), true);
+        }
+    }
+    
     // LogStream 实现
     LogStream::LogStream(Level level, const char* file, int line) 
         : level(level), file(file), line(line) {
@@ -2,6 +2,7 @@
 #include "ad_patterns.h"
 #include "file_utils.h"
 #include "logger.h"
+#include "async_io.h"
 #include "epub_cleaner/version.h"
 #include <iostream>
 #include <string>
@@ -9,6 +10,11 @@
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <memory>
+#include <cstdio>
 
 #ifdef _WIN32
     #include <windows.h>
@@ -30,6 +36,21 @@ struct CommandLineArgs {
     bool debug = false;
     bool quiet = false;
     bool preserveEncoding = false;  // 新增：保持原始编码
+    string mode;                    // 处理模式: extract / rewrite / memory / pipeline
+    int jobs = 0;                   // 批量处理时同时处理的文件数，0为硬件并发数
+    string stageThreads;            // 流水线各阶段线程数: 读取:解压:清理:压缩:写出
+    int readAhead = 2;              // 流水线预读的书数
+    int zipThreads = 0;             // 重新压缩线程数，0为自动
+    int zipChunkKB = 0;             // 大条目分块压缩的块大小(KB)，0为不分块
+    int streamThresholdMB = 64;     // 超过该大小(MB)的内容文档流式清理，0为不使用
+    int streamWindowKB = 64;        // 流式清理跨块匹配保留的窗口(KB)
+    string ioBackend = "auto";      // 文件读写后端: auto / sync / uring
+    int ioDepth = 32;               // io_uring每个线程同时在途的请求数
+    string regexEngine = "auto";    // 正则表达式引擎: auto / dfa / std
+    bool startupProfile = false;    // 输出启动阶段耗时
+    string compilePatterns;         // 把该模式文件编译为预编译模式包（输出到-o）
+    bool analyzePatterns = false;   // 分析模式集合后退出
+    string patternStats;            // 处理结束后按模式输出统计: table / json，为空时不统计
 };
 
 // 显示帮助信息
@@ -43,10 +64,29 @@ void showHelp() {
     cout << "\n    -I, --input-dir DIR     输入目录（批量处理）";
     cout << "\n    -O, --output-dir DIR    输出目录（批量处理）";
     cout << "\n  \n  广告模式:";
-    cout << "\n    -p, --patterns FILE     自定义广告模式文件";
+    cout << "\n    -p, --patterns FILE     自定义广告模式文件（文本或预编译模式包）";
+    cout << "\n    --compile-patterns FILE 把模式文件编译为预编译模式包，输出到 -o 指定的文件";
     cout << "\n    --list-patterns        列出所有内置广告模式";
+    cout << "\n    --analyze-patterns      分析内置模式（或 -p 指定的模式文件）：冗余模式和回溯隐患";
+    cout << "\n    --regex-engine ENGINE   auto: DFA引擎，不支持的语法回退到std::regex（默认）";
+    cout << "\n                            dfa:  只使用线性时间的DFA引擎";
+    cout << "\n                            std:  只使用std::regex";
     cout << "\n  \n  编码处理:";
     cout << "\n    -e, --preserve-encoding 保持原始文件编码（不转换为UTF-8）";
+    cout << "\n  \n  处理模式:";
+    cout << "\n    --mode MODE             extract: 解压到临时目录后重新打包";
+    cout << "\n                            rewrite: ZIP到ZIP重写，未修改条目直接复制（默认）";
+    cout << "\n                            memory:  整本书在内存中处理，只读写输入和输出文件";
+    cout << "\n                            pipeline: 读取、解压、清理、压缩、写出分阶段并发执行";
+    cout << "\n    -j, --jobs N            批量处理时同时处理的文件数（默认0：硬件并发数）";
+    cout << "\n    --stage-threads R:D:C:Z:W 流水线读取:解压:清理:压缩:写出的线程数（默认1:1:0:0:1，0：-j的值）";
+    cout << "\n    --read-ahead N          流水线预读的书数（默认2；内存中的书数不超过N+解压线程数+写出线程数）";
+    cout << "\n    --zip-threads N         重新压缩条目使用的线程数（默认0：自动）";
+    cout << "\n    --zip-chunk-size KB     大条目拆分为多块并行压缩（默认0：不拆分）";
+    cout << "\n    --stream-threshold MB   超过该大小的内容文档流式清理（默认64，0：不使用）";
+    cout << "\n    --stream-window KB      流式清理时单个广告的最大长度（默认64）";
+    cout << "\n    --io-backend B          文件读写: auto（io_uring可用时使用，默认）、sync、uring";
+    cout << "\n    --io-depth N            io_uring每个线程同时在途的读写请求数（默认32）";
     cout << "\n  \n  日志和输出:";
     cout << "\n    -v, --verbose           启用详细输出";
     cout << "\n    -q, --quiet             静默模式，只显示错误";
@@ -55,6 +95,9 @@ void showHelp() {
     cout << "\n    -n, --no-backup         不创建备份文件";
     cout << "\n    -h, --help              显示此帮助信息";
     cout << "\n    -V, --version           显示版本信息";
+    cout << "\n    --startup-profile       输出启动阶段耗时（到开始处理第一个内容文档为止）";
+    cout << "\n    --pattern-stats [FMT]   处理结束后按模式输出调用次数、匹配数、扫描/移除字节数和耗时";
+    cout << "\n                            FMT: table（默认）或 json";
     cout << "\n\n示例:";
     cout << "\n  epub_cleaner -i book.epub -o clean_book.epub";
     cout << "\n  epub_cleaner -I ./books -O ./cleaned_books -v";
@@ -66,7 +109,11 @@ void showHelp() {
 // 显示版本信息
 void showVersion() {
     cout << epub_cleaner::VersionInfo::getFullInfo() << endl;
+#ifdef HAVE_ZLIB
+    cout << "使用C++17和内置ZIP读写（zlib）" << endl;
+#else
     cout << "使用C++17和系统ZIP命令" << endl;
+#endif
     cout << "编译时间: " << __DATE__ << " " << __TIME__ << endl;
 }
 
@@ -97,6 +144,134 @@ void listBuiltinPatterns() {
     }
 }
 
+// 分析模式集合：加载时会跳过的冗余模式，以及std::regex执行时最坏情况超线性的写法
+int analyzePatterns(const CommandLineArgs& args) {
+    AdPatterns::Engine engine = AdPatterns::Engine::AUTO;
+    AdPatterns::parseEngine(args.regexEngine, engine);
+    
+    vector<string> labels;
+    AdPatterns::PatternSet patterns;
+    auto addPattern = [&](const string& label, const string& pattern) {
+        string error;
+        if (patterns.add(pattern, engine, &error)) {
+            labels.push_back(label);
+        } else {
+            cerr << "警告: 无效的正则表达式: " << pattern << " (" << error << ")" << endl;
+        }
+    };
+    if (args.patternFile.empty()) {
+        for (const auto& pattern : AdPatterns::getBuiltinPatterns()) {
+            if (pattern.enabled) {
+                addPattern(pattern.name, pattern.pattern);
+            }
+        }
+    } else {
+        for (const auto& pattern : AdPatterns::loadPatternStringsFromFile(args.patternFile)) {
+            addPattern(pattern, pattern);
+        }
+    }
+    
+    AdPatterns::PatternAnalysis analysis = AdPatterns::analyzePatternSet(patterns);
+    cout << "模式集合分析 (共" << patterns.size() << "个模式)" << endl;
+    cout << "========================================" << endl;
+    cout << "\n冗余模式 (" << analysis.redundant.size() << "个，加载时跳过):" << endl;
+    for (const auto& item : analysis.redundant) {
+        cout << "  [" << item.index << "] " << labels[item.index]
+             << "  <- 被 [" << item.coveredBy << "] " << labels[item.coveredBy] << " 覆盖" << endl;
+    }
+    cout << "\n回溯隐患 (" << analysis.hazards.size() << "处，只影响std::regex执行的模式):" << endl;
+    for (const auto& hazard : analysis.hazards) {
+        cout << "  [" << hazard.index << "] " << labels[hazard.index]
+             << " (" << AdPatterns::engineName(patterns.engineOf(hazard.index)) << ")" << endl;
+        cout << "      " << hazard.description << endl;
+    }
+    return 0;
+}
+
+// 字符串的显示宽度（中日韩等宽字符按2列计）
+size_t displayWidth(const string& text) {
+    size_t width = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if ((c & 0xC0) == 0x80) {
+            continue;
+        }
+        width += c >= 0xE1 ? 2 : 1;
+    }
+    return width;
+}
+
+string padLeft(const string& text, size_t width) {
+    size_t current = displayWidth(text);
+    return current >= width ? text : string(width - current, ' ') + text;
+}
+
+string jsonEscape(const string& text) {
+    string out;
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+// 按模式输出扫描统计：内置模式显示名称，自定义模式显示源字符串
+void printPatternStats(const AdPatterns::PatternProfile& profile, const string& format) {
+    vector<string> names;
+    for (size_t i = 0; i < profile.size(); ++i) {
+        string name = profile.source(i);
+        for (const auto& pattern : AdPatterns::getBuiltinPatterns()) {
+            if (pattern.pattern == profile.source(i)) {
+                name = pattern.name;
+            }
+        }
+        names.push_back(name);
+    }
+    
+    if (format == "json") {
+        cout << "{\"patterns\": [";
+        for (size_t i = 0; i < profile.size(); ++i) {
+            AdPatterns::PatternCounters counters = profile.get(i);
+            cout << (i > 0 ? "," : "") << "\n  {\"index\": " << i
+                 << ", \"name\": \"" << jsonEscape(names[i]) << "\""
+                 << ", \"pattern\": \"" << jsonEscape(profile.source(i)) << "\""
+                 << ", \"invocations\": " << counters.invocations
+                 << ", \"matches\": " << counters.matches
+                 << ", \"bytesScanned\": " << counters.bytesScanned
+                 << ", \"bytesRemoved\": " << counters.bytesRemoved
+                 << ", \"nanoseconds\": " << counters.nanoseconds << "}";
+        }
+        cout << "\n]}" << endl;
+        return;
+    }
+    
+    cout << "按模式统计 (共" << profile.size() << "个模式):" << endl;
+    cout << padLeft("序号", 6) << padLeft("调用次数", 12) << padLeft("匹配数", 10) << padLeft("扫描字节", 14)
+         << padLeft("移除字节", 12) << padLeft("耗时(ms)", 12) << "  模式" << endl;
+    for (size_t i = 0; i < profile.size(); ++i) {
+        AdPatterns::PatternCounters counters = profile.get(i);
+        ostringstream milliseconds;
+        milliseconds << fixed << setprecision(3) << counters.nanoseconds / 1e6;
+        cout << padLeft(to_string(i), 6) << padLeft(to_string(counters.invocations), 12)
+             << padLeft(to_string(counters.matches), 10) << padLeft(to_string(counters.bytesScanned), 14)
+             << padLeft(to_string(counters.bytesRemoved), 12) << padLeft(milliseconds.str(), 12)
+             << "  " << names[i] << endl;
+    }
+}
+
 // 解析命令行参数
 CommandLineArgs parseArguments(int argc, char* argv[]) {
     CommandLineArgs args;
@@ -140,6 +315,54 @@ CommandLineArgs parseArguments(int argc, char* argv[]) {
         else if (arg == "-e" || arg == "--preserve-encoding") {
             args.preserveEncoding = true;
         }
+        else if (arg == "--mode") {
+            if (i + 1 < argc) args.mode = argv[++i];
+        }
+        else if (arg == "-j" || arg == "--jobs") {
+            if (i + 1 < argc) args.jobs = atoi(argv[++i]);
+        }
+        else if (arg == "--stage-threads") {
+            if (i + 1 < argc) args.stageThreads = argv[++i];
+        }
+        else if (arg == "--read-ahead") {
+            if (i + 1 < argc) args.readAhead = atoi(argv[++i]);
+        }
+        else if (arg == "--zip-threads") {
+            if (i + 1 < argc) args.zipThreads = atoi(argv[++i]);
+        }
+        else if (arg == "--zip-chunk-size") {
+            if (i + 1 < argc) args.zipChunkKB = atoi(argv[++i]);
+        }
+        else if (arg == "--stream-threshold") {
+            if (i + 1 < argc) args.streamThresholdMB = atoi(argv[++i]);
+        }
+        else if (arg == "--stream-window") {
+            if (i + 1 < argc) args.streamWindowKB = atoi(argv[++i]);
+        }
+        else if (arg == "--io-backend") {
+            if (i + 1 < argc) args.ioBackend = argv[++i];
+        }
+        else if (arg == "--io-depth") {
+            if (i + 1 < argc) args.ioDepth = atoi(argv[++i]);
+        }
+        else if (arg == "--regex-engine") {
+            if (i + 1 < argc) args.regexEngine = argv[++i];
+        }
+        else if (arg == "--compile-patterns") {
+            if (i + 1 < argc) args.compilePatterns = argv[++i];
+        }
+        else if (arg == "--startup-profile") {
+            args.startupProfile = true;
+        }
+        else if (arg == "--analyze-patterns") {
+            args.analyzePatterns = true;
+        }
+        else if (arg == "--pattern-stats") {
+            args.patternStats = "table";
+            if (i + 1 < argc && (strcmp(argv[i + 1], "table") == 0 || strcmp(argv[i + 1], "json") == 0)) {
+                args.patternStats = argv[++i];
+            }
+        }
         else if (arg == "--list-patterns") {
             listBuiltinPatterns();
             exit(0);
@@ -159,12 +382,62 @@ CommandLineArgs parseArguments(int argc, char* argv[]) {
     return args;
 }
 
+// 解析 --stage-threads 的 读取:解压:清理:压缩:写出，为空时保留默认值
+bool parseStageThreads(const string& text, EpubProcessor::PipelineOptions& options) {
+    if (text.empty()) {
+        return true;
+    }
+    size_t* targets[] = {&options.readThreads, &options.decodeThreads, &options.cleanThreads,
+                         &options.compressThreads, &options.writeThreads};
+    stringstream input(text);
+    string field;
+    size_t count = 0;
+    while (getline(input, field, ':')) {
+        if (count >= 5 || field.empty() || field.size() > 4 ||
+            field.find_first_not_of("0123456789") != string::npos) {
+            return false;
+        }
+        *targets[count++] = static_cast<size_t>(stoul(field));
+    }
+    return count == 5;
+}
+
 // 验证参数
 bool validateArguments(const CommandLineArgs& args) {
     if (args.showHelp || args.version) {
         return true;
     }
     
+    if (args.analyzePatterns) {
+        if (!args.patternFile.empty() && !FileUtils::fileExists(args.patternFile)) {
+            cerr << "错误: 广告模式文件不存在: " << args.patternFile << endl;
+            return false;
+        }
+        AdPatterns::Engine engine;
+        if (!AdPatterns::parseEngine(args.regexEngine, engine)) {
+            cerr << "错误: 未知的正则表达式引擎: " << args.regexEngine << endl;
+            return false;
+        }
+        return true;
+    }
+    
+    if (!args.compilePatterns.empty()) {
+        if (!FileUtils::fileExists(args.compilePatterns)) {
+            cerr << "错误: 广告模式文件不存在: " << args.compilePatterns << endl;
+            return false;
+        }
+        if (args.outputPath.empty()) {
+            cerr << "错误: --compile-patterns 需要用 -o 指定输出文件" << endl;
+            return false;
+        }
+        AdPatterns::Engine engine;
+        if (!AdPatterns::parseEngine(args.regexEngine, engine)) {
+            cerr << "错误: 未知的正则表达式引擎: " << args.regexEngine << endl;
+            return false;
+        }
+        return true;
+    }
+    
     if (args.inputPath.empty() && args.inputDir.empty()) {
         cerr << "错误: 必须指定输入文件或输入目录" << endl;
         return false;
@@ -197,6 +470,55 @@ bool validateArguments(const CommandLineArgs& args) {
         }
     }
     
+    if (!args.mode.empty() && args.mode != "extract" && args.mode != "rewrite" &&
+        args.mode != "memory" && args.mode != "pipeline") {
+        cerr << "错误: 未知的处理模式: " << args.mode << endl;
+        return false;
+    }
+    
+    AdPatterns::Engine engine;
+    if (!AdPatterns::parseEngine(args.regexEngine, engine)) {
+        cerr << "错误: 未知的正则表达式引擎: " << args.regexEngine << endl;
+        return false;
+    }
+    
+    if (args.jobs < 0) {
+        cerr << "错误: --jobs 不能为负数" << endl;
+        return false;
+    }
+    
+    EpubProcessor::PipelineOptions pipelineOptions;
+    if (!parseStageThreads(args.stageThreads, pipelineOptions)) {
+        cerr << "错误: --stage-threads 格式应为 读取:解压:清理:压缩:写出，例如 1:1:4:2:1" << endl;
+        return false;
+    }
+    
+    if (args.readAhead <= 0) {
+        cerr << "错误: --read-ahead 必须大于0" << endl;
+        return false;
+    }
+    
+    if (args.zipThreads < 0 || args.zipChunkKB < 0) {
+        cerr << "错误: --zip-threads 和 --zip-chunk-size 不能为负数" << endl;
+        return false;
+    }
+    
+    AsyncIO::Backend ioBackend;
+    if (!AsyncIO::parseBackend(args.ioBackend, ioBackend)) {
+        cerr << "错误: 未知的文件读写后端: " << args.ioBackend << endl;
+        return false;
+    }
+    
+    if (args.ioDepth <= 0 || args.ioDepth > 4096) {
+        cerr << "错误: --io-depth 必须在1到4096之间" << endl;
+        return false;
+    }
+    
+    if (args.streamThresholdMB < 0 || args.streamWindowKB <= 0) {
+        cerr << "错误: --stream-threshold 不能为负数，--stream-window 必须大于0" << endl;
+        return false;
+    }
+    
     if (!args.patternFile.empty() && !FileUtils::fileExists(args.patternFile)) {
         cerr << "错误: 广告模式文件不存在: " << args.patternFile << endl;
         return false;
@@ -210,6 +532,45 @@ bool validateArguments(const CommandLineArgs& args) {
     return true;
 }
 
+// 启动阶段计时：记录各阶段结束的时刻，程序结束前输出
+class StartupTimer {
+public:
+    using Clock = chrono::steady_clock;
+    
+    StartupTimer() : start(Clock::now()), last(start) {}
+    
+    void mark(const string& phase) {
+        Clock::time_point now = Clock::now();
+        phases.emplace_back(phase, elapsedMs(last, now));
+        last = now;
+    }
+    
+    void print(const EpubProcessor::StartupProfile& profile) const {
+        cout << "启动耗时分析:" << fixed << setprecision(3) << endl;
+        for (const auto& phase : phases) {
+            cout << "  " << phase.first << ": " << phase.second << " ms" << endl;
+        }
+        cout << "  编译内置模式: " << profile.patternCompileMs << " ms" << endl;
+        if (profile.documentStarted) {
+            cout << "  到开始处理第一个内容文档: " << elapsedMs(start, profile.firstDocument) << " ms" << endl;
+        } else {
+            cout << "  到开始处理第一个内容文档: - (没有内容文档)" << endl;
+        }
+        cout << "  总耗时: " << elapsedMs(start, Clock::now()) << " ms" << endl;
+        cout.unsetf(ios::floatfield);
+        cout << setprecision(6);
+    }
+    
+private:
+    static double elapsedMs(Clock::time_point from, Clock::time_point to) {
+        return chrono::duration<double, milli>(to - from).count();
+    }
+    
+    Clock::time_point start;
+    Clock::time_point last;
+    vector<pair<string, double>> phases;
+};
+
 // 生成默认输出路径
 string getDefaultOutputPath(const string& inputPath) {
     namespace fs = std::filesystem;
@@ -227,6 +588,8 @@ string getDefaultOutputDir(const string& inputDir) {
 }
 
 int main(int argc, char* argv[]) {
+    StartupTimer startupTimer;
+    
     // Windows 控制台编码设置
 #ifdef _WIN32
     // 设置控制台输出为 UTF-8 编码
@@ -266,6 +629,44 @@ int main(int argc, char* argv[]) {
         showHelp();
         return 1;
     }
+    startupTimer.mark("解析参数");
+    
+    // 配置文件读写后端；要求io_uring但不可用时回退到同步读写。
+    // 探测会在当前线程创建io_uring并注册缓冲区，所以只在需要警告或输出调试信息时进行，
+    // 否则留到第一次读写时再创建
+    AsyncIO::Config& ioConfig = AsyncIO::getConfig();
+    AsyncIO::parseBackend(args.ioBackend, ioConfig.backend);
+    ioConfig.queueDepth = static_cast<unsigned>(args.ioDepth);
+    if (ioConfig.backend == AsyncIO::Backend::IO_URING || Logger::getConfig().minLevel <= Logger::Level::DEBUG) {
+        AsyncIO::Backend active = AsyncIO::activeBackend();
+        if (ioConfig.backend == AsyncIO::Backend::IO_URING && active != AsyncIO::Backend::IO_URING) {
+            LOG_WARN << "io_uring不可用，使用同步文件读写";
+        }
+        LOG_DEBUG << "文件读写后端: " << AsyncIO::backendName(active);
+        startupTimer.mark("探测文件读写后端");
+    }
+    
+    if (args.analyzePatterns) {
+        return analyzePatterns(args);
+    }
+    
+    // 编译模式文件为预编译模式包
+    if (!args.compilePatterns.empty()) {
+        AdPatterns::Engine engine = AdPatterns::Engine::AUTO;
+        AdPatterns::parseEngine(args.regexEngine, engine);
+        auto patterns = AdPatterns::loadPatternSetFromFile(args.compilePatterns, engine);
+        if (patterns.empty()) {
+            LOG_ERROR << "错误: 没有可编译的广告模式: " << args.compilePatterns;
+            return 1;
+        }
+        string error;
+        if (!AdPatterns::savePatternBundle(patterns, args.outputPath, &error)) {
+            LOG_ERROR << "错误: 无法保存预编译模式包: " << error;
+            return 1;
+        }
+        LOG_INFO << "已编译 " << patterns.size() << " 个广告模式到: " << args.outputPath;
+        return 0;
+    }
     
     try {
         LOG_INFO << "EPUB广告清理工具启动";
@@ -273,12 +674,50 @@ int main(int argc, char* argv[]) {
                 // 创建EPUB处理器，传递编码保持选项
         EpubProcessor processor(args.verbose, !args.noBackup, args.preserveEncoding);
         
-        // 加载自定义广告模式（如果指定）
+        if (args.mode == "extract") {
+            processor.setProcessingMode(EpubProcessor::ProcessingMode::EXTRACT);
+        } else if (args.mode == "rewrite") {
+            processor.setProcessingMode(EpubProcessor::ProcessingMode::REWRITE);
+        } else if (args.mode == "memory") {
+            processor.setProcessingMode(EpubProcessor::ProcessingMode::MEMORY);
+        } else if (args.mode == "pipeline") {
+            processor.setProcessingMode(EpubProcessor::ProcessingMode::PIPELINE);
+        }
+        EpubProcessor::PipelineOptions pipelineOptions;
+        parseStageThreads(args.stageThreads, pipelineOptions);
+        pipelineOptions.readAhead = static_cast<size_t>(args.readAhead);
+        processor.setPipelineOptions(pipelineOptions);
+        processor.setJobs(static_cast<size_t>(args.jobs));
+        processor.setCompressionThreads(static_cast<size_t>(args.zipThreads));
+        processor.setCompressionChunkSize(static_cast<size_t>(args.zipChunkKB) * 1024);
+        processor.setStreamingThreshold(static_cast<uint64_t>(args.streamThresholdMB) * 1024 * 1024);
+        processor.setStreamingWindow(static_cast<size_t>(args.streamWindowKB) * 1024);
+        
+        AdPatterns::Engine engine = AdPatterns::Engine::AUTO;
+        AdPatterns::parseEngine(args.regexEngine, engine);
+        processor.setRegexEngine(engine);
+        startupTimer.mark("创建处理器");
+        
+        // 加载自定义广告模式（如果指定）；内置模式不会被编译
+        AdPatterns::PatternSet customPatterns;
         if (!args.patternFile.empty()) {
             LOG_INFO << "加载自定义广告模式文件: " << args.patternFile;
-            auto patterns = AdPatterns::loadPatternsFromFile(args.patternFile);
-            processor.setAdPatterns(patterns);
-            LOG_INFO << "已加载 " << patterns.size() << " 个自定义广告模式";
+            customPatterns = AdPatterns::loadPatternSetFromFile(args.patternFile, engine);
+            processor.setAdPatterns(customPatterns);
+            LOG_INFO << "已加载 " << customPatterns.size() << " 个自定义广告模式";
+            startupTimer.mark("加载并编译模式文件");
+        }
+        
+        // 按模式统计需要知道清理时使用的集合，此时才由处理器取得内置模式（编译耗时记入处理器的启动统计）
+        shared_ptr<AdPatterns::PatternProfile> patternProfile;
+        if (!args.patternStats.empty()) {
+            const AdPatterns::PatternSet& patterns = processor.getAdPatterns();
+            if (args.patternFile.empty()) {
+                startupTimer.mark("取得内置模式");
+            }
+            patternProfile = make_shared<AdPatterns::PatternProfile>(patterns);
+            processor.setPatternProfile(patternProfile);
+            startupTimer.mark("准备按模式统计");
         }
         
         bool success = false;
@@ -301,6 +740,7 @@ int main(int argc, char* argv[]) {
                 LOG_INFO << "\n处理完成!";
                 LOG_INFO << "文件: " << args.inputPath << " -> " << outputPath;
                 LOG_INFO << "移除广告: " << stats.adsRemoved << " 处";
+                LOG_INFO << "预过滤跳过: " << stats.documentsSkipped << " 个文档, " << stats.bytesSkipped << " 字节";
                 if (stats.errors > 0) {
                     LOG_WARN << "警告: 处理过程中遇到 " << stats.errors << " 个错误";
                 }
@@ -330,12 +770,21 @@ int main(int argc, char* argv[]) {
                 LOG_INFO << "\n批量处理完成!";
                 LOG_INFO << "处理文件数: " << stats.filesProcessed;
                 LOG_INFO << "移除广告总数: " << stats.adsRemoved << " 处";
+                LOG_INFO << "预过滤跳过: " << stats.documentsSkipped << " 个文档, " << stats.bytesSkipped << " 字节";
                 if (stats.errors > 0) {
                     LOG_WARN << "警告: 处理过程中遇到 " << stats.errors << " 个错误";
                 }
             }
         }
         
+        if (patternProfile) {
+            printPatternStats(*patternProfile, args.patternStats);
+        }
+        
+        if (args.startupProfile) {
+            startupTimer.print(processor.getStartupProfile());
+        }
+        
         if (!success) {
             LOG_ERROR << "\n处理失败!";
             return 1;
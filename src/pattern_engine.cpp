@@ -0,0 +1,2416 @@
+#include "pattern_engine.h"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+namespace PatternEngine {
+
+    // ==================== 程序表示 ====================
+
+    // NFA指令（平坦的POD结构，按下标互相引用）
+    enum class Op : uint8_t {
+        BYTE_RANGE,     // 匹配[lo, hi]内的一个字节，然后转到out
+        SPLIT,          // 优先尝试out，其次out1
+        JUMP,           // 转到out
+        ASSERT,         // 零宽断言，成立时转到out
+        MATCH
+    };
+
+    enum class Assertion : uint8_t {
+        BEGIN_TEXT,
+        END_TEXT,
+        WORD_BOUNDARY,
+        NOT_WORD_BOUNDARY
+    };
+
+    struct Inst {
+        Op op = Op::MATCH;
+        uint8_t lo = 0;
+        uint8_t hi = 0;
+        Assertion assertion = Assertion::BEGIN_TEXT;
+        uint32_t out = 0;
+        uint32_t out1 = 0;
+    };
+
+    struct Program {
+        vector<Inst> insts;
+        uint32_t start = 0;
+        uint8_t byteClass[256] = {};    // 字节到等价类的映射（同一类的字节对所有指令表现相同）
+        vector<uint8_t> classByte;      // 每个等价类的代表字节
+        bool hasAssertions = false;
+    };
+
+    namespace {
+        const uint32_t MAX_CODE_POINT = 0x10FFFF;
+        const size_t MAX_PROGRAM_SIZE = 100000;
+        const int MAX_NESTING = 200;
+        const int MAX_REPEAT = 1000;
+
+        bool isWordByte(unsigned char c) {
+            return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+        }
+
+        using RangeList = vector<pair<uint32_t, uint32_t>>;
+
+        // 排序并合并相邻或重叠的区间
+        void normalizeRanges(RangeList& ranges) {
+            sort(ranges.begin(), ranges.end());
+            RangeList merged;
+            for (const auto& range : ranges) {
+                if (!merged.empty() && range.first <= merged.back().second + 1) {
+                    merged.back().second = max(merged.back().second, range.second);
+                } else {
+                    merged.push_back(range);
+                }
+            }
+            ranges.swap(merged);
+        }
+
+        RangeList complementRanges(const RangeList& ranges) {
+            RangeList result;
+            uint32_t next = 0;
+            for (const auto& range : ranges) {
+                if (range.first > next) {
+                    result.emplace_back(next, range.first - 1);
+                }
+                next = range.second + 1;
+            }
+            if (next <= MAX_CODE_POINT) {
+                result.emplace_back(next, MAX_CODE_POINT);
+            }
+            return result;
+        }
+
+        // ASCII字母加入另一种大小写
+        void foldAsciiCase(RangeList& ranges) {
+            RangeList extra;
+            for (const auto& range : ranges) {
+                uint32_t lo = max<uint32_t>(range.first, 'A');
+                uint32_t hi = min<uint32_t>(range.second, 'Z');
+                if (lo <= hi) {
+                    extra.emplace_back(lo + 32, hi + 32);
+                }
+                lo = max<uint32_t>(range.first, 'a');
+                hi = min<uint32_t>(range.second, 'z');
+                if (lo <= hi) {
+                    extra.emplace_back(lo - 32, hi - 32);
+                }
+            }
+            ranges.insert(ranges.end(), extra.begin(), extra.end());
+            normalizeRanges(ranges);
+        }
+
+        // ==================== 语法树 ====================
+
+        struct Node {
+            enum Kind { EMPTY, CLASS, CONCAT, ALTERNATE, REPEAT, ASSERT } kind = EMPTY;
+            RangeList ranges;                       // CLASS：码点区间
+            vector<unique_ptr<Node>> children;      // CONCAT/ALTERNATE/REPEAT
+            int min = 0;
+            int max = -1;                           // -1为不限
+            bool greedy = true;
+            Assertion assertion = Assertion::BEGIN_TEXT;
+        };
+
+        unique_ptr<Node> makeNode(Node::Kind kind) {
+            auto node = make_unique<Node>();
+            node->kind = kind;
+            return node;
+        }
+
+        unique_ptr<Node> makeClass(RangeList ranges) {
+            auto node = makeNode(Node::CLASS);
+            node->ranges = std::move(ranges);
+            return node;
+        }
+
+        // ==================== 语法分析 ====================
+
+        class Parser {
+        public:
+            Parser(const string& pattern, bool icase) : pattern(pattern), icase(icase) {}
+
+            unique_ptr<Node> parse(string& errorOut) {
+                auto node = parseAlternation(0);
+                if (error.empty() && pos < pattern.size()) {
+                    fail("多余的 ')'");
+                }
+                if (!error.empty()) {
+                    errorOut = error + "（位置 " + to_string(pos) + "）";
+                    return nullptr;
+                }
+                return node;
+            }
+
+        private:
+            const string& pattern;
+            bool icase;
+            size_t pos = 0;
+            string error;
+
+            void fail(const string& message) {
+                if (error.empty()) {
+                    error = message;
+                }
+            }
+
+            bool atEnd() const { return pos >= pattern.size(); }
+            char peek() const { return pattern[pos]; }
+
+            unique_ptr<Node> parseAlternation(int depth) {
+                if (depth > MAX_NESTING) {
+                    fail("嵌套层数过多");
+                    return nullptr;
+                }
+                auto first = parseConcat(depth);
+                if (atEnd() || peek() != '|') {
+                    return first;
+                }
+                auto node = makeNode(Node::ALTERNATE);
+                node->children.push_back(std::move(first));
+                while (error.empty() && !atEnd() && peek() == '|') {
+                    pos++;
+                    node->children.push_back(parseConcat(depth));
+                }
+                return node;
+            }
+
+            unique_ptr<Node> parseConcat(int depth) {
+                auto node = makeNode(Node::CONCAT);
+                while (error.empty() && !atEnd() && peek() != '|' && peek() != ')') {
+                    auto item = parseRepeat(depth);
+                    if (item) {
+                        node->children.push_back(std::move(item));
+                    }
+                }
+                if (node->children.size() == 1) {
+                    return std::move(node->children.front());
+                }
+                if (node->children.empty()) {
+                    return makeNode(Node::EMPTY);
+                }
+                return node;
+            }
+
+            // 解析{n}、{n,}、{n,m}；不是合法的重复次数时返回false，'{'按字面量处理
+            bool parseBraces(int& minCount, int& maxCount) {
+                size_t save = pos;
+                pos++;
+                auto readNumber = [&](int& value) {
+                    size_t begin = pos;
+                    long long number = 0;
+                    while (!atEnd() && peek() >= '0' && peek() <= '9') {
+                        number = min<long long>(number * 10 + (peek() - '0'), MAX_REPEAT + 1);
+                        pos++;
+                    }
+                    value = static_cast<int>(number);
+                    return pos > begin;
+                };
+                if (!readNumber(minCount)) {
+                    pos = save;
+                    return false;
+                }
+                maxCount = minCount;
+                if (!atEnd() && peek() == ',') {
+                    pos++;
+                    if (!readNumber(maxCount)) {
+                        maxCount = -1;
+                    }
+                }
+                if (atEnd() || peek() != '}') {
+                    pos = save;
+                    return false;
+                }
+                pos++;
+                return true;
+            }
+
+            unique_ptr<Node> parseRepeat(int depth) {
+                auto atom = parseAtom(depth);
+                if (!atom) {
+                    return nullptr;
+                }
+                while (error.empty() && !atEnd()) {
+                    int minCount = 0;
+                    int maxCount = -1;
+                    char c = peek();
+                    if (c == '*') {
+                        pos++;
+                    } else if (c == '+') {
+                        minCount = 1;
+                        pos++;
+                    } else if (c == '?') {
+                        maxCount = 1;
+                        pos++;
+                    } else if (c == '{' && parseBraces(minCount, maxCount)) {
+                        if (minCount > MAX_REPEAT || maxCount > MAX_REPEAT) {
+                            fail("重复次数过大");
+                            return nullptr;
+                        }
+                        if (maxCount != -1 && maxCount < minCount) {
+                            fail("重复次数范围无效");
+                            return nullptr;
+                        }
+                    } else {
+                        break;
+                    }
+                    if (atom->kind == Node::ASSERT) {
+                        fail("断言不能重复");
+                        return nullptr;
+                    }
+                    auto repeat = makeNode(Node::REPEAT);
+                    repeat->min = minCount;
+                    repeat->max = maxCount;
+                    if (!atEnd() && peek() == '?') {
+                        repeat->greedy = false;
+                        pos++;
+                    }
+                    repeat->children.push_back(std::move(atom));
+                    atom = std::move(repeat);
+                }
+                return atom;
+            }
+
+            unique_ptr<Node> parseAtom(int depth) {
+                char c = peek();
+                switch (c) {
+                    case '(': {
+                        pos++;
+                        if (!atEnd() && peek() == '?') {
+                            if (pos + 1 < pattern.size() && pattern[pos + 1] == ':') {
+                                pos += 2;
+                            } else {
+                                fail("不支持前瞻/后顾断言");
+                                return nullptr;
+                            }
+                        }
+                        auto inner = parseAlternation(depth + 1);
+                        if (atEnd() || peek() != ')') {
+                            fail("缺少 ')'");
+                            return nullptr;
+                        }
+                        pos++;
+                        return inner;
+                    }
+                    case '[':
+                        return parseClass();
+                    case '.': {
+                        pos++;
+                        // 除行结束符（\n、\r、U+2028、U+2029）以外的任意字符
+                        RangeList ranges = {{'\n', '\n'}, {'\r', '\r'}, {0x2028, 0x2029}};
+                        normalizeRanges(ranges);
+                        return makeClass(complementRanges(ranges));
+                    }
+                    case '^':
+                    case '$': {
+                        pos++;
+                        auto node = makeNode(Node::ASSERT);
+                        node->assertion = (c == '^') ? Assertion::BEGIN_TEXT : Assertion::END_TEXT;
+                        return node;
+                    }
+                    case '\\':
+                        return parseEscapeAtom();
+                    case '*':
+                    case '+':
+                    case '?':
+                        fail("重复符号前没有内容");
+                        return nullptr;
+                    default: {
+                        uint32_t cp = 0;
+                        if (!decodeChar(cp)) {
+                            return nullptr;
+                        }
+                        return literal(cp);
+                    }
+                }
+            }
+
+            unique_ptr<Node> literal(uint32_t cp) {
+                RangeList ranges = {{cp, cp}};
+                if (icase) {
+                    foldAsciiCase(ranges);
+                }
+                return makeClass(std::move(ranges));
+            }
+
+            // 解码pos处的一个UTF-8字符
+            bool decodeChar(uint32_t& cp) {
+                unsigned char lead = static_cast<unsigned char>(pattern[pos]);
+                size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 :
+                                (lead >> 3) == 0x1E ? 4 : 0;
+                if (length == 0 || pos + length > pattern.size()) {
+                    fail("模式不是有效的UTF-8");
+                    return false;
+                }
+                cp = length == 1 ? lead : (lead & (0xFF >> (length + 1)));
+                for (size_t i = 1; i < length; ++i) {
+                    unsigned char next = static_cast<unsigned char>(pattern[pos + i]);
+                    if ((next & 0xC0) != 0x80) {
+                        fail("模式不是有效的UTF-8");
+                        return false;
+                    }
+                    cp = (cp << 6) | (next & 0x3F);
+                }
+                pos += length;
+                return true;
+            }
+
+            bool readHex(size_t digits, uint32_t& value) {
+                if (pos + digits > pattern.size()) {
+                    return false;
+                }
+                value = 0;
+                for (size_t i = 0; i < digits; ++i) {
+                    char h = pattern[pos + i];
+                    int v = (h >= '0' && h <= '9') ? h - '0' : (h >= 'a' && h <= 'f') ? h - 'a' + 10 :
+                            (h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+                    if (v < 0) {
+                        return false;
+                    }
+                    value = value * 16 + static_cast<uint32_t>(v);
+                }
+                pos += digits;
+                return true;
+            }
+
+            // 解析'\\'之后的转义：字符类转义写入ranges，单个字符写入cp；
+            // inClass为true时\b表示退格
+            enum class EscapeKind { CHAR, CLASS, ASSERT, INVALID };
+            EscapeKind parseEscape(bool inClass, uint32_t& cp, RangeList& ranges, Assertion& assertion) {
+                pos++;
+                if (atEnd()) {
+                    fail("模式以'\\'结尾");
+                    return EscapeKind::INVALID;
+                }
+                char c = peek();
+                pos++;
+                switch (c) {
+                    case 'd': case 'D':
+                        ranges = {{'0', '9'}};
+                        break;
+                    case 'w': case 'W':
+                        ranges = {{'0', '9'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}};
+                        break;
+                    case 's': case 'S':
+                        // 与std::regex在"C"区域设置下一致，只包含ASCII空白
+                        ranges = {{'\t', '\r'}, {' ', ' '}};
+                        break;
+                    case 'b':
+                        if (inClass) {
+                            cp = '\b';
+                            return EscapeKind::CHAR;
+                        }
+                        assertion = Assertion::WORD_BOUNDARY;
+                        return EscapeKind::ASSERT;
+                    case 'B':
+                        if (inClass) {
+                            fail("字符类中不能使用\\B");
+                            return EscapeKind::INVALID;
+                        }
+                        assertion = Assertion::NOT_WORD_BOUNDARY;
+                        return EscapeKind::ASSERT;
+                    case 'n': cp = '\n'; return EscapeKind::CHAR;
+                    case 'r': cp = '\r'; return EscapeKind::CHAR;
+                    case 't': cp = '\t'; return EscapeKind::CHAR;
+                    case 'f': cp = '\f'; return EscapeKind::CHAR;
+                    case 'v': cp = '\v'; return EscapeKind::CHAR;
+                    case '0':
+                        if (!atEnd() && peek() >= '0' && peek() <= '9') {
+                            fail("不支持八进制转义");
+                            return EscapeKind::INVALID;
+                        }
+                        cp = 0;
+                        return EscapeKind::CHAR;
+                    case 'x':
+                        if (!readHex(2, cp)) {
+                            fail("无效的\\x转义");
+                            return EscapeKind::INVALID;
+                        }
+                        return EscapeKind::CHAR;
+                    case 'u':
+                        if (!readHex(4, cp) || (cp >= 0xD800 && cp <= 0xDFFF)) {
+                            fail("无效的\\u转义");
+                            return EscapeKind::INVALID;
+                        }
+                        return EscapeKind::CHAR;
+                    default:
+                        if (c >= '1' && c <= '9') {
+                            fail("不支持反向引用");
+                            return EscapeKind::INVALID;
+                        }
+                        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+                            fail(string("不支持的转义 \\") + c);
+                            return EscapeKind::INVALID;
+                        }
+                        // 标点等字符的转义表示字符本身（多字节字符需要重新解码）
+                        pos--;
+                        if (!decodeChar(cp)) {
+                            return EscapeKind::INVALID;
+                        }
+                        return EscapeKind::CHAR;
+                }
+                normalizeRanges(ranges);
+                if (c == 'D' || c == 'W' || c == 'S') {
+                    ranges = complementRanges(ranges);
+                }
+                return EscapeKind::CLASS;
+            }
+
+            unique_ptr<Node> parseEscapeAtom() {
+                uint32_t cp = 0;
+                RangeList ranges;
+                Assertion assertion = Assertion::BEGIN_TEXT;
+                switch (parseEscape(false, cp, ranges, assertion)) {
+                    case EscapeKind::CHAR:
+                        return literal(cp);
+                    case EscapeKind::CLASS:
+                        return makeClass(std::move(ranges));
+                    case EscapeKind::ASSERT: {
+                        auto node = makeNode(Node::ASSERT);
+                        node->assertion = assertion;
+                        return node;
+                    }
+                    default:
+                        return nullptr;
+                }
+            }
+
+            unique_ptr<Node> parseClass() {
+                pos++;
+                bool negated = false;
+                if (!atEnd() && peek() == '^') {
+                    negated = true;
+                    pos++;
+                }
+
+                RangeList ranges;
+                while (true) {
+                    if (atEnd()) {
+                        fail("缺少 ']'");
+                        return nullptr;
+                    }
+                    if (peek() == ']') {
+                        pos++;
+                        break;
+                    }
+
+                    // 区间起点
+                    uint32_t lo = 0;
+                    if (!classAtom(ranges, lo)) {
+                        if (!error.empty()) {
+                            return nullptr;
+                        }
+                        continue;
+                    }
+
+                    // 区间终点（'-'在末尾或后面是字符类转义时按字面量处理）
+                    if (pos + 1 < pattern.size() && peek() == '-' && pattern[pos + 1] != ']') {
+                        size_t save = pos;
+                        pos++;
+                        RangeList classRanges;
+                        uint32_t hi = 0;
+                        if (classAtom(classRanges, hi)) {
+                            if (hi < lo) {
+                                fail("字符类区间顺序无效");
+                                return nullptr;
+                            }
+                            ranges.emplace_back(lo, hi);
+                            continue;
+                        }
+                        if (!error.empty()) {
+                            return nullptr;
+                        }
+                        pos = save + 1;
+                        ranges.insert(ranges.end(), classRanges.begin(), classRanges.end());
+                        ranges.emplace_back(lo, lo);
+                        ranges.emplace_back('-', '-');
+                        continue;
+                    }
+                    ranges.emplace_back(lo, lo);
+                }
+
+                normalizeRanges(ranges);
+                if (icase) {
+                    foldAsciiCase(ranges);
+                }
+                if (negated) {
+                    ranges = complementRanges(ranges);
+                }
+                return makeClass(std::move(ranges));
+            }
+
+            // 字符类中的一个成员：单个字符返回true，字符类转义并入ranges后返回false
+            bool classAtom(RangeList& ranges, uint32_t& cp) {
+                if (peek() != '\\') {
+                    return decodeChar(cp);
+                }
+                RangeList escaped;
+                Assertion assertion = Assertion::BEGIN_TEXT;
+                switch (parseEscape(true, cp, escaped, assertion)) {
+                    case EscapeKind::CHAR:
+                        return true;
+                    case EscapeKind::CLASS:
+                        ranges.insert(ranges.end(), escaped.begin(), escaped.end());
+                        return false;
+                    default:
+                        fail("字符类中的转义无效");
+                        return false;
+                }
+            }
+        };
+
+        // ==================== 编译为NFA ====================
+
+        // UTF-8编码的一段字节区间序列，如E4-E9 80-BF 80-BF
+        struct ByteSequence {
+            uint8_t lo[4];
+            uint8_t hi[4];
+            int length = 0;
+        };
+
+        int encodeUtf8(uint32_t cp, uint8_t* out) {
+            if (cp < 0x80) {
+                out[0] = static_cast<uint8_t>(cp);
+                return 1;
+            }
+            if (cp < 0x800) {
+                out[0] = static_cast<uint8_t>(0xC0 | (cp >> 6));
+                out[1] = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+                return 2;
+            }
+            if (cp < 0x10000) {
+                out[0] = static_cast<uint8_t>(0xE0 | (cp >> 12));
+                out[1] = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F));
+                out[2] = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+                return 3;
+            }
+            out[0] = static_cast<uint8_t>(0xF0 | (cp >> 18));
+            out[1] = static_cast<uint8_t>(0x80 | ((cp >> 12) & 0x3F));
+            out[2] = static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F));
+            out[3] = static_cast<uint8_t>(0x80 | (cp & 0x3F));
+            return 4;
+        }
+
+        // 把码点区间拆成若干UTF-8字节区间序列（每个字节位置都是连续区间）
+        void utf8Sequences(uint32_t lo, uint32_t hi, vector<ByteSequence>& out) {
+            // 代理区不是有效字符
+            if (lo <= 0xDFFF && hi >= 0xD800) {
+                if (lo < 0xD800) {
+                    utf8Sequences(lo, 0xD7FF, out);
+                }
+                if (hi > 0xDFFF) {
+                    utf8Sequences(0xE000, hi, out);
+                }
+                return;
+            }
+
+            // 按编码长度拆分
+            static const uint32_t limits[] = {0x7F, 0x7FF, 0xFFFF};
+            for (uint32_t limit : limits) {
+                if (lo <= limit && hi > limit) {
+                    utf8Sequences(lo, limit, out);
+                    utf8Sequences(limit + 1, hi, out);
+                    return;
+                }
+            }
+
+            // 按续字节对齐拆分，使每个字节位置都是连续区间
+            if (hi >= 0x80) {
+                for (int i = 1; i < 4; ++i) {
+                    uint32_t mask = (1u << (6 * i)) - 1;
+                    if ((lo & ~mask) != (hi & ~mask)) {
+                        if ((lo & mask) != 0) {
+                            utf8Sequences(lo, lo | mask, out);
+                            utf8Sequences((lo | mask) + 1, hi, out);
+                            return;
+                        }
+                        if ((hi & mask) != mask) {
+                            utf8Sequences(lo, (hi & ~mask) - 1, out);
+                            utf8Sequences(hi & ~mask, hi, out);
+                            return;
+                        }
+                    }
+                }
+            }
+
+            ByteSequence sequence;
+            uint8_t loBytes[4];
+            uint8_t hiBytes[4];
+            sequence.length = encodeUtf8(lo, loBytes);
+            encodeUtf8(hi, hiBytes);
+            for (int i = 0; i < sequence.length; ++i) {
+                sequence.lo[i] = loBytes[i];
+                sequence.hi[i] = hiBytes[i];
+            }
+            out.push_back(sequence);
+        }
+
+        class Compiler {
+        public:
+            Compiler(Program& program, bool reversed) : program(program), reversed(reversed) {}
+
+            bool compile(const Node& root, string& error) {
+                Fragment body = emit(root);
+                if (program.insts.size() > MAX_PROGRAM_SIZE) {
+                    error = "模式过大";
+                    return false;
+                }
+                uint32_t match = add(Op::MATCH);
+                patch(body.holes, match);
+                program.start = body.start;
+                buildByteClasses();
+                return true;
+            }
+
+        private:
+            // 未连接的出口：指令下标*2，最低位区分out/out1
+            struct Fragment {
+                uint32_t start = 0;
+                vector<uint32_t> holes;
+            };
+
+            Program& program;
+            bool reversed;
+
+            uint32_t add(Op op) {
+                Inst inst;
+                inst.op = op;
+                program.insts.push_back(inst);
+                return static_cast<uint32_t>(program.insts.size() - 1);
+            }
+
+            void patch(const vector<uint32_t>& holes, uint32_t target) {
+                for (uint32_t hole : holes) {
+                    Inst& inst = program.insts[hole >> 1];
+                    if (hole & 1) {
+                        inst.out1 = target;
+                    } else {
+                        inst.out = target;
+                    }
+                }
+            }
+
+            Fragment emit(const Node& node) {
+                // 超过大小上限后不再继续展开，由compile统一报错
+                if (program.insts.size() > MAX_PROGRAM_SIZE) {
+                    return emitEmpty();
+                }
+                switch (node.kind) {
+                    case Node::EMPTY:
+                        return emitEmpty();
+                    case Node::ASSERT: {
+                        uint32_t pc = add(Op::ASSERT);
+                        program.insts[pc].assertion = node.assertion;
+                        program.hasAssertions = true;
+                        return {pc, {pc * 2}};
+                    }
+                    case Node::CLASS:
+                        return emitClass(node.ranges);
+                    case Node::CONCAT: {
+                        vector<const Node*> order;
+                        for (const auto& child : node.children) {
+                            order.push_back(child.get());
+                        }
+                        if (reversed) {
+                            reverse(order.begin(), order.end());
+                        }
+                        Fragment result = emit(*order.front());
+                        for (size_t i = 1; i < order.size(); ++i) {
+                            Fragment next = emit(*order[i]);
+                            patch(result.holes, next.start);
+                            result.holes = std::move(next.holes);
+                        }
+                        return result;
+                    }
+                    case Node::ALTERNATE: {
+                        vector<Fragment> branches;
+                        for (const auto& child : node.children) {
+                            branches.push_back(emit(*child));
+                        }
+                        return alternate(branches);
+                    }
+                    case Node::REPEAT:
+                        return emitRepeat(node);
+                }
+                return emitEmpty();
+            }
+
+            Fragment emitEmpty() {
+                uint32_t pc = add(Op::JUMP);
+                return {pc, {pc * 2}};
+            }
+
+            // 按优先顺序连接分支：SPLIT的out优先于out1
+            Fragment alternate(vector<Fragment>& branches) {
+                Fragment result = std::move(branches.back());
+                for (size_t i = branches.size() - 1; i-- > 0;) {
+                    uint32_t split = add(Op::SPLIT);
+                    program.insts[split].out = branches[i].start;
+                    program.insts[split].out1 = result.start;
+                    result.start = split;
+                    result.holes.insert(result.holes.end(), branches[i].holes.begin(), branches[i].holes.end());
+                }
+                return result;
+            }
+
+            Fragment emitClass(const RangeList& ranges) {
+                vector<ByteSequence> sequences;
+                for (const auto& range : ranges) {
+                    utf8Sequences(range.first, range.second, sequences);
+                }
+                if (sequences.empty()) {
+                    // 空字符类：永远不匹配
+                    uint32_t pc = add(Op::BYTE_RANGE);
+                    program.insts[pc].lo = 1;
+                    program.insts[pc].hi = 0;
+                    return {pc, {pc * 2}};
+                }
+
+                vector<Fragment> branches;
+                for (const auto& sequence : sequences) {
+                    Fragment fragment;
+                    uint32_t previous = 0;
+                    for (int i = 0; i < sequence.length; ++i) {
+                        int index = reversed ? sequence.length - 1 - i : i;
+                        uint32_t pc = add(Op::BYTE_RANGE);
+                        program.insts[pc].lo = sequence.lo[index];
+                        program.insts[pc].hi = sequence.hi[index];
+                        if (i == 0) {
+                            fragment.start = pc;
+                        } else {
+                            program.insts[previous].out = pc;
+                        }
+                        previous = pc;
+                    }
+                    fragment.holes.push_back(previous * 2);
+                    branches.push_back(std::move(fragment));
+                }
+                return alternate(branches);
+            }
+
+            // x?：贪婪时优先进入x
+            Fragment optional(const Node& child, bool greedy) {
+                Fragment body = emit(child);
+                uint32_t split = add(Op::SPLIT);
+                Fragment result;
+                result.start = split;
+                if (greedy) {
+                    program.insts[split].out = body.start;
+                    result.holes.push_back(split * 2 + 1);
+                } else {
+                    program.insts[split].out1 = body.start;
+                    result.holes.push_back(split * 2);
+                }
+                result.holes.insert(result.holes.end(), body.holes.begin(), body.holes.end());
+                return result;
+            }
+
+            // x*：循环回到SPLIT
+            Fragment star(const Node& child, bool greedy) {
+                uint32_t split = add(Op::SPLIT);
+                Fragment body = emit(child);
+                patch(body.holes, split);
+                Fragment result;
+                result.start = split;
+                if (greedy) {
+                    program.insts[split].out = body.start;
+                    result.holes.push_back(split * 2 + 1);
+                } else {
+                    program.insts[split].out1 = body.start;
+                    result.holes.push_back(split * 2);
+                }
+                return result;
+            }
+
+            Fragment emitRepeat(const Node& node) {
+                const Node& child = *node.children.front();
+                vector<Fragment> parts;
+                for (int i = 0; i < node.min; ++i) {
+                    parts.push_back(emit(child));
+                }
+                if (node.max == -1) {
+                    parts.push_back(star(child, node.greedy));
+                } else {
+                    for (int i = node.min; i < node.max; ++i) {
+                        parts.push_back(optional(child, node.greedy));
+                    }
+                }
+                if (parts.empty()) {
+                    return emitEmpty();
+                }
+                // 各部分相同，反向程序中顺序无关紧要
+                Fragment result = std::move(parts.front());
+                for (size_t i = 1; i < parts.size(); ++i) {
+                    patch(result.holes, parts[i].start);
+                    result.holes = std::move(parts[i].holes);
+                }
+                return result;
+            }
+
+            // 根据所有字节区间的边界划分等价类，DFA的转移表按类而不是按字节建立
+            void buildByteClasses() {
+                bool boundary[257] = {};
+                boundary[0] = true;
+                for (const auto& inst : program.insts) {
+                    if (inst.op == Op::BYTE_RANGE && inst.lo <= inst.hi) {
+                        boundary[inst.lo] = true;
+                        boundary[inst.hi + 1] = true;
+                    }
+                }
+                if (program.hasAssertions) {
+                    // \b需要区分单词字符
+                    for (int c : {int('0'), '9' + 1, int('A'), 'Z' + 1, int('_'), '_' + 1, int('a'), 'z' + 1}) {
+                        boundary[c] = true;
+                    }
+                }
+                int cls = -1;
+                program.classByte.clear();
+                for (int c = 0; c < 256; ++c) {
+                    if (boundary[c]) {
+                        cls++;
+                        program.classByte.push_back(static_cast<uint8_t>(c));
+                    }
+                    program.byteClass[c] = static_cast<uint8_t>(cls);
+                }
+            }
+        };
+
+        bool buildProgram(const Node& root, bool reversed, Program& program, string& error) {
+            Compiler compiler(program, reversed);
+            return compiler.compile(root, error);
+        }
+    }
+
+    // ==================== 必需字面量分析 ====================
+
+    namespace {
+        const size_t MAX_LITERAL_SET = 64;      // 字面量集合的大小上限
+        const size_t MAX_CLASS_LITERALS = 16;   // 字符类展开为字面量的码点数上限
+        const size_t MIN_LITERAL_LENGTH = 2;    // 太短的字面量几乎处处出现，不用于预过滤
+
+        using LiteralSet = vector<string>;
+
+        // exact为true时，节点匹配的字符串恰好是set中的某一个；
+        // required为任何匹配都至少包含其中一个的字面量集合（为空表示没有）
+        struct LiteralInfo {
+            bool exact = false;
+            LiteralSet set;
+            LiteralSet required;
+        };
+
+        char foldByte(char c) {
+            return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 32) : c;
+        }
+
+        // 集合中最短字面量的长度，越大越适合预过滤
+        size_t literalScore(const LiteralSet& set) {
+            if (set.empty()) {
+                return 0;
+            }
+            size_t shortest = set.front().size();
+            for (const auto& literal : set) {
+                shortest = min(shortest, literal.size());
+            }
+            return shortest;
+        }
+
+        void chooseBetter(LiteralSet& best, const LiteralSet& candidate) {
+            size_t score = literalScore(candidate);
+            size_t bestScore = literalScore(best);
+            if (score > bestScore || (score == bestScore && score > 0 && candidate.size() < best.size())) {
+                best = candidate;
+            }
+        }
+
+        void dedupe(LiteralSet& set) {
+            sort(set.begin(), set.end());
+            set.erase(unique(set.begin(), set.end()), set.end());
+        }
+
+        bool crossProduct(const LiteralSet& left, const LiteralSet& right, LiteralSet& out) {
+            if (left.size() * right.size() > MAX_LITERAL_SET) {
+                return false;
+            }
+            out.clear();
+            for (const auto& a : left) {
+                for (const auto& b : right) {
+                    out.push_back(a + b);
+                }
+            }
+            dedupe(out);
+            return true;
+        }
+
+        const LiteralSet& bestOf(const LiteralInfo& info) {
+            return info.exact && literalScore(info.set) >= literalScore(info.required) ? info.set : info.required;
+        }
+
+        LiteralInfo analyzeLiterals(const Node& node) {
+            LiteralInfo info;
+            switch (node.kind) {
+                case Node::EMPTY:
+                case Node::ASSERT:
+                    info.exact = true;
+                    info.set = {string()};
+                    break;
+                case Node::CLASS: {
+                    vector<uint32_t> codePoints;
+                    for (const auto& range : node.ranges) {
+                        if (range.second - range.first >= MAX_CLASS_LITERALS) {
+                            return info;
+                        }
+                        for (uint32_t cp = range.first; cp <= range.second; ++cp) {
+                            codePoints.push_back(cp >= 'A' && cp <= 'Z' ? cp + 32 : cp);
+                        }
+                    }
+                    sort(codePoints.begin(), codePoints.end());
+                    codePoints.erase(unique(codePoints.begin(), codePoints.end()), codePoints.end());
+                    if (codePoints.empty() || codePoints.size() > MAX_CLASS_LITERALS) {
+                        return info;
+                    }
+                    info.exact = true;
+                    for (uint32_t cp : codePoints) {
+                        uint8_t bytes[4];
+                        int length = encodeUtf8(cp, bytes);
+                        info.set.emplace_back(reinterpret_cast<const char*>(bytes), length);
+                    }
+                    break;
+                }
+                case Node::CONCAT: {
+                    // 相邻的精确子节点拼接成更长的字面量，遇到非精确子节点时断开
+                    LiteralSet running = {string()};
+                    bool exact = true;
+                    for (const auto& child : node.children) {
+                        LiteralInfo childInfo = analyzeLiterals(*child);
+                        LiteralSet product;
+                        if (childInfo.exact && crossProduct(running, childInfo.set, product)) {
+                            running.swap(product);
+                            continue;
+                        }
+                        exact = false;
+                        chooseBetter(info.required, running);
+                        if (childInfo.exact) {
+                            running = childInfo.set;
+                        } else {
+                            chooseBetter(info.required, childInfo.required);
+                            running = {string()};
+                        }
+                    }
+                    if (exact) {
+                        info.exact = true;
+                        info.set = running;
+                    } else {
+                        chooseBetter(info.required, running);
+                    }
+                    break;
+                }
+                case Node::ALTERNATE: {
+                    // 每个分支都有字面量时，所有分支字面量的并集才是必需的
+                    LiteralSet exactUnion;
+                    LiteralSet requiredUnion;
+                    bool exact = true;
+                    bool required = true;
+                    for (const auto& child : node.children) {
+                        LiteralInfo childInfo = analyzeLiterals(*child);
+                        if (childInfo.exact) {
+                            exactUnion.insert(exactUnion.end(), childInfo.set.begin(), childInfo.set.end());
+                        } else {
+                            exact = false;
+                        }
+                        const LiteralSet& best = bestOf(childInfo);
+                        if (literalScore(best) == 0) {
+                            required = false;
+                        } else {
+                            requiredUnion.insert(requiredUnion.end(), best.begin(), best.end());
+                        }
+                    }
+                    dedupe(exactUnion);
+                    dedupe(requiredUnion);
+                    if (exact && exactUnion.size() <= MAX_LITERAL_SET) {
+                        info.exact = true;
+                        info.set = exactUnion;
+                    }
+                    if (required && requiredUnion.size() <= MAX_LITERAL_SET) {
+                        info.required = requiredUnion;
+                    }
+                    break;
+                }
+                case Node::REPEAT: {
+                    if (node.min == 0) {
+                        break;
+                    }
+                    LiteralInfo childInfo = analyzeLiterals(*node.children.front());
+                    if (node.min == 1 && node.max == 1) {
+                        return childInfo;
+                    }
+                    info.required = bestOf(childInfo);
+                    break;
+                }
+            }
+            return info;
+        }
+
+        size_t maxMatchBytes(const Node& node) {
+            const size_t unbounded = Regex::UNBOUNDED;
+            switch (node.kind) {
+                case Node::EMPTY:
+                case Node::ASSERT:
+                    return 0;
+                case Node::CLASS: {
+                    if (node.ranges.empty()) {
+                        return 0;
+                    }
+                    uint8_t bytes[4];
+                    return static_cast<size_t>(encodeUtf8(node.ranges.back().second, bytes));
+                }
+                case Node::CONCAT: {
+                    size_t total = 0;
+                    for (const auto& child : node.children) {
+                        size_t length = maxMatchBytes(*child);
+                        if (length == unbounded) {
+                            return unbounded;
+                        }
+                        total += length;
+                    }
+                    return total;
+                }
+                case Node::ALTERNATE: {
+                    size_t longest = 0;
+                    for (const auto& child : node.children) {
+                        longest = max(longest, maxMatchBytes(*child));
+                    }
+                    return longest;
+                }
+                case Node::REPEAT: {
+                    size_t length = maxMatchBytes(*node.children.front());
+                    if (length == 0) {
+                        return 0;
+                    }
+                    if (node.max == -1 || length == unbounded) {
+                        return unbounded;
+                    }
+                    return length * static_cast<size_t>(node.max);
+                }
+            }
+            return unbounded;
+        }
+
+        // 能否匹配空串（断言看作可以）
+        bool canMatchEmpty(const Node& node) {
+            switch (node.kind) {
+                case Node::EMPTY:
+                case Node::ASSERT:
+                    return true;
+                case Node::CLASS:
+                    return false;
+                case Node::CONCAT:
+                    for (const auto& child : node.children) {
+                        if (!canMatchEmpty(*child)) {
+                            return false;
+                        }
+                    }
+                    return true;
+                case Node::ALTERNATE:
+                    for (const auto& child : node.children) {
+                        if (canMatchEmpty(*child)) {
+                            return true;
+                        }
+                    }
+                    return false;
+                case Node::REPEAT:
+                    return node.min == 0 || canMatchEmpty(*node.children.front());
+            }
+            return true;
+        }
+
+        // 子树中有次数可变、循环体能匹配空串的重复（如(?:a|\b)+、(?:b?)*）。ECMAScript规定超出最少次数的
+        // 一轮循环匹配到空串即失败并回溯，这依赖回溯过程，NFA/DFA无法表达；std::regex的实现也与规范不完全一致
+        bool hasEmptyLoop(const Node& node) {
+            if (node.kind == Node::REPEAT && node.min != node.max && canMatchEmpty(*node.children.front())) {
+                return true;
+            }
+            for (const auto& child : node.children) {
+                if (hasEmptyLoop(*child)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // ==================== 回溯隐患分析 ====================
+
+        // 两个有序区间列表是否有公共码点
+        bool rangesOverlap(const RangeList& a, const RangeList& b) {
+            size_t i = 0;
+            size_t j = 0;
+            while (i < a.size() && j < b.size()) {
+                if (a[i].second < b[j].first) {
+                    ++i;
+                } else if (b[j].second < a[i].first) {
+                    ++j;
+                } else {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // 节点只可能匹配set中的码点（零宽的节点也算）
+        bool onlyMatches(const Node& node, const RangeList& set) {
+            if (node.kind == Node::CLASS) {
+                for (const auto& range : node.ranges) {
+                    auto it = upper_bound(set.begin(), set.end(), make_pair(range.first, MAX_CODE_POINT));
+                    if (it == set.begin() || prev(it)->second < range.second) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            for (const auto& child : node.children) {
+                if (!onlyMatches(*child, set)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // 形如[...]*、x+的无界重复单个字符
+        bool isUnboundedRun(const Node& node) {
+            return node.kind == Node::REPEAT && node.max == -1 && node.children.front()->kind == Node::CLASS;
+        }
+
+        // 子树中有次数可变、能匹配非空内容的重复
+        bool hasVariableRepeat(const Node& node) {
+            if (node.kind == Node::REPEAT && node.min != node.max && maxMatchBytes(*node.children.front()) > 0) {
+                return true;
+            }
+            for (const auto& child : node.children) {
+                if (hasVariableRepeat(*child)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void addHazard(vector<string>& hazards, const string& description) {
+            if (find(hazards.begin(), hazards.end(), description) == hazards.end()) {
+                hazards.push_back(description);
+            }
+        }
+
+        void collectHazards(const Node& node, vector<string>& hazards) {
+            if (node.kind == Node::REPEAT && node.max == -1 && hasVariableRepeat(*node.children.front())) {
+                addHazard(hazards, "嵌套的量词（如(a+)+）：匹配失败时回溯要尝试的拆分方式随长度指数增长");
+            }
+            if (node.kind == Node::CONCAT) {
+                // 一段无界重复之后，中间的内容都能被它吸收，又接着一段有公共字符的无界重复
+                // （如[^】]*下载[^】]*）：回溯时每段的长度都要逐一尝试，k段最坏O(n^k)
+                const auto& children = node.children;
+                for (size_t i = 0; i < children.size(); ++i) {
+                    if (!isUnboundedRun(*children[i])) {
+                        continue;
+                    }
+                    const RangeList& set = children[i]->children.front()->ranges;
+                    size_t runs = 1;
+                    size_t j = i + 1;
+                    for (; j < children.size(); ++j) {
+                        if (isUnboundedRun(*children[j]) &&
+                            rangesOverlap(set, children[j]->children.front()->ranges)) {
+                            ++runs;
+                        } else if (!onlyMatches(*children[j], set)) {
+                            break;
+                        }
+                    }
+                    if (runs > 1) {
+                        addHazard(hazards, to_string(runs) + " 段可匹配相同字符的无界重复相连，回溯最坏O(n^" +
+                                           to_string(runs) + ")");
+                        i = j - 1;
+                    }
+                }
+            }
+            for (const auto& child : node.children) {
+                collectHazards(*child, hazards);
+            }
+        }
+
+        // 第一个消耗字符的节点是无界重复且后面还有内容（后面的内容匹配失败时要回退），模式没有用^锚定
+        bool startsWithUnboundedRun(const Node& node, bool followed) {
+            if (isUnboundedRun(node)) {
+                return followed;
+            }
+            if (node.kind == Node::CONCAT) {
+                const auto& children = node.children;
+                for (size_t i = 0; i < children.size(); ++i) {
+                    if (children[i]->kind == Node::ASSERT) {
+                        if (children[i]->assertion == Assertion::BEGIN_TEXT) {
+                            return false;
+                        }
+                        continue;
+                    }
+                    bool rest = followed;
+                    for (size_t j = i + 1; j < children.size(); ++j) {
+                        rest = rest || children[j]->kind != Node::ASSERT;
+                    }
+                    return startsWithUnboundedRun(*children[i], rest);
+                }
+            }
+            if (node.kind == Node::ALTERNATE) {
+                for (const auto& child : node.children) {
+                    if (startsWithUnboundedRun(*child, followed)) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+    }
+
+    bool findBacktrackingHazards(const string& pattern, vector<string>& hazards) {
+        Parser parser(pattern, true);
+        string error;
+        unique_ptr<Node> root = parser.parse(error);
+        if (!root) {
+            return false;
+        }
+        if (startsWithUnboundedRun(*root, false)) {
+            addHazard(hazards, "以无界重复开头：非锚定搜索在连续段的每个起点上都重新扫描整段，最坏O(n^2)");
+        }
+        collectHazards(*root, hazards);
+        return true;
+    }
+
+    // ==================== 多字面量查找 ====================
+
+    uint32_t LiteralMatcher::add(const string& literal) {
+        lengths.push_back(literal.size());
+        string head = literal.substr(0, SimdScan::PrefixSet::MAX_LENGTH);
+        for (char& c : head) {
+            c = foldByte(c);
+        }
+        heads.push_back(head);
+        uint32_t id = static_cast<uint32_t>(lengths.size() - 1);
+
+        if (transitions.empty()) {
+            transitions.assign(256, -1);
+            outputs.emplace_back();
+        }
+        int32_t state = 0;
+        for (char c : literal) {
+            size_t slot = static_cast<size_t>(state) * 256 + static_cast<unsigned char>(foldByte(c));
+            if (transitions[slot] < 0) {
+                transitions[slot] = static_cast<int32_t>(outputs.size());
+                transitions.resize(transitions.size() + 256, -1);
+                outputs.emplace_back();
+            }
+            state = transitions[slot];
+        }
+        outputs[state].push_back(id);
+        built = false;
+        return id;
+    }
+
+    void LiteralMatcher::build() {
+        if (transitions.empty()) {
+            transitions.assign(256, -1);
+            outputs.emplace_back();
+        }
+
+        // 按广度优先顺序计算失败转移，并把缺失的转移补全为完整的DFA
+        failure.assign(outputs.size(), 0);
+        vector<int32_t> queue;
+        for (int c = 0; c < 256; ++c) {
+            int32_t& next = transitions[c];
+            if (next < 0) {
+                next = 0;
+            } else {
+                failure[next] = 0;
+                queue.push_back(next);
+            }
+        }
+        for (size_t head = 0; head < queue.size(); ++head) {
+            int32_t state = queue[head];
+            const auto& inherited = outputs[failure[state]];
+            outputs[state].insert(outputs[state].end(), inherited.begin(), inherited.end());
+            for (int c = 0; c < 256; ++c) {
+                size_t slot = static_cast<size_t>(state) * 256 + c;
+                int32_t fallback = transitions[static_cast<size_t>(failure[state]) * 256 + c];
+                if (transitions[slot] < 0) {
+                    transitions[slot] = fallback;
+                } else {
+                    failure[transitions[slot]] = fallback;
+                    queue.push_back(transitions[slot]);
+                }
+            }
+        }
+        // 大写ASCII字母与小写字母走相同的转移
+        for (size_t state = 0; state < outputs.size(); ++state) {
+            for (int c = 'A'; c <= 'Z'; ++c) {
+                transitions[state * 256 + c] = transitions[state * 256 + c + 32];
+            }
+        }
+
+        buildPrefixes();
+        built = true;
+    }
+
+    void LiteralMatcher::buildPrefixes() {
+        // 初始状态下，不是任何字面量开头的字节不会改变状态，可以成块跳过。
+        // 按前几个字节跳过同样安全：后面的字节对不上时，从下一个字节重新开始的状态相同
+        prefixes = SimdScan::PrefixSet();
+        skipping = true;
+        vector<string> distinct = heads;
+        sort(distinct.begin(), distinct.end());
+        distinct.erase(unique(distinct.begin(), distinct.end()), distinct.end());
+        for (const auto& head : distinct) {
+            if (head.empty() || !prefixes.add(head.data(), head.size())) {
+                skipping = false;
+                break;
+            }
+        }
+    }
+
+    void LiteralMatcher::findAll(const char* data, size_t size, vector<Hit>& hits) const {
+        if (!built || lengths.empty()) {
+            return;
+        }
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+        const int32_t* table = transitions.data();
+        int32_t state = 0;
+        for (size_t i = 0; i < size; ++i) {
+            if (state == 0 && skipping) {
+                i = prefixes.find(data, size, i);
+                if (i == size) {
+                    break;
+                }
+            }
+            state = table[static_cast<size_t>(state) * 256 + bytes[i]];
+            if (!outputs[state].empty()) {
+                for (uint32_t literal : outputs[state]) {
+                    hits.push_back({i + 1 - lengths[literal], literal});
+                }
+            }
+        }
+    }
+
+    // ==================== 按需构造的DFA ====================
+
+    // 每个DFA状态是一组有序的NFA线程（尚未展开ε转移）加上一侧的上下文。
+    // 读入一个符号时才展开ε转移：此时两侧字符都已知，可以判断^、$、\b。
+    // 最左优先模式下线程按优先级排序，遇到MATCH即丢弃其后的低优先级线程，
+    // 与回溯引擎选择的匹配一致；否则线程集合排序去重，只判断是否存在匹配
+    class LazyDfa {
+    public:
+        enum Context : uint8_t {
+            CTX_EDGE = 0,       // 文本开头/结尾
+            CTX_WORD = 1,
+            CTX_OTHER = 2,
+            CTX_PARTIAL = 3     // 数据结束但后面还有内容
+        };
+
+        static const size_t NPOS = static_cast<size_t>(-1);
+
+        LazyDfa(const Program& program, bool leftmostFirst, bool unanchored, bool reversed)
+            : program(program), leftmostFirst(leftmostFirst), unanchored(unanchored), reversed(reversed),
+              classCount(program.classByte.size()), symbolCount(classCount + 2),
+              visited(program.insts.size(), 0), queued(program.insts.size(), 0) {
+            for (size_t cls = 0; cls < classCount; ++cls) {
+                classIsWord.push_back(isWordByte(program.classByte[cls]));
+            }
+        }
+
+        // 从from开始向右查找最左匹配的终点，起点必须小于limit
+        size_t findEnd(const char* data, size_t size, size_t from, size_t limit, bool partial) {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+            uint8_t context = from == 0 ? static_cast<uint8_t>(CTX_EDGE) : contextOf(bytes[from - 1]);
+            int32_t state = intern({}, context);
+            size_t lastEnd = NPOS;
+            for (size_t i = from;; ++i) {
+                if (i == limit) {
+                    state = withoutStarts(state);
+                    if (state == deadState) {
+                        break;
+                    }
+                }
+                uint32_t symbol = i < size ? program.byteClass[bytes[i]]
+                                           : static_cast<uint32_t>(partial ? partialSymbol() : edgeSymbol());
+                int32_t next = transition(state, symbol);
+                if (next & 1) {
+                    lastEnd = i;
+                }
+                if (i == size) {
+                    break;
+                }
+                state = next >> 1;
+                if (state == deadState) {
+                    break;
+                }
+            }
+            return lastEnd;
+        }
+
+        // 从end开始向左查找最小的起点，使[start, end)是一个非空匹配
+        size_t findStart(const char* data, size_t size, size_t from, size_t end, bool partial) {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+            uint8_t context = end < size ? contextOf(bytes[end])
+                                           : static_cast<uint8_t>(partial ? CTX_PARTIAL : CTX_EDGE);
+            int32_t state = intern({program.start}, static_cast<uint8_t>(context | FLAG_NO_EMPTY));
+            size_t best = NPOS;
+            for (size_t i = end;; --i) {
+                uint32_t symbol = i > 0 ? program.byteClass[bytes[i - 1]] : static_cast<uint32_t>(edgeSymbol());
+                int32_t next = transition(state, symbol);
+                if (next & 1) {
+                    best = i;
+                }
+                if (i == from) {
+                    break;
+                }
+                state = next >> 1;
+                if (state == deadState) {
+                    break;
+                }
+            }
+            return best;
+        }
+
+        // 逐符号模拟（用于静态分析）：从一个起点开始、不计空匹配的初始状态，context为起点左侧的字符
+        int32_t anchoredStart(uint8_t context) {
+            return intern({program.start}, static_cast<uint8_t>(context | FLAG_NO_EMPTY));
+        }
+
+        // 返回(下一状态<<1)|(读入该符号前是否匹配)；状态编号在缓存清空（resetCount增加）后失效
+        int32_t step(int32_t state, uint32_t symbol) { return transition(state, symbol); }
+        bool isDead(int32_t state) const { return state == deadState; }
+        size_t resetCount() const { return resets; }
+
+        uint32_t symbolOf(unsigned char byte) const { return program.byteClass[byte]; }
+        uint32_t endSymbol(bool partial) const {
+            return static_cast<uint32_t>(partial ? partialSymbol() : edgeSymbol());
+        }
+
+    private:
+        static const uint8_t CONTEXT_MASK = 0x3;
+        static const uint8_t FLAG_NO_START = 0x4;   // 不再开始新的匹配（非锚定模式）
+        static const uint8_t FLAG_NO_EMPTY = 0x8;   // 忽略空匹配（只用于初始状态）
+
+        // 缓存的状态数超过上限时清空重建，内存占用有界
+        static const size_t MAX_STATES = 4096;
+
+        struct State {
+            vector<uint32_t> threads;
+            uint8_t flags = 0;
+            vector<int32_t> next;   // (下一状态<<1)|(读入该符号前是否匹配)，-1为尚未计算
+        };
+
+        const Program& program;
+        bool leftmostFirst;
+        bool unanchored;
+        bool reversed;
+        size_t classCount;
+        size_t symbolCount;
+        vector<bool> classIsWord;
+
+        vector<State> states;
+        unordered_map<string, int32_t> index;
+        int32_t deadState = -1;
+        size_t resets = 0;
+
+        // 展开ε转移时的访问标记
+        vector<uint32_t> visited;
+        vector<uint32_t> queued;
+        uint32_t stamp = 0;
+        vector<uint32_t> stack;
+        vector<uint32_t> consuming;
+        vector<uint32_t> nextThreads;
+
+        size_t edgeSymbol() const { return classCount; }
+        size_t partialSymbol() const { return classCount + 1; }
+
+        static uint8_t contextOf(unsigned char c) {
+            return isWordByte(c) ? CTX_WORD : CTX_OTHER;
+        }
+
+        static bool isWordContext(uint8_t context) {
+            return context == CTX_WORD;
+        }
+
+        static bool assertionHolds(Assertion assertion, uint8_t left, uint8_t right) {
+            switch (assertion) {
+                case Assertion::BEGIN_TEXT:
+                    return left == CTX_EDGE;
+                case Assertion::END_TEXT:
+                    return right == CTX_EDGE;
+                case Assertion::WORD_BOUNDARY:
+                    return right != CTX_PARTIAL && isWordContext(left) != isWordContext(right);
+                case Assertion::NOT_WORD_BOUNDARY:
+                    return right != CTX_PARTIAL && isWordContext(left) == isWordContext(right);
+            }
+            return false;
+        }
+
+        void resetCache() {
+            states.clear();
+            index.clear();
+            deadState = -1;
+            ++resets;
+        }
+
+        int32_t intern(const vector<uint32_t>& threads, uint8_t flags) {
+            // 上下文只用于判断断言，没有断言的程序不按上下文区分状态
+            if (!program.hasAssertions) {
+                flags &= static_cast<uint8_t>(~CONTEXT_MASK);
+            }
+            // 没有线程且不会开始新匹配的状态是死状态
+            if (threads.empty() && (!unanchored || (flags & FLAG_NO_START))) {
+                flags = FLAG_NO_START;
+            }
+
+            string key(1, static_cast<char>(flags));
+            key.append(reinterpret_cast<const char*>(threads.data()), threads.size() * sizeof(uint32_t));
+            auto found = index.find(key);
+            if (found != index.end()) {
+                return found->second;
+            }
+
+            if (states.size() >= MAX_STATES) {
+                resetCache();
+            }
+            State state;
+            state.threads = threads;
+            state.flags = flags;
+            state.next.assign(symbolCount, -1);
+            states.push_back(std::move(state));
+            int32_t id = static_cast<int32_t>(states.size() - 1);
+            index.emplace(std::move(key), id);
+            if (threads.empty() && (flags & FLAG_NO_START)) {
+                deadState = id;
+            }
+            return id;
+        }
+
+        int32_t withoutStarts(int32_t state) {
+            if (!unanchored || (states[state].flags & FLAG_NO_START)) {
+                return state;
+            }
+            vector<uint32_t> threads = states[state].threads;
+            return intern(threads, static_cast<uint8_t>(states[state].flags | FLAG_NO_START));
+        }
+
+        int32_t transition(int32_t state, uint32_t symbol) {
+            int32_t cached = states[state].next[symbol];
+            if (cached >= 0) {
+                return cached;
+            }
+
+            size_t generation = states.size();
+            int32_t result = computeTransition(state, symbol);
+            // 计算过程中缓存被清空时，原状态已失效，不写回
+            if (states.size() >= generation && static_cast<size_t>(state) < states.size()) {
+                states[state].next[symbol] = result;
+            }
+            return result;
+        }
+
+        // 优先级顺序的深度优先展开；遇到MATCH时（最左优先模式）返回true表示截断
+        bool expand(uint32_t pc, bool ignoreMatch, uint8_t left, uint8_t right, bool& matched) {
+            stack.clear();
+            stack.push_back(pc);
+            while (!stack.empty()) {
+                uint32_t current = stack.back();
+                stack.pop_back();
+                if (visited[current] == stamp) {
+                    continue;
+                }
+                visited[current] = stamp;
+
+                const Inst& inst = program.insts[current];
+                switch (inst.op) {
+                    case Op::JUMP:
+                        stack.push_back(inst.out);
+                        break;
+                    case Op::SPLIT:
+                        stack.push_back(inst.out1);
+                        stack.push_back(inst.out);
+                        break;
+                    case Op::ASSERT:
+                        if (assertionHolds(inst.assertion, left, right)) {
+                            stack.push_back(inst.out);
+                        }
+                        break;
+                    case Op::BYTE_RANGE:
+                        consuming.push_back(current);
+                        break;
+                    case Op::MATCH:
+                        if (!ignoreMatch) {
+                            matched = true;
+                            if (leftmostFirst) {
+                                return true;
+                            }
+                        }
+                        break;
+                }
+            }
+            return false;
+        }
+
+        int32_t computeTransition(int32_t stateId, uint32_t symbol) {
+            // 复制状态内容：新建状态可能使引用失效
+            vector<uint32_t> threads = states[stateId].threads;
+            uint8_t flags = states[stateId].flags;
+
+            uint8_t stateContext = flags & CONTEXT_MASK;
+            uint8_t symbolContext = symbol == edgeSymbol() ? CTX_EDGE
+                                  : symbol == partialSymbol() ? CTX_PARTIAL
+                                  : (classIsWord[symbol] ? CTX_WORD : CTX_OTHER);
+            uint8_t left = reversed ? symbolContext : stateContext;
+            uint8_t right = reversed ? stateContext : symbolContext;
+
+            if (++stamp == 0) {
+                fill(visited.begin(), visited.end(), 0);
+                fill(queued.begin(), queued.end(), 0);
+                stamp = 1;
+            }
+            consuming.clear();
+            bool matched = false;
+            bool cut = false;
+            bool ignoreMatch = (flags & FLAG_NO_EMPTY) != 0;
+            for (uint32_t pc : threads) {
+                if (expand(pc, ignoreMatch, left, right, matched)) {
+                    cut = true;
+                    break;
+                }
+            }
+            // 在当前位置开始的新匹配优先级最低，且不能是空匹配
+            bool noStart = !unanchored || (flags & FLAG_NO_START) || (leftmostFirst && matched);
+            if (!cut && !noStart) {
+                expand(program.start, true, left, right, matched);
+            }
+
+            int32_t matchBit = matched ? 1 : 0;
+            if (symbol >= classCount) {
+                return (intern({}, FLAG_NO_START) << 1) | matchBit;
+            }
+
+            uint8_t byte = program.classByte[symbol];
+            nextThreads.clear();
+            for (uint32_t pc : consuming) {
+                const Inst& inst = program.insts[pc];
+                if (byte >= inst.lo && byte <= inst.hi && queued[inst.out] != stamp) {
+                    queued[inst.out] = stamp;
+                    nextThreads.push_back(inst.out);
+                }
+            }
+            if (!leftmostFirst) {
+                sort(nextThreads.begin(), nextThreads.end());
+            }
+
+            uint8_t nextFlags = symbolContext;
+            if (unanchored && noStart) {
+                nextFlags |= FLAG_NO_START;
+            }
+            vector<uint32_t> nextCopy = nextThreads;
+            return (intern(nextCopy, nextFlags) << 1) | matchBit;
+        }
+    };
+
+    // ==================== Regex ====================
+
+    Regex::Regex() = default;
+    Regex::~Regex() = default;
+
+    unique_ptr<Regex> Regex::compile(const string& pattern, bool icase, string& error) {
+        Parser parser(pattern, icase);
+        unique_ptr<Node> root = parser.parse(error);
+        if (!root) {
+            return nullptr;
+        }
+        if (hasEmptyLoop(*root)) {
+            error = "不支持循环体可以匹配空串的重复";
+            return nullptr;
+        }
+
+        unique_ptr<Regex> regex(new Regex());
+        regex->source = pattern;
+        regex->forwardProgram = make_unique<Program>();
+        regex->reverseProgram = make_unique<Program>();
+        if (!buildProgram(*root, false, *regex->forwardProgram, error) ||
+            !buildProgram(*root, true, *regex->reverseProgram, error)) {
+            return nullptr;
+        }
+        LiteralInfo literalInfo = analyzeLiterals(*root);
+        const LiteralSet& literals = bestOf(literalInfo);
+        if (literalScore(literals) >= MIN_LITERAL_LENGTH) {
+            regex->literals = literals;
+        }
+        regex->maxLength = maxMatchBytes(*root);
+
+        // [...]+：最左匹配就是第一个集合内码点开始的最长连续段
+        if (root->kind == Node::REPEAT && root->min == 1 && root->max == -1 && root->greedy &&
+            root->children.front()->kind == Node::CLASS) {
+            LiteralInfo members = analyzeLiterals(*root->children.front());
+            SimdScan::PrefixSet prefixes;
+            vector<string> heads;
+            for (const auto& member : members.set) {
+                heads.push_back(member.substr(0, SimdScan::PrefixSet::MAX_LENGTH));
+            }
+            sort(heads.begin(), heads.end());
+            heads.erase(unique(heads.begin(), heads.end()), heads.end());
+            bool usable = members.exact && !members.set.empty();
+            for (const auto& head : heads) {
+                usable = usable && prefixes.add(head.data(), head.size());
+            }
+            if (usable) {
+                // 字面量分析把ASCII字母折叠为小写，这里需要原始码点
+                regex->runMembers.clear();
+                for (const auto& range : root->children.front()->ranges) {
+                    for (uint32_t cp = range.first; cp <= range.second; ++cp) {
+                        uint8_t bytes[4];
+                        int length = encodeUtf8(cp, bytes);
+                        regex->runMembers.emplace_back(reinterpret_cast<const char*>(bytes), length);
+                    }
+                }
+                regex->runPrefixes = prefixes;
+                regex->charRun = true;
+            }
+        }
+        return regex;
+    }
+
+    size_t Regex::runLength(const char* data, size_t size, size_t pos) const {
+        for (const auto& member : runMembers) {
+            if (pos + member.size() <= size && memcmp(data + pos, member.data(), member.size()) == 0) {
+                return member.size();
+            }
+        }
+        return 0;
+    }
+
+    MatchCache::MatchCache() = default;
+    MatchCache::~MatchCache() = default;
+    MatchCache::MatchCache(MatchCache&&) noexcept = default;
+    MatchCache& MatchCache::operator=(MatchCache&&) noexcept = default;
+
+    bool Regex::search(const char* data, size_t size, size_t from, size_t limit, bool partial,
+                       size_t& matchStart, size_t& matchEnd) const {
+        MatchCache cache;
+        return search(data, size, from, limit, partial, matchStart, matchEnd, cache);
+    }
+
+    bool Regex::search(const char* data, size_t size, size_t from, size_t limit, bool partial,
+                       size_t& matchStart, size_t& matchEnd, MatchCache& cache) const {
+        limit = min(limit, size);
+        if (from >= limit) {
+            return false;
+        }
+
+        if (charRun) {
+            for (size_t pos = runPrefixes.find(data, size, from); pos < limit;
+                 pos = runPrefixes.find(data, size, pos + 1)) {
+                size_t length = runLength(data, size, pos);
+                if (length == 0) {
+                    continue;
+                }
+                matchStart = pos;
+                matchEnd = pos + length;
+                while ((length = runLength(data, size, matchEnd)) > 0) {
+                    matchEnd += length;
+                }
+                return true;
+            }
+            return false;
+        }
+
+        if (cache.owner != this) {
+            cache.forward = make_unique<LazyDfa>(*forwardProgram, true, true, false);
+            cache.reverse = make_unique<LazyDfa>(*reverseProgram, false, false, true);
+            cache.owner = this;
+        }
+        // 先找到最左匹配的终点，再从终点反向找到它的起点
+        size_t end = cache.forward->findEnd(data, size, from, limit, partial);
+        if (end == LazyDfa::NPOS) {
+            return false;
+        }
+        size_t start = cache.reverse->findStart(data, size, from, end, partial);
+        if (start == LazyDfa::NPOS) {
+            return false;
+        }
+        matchStart = start;
+        matchEnd = end;
+        return true;
+    }
+
+    // ==================== 匹配关系比较 ====================
+
+    namespace {
+        // 同一起点上两个模式已读过的部分的匹配情况：各自是否已有匹配，都有匹配时谁的终点靠后
+        // （最左优先规则下每个模式的终点是最后一次报告匹配的位置）
+        const uint8_t RELATION_A = 1;
+        const uint8_t RELATION_B = 2;
+        const uint8_t RELATION_A_LATER = 4;
+        const uint8_t RELATION_B_LATER = 8;
+
+        // 乘积状态数上限，超过时放弃判断
+        const size_t MAX_PRODUCT_STATES = 1 << 16;
+
+        // 语法树能匹配的一个最短文本（每个字符类取第一个码点，断言忽略，因此不一定真能匹配）
+        bool shortestText(const Node& node, string& out) {
+            switch (node.kind) {
+                case Node::EMPTY:
+                case Node::ASSERT:
+                    return true;
+                case Node::CLASS: {
+                    if (node.ranges.empty()) {
+                        return false;
+                    }
+                    uint8_t bytes[4];
+                    int length = encodeUtf8(node.ranges.front().first, bytes);
+                    out.append(reinterpret_cast<const char*>(bytes), length);
+                    return true;
+                }
+                case Node::CONCAT:
+                    for (const auto& child : node.children) {
+                        if (!shortestText(*child, out)) {
+                            return false;
+                        }
+                    }
+                    return true;
+                case Node::ALTERNATE: {
+                    bool found = false;
+                    string best;
+                    for (const auto& child : node.children) {
+                        string text;
+                        if (shortestText(*child, text) && (!found || text.size() < best.size())) {
+                            best = std::move(text);
+                            found = true;
+                        }
+                    }
+                    out += best;
+                    return found;
+                }
+                case Node::REPEAT: {
+                    string text;
+                    if (!shortestText(*node.children.front(), text)) {
+                        return node.min == 0;
+                    }
+                    for (int i = 0; i < node.min; ++i) {
+                        out += text;
+                    }
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        uint8_t advanceRelation(uint8_t relation, bool matchA, bool matchB) {
+            if (matchA && matchB) {
+                return RELATION_A | RELATION_B;
+            }
+            if (matchA) {
+                return (relation & RELATION_B) ? (RELATION_A | RELATION_B | RELATION_A_LATER) : RELATION_A;
+            }
+            if (matchB) {
+                return (relation & RELATION_A) ? (RELATION_A | RELATION_B | RELATION_B_LATER) : RELATION_B;
+            }
+            return relation;
+        }
+    }
+
+    MatchComparer::MatchComparer(vector<const Regex*> patterns)
+        : patterns(std::move(patterns)), dfas(this->patterns.size()), witnesses(this->patterns.size()) {}
+
+    MatchComparer::~MatchComparer() = default;
+
+    LazyDfa& MatchComparer::dfaOf(size_t index) {
+        if (!dfas[index]) {
+            dfas[index] = make_unique<LazyDfa>(*patterns[index]->forwardProgram, true, false, false);
+        }
+        return *dfas[index];
+    }
+
+    const MatchComparer::Witness& MatchComparer::witnessOf(size_t index) {
+        Witness& witness = witnesses[index];
+        if (!witness.built) {
+            witness.built = true;
+            Parser parser(patterns[index]->source, true);
+            string error;
+            unique_ptr<Node> root = parser.parse(error);
+            witness.found = root && shortestText(*root, witness.text);
+            witness.context = LazyDfa::CTX_OTHER;
+        }
+        return witness;
+    }
+
+    size_t MatchComparer::matchEnd(size_t index, const Witness& witness) {
+        LazyDfa& dfa = dfaOf(index);
+        int32_t state = dfa.anchoredStart(witness.context);
+        size_t end = LazyDfa::NPOS;
+        for (size_t i = 0;; ++i) {
+            uint32_t symbol = i < witness.text.size() ? dfa.symbolOf(static_cast<unsigned char>(witness.text[i]))
+                                                      : dfa.endSymbol(false);
+            int32_t next = dfa.step(state, symbol);
+            if (next & 1) {
+                end = i;
+            }
+            state = next >> 1;
+            if (i == witness.text.size() || dfa.isDead(state)) {
+                return end;
+            }
+        }
+    }
+
+    MatchComparer::Result MatchComparer::check(size_t a, size_t b, bool covers, bool sameEnd) {
+        if (!patterns[a] || !patterns[b]) {
+            return Result::UNKNOWN;
+        }
+
+        // 先在两个模式各自的最短匹配上找反例
+        for (size_t index : {a, b}) {
+            const Witness& witness = witnessOf(index);
+            if (!witness.found || (index == b && !sameEnd)) {
+                continue;
+            }
+            size_t endA = matchEnd(a, witness);
+            size_t endB = matchEnd(b, witness);
+            if (covers && endA != LazyDfa::NPOS && endB == LazyDfa::NPOS) {
+                return Result::NO;
+            }
+            if (sameEnd && endA != LazyDfa::NPOS && endB != LazyDfa::NPOS && endA != endB) {
+                return Result::NO;
+            }
+        }
+
+        LazyDfa& dfaA = dfaOf(a);
+        LazyDfa& dfaB = dfaOf(b);
+        size_t resetsA = dfaA.resetCount();
+        size_t resetsB = dfaB.resetCount();
+
+        // 两个程序的字节等价类组合在一起
+        vector<pair<uint32_t, uint32_t>> symbols;
+        vector<bool> seenSymbol(256 * 256, false);
+        for (int byte = 0; byte < 256; ++byte) {
+            uint32_t symbolA = dfaA.symbolOf(static_cast<unsigned char>(byte));
+            uint32_t symbolB = dfaB.symbolOf(static_cast<unsigned char>(byte));
+            if (!seenSymbol[symbolA * 256 + symbolB]) {
+                seenSymbol[symbolA * 256 + symbolB] = true;
+                symbols.emplace_back(symbolA, symbolB);
+            }
+        }
+
+        auto violates = [covers, sameEnd](uint8_t relation) {
+            if (covers && (relation & RELATION_A) && !(relation & RELATION_B)) {
+                return true;
+            }
+            return sameEnd && (relation & (RELATION_A_LATER | RELATION_B_LATER)) != 0;
+        };
+
+        // 在乘积自动机上广度优先搜索：任何可达位置上文本结束（或数据结束但后面还有内容）
+        // 时的匹配关系都必须满足条件
+        struct ProductState {
+            int32_t stateA;
+            int32_t stateB;
+            uint8_t relation;
+        };
+        vector<ProductState> queue;
+        unordered_set<uint64_t> visited;
+        // 同一状态读入不同符号大多转到同一个乘积状态，与上一次相同时不再查表
+        uint64_t lastKey = UINT64_MAX;
+        auto push = [&](int32_t stateA, int32_t stateB, uint8_t relation) {
+            uint64_t key = (static_cast<uint64_t>(stateA) << 36) | (static_cast<uint64_t>(stateB) << 4) | relation;
+            if (key == lastKey) {
+                return;
+            }
+            lastKey = key;
+            if (visited.insert(key).second) {
+                queue.push_back({stateA, stateB, relation});
+            }
+        };
+        // 缓存清空后已有的状态编号全部失效，只能放弃
+        auto stable = [&]() {
+            return dfaA.resetCount() == resetsA && dfaB.resetCount() == resetsB;
+        };
+        for (uint8_t context : {LazyDfa::CTX_EDGE, LazyDfa::CTX_WORD, LazyDfa::CTX_OTHER}) {
+            int32_t startA = dfaA.anchoredStart(context);
+            int32_t startB = dfaB.anchoredStart(context);
+            if (!stable()) {
+                return Result::UNKNOWN;
+            }
+            push(startA, startB, 0);
+        }
+
+        // 中途的匹配关系之后还会变化，只在匹配终结时检查：文本在此结束，或两个模式都不会再匹配
+        for (size_t head = 0; head < queue.size(); ++head) {
+            if (queue.size() > MAX_PRODUCT_STATES) {
+                return Result::UNKNOWN;
+            }
+            ProductState node = queue[head];
+            for (bool partial : {false, true}) {
+                int32_t nextA = dfaA.step(node.stateA, dfaA.endSymbol(partial));
+                int32_t nextB = dfaB.step(node.stateB, dfaB.endSymbol(partial));
+                if (!stable()) {
+                    return Result::UNKNOWN;
+                }
+                if (violates(advanceRelation(node.relation, nextA & 1, nextB & 1))) {
+                    return Result::NO;
+                }
+            }
+            for (const auto& symbol : symbols) {
+                int32_t nextA = dfaA.step(node.stateA, symbol.first);
+                int32_t nextB = dfaB.step(node.stateB, symbol.second);
+                if (!stable()) {
+                    return Result::UNKNOWN;
+                }
+                uint8_t relation = advanceRelation(node.relation, nextA & 1, nextB & 1);
+                nextA >>= 1;
+                nextB >>= 1;
+                if (dfaA.isDead(nextA) && dfaB.isDead(nextB)) {
+                    if (violates(relation)) {
+                        return Result::NO;
+                    }
+                    continue;
+                }
+                // a不再可能匹配且还没有匹配过，或者只检查终点时b不再可能匹配且还没有匹配过：
+                // 之后不会出现需要检查的情况
+                if (dfaA.isDead(nextA) && !(relation & RELATION_A)) {
+                    continue;
+                }
+                if (!covers && dfaB.isDead(nextB) && !(relation & RELATION_B)) {
+                    continue;
+                }
+                push(nextA, nextB, relation);
+            }
+        }
+        return Result::YES;
+    }
+
+    // ==================== 序列化 ====================
+
+    void BinaryWriter::u8(uint8_t value) {
+        out += static_cast<char>(value);
+    }
+
+    void BinaryWriter::u32(uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            out += static_cast<char>((value >> shift) & 0xFF);
+        }
+    }
+
+    void BinaryWriter::u64(uint64_t value) {
+        for (int shift = 0; shift < 64; shift += 8) {
+            out += static_cast<char>((value >> shift) & 0xFF);
+        }
+    }
+
+    void BinaryWriter::bytes(const void* data, size_t size) {
+        out.append(static_cast<const char*>(data), size);
+    }
+
+    void BinaryWriter::str(const string& value) {
+        u32(static_cast<uint32_t>(value.size()));
+        out += value;
+    }
+
+    namespace {
+        bool littleEndianHost() {
+            const uint16_t probe = 1;
+            uint8_t first = 0;
+            memcpy(&first, &probe, 1);
+            return first == 1;
+        }
+    }
+
+    void BinaryWriter::u32Array(const uint32_t* values, size_t count) {
+        if (littleEndianHost()) {
+            bytes(values, count * sizeof(uint32_t));
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            u32(values[i]);
+        }
+    }
+
+    bool BinaryReader::take(size_t size) {
+        if (failed || static_cast<size_t>(end - cursor) < size) {
+            failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    bool BinaryReader::u8(uint8_t& value) {
+        if (!take(1)) {
+            return false;
+        }
+        value = *cursor++;
+        return true;
+    }
+
+    bool BinaryReader::u32(uint32_t& value) {
+        if (!take(4)) {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < 4; ++i) {
+            value |= static_cast<uint32_t>(cursor[i]) << (8 * i);
+        }
+        cursor += 4;
+        return true;
+    }
+
+    bool BinaryReader::u64(uint64_t& value) {
+        if (!take(8)) {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < 8; ++i) {
+            value |= static_cast<uint64_t>(cursor[i]) << (8 * i);
+        }
+        cursor += 8;
+        return true;
+    }
+
+    bool BinaryReader::bytes(void* data, size_t size) {
+        if (!take(size)) {
+            return false;
+        }
+        memcpy(data, cursor, size);
+        cursor += size;
+        return true;
+    }
+
+    bool BinaryReader::u32Array(uint32_t* values, size_t count) {
+        if (count > static_cast<size_t>(end - cursor) / sizeof(uint32_t)) {
+            failed = true;
+            return false;
+        }
+        if (littleEndianHost()) {
+            return bytes(values, count * sizeof(uint32_t));
+        }
+        for (size_t i = 0; i < count; ++i) {
+            u32(values[i]);
+        }
+        return true;
+    }
+
+    bool BinaryReader::str(string& value) {
+        uint32_t size = 0;
+        if (!u32(size) || !take(size)) {
+            return false;
+        }
+        value.assign(reinterpret_cast<const char*>(cursor), size);
+        cursor += size;
+        return true;
+    }
+
+    namespace {
+        void writeStrings(BinaryWriter& out, const vector<string>& values) {
+            out.u32(static_cast<uint32_t>(values.size()));
+            for (const auto& value : values) {
+                out.str(value);
+            }
+        }
+
+        bool readStrings(BinaryReader& in, vector<string>& values) {
+            uint32_t count = 0;
+            if (!in.u32(count)) {
+                return false;
+            }
+            values.clear();
+            for (uint32_t i = 0; i < count; ++i) {
+                string value;
+                if (!in.str(value)) {
+                    return false;
+                }
+                values.push_back(std::move(value));
+            }
+            return true;
+        }
+
+        // 每条指令定长10字节：op、lo、hi、assertion、out、out1
+        void writeProgram(BinaryWriter& out, const Program& program) {
+            out.u32(program.start);
+            out.u8(program.hasAssertions ? 1 : 0);
+            out.bytes(program.byteClass, sizeof(program.byteClass));
+            out.u32(static_cast<uint32_t>(program.classByte.size()));
+            out.bytes(program.classByte.data(), program.classByte.size());
+            out.u32(static_cast<uint32_t>(program.insts.size()));
+            for (const auto& inst : program.insts) {
+                out.u8(static_cast<uint8_t>(inst.op));
+                out.u8(inst.lo);
+                out.u8(inst.hi);
+                out.u8(static_cast<uint8_t>(inst.assertion));
+                out.u32(inst.out);
+                out.u32(inst.out1);
+            }
+        }
+
+        // 读取并检查程序：所有跳转目标和等价类编号都必须在范围内，否则匹配时会越界
+        bool readProgram(BinaryReader& in, Program& program) {
+            uint8_t hasAssertions = 0;
+            uint32_t classCount = 0;
+            uint32_t instCount = 0;
+            if (!in.u32(program.start) || !in.u8(hasAssertions) ||
+                !in.bytes(program.byteClass, sizeof(program.byteClass)) || !in.u32(classCount) ||
+                classCount == 0 || classCount > 256) {
+                return false;
+            }
+            program.hasAssertions = hasAssertions != 0;
+            program.classByte.resize(classCount);
+            if (!in.bytes(program.classByte.data(), classCount) || !in.u32(instCount) ||
+                instCount == 0 || instCount > MAX_PROGRAM_SIZE || program.start >= instCount) {
+                return false;
+            }
+            for (uint8_t cls : program.byteClass) {
+                if (cls >= classCount) {
+                    return false;
+                }
+            }
+            program.insts.resize(instCount);
+            for (auto& inst : program.insts) {
+                uint8_t op = 0;
+                uint8_t assertion = 0;
+                if (!in.u8(op) || !in.u8(inst.lo) || !in.u8(inst.hi) || !in.u8(assertion) ||
+                    !in.u32(inst.out) || !in.u32(inst.out1) ||
+                    op > static_cast<uint8_t>(Op::MATCH) ||
+                    assertion > static_cast<uint8_t>(Assertion::NOT_WORD_BOUNDARY)) {
+                    return false;
+                }
+                inst.op = static_cast<Op>(op);
+                inst.assertion = static_cast<Assertion>(assertion);
+                if (inst.op != Op::MATCH && inst.out >= instCount) {
+                    return false;
+                }
+                if (inst.op == Op::SPLIT && inst.out1 >= instCount) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    void Regex::serialize(BinaryWriter& out) const {
+        out.str(source);
+        writeStrings(out, literals);
+        out.u64(maxLength);
+        out.u8(charRun ? 1 : 0);
+        if (charRun) {
+            writeStrings(out, runMembers);
+            vector<string> heads;
+            for (size_t i = 0; i < runPrefixes.size(); ++i) {
+                heads.push_back(runPrefixes.prefix(i));
+            }
+            writeStrings(out, heads);
+        }
+        writeProgram(out, *forwardProgram);
+        writeProgram(out, *reverseProgram);
+    }
+
+    unique_ptr<Regex> Regex::deserialize(BinaryReader& in, string& error) {
+        unique_ptr<Regex> regex(new Regex());
+        uint64_t maxLength = 0;
+        uint8_t charRun = 0;
+        if (!in.str(regex->source) || !readStrings(in, regex->literals) || !in.u64(maxLength) ||
+            !in.u8(charRun)) {
+            error = "数据不完整";
+            return nullptr;
+        }
+        regex->maxLength = static_cast<size_t>(maxLength);
+        if (charRun) {
+            vector<string> heads;
+            if (!readStrings(in, regex->runMembers) || !readStrings(in, heads)) {
+                error = "数据不完整";
+                return nullptr;
+            }
+            for (const auto& head : heads) {
+                if (!regex->runPrefixes.add(head.data(), head.size())) {
+                    error = "无效的字符前缀";
+                    return nullptr;
+                }
+            }
+            regex->charRun = true;
+        }
+        regex->forwardProgram = make_unique<Program>();
+        regex->reverseProgram = make_unique<Program>();
+        if (!readProgram(in, *regex->forwardProgram) || !readProgram(in, *regex->reverseProgram)) {
+            error = "无效的NFA程序";
+            return nullptr;
+        }
+        return regex;
+    }
+
+    void LiteralMatcher::serialize(BinaryWriter& out) const {
+        out.u32(static_cast<uint32_t>(outputs.size()));
+        static_assert(sizeof(int32_t) == sizeof(uint32_t), "转移表按u32保存");
+        out.u32Array(reinterpret_cast<const uint32_t*>(transitions.data()), transitions.size());
+        for (const auto& ids : outputs) {
+            out.u32(static_cast<uint32_t>(ids.size()));
+            for (uint32_t id : ids) {
+                out.u32(id);
+            }
+        }
+        out.u32(static_cast<uint32_t>(lengths.size()));
+        for (size_t length : lengths) {
+            out.u64(length);
+        }
+        writeStrings(out, heads);
+    }
+
+    unique_ptr<LiteralMatcher> LiteralMatcher::deserialize(BinaryReader& in) {
+        unique_ptr<LiteralMatcher> matcher(new LiteralMatcher());
+        uint32_t stateCount = 0;
+        if (!in.u32(stateCount) || stateCount == 0 || stateCount > MAX_PROGRAM_SIZE * 16) {
+            return nullptr;
+        }
+        matcher->transitions.resize(static_cast<size_t>(stateCount) * 256);
+        if (!in.u32Array(reinterpret_cast<uint32_t*>(matcher->transitions.data()), matcher->transitions.size())) {
+            return nullptr;
+        }
+        for (int32_t next : matcher->transitions) {
+            if (static_cast<uint32_t>(next) >= stateCount) {
+                return nullptr;
+            }
+        }
+        matcher->outputs.resize(stateCount);
+        vector<uint32_t> ids;
+        for (auto& output : matcher->outputs) {
+            uint32_t count = 0;
+            if (!in.u32(count)) {
+                return nullptr;
+            }
+            for (uint32_t i = 0; i < count; ++i) {
+                uint32_t id = 0;
+                if (!in.u32(id)) {
+                    return nullptr;
+                }
+                output.push_back(id);
+            }
+        }
+        uint32_t literalCount = 0;
+        if (!in.u32(literalCount)) {
+            return nullptr;
+        }
+        for (uint32_t i = 0; i < literalCount; ++i) {
+            uint64_t length = 0;
+            if (!in.u64(length) || length == 0) {
+                return nullptr;
+            }
+            matcher->lengths.push_back(static_cast<size_t>(length));
+        }
+        for (const auto& output : matcher->outputs) {
+            for (uint32_t id : output) {
+                if (id >= literalCount) {
+                    return nullptr;
+                }
+            }
+        }
+        if (!readStrings(in, matcher->heads) || matcher->heads.size() != literalCount) {
+            return nullptr;
+        }
+        matcher->buildPrefixes();
+        matcher->built = true;
+        return matcher;
+    }
+}
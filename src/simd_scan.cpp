@@ -0,0 +1,230 @@
+#include "simd_scan.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define SIMD_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(SIMD_SCAN_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_SCAN_AVX2 1
+#endif
+
+using namespace std;
+
+namespace SimdScan {
+
+    namespace {
+        Level probeLevel() {
+#if defined(SIMD_SCAN_AVX2)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) {
+                return Level::AVX2;
+            }
+#endif
+#if defined(SIMD_SCAN_X86)
+            return Level::SSE2;
+#else
+            return Level::SCALAR;
+#endif
+        }
+
+        atomic<int>& levelSlot() {
+            static atomic<int> slot(static_cast<int>(probeLevel()));
+            return slot;
+        }
+
+        inline uint8_t foldFor(uint8_t c) {
+            return (c >= 'a' && c <= 'z') ? 0x20 : 0x00;
+        }
+
+        inline unsigned countTrailingZeros(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+            return static_cast<unsigned>(__builtin_ctz(mask));
+#else
+            unsigned n = 0;
+            while ((mask & 1) == 0) {
+                mask >>= 1;
+                n++;
+            }
+            return n;
+#endif
+        }
+
+        size_t findScalar(const PrefixSet::Table& table, size_t count, const uint8_t* data, size_t size,
+                          size_t from) {
+            for (size_t i = from; i < size; ++i) {
+                if (!table.leads[data[i]]) {
+                    continue;
+                }
+                for (size_t p = 0; p < count; ++p) {
+                    size_t length = table.length[p];
+                    if (i + length > size) {
+                        continue;
+                    }
+                    size_t k = 0;
+                    while (k < length && (data[i + k] | table.fold[k][p]) == table.value[k][p]) {
+                        k++;
+                    }
+                    if (k == length) {
+                        return i;
+                    }
+                }
+            }
+            return size;
+        }
+
+#if defined(SIMD_SCAN_X86)
+        size_t findSse2(const PrefixSet::Table& table, size_t count, const uint8_t* data, size_t size,
+                        size_t from) {
+            const size_t width = PrefixSet::MAX_LENGTH;
+            __m128i value[width][PrefixSet::MAX_PREFIXES];
+            __m128i fold[width][PrefixSet::MAX_PREFIXES];
+            for (size_t k = 0; k < width; ++k) {
+                for (size_t p = 0; p < count; ++p) {
+                    value[k][p] = _mm_set1_epi8(static_cast<char>(table.value[k][p]));
+                    fold[k][p] = _mm_set1_epi8(static_cast<char>(table.fold[k][p]));
+                }
+            }
+
+            // 每次比较16个起点，每个起点需要看到后面的MAX_LENGTH-1个字节
+            size_t i = from;
+            while (i + 16 + width - 1 <= size) {
+                __m128i bytes[width];
+                for (size_t k = 0; k < width; ++k) {
+                    bytes[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + k));
+                }
+                __m128i hits = _mm_setzero_si128();
+                for (size_t p = 0; p < count; ++p) {
+                    __m128i match = _mm_cmpeq_epi8(_mm_or_si128(bytes[0], fold[0][p]), value[0][p]);
+                    for (size_t k = 1; k < width; ++k) {
+                        match = _mm_and_si128(match, _mm_cmpeq_epi8(_mm_or_si128(bytes[k], fold[k][p]), value[k][p]));
+                    }
+                    hits = _mm_or_si128(hits, match);
+                }
+                uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+                if (mask != 0) {
+                    return i + countTrailingZeros(mask);
+                }
+                i += 16;
+            }
+            return findScalar(table, count, data, size, i);
+        }
+#endif
+
+#if defined(SIMD_SCAN_AVX2)
+        __attribute__((target("avx2")))
+        size_t findAvx2(const PrefixSet::Table& table, size_t count, const uint8_t* data, size_t size,
+                        size_t from) {
+            const size_t width = PrefixSet::MAX_LENGTH;
+            __m256i value[width][PrefixSet::MAX_PREFIXES];
+            __m256i fold[width][PrefixSet::MAX_PREFIXES];
+            for (size_t k = 0; k < width; ++k) {
+                for (size_t p = 0; p < count; ++p) {
+                    value[k][p] = _mm256_set1_epi8(static_cast<char>(table.value[k][p]));
+                    fold[k][p] = _mm256_set1_epi8(static_cast<char>(table.fold[k][p]));
+                }
+            }
+
+            size_t i = from;
+            while (i + 32 + width - 1 <= size) {
+                __m256i bytes[width];
+                for (size_t k = 0; k < width; ++k) {
+                    bytes[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + k));
+                }
+                __m256i hits = _mm256_setzero_si256();
+                for (size_t p = 0; p < count; ++p) {
+                    __m256i match = _mm256_cmpeq_epi8(_mm256_or_si256(bytes[0], fold[0][p]), value[0][p]);
+                    for (size_t k = 1; k < width; ++k) {
+                        match = _mm256_and_si256(
+                            match, _mm256_cmpeq_epi8(_mm256_or_si256(bytes[k], fold[k][p]), value[k][p]));
+                    }
+                    hits = _mm256_or_si256(hits, match);
+                }
+                uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+                if (mask != 0) {
+                    return i + countTrailingZeros(mask);
+                }
+                i += 32;
+            }
+            return findSse2(table, count, data, size, i);
+        }
+#endif
+    }
+
+    Level detectedLevel() {
+        static const Level detected = probeLevel();
+        return detected;
+    }
+
+    Level activeLevel() {
+        return static_cast<Level>(levelSlot().load(memory_order_relaxed));
+    }
+
+    void setLevel(Level level) {
+        if (static_cast<int>(level) > static_cast<int>(detectedLevel())) {
+            level = detectedLevel();
+        }
+        levelSlot().store(static_cast<int>(level), memory_order_relaxed);
+    }
+
+    const char* levelName(Level level) {
+        switch (level) {
+            case Level::SCALAR: return "scalar";
+            case Level::SSE2: return "sse2";
+            case Level::AVX2: return "avx2";
+        }
+        return "scalar";
+    }
+
+    bool PrefixSet::add(const char* bytes, size_t length) {
+        if (count >= MAX_PREFIXES || length == 0 || length > MAX_LENGTH) {
+            return false;
+        }
+        for (size_t k = 0; k < MAX_LENGTH; ++k) {
+            if (k < length) {
+                uint8_t c = static_cast<uint8_t>(bytes[k]);
+                table.value[k][count] = c;
+                table.fold[k][count] = foldFor(c);
+            } else {
+                table.value[k][count] = 0xFF;
+                table.fold[k][count] = 0xFF;
+            }
+        }
+        table.length[count] = static_cast<uint8_t>(length);
+        uint8_t first = static_cast<uint8_t>(bytes[0]);
+        table.leads[first] = true;
+        if (foldFor(first) != 0) {
+            table.leads[first - 0x20] = true;
+        }
+        count++;
+        return true;
+    }
+
+    string PrefixSet::prefix(size_t index) const {
+        string result;
+        for (size_t k = 0; k < table.length[index]; ++k) {
+            result += static_cast<char>(table.value[k][index]);
+        }
+        return result;
+    }
+    
+    size_t PrefixSet::find(const char* data, size_t size, size_t from) const {
+        if (count == 0 || from >= size) {
+            return size;
+        }
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+        switch (activeLevel()) {
+#if defined(SIMD_SCAN_AVX2)
+            case Level::AVX2:
+                return findAvx2(table, count, bytes, size, from);
+#endif
+#if defined(SIMD_SCAN_X86)
+            case Level::SSE2:
+                return findSse2(table, count, bytes, size, from);
+#endif
+            default:
+                return findScalar(table, count, bytes, size, from);
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#include "thread_pool.h"
+
+using namespace std;
+
+// 当前线程所属的线程池和在其中的序号，用于把工作线程提交的任务放入它自己的队列
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local size_t currentIndex = 0;
+
+size_t ThreadPool::resolveThreadCount(size_t requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    unsigned int hardware = thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+ThreadPool::ThreadPool(size_t threads) {
+    size_t count = resolveThreadCount(threads);
+    localQueues.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        localQueues.push_back(make_unique<WorkQueue>());
+    }
+    workers.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    available.notify_all();
+    // 退出前执行完队列中剩余的任务
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::push(function<void()> task) {
+    bool local = currentPool == this;
+    {
+        // 先计数再放入队列：任务可见之前pending已经包含它，取出时的递减不会越界
+        lock_guard<mutex> lock(queueMutex);
+        pending++;
+        if (!local) {
+            tasks.push_back(std::move(task));
+        }
+    }
+    if (local) {
+        WorkQueue& queue = *localQueues[currentIndex];
+        lock_guard<mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    available.notify_one();
+}
+
+bool ThreadPool::popTask(size_t self, function<void()>& task) {
+    bool found = false;
+    
+    // 自己的队列：后进先出，刚拆出的任务数据还在缓存中
+    {
+        WorkQueue& queue = *localQueues[self];
+        lock_guard<mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            found = true;
+        }
+    }
+    
+    // 共享队列：按提交顺序
+    if (!found) {
+        lock_guard<mutex> lock(queueMutex);
+        if (!tasks.empty()) {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            pending--;
+            return true;
+        }
+    }
+    
+    // 从其他线程队列的头部窃取最早拆出的任务
+    for (size_t i = 1; !found && i < localQueues.size(); ++i) {
+        WorkQueue& queue = *localQueues[(self + i) % localQueues.size()];
+        lock_guard<mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            found = true;
+        }
+    }
+    
+    if (found) {
+        lock_guard<mutex> lock(queueMutex);
+        pending--;
+    }
+    return found;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    currentPool = this;
+    currentIndex = index;
+    for (;;) {
+        function<void()> task;
+        if (popTask(index, task)) {
+            task();
+            continue;
+        }
+        
+        unique_lock<mutex> lock(queueMutex);
+        available.wait(lock, [this] { return stopping || pending > 0; });
+        if (pending == 0) {
+            return;
+        }
+        // pending大于0但任务可能刚被其他线程取走或尚未放入队列，回到循环重新查找
+        if (tasks.empty()) {
+            lock.unlock();
+            this_thread::yield();
+        }
+    }
+}
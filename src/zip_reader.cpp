@@ -0,0 +1,485 @@
+#include "zip_utils.h"
+#include "file_utils.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+namespace ZipUtils {
+
+    // ZIP格式常量
+    namespace {
+        const uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+        const uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+        const uint32_t END_OF_CENTRAL_DIR_SIGNATURE = 0x06054b50;
+        const uint32_t ZIP64_END_OF_CENTRAL_DIR_SIGNATURE = 0x06064b50;
+        const uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+        const uint16_t ZIP64_EXTRA_ID = 0x0001;
+
+        const size_t LOCAL_HEADER_SIZE = 30;
+        const size_t CENTRAL_HEADER_SIZE = 46;
+        const size_t END_OF_CENTRAL_DIR_SIZE = 22;
+        const size_t ZIP64_END_OF_CENTRAL_DIR_SIZE = 56;
+        const size_t ZIP64_LOCATOR_SIZE = 20;
+        const size_t MAX_COMMENT_SIZE = 0xFFFF;
+        const uint32_t ZIP64_MARKER_32 = 0xFFFFFFFF;
+        const uint16_t ZIP64_MARKER_16 = 0xFFFF;
+        const size_t STREAM_CHUNK_SIZE = 64 * 1024;
+
+        const uint16_t METHOD_STORED = 0;
+        const uint16_t METHOD_DEFLATED = 8;
+
+        // 小端序读取
+        inline uint16_t readU16(const unsigned char* p) {
+            return static_cast<uint16_t>(p[0] | (p[1] << 8));
+        }
+
+        inline uint32_t readU32(const unsigned char* p) {
+            return static_cast<uint32_t>(p[0]) |
+                   (static_cast<uint32_t>(p[1]) << 8) |
+                   (static_cast<uint32_t>(p[2]) << 16) |
+                   (static_cast<uint32_t>(p[3]) << 24);
+        }
+
+        inline uint64_t readU64(const unsigned char* p) {
+            return static_cast<uint64_t>(readU32(p)) | (static_cast<uint64_t>(readU32(p + 4)) << 32);
+        }
+
+        // 从ZIP64扩展字段中读取被标记为0xFFFFFFFF的值（按规范顺序）
+        bool applyZip64Extra(const unsigned char* extra, size_t extraLength, ZipEntry& entry,
+                             bool sizeMarked, bool compressedMarked, bool offsetMarked) {
+            size_t pos = 0;
+            while (pos + 4 <= extraLength) {
+                uint16_t id = readU16(extra + pos);
+                uint16_t fieldSize = readU16(extra + pos + 2);
+                if (pos + 4 + fieldSize > extraLength) {
+                    return false;
+                }
+                if (id == ZIP64_EXTRA_ID) {
+                    const unsigned char* field = extra + pos + 4;
+                    size_t used = 0;
+                    if (sizeMarked) {
+                        if (used + 8 > fieldSize) return false;
+                        entry.uncompressedSize = readU64(field + used);
+                        used += 8;
+                    }
+                    if (compressedMarked) {
+                        if (used + 8 > fieldSize) return false;
+                        entry.compressedSize = readU64(field + used);
+                        used += 8;
+                    }
+                    if (offsetMarked) {
+                        if (used + 8 > fieldSize) return false;
+                        entry.localHeaderOffset = readU64(field + used);
+                    }
+                    return true;
+                }
+                pos += 4 + fieldSize;
+            }
+            return !(sizeMarked || compressedMarked || offsetMarked);
+        }
+
+        ZipResult makeError(ZipStatus status, const string& message) {
+            return {status, message, -1};
+        }
+    }
+
+    bool isSafeEntryName(const string& name) {
+        if (name.empty() || name[0] == '/' || name[0] == '\\') {
+            return false;
+        }
+
+        // 拒绝Windows盘符路径
+        if (name.size() >= 2 && name[1] == ':') {
+            return false;
+        }
+
+        // 拒绝包含".."的路径组件
+        size_t start = 0;
+        while (start <= name.size()) {
+            size_t end = name.find_first_of("/\\", start);
+            if (end == string::npos) {
+                end = name.size();
+            }
+            if (name.compare(start, end - start, "..") == 0 && end - start == 2) {
+                return false;
+            }
+            start = end + 1;
+        }
+
+        return true;
+    }
+
+    ZipResult ZipReader::open(const fs::path& zipPath) {
+        opened = false;
+        base = nullptr;
+        length = 0;
+        entryList.clear();
+        archiveComment.clear();
+
+        if (!mappedFile.open(zipPath)) {
+            return makeError(ZipStatus::FILE_NOT_FOUND, "无法打开ZIP文件: " + zipPath.string());
+        }
+
+        return openMemory(mappedFile.data(), mappedFile.size());
+    }
+
+    ZipResult ZipReader::openMemory(const void* data, size_t size) {
+        if (data != mappedFile.data()) {
+            mappedFile.close();
+        }
+        opened = false;
+        entryList.clear();
+        archiveComment.clear();
+        base = static_cast<const unsigned char*>(data);
+        length = size;
+
+        ZipResult result = parseCentralDirectory();
+        if (!result.success()) {
+            mappedFile.close();
+            base = nullptr;
+            length = 0;
+            entryList.clear();
+            return result;
+        }
+
+        opened = true;
+        return result;
+    }
+
+    ZipResult ZipReader::parseCentralDirectory() {
+        const unsigned char* data = base;
+        size_t size = length;
+
+        if (size < END_OF_CENTRAL_DIR_SIZE) {
+            return makeError(ZipStatus::INVALID_ARCHIVE, "文件太小，不是有效的ZIP文件");
+        }
+
+        // 从文件末尾向前查找中央目录结束记录
+        size_t searchLimit = min(size, END_OF_CENTRAL_DIR_SIZE + MAX_COMMENT_SIZE);
+        size_t eocdOffset = string::npos;
+        for (size_t back = END_OF_CENTRAL_DIR_SIZE; back <= searchLimit; ++back) {
+            size_t pos = size - back;
+            if (readU32(data + pos) == END_OF_CENTRAL_DIR_SIGNATURE) {
+                size_t commentLength = readU16(data + pos + 20);
+                if (pos + END_OF_CENTRAL_DIR_SIZE + commentLength <= size) {
+                    eocdOffset = pos;
+                    break;
+                }
+            }
+        }
+
+        if (eocdOffset == string::npos) {
+            return makeError(ZipStatus::INVALID_ARCHIVE, "未找到中央目录结束记录");
+        }
+
+        const unsigned char* eocd = data + eocdOffset;
+        uint32_t diskNumber = readU16(eocd + 4);
+        uint32_t centralDirDisk = readU16(eocd + 6);
+        uint64_t totalEntries = readU16(eocd + 10);
+        uint64_t centralDirSize = readU32(eocd + 12);
+        uint64_t centralDirOffset = readU32(eocd + 16);
+        uint16_t commentLength = readU16(eocd + 20);
+        uint64_t directoryLimit = eocdOffset;
+
+        // ZIP64：定位器紧邻结束记录之前，指向ZIP64结束记录
+        if (eocdOffset >= ZIP64_LOCATOR_SIZE &&
+            readU32(data + eocdOffset - ZIP64_LOCATOR_SIZE) == ZIP64_LOCATOR_SIGNATURE) {
+            const unsigned char* locator = data + eocdOffset - ZIP64_LOCATOR_SIZE;
+            uint64_t zip64Offset = readU64(locator + 8);
+            // 偏移量来自归档，用减法比较，避免相加后回绕
+            uint64_t zip64Limit = eocdOffset - ZIP64_LOCATOR_SIZE;
+            if (zip64Offset > zip64Limit || zip64Limit - zip64Offset < ZIP64_END_OF_CENTRAL_DIR_SIZE ||
+                readU32(data + zip64Offset) != ZIP64_END_OF_CENTRAL_DIR_SIGNATURE) {
+                return makeError(ZipStatus::INVALID_ARCHIVE, "ZIP64结束记录损坏");
+            }
+            const unsigned char* zip64 = data + zip64Offset;
+            diskNumber = readU32(zip64 + 16);
+            centralDirDisk = readU32(zip64 + 20);
+            totalEntries = readU64(zip64 + 32);
+            centralDirSize = readU64(zip64 + 40);
+            centralDirOffset = readU64(zip64 + 48);
+            directoryLimit = zip64Offset;
+        } else if (totalEntries == ZIP64_MARKER_16 || centralDirSize == ZIP64_MARKER_32 ||
+                   centralDirOffset == ZIP64_MARKER_32) {
+            // 标记值也可能是真实值，只有在无法定位中央目录时才报错
+            if (centralDirOffset + centralDirSize > eocdOffset) {
+                return makeError(ZipStatus::INVALID_ARCHIVE, "缺少ZIP64结束记录");
+            }
+        }
+
+        if (diskNumber != 0 || centralDirDisk != 0) {
+            return makeError(ZipStatus::UNSUPPORTED_FEATURE, "不支持分卷ZIP文件");
+        }
+
+        if (centralDirOffset > directoryLimit || centralDirSize > directoryLimit - centralDirOffset) {
+            return makeError(ZipStatus::INVALID_ARCHIVE, "中央目录位置无效");
+        }
+
+        // 每条记录至少46字节，据此限制预分配
+        if (totalEntries > centralDirSize / CENTRAL_HEADER_SIZE) {
+            return makeError(ZipStatus::INVALID_ARCHIVE, "中央目录条目数量无效");
+        }
+
+        archiveComment.assign(reinterpret_cast<const char*>(eocd + END_OF_CENTRAL_DIR_SIZE), commentLength);
+
+        // 逐条解析中央目录记录
+        entryList.reserve(static_cast<size_t>(totalEntries));
+        size_t pos = static_cast<size_t>(centralDirOffset);
+        size_t end = static_cast<size_t>(centralDirOffset + centralDirSize);
+
+        for (uint64_t i = 0; i < totalEntries; ++i) {
+            if (pos + CENTRAL_HEADER_SIZE > end || readU32(data + pos) != CENTRAL_HEADER_SIGNATURE) {
+                return makeError(ZipStatus::INVALID_ARCHIVE, "中央目录记录损坏");
+            }
+
+            const unsigned char* header = data + pos;
+            ZipEntry entry;
+            entry.flags = readU16(header + 8);
+            entry.method = readU16(header + 10);
+            entry.modTime = readU16(header + 12);
+            entry.modDate = readU16(header + 14);
+            entry.crc32 = readU32(header + 16);
+            entry.compressedSize = readU32(header + 20);
+            entry.uncompressedSize = readU32(header + 24);
+            uint16_t nameLength = readU16(header + 28);
+            uint16_t extraLength = readU16(header + 30);
+            uint16_t entryCommentLength = readU16(header + 32);
+            entry.externalAttributes = readU32(header + 38);
+            entry.localHeaderOffset = readU32(header + 42);
+
+            size_t recordSize = CENTRAL_HEADER_SIZE + nameLength + extraLength + entryCommentLength;
+            if (pos + recordSize > end) {
+                return makeError(ZipStatus::INVALID_ARCHIVE, "中央目录记录越界");
+            }
+
+            entry.name.assign(reinterpret_cast<const char*>(header + CENTRAL_HEADER_SIZE), nameLength);
+
+            bool sizeMarked = entry.uncompressedSize == ZIP64_MARKER_32;
+            bool compressedMarked = entry.compressedSize == ZIP64_MARKER_32;
+            bool offsetMarked = entry.localHeaderOffset == ZIP64_MARKER_32;
+            if ((sizeMarked || compressedMarked || offsetMarked) &&
+                !applyZip64Extra(header + CENTRAL_HEADER_SIZE + nameLength, extraLength, entry,
+                                 sizeMarked, compressedMarked, offsetMarked)) {
+                return makeError(ZipStatus::INVALID_ARCHIVE, "ZIP64扩展字段损坏: " + entry.name);
+            }
+
+            entryList.push_back(std::move(entry));
+            pos += recordSize;
+        }
+
+        return {ZipStatus::SUCCESS, "中央目录解析成功", 0};
+    }
+
+    const ZipEntry* ZipReader::findEntry(const string& name) const {
+        for (const auto& entry : entryList) {
+            if (entry.name == name) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    ZipResult ZipReader::rawData(const ZipEntry& entry, const unsigned char*& dataPtr) const {
+        const unsigned char* data = base;
+        size_t size = length;
+
+        if (entry.localHeaderOffset > size || size - entry.localHeaderOffset < LOCAL_HEADER_SIZE ||
+            readU32(data + entry.localHeaderOffset) != LOCAL_HEADER_SIGNATURE) {
+            return makeError(ZipStatus::INVALID_ARCHIVE, "本地文件头损坏: " + entry.name);
+        }
+
+        // 本地文件头中的扩展字段长度可能与中央目录不同，必须以本地头为准
+        const unsigned char* header = data + entry.localHeaderOffset;
+        uint16_t nameLength = readU16(header + 26);
+        uint16_t extraLength = readU16(header + 28);
+        uint64_t dataOffset = entry.localHeaderOffset + LOCAL_HEADER_SIZE + nameLength + extraLength;
+
+        if (dataOffset > size || entry.compressedSize > size - dataOffset) {
+            return makeError(ZipStatus::INVALID_ARCHIVE, "条目数据越界: " + entry.name);
+        }
+
+        dataPtr = data + dataOffset;
+        return {ZipStatus::SUCCESS, "", 0};
+    }
+
+    ZipResult ZipReader::readEntry(const ZipEntry& entry, string& content) const {
+        content.clear();
+
+        if (entry.isEncrypted()) {
+            return makeError(ZipStatus::UNSUPPORTED_FEATURE, "不支持加密条目: " + entry.name);
+        }
+
+        const unsigned char* data = nullptr;
+        ZipResult located = rawData(entry, data);
+        if (!located.success()) {
+            return located;
+        }
+
+        if (entry.method == METHOD_STORED) {
+            if (entry.compressedSize != entry.uncompressedSize) {
+                return makeError(ZipStatus::INVALID_ARCHIVE, "存储条目大小不一致: " + entry.name);
+            }
+            content.assign(reinterpret_cast<const char*>(data), static_cast<size_t>(entry.compressedSize));
+        } else if (entry.method == METHOD_DEFLATED) {
+            if (!inflateRaw(data, static_cast<size_t>(entry.compressedSize), content, entry.uncompressedSize)) {
+                return makeError(ZipStatus::INVALID_ARCHIVE, "解压条目失败: " + entry.name);
+            }
+        } else {
+            return makeError(ZipStatus::UNSUPPORTED_FEATURE,
+                             "不支持的压缩方法 " + to_string(entry.method) + ": " + entry.name);
+        }
+
+        // 校验CRC32
+        if (updateCRC32(0, content.data(), content.size()) != entry.crc32) {
+            content.clear();
+            return makeError(ZipStatus::INVALID_ARCHIVE, "CRC32校验失败: " + entry.name);
+        }
+
+        return {ZipStatus::SUCCESS, "", 0};
+    }
+
+    ZipResult ZipReader::extractEntry(const ZipEntry& entry, const fs::path& destPath) const {
+        if (entry.isDirectory()) {
+            if (!FileUtils::createDirectory(destPath)) {
+                return makeError(ZipStatus::PERMISSION_DENIED, "无法创建目录: " + destPath.string());
+            }
+            return {ZipStatus::SUCCESS, "", 0};
+        }
+
+        fs::path parentDir = destPath.parent_path();
+        if (!parentDir.empty() && !FileUtils::createDirectory(parentDir)) {
+            return makeError(ZipStatus::PERMISSION_DENIED, "无法创建目录: " + parentDir.string());
+        }
+
+        // 原样写出（不能使用writeStringToFile，它会为文本文件添加BOM）
+        ofstream file(destPath, ios::binary | ios::trunc);
+        if (!file.is_open()) {
+            return makeError(ZipStatus::PERMISSION_DENIED, "无法创建文件: " + destPath.string());
+        }
+
+        ZipResult result = streamEntry(entry, [&file](const char* chunk, size_t chunkSize) {
+            file.write(chunk, static_cast<streamsize>(chunkSize));
+            return file.good();
+        });
+        file.close();
+        if (!result.success()) {
+            FileUtils::removeFile(destPath);
+            return result;
+        }
+        if (file.fail()) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "写入文件失败: " + destPath.string());
+        }
+
+        return {ZipStatus::SUCCESS, "", 0};
+    }
+
+    ZipResult ZipReader::streamEntry(const ZipEntry& entry,
+                                     const function<bool(const char*, size_t)>& sink) const {
+        if (entry.isEncrypted()) {
+            return makeError(ZipStatus::UNSUPPORTED_FEATURE, "不支持加密条目: " + entry.name);
+        }
+
+        const unsigned char* data = nullptr;
+        ZipResult located = rawData(entry, data);
+        if (!located.success()) {
+            return located;
+        }
+
+        uint32_t crc = 0;
+        uint64_t produced = 0;
+        const ZipResult writeFailed = makeError(ZipStatus::UNKNOWN_ERROR, "写出条目失败: " + entry.name);
+
+        if (entry.method == METHOD_STORED) {
+            if (entry.compressedSize != entry.uncompressedSize) {
+                return makeError(ZipStatus::INVALID_ARCHIVE, "存储条目大小不一致: " + entry.name);
+            }
+            // 存储条目直接从映射区分块交给sink，不复制
+            size_t total = static_cast<size_t>(entry.compressedSize);
+            for (size_t pos = 0; pos < total; pos += STREAM_CHUNK_SIZE) {
+                size_t piece = min(STREAM_CHUNK_SIZE, total - pos);
+                const char* chunk = reinterpret_cast<const char*>(data + pos);
+                crc = updateCRC32(crc, chunk, piece);
+                if (!sink(chunk, piece)) {
+                    return writeFailed;
+                }
+            }
+            produced = total;
+        } else if (entry.method == METHOD_DEFLATED) {
+            Inflater inflater;
+            if (!inflater.valid()) {
+                return makeError(ZipStatus::UNKNOWN_ERROR, "初始化inflate失败: " + entry.name);
+            }
+
+            vector<char> outBuffer(STREAM_CHUNK_SIZE);
+            const char* in = reinterpret_cast<const char*>(data);
+            size_t inSize = static_cast<size_t>(entry.compressedSize);
+            CodecStatus status = CodecStatus::OK;
+            while (status == CodecStatus::OK) {
+                char* out = outBuffer.data();
+                size_t outSize = outBuffer.size();
+                status = inflater.process(in, inSize, out, outSize);
+                size_t got = outBuffer.size() - outSize;
+                if (status == CodecStatus::OK && got == 0) {
+                    // 输入已耗尽仍未到达流末尾
+                    status = CodecStatus::FAILED;
+                }
+                if (status == CodecStatus::FAILED) {
+                    break;
+                }
+                crc = updateCRC32(crc, outBuffer.data(), got);
+                produced += got;
+                if (got > 0 && !sink(outBuffer.data(), got)) {
+                    return writeFailed;
+                }
+            }
+
+            if (status != CodecStatus::STREAM_END) {
+                return makeError(ZipStatus::INVALID_ARCHIVE, "解压条目失败: " + entry.name);
+            }
+        } else {
+            return makeError(ZipStatus::UNSUPPORTED_FEATURE,
+                             "不支持的压缩方法 " + to_string(entry.method) + ": " + entry.name);
+        }
+
+        if (produced != entry.uncompressedSize || crc != entry.crc32) {
+            return makeError(ZipStatus::INVALID_ARCHIVE, "CRC32校验失败: " + entry.name);
+        }
+
+        return {ZipStatus::SUCCESS, "", 0};
+    }
+
+    ZipResult ZipReader::extractAll(const fs::path& extractDir) const {
+        if (!opened) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "ZIP文件未打开");
+        }
+
+        for (const auto& entry : entryList) {
+            if (!isSafeEntryName(entry.name)) {
+                return makeError(ZipStatus::INVALID_ARCHIVE, "不安全的条目路径: " + entry.name);
+            }
+
+            ZipResult result = extractEntry(entry, extractDir / fs::u8path(entry.name));
+            if (!result.success()) {
+                return result;
+            }
+        }
+
+        return {ZipStatus::SUCCESS, "解压成功", 0};
+    }
+
+    namespace Platform {
+        ZipResult extractZipNative(const fs::path& zipPath, const fs::path& extractDir) {
+            ZipReader reader;
+            ZipResult result = reader.open(zipPath);
+            if (!result.success()) {
+                return result;
+            }
+            return reader.extractAll(extractDir);
+        }
+    }
+}
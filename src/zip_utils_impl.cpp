@@ -3,6 +3,7 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <deque>
 #include <string>
 #include <cstring>
 #include <algorithm>
@@ -131,6 +132,10 @@ namespace ZipUtils {
                     "无法创建解压目录: " + extractDir.string(), -1};
         }
         
+#if defined(HAVE_ZLIB) && !defined(USE_SYSTEM_ZIP)
+        // 内置实现：直接解析中央目录并用zlib解压，无需临时副本和外部命令
+        return Platform::extractZipNative(zipPath, extractDir);
+#else
         // 检查文件扩展名
         string ext = FileUtils::getFileExtension(zipPath);
         bool isEpub = (ext == ".epub");
@@ -156,6 +161,7 @@ namespace ZipUtils {
         }
         
         return result;
+#endif
     }
     
     // 主压缩函数
@@ -172,6 +178,10 @@ namespace ZipUtils {
             FileUtils::createDirectory(parentDir);
         }
         
+#if defined(HAVE_ZLIB) && !defined(USE_SYSTEM_ZIP)
+        // 内置实现：直接写入目标路径，无需临时文件和重命名/复制
+        return Platform::createZipNative(sourceDir, zipPath);
+#else
         // 检查输出文件扩展名
         string ext = FileUtils::getFileExtension(zipPath);
         bool isEpub = (ext == ".epub");
@@ -211,6 +221,7 @@ namespace ZipUtils {
         }
         
         return result;
+#endif
     }
     
     // 列出ZIP文件内容
@@ -221,6 +232,18 @@ namespace ZipUtils {
             return contents;
         }
         
+#ifdef HAVE_ZLIB
+        // 只解析中央目录，不解压任何条目
+        ZipReader reader;
+        if (!reader.open(zipPath).success()) {
+            return contents;
+        }
+        contents.reserve(reader.entries().size());
+        for (const auto& entry : reader.entries()) {
+            contents.push_back(entry.name);
+        }
+        return contents;
+#else
         // 检查文件扩展名
         string ext = FileUtils::getFileExtension(zipPath);
         bool isEpub = (ext == ".epub");
@@ -290,6 +313,7 @@ namespace ZipUtils {
         }
         
         return contents;
+#endif
     }
     
     // 获取ZIP文件信息
@@ -300,13 +324,319 @@ namespace ZipUtils {
             return info;
         }
         
+#ifdef HAVE_ZLIB
+        ZipReader reader;
+        if (!reader.open(zipPath).success()) {
+            return info;
+        }
+        
+        info.entries = reader.entries();
+        info.fileCount = info.entries.size();
+        info.comment = reader.comment();
+        for (const auto& entry : info.entries) {
+            info.compressedSize += entry.compressedSize;
+            info.uncompressedSize += entry.uncompressedSize;
+        }
+#else
         // 获取文件大小
         info.compressedSize = FileUtils::getFileSize(zipPath);
         
         // 统计文件数量
         auto contents = listZipContents(zipPath);
-        info.fileCount = static_cast<uint32_t>(contents.size());
+        info.fileCount = contents.size();
+#endif
         
         return info;
     }
+    
+#ifdef HAVE_ZLIB
+    // EPUB条目顺序：mimetype在前，其余保持原有顺序
+    static vector<const ZipEntry*> epubEntryOrder(const ZipReader& reader) {
+        vector<const ZipEntry*> order;
+        order.reserve(reader.entries().size());
+        const ZipEntry* mimetype = reader.findEntry("mimetype");
+        if (mimetype) {
+            order.push_back(mimetype);
+        }
+        for (const auto& entry : reader.entries()) {
+            if (&entry != mimetype) {
+                order.push_back(&entry);
+            }
+        }
+        return order;
+    }
+    
+    // mimetype必须以存储方式写出
+    static bool mustRestore(const ZipEntry& entry) {
+        return entry.name == "mimetype" && entry.method != 0;
+    }
+    
+    // 原样复制条目的压缩数据
+    static ZipResult copyRawEntry(const ZipReader& reader, const ZipEntry& entry,
+                                  ZipWriter& writer, RewriteStats& stats) {
+        const unsigned char* data = nullptr;
+        ZipResult result = reader.rawData(entry, data);
+        if (!result.success()) {
+            return result;
+        }
+        
+        result = writer.addRawEntry(entry, data);
+        if (result.success()) {
+            stats.entriesCopied++;
+            stats.bytesCopied += entry.compressedSize;
+        }
+        return result;
+    }
+    
+    // 流式重写单个条目，streamed为false表示过滤器拒绝流式处理（调用者应回退到内存处理）
+    static ZipResult streamRewriteEntry(const ZipReader& reader, const ZipEntry& entry,
+                                        const StreamFilterFactory& factory, ZipWriter& writer,
+                                        bool& streamed, bool& modified) {
+        streamed = true;
+        modified = false;
+        
+        // 第一遍：只扫描，发现修改即停止；未修改的条目随后直接复制
+        unique_ptr<EntryStreamFilter> scanner = factory(entry);
+        string scratch;
+        bool rejected = false;
+        ZipResult result = reader.streamEntry(entry, [&](const char* data, size_t size) {
+            scratch.clear();
+            if (!scanner->write(data, size, false, scratch)) {
+                rejected = true;
+                return false;
+            }
+            return !scanner->modified();
+        });
+        if (rejected) {
+            streamed = false;
+            return {ZipStatus::SUCCESS, "", 0};
+        }
+        if (!scanner->modified()) {
+            if (!result.success()) {
+                return result;
+            }
+            scratch.clear();
+            if (!scanner->write(nullptr, 0, true, scratch)) {
+                streamed = false;
+                return {ZipStatus::SUCCESS, "", 0};
+            }
+            if (!scanner->modified()) {
+                return result;
+            }
+        }
+        scanner.reset();
+        
+        // 第二遍：解压、过滤、压缩同步进行，内存占用与条目大小无关
+        unique_ptr<EntryStreamFilter> filter = factory(entry);
+        result = writer.beginStream(entry.name, entry.uncompressedSize);
+        if (!result.success()) {
+            return result;
+        }
+        
+        ZipResult writeResult = {ZipStatus::SUCCESS, "", 0};
+        string out;
+        auto pump = [&](const char* data, size_t size, bool last) {
+            out.clear();
+            if (!filter->write(data, size, last, out)) {
+                writeResult = {ZipStatus::UNKNOWN_ERROR, "流式处理条目失败: " + entry.name, -1};
+                return false;
+            }
+            writeResult = writer.writeStream(out.data(), out.size());
+            return writeResult.success();
+        };
+        
+        result = reader.streamEntry(entry, [&](const char* data, size_t size) {
+            return pump(data, size, false);
+        });
+        if (!writeResult.success()) {
+            return writeResult;
+        }
+        if (!result.success()) {
+            return result;
+        }
+        if (!pump(nullptr, 0, true)) {
+            return writeResult;
+        }
+        
+        result = writer.finishStream();
+        if (result.success()) {
+            modified = true;
+            filter->commit();
+        }
+        return result;
+    }
+    
+    // 写出条目表中的一个条目（writeEntries和rewriteZip共用）
+    static ZipResult writeEntry(const ZipReader& reader, ArchiveEntry& item, ZipWriter& writer,
+                                RewriteStats& stats) {
+        bool forceStored = mustRestore(item.info);
+        ZipResult result;
+        if (item.precompressed) {
+            result = writer.addPrecompressed(item.info.name, std::move(item.compressed));
+        } else if (item.loaded && (item.modified || forceStored)) {
+            result = writer.addEntry(item.info.name, std::move(item.content), !forceStored);
+        } else {
+            return copyRawEntry(reader, item.info, writer, stats);
+        }
+        if (result.success()) {
+            stats.entriesRecompressed++;
+        }
+        return result;
+    }
+    
+    // ZIP到ZIP重写
+    ZipResult rewriteZip(const fs::path& inputPath, const fs::path& outputPath,
+                         const EntryFilter& needsContent, const EntryTransform& transform,
+                         RewriteStats* stats, const WriterOptions& options,
+                         const StreamingOptions& streaming, const BatchOptions& batch) {
+        ZipReader reader;
+        ZipResult result = reader.open(inputPath);
+        if (!result.success()) {
+            return result;
+        }
+        
+        ZipWriter writer;
+        writer.setOptions(options);
+        result = writer.open(outputPath);
+        if (!result.success()) {
+            return result;
+        }
+        
+        RewriteStats localStats;
+        
+        // 等待变换和写出的条目：逐条处理时只有一个（任一时刻只有一个条目的内容在内存中），
+        // 批量处理时攒够batch.size个选中的条目后一起变换，再按原顺序写出
+        bool batched = batch.transform && batch.size > 0;
+        deque<ArchiveEntry> pending;        // deque追加时不移动已有条目，selectedEntries中的指针保持有效
+        vector<ArchiveEntry*> selectedEntries;
+        auto flushPending = [&]() {
+            if (batched && !selectedEntries.empty()) {
+                batch.transform(selectedEntries);
+            } else if (!batched) {
+                for (ArchiveEntry* item : selectedEntries) {
+                    item->modified = transform && transform(item->info, item->content);
+                }
+            }
+            ZipResult written{ZipStatus::SUCCESS, "", 0};
+            for (auto& item : pending) {
+                written = writeEntry(reader, item, writer, localStats);
+                if (!written.success()) {
+                    break;
+                }
+            }
+            pending.clear();
+            selectedEntries.clear();
+            return written;
+        };
+        
+        for (const ZipEntry* entry : epubEntryOrder(reader)) {
+            bool forceStored = mustRestore(*entry);
+            bool selected = needsContent && needsContent(*entry);
+            
+            // 大条目流式处理，不把整个条目载入内存；之前的条目先按顺序写出
+            if (selected && !forceStored && streaming.filterFactory && streaming.threshold > 0 &&
+                entry->uncompressedSize > streaming.threshold) {
+                result = flushPending();
+                if (!result.success()) {
+                    writer.abort();
+                    return result;
+                }
+                bool streamed = false;
+                bool modified = false;
+                result = streamRewriteEntry(reader, *entry, streaming.filterFactory, writer,
+                                            streamed, modified);
+                if (!result.success()) {
+                    writer.abort();
+                    return result;
+                }
+                if (streamed) {
+                    if (modified) {
+                        localStats.entriesRecompressed++;
+                        localStats.entriesStreamed++;
+                        continue;
+                    }
+                    selected = false;
+                }
+            }
+            
+            // 未选中的条目写出时直接复制压缩数据和CRC32
+            pending.emplace_back();
+            ArchiveEntry& item = pending.back();
+            item.info = *entry;
+            if (forceStored || selected) {
+                result = reader.readEntry(*entry, item.content);
+                if (!result.success()) {
+                    writer.abort();
+                    return result;
+                }
+                item.loaded = true;
+            }
+            
+            if (selected && !forceStored) {
+                selectedEntries.push_back(&item);
+            }
+            if (!batched || selectedEntries.size() >= batch.size) {
+                result = flushPending();
+                if (!result.success()) {
+                    writer.abort();
+                    return result;
+                }
+            }
+        }
+        
+        result = flushPending();
+        if (!result.success()) {
+            writer.abort();
+            return result;
+        }
+        
+        result = writer.close();
+        if (result.success() && stats) {
+            *stats = localStats;
+        }
+        return result;
+    }
+    
+    ZipResult loadEntries(const ZipReader& reader, const EntryFilter& needsContent,
+                          vector<ArchiveEntry>& entries) {
+        entries.clear();
+        entries.reserve(reader.entries().size());
+        
+        for (const ZipEntry* entry : epubEntryOrder(reader)) {
+            ArchiveEntry item;
+            item.info = *entry;
+            
+            if (mustRestore(*entry) || (needsContent && needsContent(*entry))) {
+                ZipResult result = reader.readEntry(*entry, item.content);
+                if (!result.success()) {
+                    entries.clear();
+                    return result;
+                }
+                item.loaded = true;
+            }
+            
+            entries.push_back(std::move(item));
+        }
+        
+        return {ZipStatus::SUCCESS, "", 0};
+    }
+    
+    ZipResult writeEntries(const ZipReader& reader, vector<ArchiveEntry>& entries,
+                           ZipWriter& writer, RewriteStats* stats) {
+        RewriteStats localStats;
+        
+        for (auto& item : entries) {
+            ZipResult result = writeEntry(reader, item, writer, localStats);
+            if (!result.success()) {
+                writer.abort();
+                return result;
+            }
+        }
+        
+        if (stats) {
+            *stats = localStats;
+        }
+        return {ZipStatus::SUCCESS, "", 0};
+    }
+#endif
 }
\ No newline at end of file
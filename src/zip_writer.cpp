@@ -0,0 +1,938 @@
+#include "zip_utils.h"
+#include "file_utils.h"
+#include "thread_pool.h"
+#include <zlib.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <memory>
+#include <future>
+#include <optional>
+
+using namespace std;
+
+namespace ZipUtils {
+
+    namespace {
+        const uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+        const uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+        const uint32_t END_OF_CENTRAL_DIR_SIGNATURE = 0x06054b50;
+
+        const uint16_t METHOD_STORED = 0;
+        const uint16_t METHOD_DEFLATED = 8;
+        const uint32_t ZIP64_END_OF_CENTRAL_DIR_SIGNATURE = 0x06064b50;
+        const uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+        const uint16_t ZIP64_EXTRA_ID = 0x0001;
+
+        const uint16_t VERSION_NEEDED = 20;
+        const uint16_t VERSION_NEEDED_ZIP64 = 45;
+        const uint16_t FLAG_UTF8_NAME = 0x0800;
+        const uint32_t DOS_DIRECTORY_ATTRIBUTE = 0x10;
+        const uint64_t MAX_32BIT_VALUE = 0xFFFFFFFFull;
+        const uint64_t MAX_16BIT_VALUE = 0xFFFF;
+
+        // 流式写入无法预知压缩后大小，源文件接近4GB时预先使用ZIP64本地头
+        const uint64_t ZIP64_STREAM_THRESHOLD = 0xF0000000ull;
+
+        // 单次deflate调用的最大输入（avail_in为uInt）
+        const size_t MAX_DEFLATE_INPUT = 0x40000000;
+
+        const size_t STREAM_CHUNK_SIZE = 64 * 1024;
+
+        // 小端序写入
+        inline void putU16(string& buf, uint16_t v) {
+            buf.push_back(static_cast<char>(v & 0xFF));
+            buf.push_back(static_cast<char>((v >> 8) & 0xFF));
+        }
+
+        inline void putU32(string& buf, uint32_t v) {
+            for (int i = 0; i < 4; ++i) {
+                buf.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+            }
+        }
+
+        inline void putU64(string& buf, uint64_t v) {
+            putU32(buf, static_cast<uint32_t>(v & MAX_32BIT_VALUE));
+            putU32(buf, static_cast<uint32_t>(v >> 32));
+        }
+
+        // 超出32位字段范围的值写为0xFFFFFFFF，真实值放入ZIP64扩展字段
+        inline uint32_t clamp32(uint64_t v) {
+            return v >= MAX_32BIT_VALUE ? static_cast<uint32_t>(MAX_32BIT_VALUE) : static_cast<uint32_t>(v);
+        }
+
+        inline bool needsZip64(const ZipEntry& entry) {
+            return entry.compressedSize >= MAX_32BIT_VALUE || entry.uncompressedSize >= MAX_32BIT_VALUE;
+        }
+
+        ZipResult makeError(ZipStatus status, const string& message) {
+            return {status, message, -1};
+        }
+
+        ZipResult ok() {
+            return {ZipStatus::SUCCESS, "", 0};
+        }
+
+        // 当前时间转换为DOS日期/时间格式
+        void currentDosDateTime(uint16_t& dosTime, uint16_t& dosDate) {
+            time_t now = time(nullptr);
+            tm localTime;
+#ifdef _WIN32
+            localtime_s(&localTime, &now);
+#else
+            localtime_r(&now, &localTime);
+#endif
+            int year = max(localTime.tm_year + 1900, 1980);
+            dosTime = static_cast<uint16_t>((localTime.tm_hour << 11) |
+                                            (localTime.tm_min << 5) |
+                                            (localTime.tm_sec / 2));
+            dosDate = static_cast<uint16_t>(((year - 1980) << 9) |
+                                            ((localTime.tm_mon + 1) << 5) |
+                                            localTime.tm_mday);
+        }
+
+        // zip64为true时本地头的大小字段写为0xFFFFFFFF，并附带包含两个大小的ZIP64扩展字段
+        string buildLocalHeader(const ZipEntry& entry, bool zip64) {
+            string header;
+            header.reserve(30 + entry.name.size() + 20);
+            putU32(header, LOCAL_HEADER_SIGNATURE);
+            putU16(header, zip64 ? VERSION_NEEDED_ZIP64 : VERSION_NEEDED);
+            putU16(header, entry.flags);
+            putU16(header, entry.method);
+            putU16(header, entry.modTime);
+            putU16(header, entry.modDate);
+            putU32(header, entry.crc32);
+            putU32(header, zip64 ? static_cast<uint32_t>(MAX_32BIT_VALUE) : static_cast<uint32_t>(entry.compressedSize));
+            putU32(header, zip64 ? static_cast<uint32_t>(MAX_32BIT_VALUE) : static_cast<uint32_t>(entry.uncompressedSize));
+            putU16(header, static_cast<uint16_t>(entry.name.size()));
+            putU16(header, zip64 ? 20 : 0);
+            header += entry.name;
+            if (zip64) {
+                putU16(header, ZIP64_EXTRA_ID);
+                putU16(header, 16);
+                putU64(header, entry.uncompressedSize);
+                putU64(header, entry.compressedSize);
+            }
+            return header;
+        }
+    }
+
+    // 正在写入的条目状态
+    struct ZipWriter::PendingEntry {
+        ZipEntry info;
+        optional<Deflater> deflater;    // 存储条目为空
+        bool zip64 = false;
+        uint32_t crc = 0;
+    };
+
+    // 独立压缩的数据块；非最后一块以Z_SYNC_FLUSH结束，可直接拼接成一个deflate流
+    struct ZipWriter::DeflatedChunk {
+        string data;
+        uLong crc = 0;
+        size_t size = 0;
+        bool ok = false;
+    };
+
+    // 等待按顺序写出的条目：后台压缩的数据块或延后的原样复制
+    struct ZipWriter::QueuedEntry {
+        string name;
+        shared_ptr<const string> content;
+        vector<future<DeflatedChunk>> chunks;
+        bool raw = false;
+        ZipEntry rawInfo;
+        const unsigned char* rawData = nullptr;
+    };
+
+    ZipWriter::ZipWriter() = default;
+
+    ZipWriter::~ZipWriter() {
+        if (isOpen()) {
+            abort();
+        }
+    }
+
+    void ZipWriter::setCompressionThreads(size_t threads) {
+        // 失败时记录在queueError中
+        flushQueue(0);
+        poolThreads = ThreadPool::resolveThreadCount(threads);
+        if (pool && pool->size() != poolThreads) {
+            pool.reset();
+        }
+    }
+
+    void ZipWriter::setOptions(const WriterOptions& options) {
+        setCompressionLevel(options.compressionLevel);
+        setChunkSize(options.chunkSize);
+        setCompressionThreads(options.threads);
+    }
+
+    // 压缩一个数据块，dictSize为紧邻其前的预设字典长度（来自上一块的末尾）
+    ZipWriter::DeflatedChunk ZipWriter::deflateChunk(const char* data, size_t size, size_t dictSize,
+                                                     bool last, int level) {
+        DeflatedChunk chunk;
+        chunk.size = size;
+        chunk.crc = updateCRC32(0, data, size);
+
+        // 压缩器取自当前工作线程的缓存池
+        Deflater deflater(level);
+        if (!deflater.valid() || (dictSize > 0 && !deflater.setDictionary(data - dictSize, dictSize))) {
+            return chunk;
+        }
+
+        // 同步刷新会追加一个空的存储块，预留少量额外空间
+        chunk.data.resize(deflater.bound(size) + 16);
+        const char* in = data;
+        size_t inSize = size;
+        char* out = &chunk.data[0];
+        size_t outSize = chunk.data.size();
+        CodecStatus status = deflater.process(in, inSize, out, outSize,
+                                              last ? Deflater::Flush::FINISH : Deflater::Flush::SYNC);
+        chunk.ok = last ? (status == CodecStatus::STREAM_END)
+                        : (status == CodecStatus::OK && inSize == 0 && outSize > 0);
+        chunk.data.resize(chunk.data.size() - outSize);
+        return chunk;
+    }
+
+    vector<pair<size_t, size_t>> ZipWriter::chunkRanges(size_t size) const {
+        return chunkRanges(size, chunkSize);
+    }
+
+    vector<pair<size_t, size_t>> ZipWriter::chunkRanges(size_t size, size_t chunkSize) {
+        vector<pair<size_t, size_t>> ranges;
+        // 未设置分块时，只有超过单次deflate输入上限的条目才会拆分
+        size_t step = (chunkSize == 0) ? MAX_DEFLATE_INPUT : min(chunkSize, MAX_DEFLATE_INPUT);
+        if (size <= step) {
+            ranges.emplace_back(0, size);
+            return ranges;
+        }
+        for (size_t begin = 0; begin < size; begin += step) {
+            ranges.emplace_back(begin, min(step, size - begin));
+        }
+        return ranges;
+    }
+
+    ZipResult ZipWriter::open(const fs::path& zipPath) {
+        if (isOpen()) {
+            abort();
+        }
+
+        written.clear();
+        queueError = ok();
+        outputPath = zipPath;
+
+        fs::path parentDir = zipPath.parent_path();
+        if (!parentDir.empty() && !FileUtils::createDirectory(parentDir)) {
+            return makeError(ZipStatus::DIRECTORY_NOT_FOUND, "无法创建输出目录: " + parentDir.string());
+        }
+
+        fileOutput.open(zipPath, ios::binary | ios::trunc);
+        if (!fileOutput.is_open()) {
+            return makeError(ZipStatus::PERMISSION_DENIED, "无法创建ZIP文件: " + zipPath.string());
+        }
+
+        output = &fileOutput;
+        currentDosDateTime(dosTime, dosDate);
+        return ok();
+    }
+
+    void StringOutputBuffer::reset(size_t capacity) {
+        string().swap(buffer);
+        buffer.reserve(capacity);
+        position = 0;
+    }
+
+    string StringOutputBuffer::take() {
+        string data = std::move(buffer);
+        reset();
+        return data;
+    }
+
+    streamsize StringOutputBuffer::xsputn(const char* data, streamsize size) {
+        // 先覆盖当前位置之后已有的内容（回写头部字段），其余追加到末尾
+        size_t count = static_cast<size_t>(size);
+        size_t overwrite = min(count, buffer.size() - position);
+        memcpy(&buffer[0] + position, data, overwrite);
+        buffer.append(data + overwrite, count - overwrite);
+        position += count;
+        return size;
+    }
+
+    StringOutputBuffer::int_type StringOutputBuffer::overflow(int_type ch) {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) {
+            return traits_type::not_eof(ch);
+        }
+        char c = traits_type::to_char_type(ch);
+        xsputn(&c, 1);
+        return ch;
+    }
+
+    StringOutputBuffer::pos_type StringOutputBuffer::seekoff(off_type offset, ios_base::seekdir dir,
+                                                            ios_base::openmode which) {
+        if (!(which & ios_base::out)) {
+            return pos_type(off_type(-1));
+        }
+        off_type base = dir == ios_base::beg ? 0 : dir == ios_base::cur ? static_cast<off_type>(position)
+                                                                         : static_cast<off_type>(buffer.size());
+        off_type target = base + offset;
+        if (target < 0 || target > static_cast<off_type>(buffer.size())) {
+            return pos_type(off_type(-1));
+        }
+        position = static_cast<size_t>(target);
+        return pos_type(target);
+    }
+
+    StringOutputBuffer::pos_type StringOutputBuffer::seekpos(pos_type pos, ios_base::openmode which) {
+        return seekoff(off_type(pos), ios_base::beg, which);
+    }
+
+    ZipResult ZipWriter::openMemory(size_t expectedSize) {
+        if (isOpen()) {
+            abort();
+        }
+
+        written.clear();
+        queueError = ok();
+        outputPath.clear();
+        memoryBuffer.reset(expectedSize);
+        memoryOutput.clear();
+
+        output = &memoryOutput;
+        currentDosDateTime(dosTime, dosDate);
+        return ok();
+    }
+
+    string ZipWriter::takeBuffer() {
+        return memoryBuffer.take();
+    }
+
+    ZipResult ZipWriter::beginEntry(const string& name, uint16_t method, bool zip64, PendingEntry& entry) {
+        if (!isOpen()) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "ZIP文件未打开");
+        }
+        if (streaming) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "流式条目尚未完成");
+        }
+        if (name.empty() || name.size() > 0xFFFF) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "无效的条目名称: " + name);
+        }
+
+        uint64_t offset = static_cast<uint64_t>(output->tellp());
+
+        entry.info = ZipEntry{};
+        entry.info.name = name;
+        entry.info.method = method;
+        entry.info.flags = FLAG_UTF8_NAME;
+        entry.info.modTime = dosTime;
+        entry.info.modDate = dosDate;
+        entry.info.localHeaderOffset = offset;
+        entry.crc = 0;
+        entry.deflater.reset();
+        entry.zip64 = zip64;
+
+        // 先写入占位的本地文件头，完成后回填CRC和大小
+        string header = buildLocalHeader(entry.info, zip64);
+        output->write(header.data(), static_cast<streamsize>(header.size()));
+
+        if (method == METHOD_DEFLATED) {
+            entry.deflater.emplace(compressionLevel);
+            if (!entry.deflater->valid()) {
+                return makeError(ZipStatus::UNKNOWN_ERROR, "初始化deflate失败: " + name);
+            }
+            streamBuffer.resize(STREAM_CHUNK_SIZE);
+        }
+
+        return output->good() ? ok() : makeError(ZipStatus::UNKNOWN_ERROR, "写入ZIP文件失败");
+    }
+
+    ZipResult ZipWriter::writeChunk(PendingEntry& entry, const char* data, size_t size, bool last) {
+        entry.crc = updateCRC32(entry.crc, data, size);
+        entry.info.uncompressedSize += size;
+
+        if (!entry.deflater) {
+            output->write(data, static_cast<streamsize>(size));
+            entry.info.compressedSize += size;
+            return output->good() ? ok() : makeError(ZipStatus::UNKNOWN_ERROR, "写入ZIP文件失败");
+        }
+
+        // 输出经由复用的缓冲区写出，缓冲区写满时继续压缩剩余输入
+        Deflater::Flush flush = last ? Deflater::Flush::FINISH : Deflater::Flush::NONE;
+        const char* in = data;
+        size_t inSize = size;
+        CodecStatus status = CodecStatus::OK;
+        size_t outSize = 0;
+        do {
+            char* out = streamBuffer.data();
+            outSize = streamBuffer.size();
+            status = entry.deflater->process(in, inSize, out, outSize, flush);
+            if (status == CodecStatus::FAILED) {
+                return makeError(ZipStatus::UNKNOWN_ERROR, "deflate压缩失败: " + entry.info.name);
+            }
+            size_t produced = streamBuffer.size() - outSize;
+            output->write(streamBuffer.data(), static_cast<streamsize>(produced));
+            entry.info.compressedSize += produced;
+        } while (outSize == 0 || (last && status != CodecStatus::STREAM_END));
+
+        return output->good() ? ok() : makeError(ZipStatus::UNKNOWN_ERROR, "写入ZIP文件失败");
+    }
+
+    ZipResult ZipWriter::finishEntry(PendingEntry& entry) {
+        entry.deflater.reset();
+
+        entry.info.crc32 = entry.crc;
+        if (!entry.zip64 && needsZip64(entry.info)) {
+            return makeError(ZipStatus::UNSUPPORTED_FEATURE, "条目超过4GB上限: " + entry.info.name);
+        }
+
+        // 回填本地文件头中的CRC32和大小字段（ZIP64时大小位于扩展字段中）
+        streampos endPos = output->tellp();
+        string fields;
+        putU32(fields, entry.info.crc32);
+        if (!entry.zip64) {
+            putU32(fields, static_cast<uint32_t>(entry.info.compressedSize));
+            putU32(fields, static_cast<uint32_t>(entry.info.uncompressedSize));
+        }
+        output->seekp(static_cast<streamoff>(entry.info.localHeaderOffset + 14));
+        output->write(fields.data(), static_cast<streamsize>(fields.size()));
+        if (entry.zip64) {
+            string sizes;
+            putU64(sizes, entry.info.uncompressedSize);
+            putU64(sizes, entry.info.compressedSize);
+            output->seekp(static_cast<streamoff>(entry.info.localHeaderOffset + 30 + entry.info.name.size() + 4));
+            output->write(sizes.data(), static_cast<streamsize>(sizes.size()));
+        }
+        output->seekp(endPos);
+
+        if (!output->good()) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "写入ZIP文件失败");
+        }
+
+        written.push_back(entry.info);
+        return ok();
+    }
+
+    ZipResult ZipWriter::addEntry(const string& name, const char* data, size_t size, bool compress) {
+        if (!isOpen()) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "ZIP文件未打开");
+        }
+
+        ZipResult result = flushQueue(0);
+        if (!result.success()) {
+            return result;
+        }
+
+        // 内存数据可以预先压缩，压缩无收益时改为存储
+        vector<DeflatedChunk> chunks;
+        if (compress && size > 0) {
+            auto ranges = chunkRanges(size);
+            for (size_t i = 0; i < ranges.size(); ++i) {
+                size_t dictSize = min<size_t>(ranges[i].first, 32768);
+                chunks.push_back(deflateChunk(data + ranges[i].first, ranges[i].second, dictSize,
+                                              i + 1 == ranges.size(), compressionLevel));
+            }
+        }
+
+        return writeEntryData(name, data, size, chunks);
+    }
+
+    ZipResult ZipWriter::addEntry(const string& name, string&& content, bool compress) {
+        if (!isOpen()) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "ZIP文件未打开");
+        }
+        // 线程池在第一个需要压缩的条目到来时才创建，没有修改条目的书不启动压缩线程
+        if (!pool && compress && !content.empty() && poolThreads > 1) {
+            pool.reset(new ThreadPool(poolThreads));
+        }
+        if (!pool) {
+            return addEntry(name, content.data(), content.size(), compress);
+        }
+
+        // 数据块在线程池中压缩，写出顺序由队列决定，与线程数无关
+        auto item = make_unique<QueuedEntry>();
+        item->name = name;
+        item->content = make_shared<const string>(std::move(content));
+        if (compress && !item->content->empty()) {
+            auto ranges = chunkRanges(item->content->size());
+            for (size_t i = 0; i < ranges.size(); ++i) {
+                auto shared = item->content;
+                size_t begin = ranges[i].first;
+                size_t length = ranges[i].second;
+                size_t dictSize = min<size_t>(begin, 32768);
+                bool last = i + 1 == ranges.size();
+                int level = compressionLevel;
+                item->chunks.push_back(pool->submit([shared, begin, length, dictSize, last, level]() {
+                    return deflateChunk(shared->data() + begin, length, dictSize, last, level);
+                }));
+            }
+        }
+        queue.push_back(std::move(item));
+
+        // 限制排队条目数，避免整本书的内容同时驻留内存
+        return flushQueue(pool->size() * 4);
+    }
+
+    PrecompressedEntry ZipWriter::precompress(string&& content, bool compress, int level, size_t chunkSize) {
+        PrecompressedEntry entry;
+        entry.content = std::move(content);
+        entry.size = entry.content.size();
+        if (!compress || entry.content.empty()) {
+            entry.crc32 = updateCRC32(0, entry.content.data(), entry.content.size());
+            return entry;
+        }
+
+        // 各块独立压缩后拼接，CRC32按块合并，结果与addEntry逐块压缩相同
+        uLong crc = 0;
+        auto ranges = chunkRanges(entry.content.size(), chunkSize);
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            size_t dictSize = min<size_t>(ranges[i].first, 32768);
+            DeflatedChunk chunk = deflateChunk(entry.content.data() + ranges[i].first, ranges[i].second, dictSize,
+                                               i + 1 == ranges.size(), level);
+            if (!chunk.ok) {
+                entry.ok = false;
+                return entry;
+            }
+            entry.deflated += chunk.data;
+            crc = crc32_combine(crc, chunk.crc, static_cast<z_off_t>(chunk.size));
+        }
+        entry.crc32 = static_cast<uint32_t>(crc);
+
+        // 在这里决定是否退回存储方式，只保留要写出的那一份数据
+        if (entry.deflated.size() >= entry.content.size()) {
+            string().swap(entry.deflated);
+        } else {
+            string().swap(entry.content);
+            entry.compressed = true;
+        }
+        return entry;
+    }
+
+    ZipResult ZipWriter::addPrecompressed(const string& name, PrecompressedEntry&& entry) {
+        if (!isOpen()) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "ZIP文件未打开");
+        }
+        if (!entry.ok) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "deflate压缩失败: " + name);
+        }
+
+        ZipResult result = flushQueue(0);
+        if (!result.success()) {
+            return result;
+        }
+
+        if (!entry.compressed) {
+            return writeEntryData(name, entry.content.data(), entry.content.size(), {});
+        }
+        vector<DeflatedChunk> chunks(1);
+        chunks[0].data = std::move(entry.deflated);
+        chunks[0].crc = entry.crc32;
+        chunks[0].size = entry.size;
+        chunks[0].ok = true;
+        return writeEntryData(name, nullptr, entry.size, chunks);
+    }
+
+    ZipResult ZipWriter::flushQueue(size_t keep) {
+        if (!queueError.success()) {
+            return queueError;
+        }
+        while (queue.size() > keep) {
+            unique_ptr<QueuedEntry> item = std::move(queue.front());
+            queue.pop_front();
+
+            ZipResult result;
+            if (item->raw) {
+                result = writeRawEntry(item->rawInfo, item->rawData);
+            } else {
+                vector<DeflatedChunk> chunks;
+                chunks.reserve(item->chunks.size());
+                for (auto& chunk : item->chunks) {
+                    chunks.push_back(chunk.get());
+                }
+                result = writeEntryData(item->name, item->content->data(), item->content->size(), chunks);
+            }
+
+            if (!result.success()) {
+                queue.clear();
+                queueError = result;
+                return result;
+            }
+        }
+        return ok();
+    }
+
+    ZipResult ZipWriter::writeEntryData(const string& name, const char* data, size_t size,
+                                        const vector<DeflatedChunk>& chunks) {
+        if (streaming) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "流式条目尚未完成");
+        }
+
+        uint16_t method = chunks.empty() ? METHOD_STORED : METHOD_DEFLATED;
+        uint64_t compressedSize = 0;
+        uLong crc = 0;
+        for (const auto& chunk : chunks) {
+            if (!chunk.ok) {
+                return makeError(ZipStatus::UNKNOWN_ERROR, "deflate压缩失败: " + name);
+            }
+            compressedSize += chunk.data.size();
+            crc = crc32_combine(crc, chunk.crc, static_cast<z_off_t>(chunk.size));
+        }
+        if (method == METHOD_DEFLATED && compressedSize >= size) {
+            method = METHOD_STORED;
+        }
+        if (chunks.empty()) {
+            crc = updateCRC32(static_cast<uint32_t>(crc), data, size);
+        }
+
+        uint64_t offset = static_cast<uint64_t>(output->tellp());
+
+        ZipEntry info;
+        info.name = name;
+        info.method = method;
+        info.flags = FLAG_UTF8_NAME;
+        info.modTime = dosTime;
+        info.modDate = dosDate;
+        info.crc32 = static_cast<uint32_t>(crc);
+        info.uncompressedSize = size;
+        info.compressedSize = (method == METHOD_DEFLATED) ? compressedSize : size;
+        info.localHeaderOffset = offset;
+
+        string header = buildLocalHeader(info, needsZip64(info));
+        output->write(header.data(), static_cast<streamsize>(header.size()));
+        if (method == METHOD_DEFLATED) {
+            for (const auto& chunk : chunks) {
+                output->write(chunk.data.data(), static_cast<streamsize>(chunk.data.size()));
+            }
+        } else if (size > 0) {
+            output->write(data, static_cast<streamsize>(size));
+        }
+
+        if (!output->good()) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "写入ZIP文件失败");
+        }
+
+        written.push_back(std::move(info));
+        return ok();
+    }
+
+    ZipResult ZipWriter::addFile(const string& name, const fs::path& sourcePath, bool compress) {
+        ZipResult result = flushQueue(0);
+        if (!result.success()) {
+            return result;
+        }
+
+        ifstream input(sourcePath, ios::binary);
+        if (!input.is_open()) {
+            return makeError(ZipStatus::FILE_NOT_FOUND, "无法打开文件: " + sourcePath.string());
+        }
+
+        bool zip64 = FileUtils::getFileSize(sourcePath) >= ZIP64_STREAM_THRESHOLD;
+        PendingEntry entry;
+        result = beginEntry(name, compress ? METHOD_DEFLATED : METHOD_STORED, zip64, entry);
+        if (!result.success()) {
+            return result;
+        }
+
+        // 分块读取并压缩，CRC32在流式处理中同步计算
+        vector<char> chunk(STREAM_CHUNK_SIZE);
+        bool done = false;
+        while (!done) {
+            input.read(chunk.data(), static_cast<streamsize>(chunk.size()));
+            size_t got = static_cast<size_t>(input.gcount());
+            done = input.eof() || got == 0;
+            if (input.bad()) {
+                result = makeError(ZipStatus::UNKNOWN_ERROR, "读取文件失败: " + sourcePath.string());
+                break;
+            }
+            result = writeChunk(entry, chunk.data(), got, done);
+            if (!result.success()) {
+                break;
+            }
+        }
+
+        if (!result.success()) {
+            return result;
+        }
+
+        return finishEntry(entry);
+    }
+
+    ZipResult ZipWriter::beginStream(const string& name, uint64_t sizeHint, bool compress) {
+        if (streaming) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "上一个流式条目尚未完成");
+        }
+
+        ZipResult result = flushQueue(0);
+        if (!result.success()) {
+            return result;
+        }
+
+        auto entry = make_unique<PendingEntry>();
+        result = beginEntry(name, compress ? METHOD_DEFLATED : METHOD_STORED,
+                            sizeHint >= ZIP64_STREAM_THRESHOLD, *entry);
+        if (!result.success()) {
+            return result;
+        }
+
+        streaming = std::move(entry);
+        return ok();
+    }
+
+    ZipResult ZipWriter::writeStream(const char* data, size_t size) {
+        if (!streaming) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "没有正在写入的流式条目");
+        }
+        if (size == 0) {
+            return ok();
+        }
+        return writeChunk(*streaming, data, size, false);
+    }
+
+    ZipResult ZipWriter::finishStream() {
+        if (!streaming) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "没有正在写入的流式条目");
+        }
+
+        unique_ptr<PendingEntry> entry = std::move(streaming);
+        ZipResult result = writeChunk(*entry, "", 0, true);
+        if (!result.success()) {
+            return result;
+        }
+        return finishEntry(*entry);
+    }
+
+    ZipResult ZipWriter::addRawEntry(const ZipEntry& source, const unsigned char* compressedData) {
+        if (!isOpen()) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "ZIP文件未打开");
+        }
+        if (queue.empty()) {
+            ZipResult result = flushQueue(0);
+            return result.success() ? writeRawEntry(source, compressedData) : result;
+        }
+
+        // 排在后台压缩的条目之后，保持添加顺序
+        auto item = make_unique<QueuedEntry>();
+        item->raw = true;
+        item->rawInfo = source;
+        item->rawData = compressedData;
+        queue.push_back(std::move(item));
+        return flushQueue(pool ? pool->size() * 4 : 0);
+    }
+
+    ZipResult ZipWriter::writeRawEntry(const ZipEntry& source, const unsigned char* compressedData) {
+        if (streaming) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "流式条目尚未完成");
+        }
+
+        uint64_t offset = static_cast<uint64_t>(output->tellp());
+
+        // 保留原条目的方法、CRC32、时间和属性；大小已写入本地头，因此去掉数据描述符标志
+        ZipEntry info = source;
+        info.flags = static_cast<uint16_t>(source.flags & ~0x0008);
+        info.localHeaderOffset = offset;
+
+        string header = buildLocalHeader(info, needsZip64(info));
+        output->write(header.data(), static_cast<streamsize>(header.size()));
+        if (info.compressedSize > 0) {
+            output->write(reinterpret_cast<const char*>(compressedData),
+                         static_cast<streamsize>(info.compressedSize));
+        }
+
+        if (!output->good()) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "写入ZIP文件失败");
+        }
+
+        written.push_back(std::move(info));
+        return ok();
+    }
+
+    ZipResult ZipWriter::addDirectory(const string& name) {
+        string dirName = name;
+        if (dirName.empty() || dirName.back() != '/') {
+            dirName += '/';
+        }
+
+        ZipResult result = addEntry(dirName, nullptr, 0, false);
+        if (result.success()) {
+            written.back().externalAttributes = DOS_DIRECTORY_ATTRIBUTE;
+        }
+        return result;
+    }
+
+    ZipResult ZipWriter::close() {
+        if (!isOpen()) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "ZIP文件未打开");
+        }
+
+        if (streaming) {
+            abort();
+            return makeError(ZipStatus::UNKNOWN_ERROR, "流式条目尚未完成");
+        }
+
+        ZipResult result = flushQueue(0);
+        if (!result.success()) {
+            abort();
+            return result;
+        }
+
+        uint64_t centralDirOffset = static_cast<uint64_t>(output->tellp());
+
+        string directory;
+        for (const auto& entry : written) {
+            // 超出32位范围的字段按规范顺序写入ZIP64扩展字段
+            string extra;
+            if (entry.uncompressedSize >= MAX_32BIT_VALUE) putU64(extra, entry.uncompressedSize);
+            if (entry.compressedSize >= MAX_32BIT_VALUE) putU64(extra, entry.compressedSize);
+            if (entry.localHeaderOffset >= MAX_32BIT_VALUE) putU64(extra, entry.localHeaderOffset);
+            uint16_t version = extra.empty() ? VERSION_NEEDED : VERSION_NEEDED_ZIP64;
+
+            putU32(directory, CENTRAL_HEADER_SIGNATURE);
+            putU16(directory, version);            // 创建版本
+            putU16(directory, version);            // 所需版本
+            putU16(directory, entry.flags);
+            putU16(directory, entry.method);
+            putU16(directory, entry.modTime);
+            putU16(directory, entry.modDate);
+            putU32(directory, entry.crc32);
+            putU32(directory, clamp32(entry.compressedSize));
+            putU32(directory, clamp32(entry.uncompressedSize));
+            putU16(directory, static_cast<uint16_t>(entry.name.size()));
+            putU16(directory, static_cast<uint16_t>(extra.empty() ? 0 : extra.size() + 4));
+            putU16(directory, 0);                  // 注释长度
+            putU16(directory, 0);                  // 起始磁盘号
+            putU16(directory, 0);                  // 内部属性
+            putU32(directory, entry.externalAttributes);
+            putU32(directory, clamp32(entry.localHeaderOffset));
+            directory += entry.name;
+            if (!extra.empty()) {
+                putU16(directory, ZIP64_EXTRA_ID);
+                putU16(directory, static_cast<uint16_t>(extra.size()));
+                directory += extra;
+            }
+        }
+
+        uint64_t centralDirSize = directory.size();
+        uint64_t entryCount = written.size();
+
+        // 条目数、目录大小或偏移超出范围时写入ZIP64结束记录和定位器
+        if (entryCount >= MAX_16BIT_VALUE || centralDirSize >= MAX_32BIT_VALUE ||
+            centralDirOffset >= MAX_32BIT_VALUE) {
+            uint64_t zip64Offset = centralDirOffset + centralDirSize;
+            putU32(directory, ZIP64_END_OF_CENTRAL_DIR_SIGNATURE);
+            putU64(directory, 44);                 // 记录剩余部分的大小
+            putU16(directory, VERSION_NEEDED_ZIP64);
+            putU16(directory, VERSION_NEEDED_ZIP64);
+            putU32(directory, 0);                  // 磁盘号
+            putU32(directory, 0);                  // 中央目录起始磁盘号
+            putU64(directory, entryCount);
+            putU64(directory, entryCount);
+            putU64(directory, centralDirSize);
+            putU64(directory, centralDirOffset);
+
+            putU32(directory, ZIP64_LOCATOR_SIGNATURE);
+            putU32(directory, 0);
+            putU64(directory, zip64Offset);
+            putU32(directory, 1);                  // 磁盘总数
+        }
+
+        // 中央目录结束记录
+        uint16_t shortCount = static_cast<uint16_t>(min(entryCount, MAX_16BIT_VALUE));
+        putU32(directory, END_OF_CENTRAL_DIR_SIGNATURE);
+        putU16(directory, 0);
+        putU16(directory, 0);
+        putU16(directory, shortCount);
+        putU16(directory, shortCount);
+        putU32(directory, clamp32(centralDirSize));
+        putU32(directory, clamp32(centralDirOffset));
+        putU16(directory, 0);
+
+        output->write(directory.data(), static_cast<streamsize>(directory.size()));
+        bool failed = output->fail();
+        output = nullptr;
+        written.clear();
+
+        if (fileOutput.is_open()) {
+            fileOutput.close();
+            failed = failed || fileOutput.fail();
+            if (failed) {
+                FileUtils::removeFile(outputPath);
+            }
+        }
+
+        if (failed) {
+            return makeError(ZipStatus::UNKNOWN_ERROR, "写入ZIP文件失败: " + outputPath.string());
+        }
+
+        return {ZipStatus::SUCCESS, "压缩成功", 0};
+    }
+
+    void ZipWriter::abort() {
+        output = nullptr;
+        written.clear();
+        queue.clear();
+        streaming.reset();
+        memoryBuffer.reset();
+        if (fileOutput.is_open()) {
+            fileOutput.close();
+            if (!outputPath.empty()) {
+                FileUtils::removeFile(outputPath);
+            }
+        }
+    }
+
+    namespace Platform {
+        ZipResult createZipNative(const fs::path& sourceDir, const fs::path& zipPath) {
+            // 收集并排序文件，保证输出确定
+            vector<fs::path> paths;
+            try {
+                for (const auto& item : fs::recursive_directory_iterator(sourceDir)) {
+                    if (item.is_regular_file() || item.is_directory()) {
+                        paths.push_back(item.path());
+                    }
+                }
+            } catch (const fs::filesystem_error& e) {
+                return makeError(ZipStatus::DIRECTORY_NOT_FOUND, string("遍历目录失败: ") + e.what());
+            }
+            sort(paths.begin(), paths.end());
+
+            ZipWriter writer;
+            ZipResult result = writer.open(zipPath);
+            if (!result.success()) {
+                return result;
+            }
+
+            // EPUB OCF规范要求mimetype为第一个条目且不压缩
+            fs::path mimetypePath = sourceDir / "mimetype";
+            bool hasMimetype = FileUtils::fileExists(mimetypePath);
+            if (hasMimetype) {
+                result = writer.addFile("mimetype", mimetypePath, false);
+                if (!result.success()) {
+                    writer.abort();
+                    return result;
+                }
+            }
+
+            for (const auto& path : paths) {
+                string name = fs::relative(path, sourceDir).generic_u8string();
+                if (hasMimetype && name == "mimetype") {
+                    continue;
+                }
+
+                if (fs::is_directory(path)) {
+                    result = writer.addDirectory(name);
+                } else {
+                    result = writer.addFile(name, path, true);
+                }
+
+                if (!result.success()) {
+                    writer.abort();
+                    return result;
+                }
+            }
+
+            return writer.close();
+        }
+    }
+}
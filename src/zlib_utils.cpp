@@ -6,81 +6,434 @@
 #include <vector>
 #include <string>
 #include <cstring>
+#include <algorithm>
 
 using namespace std;
 
 namespace ZipUtils {
     
-    // 使用zlib进行简单的数据压缩/解压缩
-    // 注意：这些函数处理原始数据，不处理ZIP文件格式
+    // ==================== 池化的zlib流 ====================
+    
+    struct CodecStream {
+        z_stream zs;
+        bool deflating = false;
+        int level = Z_DEFAULT_COMPRESSION;
+        StreamFormat format = StreamFormat::RAW;
+    };
+    
+    namespace {
+        // avail_in/avail_out为uInt，单次调用最多提供1GB
+        const size_t MAX_WINDOW = 0x40000000;
+        
+        // 每个线程缓存的空闲流数量上限
+        const size_t MAX_POOLED_STREAMS = 8;
+        
+        const size_t WRITE_STEP = 64 * 1024;
+        
+        int windowBits(StreamFormat format) {
+            return format == StreamFormat::RAW ? -MAX_WBITS : MAX_WBITS;
+        }
+        
+        void destroyStream(CodecStream* stream) {
+            if (stream->deflating) {
+                deflateEnd(&stream->zs);
+            } else {
+                inflateEnd(&stream->zs);
+            }
+            delete stream;
+        }
+        
+        // 每线程的空闲流缓存；线程结束时释放
+        struct StreamPool {
+            vector<CodecStream*> idle;
+            
+            ~StreamPool() {
+                for (CodecStream* stream : idle) {
+                    destroyStream(stream);
+                }
+            }
+        };
+        
+        StreamPool& localPool() {
+            thread_local StreamPool pool;
+            return pool;
+        }
+        
+        CodecStream* acquireStream(bool deflating, int level, StreamFormat format) {
+            auto& idle = localPool().idle;
+            for (size_t i = idle.size(); i-- > 0;) {
+                CodecStream* stream = idle[i];
+                if (stream->deflating == deflating && stream->format == format &&
+                    (!deflating || stream->level == level)) {
+                    idle.erase(idle.begin() + static_cast<ptrdiff_t>(i));
+                    return stream;
+                }
+            }
+            
+            CodecStream* stream = new CodecStream;
+            memset(&stream->zs, 0, sizeof(stream->zs));
+            stream->deflating = deflating;
+            stream->level = level;
+            stream->format = format;
+            int ret = deflating
+                ? deflateInit2(&stream->zs, level, Z_DEFLATED, windowBits(format), 8, Z_DEFAULT_STRATEGY)
+                : inflateInit2(&stream->zs, windowBits(format));
+            if (ret != Z_OK) {
+                delete stream;
+                return nullptr;
+            }
+            return stream;
+        }
+        
+        // 复位后放回当前线程的缓存池（可以在与获取时不同的线程上归还）
+        void releaseStream(CodecStream* stream) {
+            if (!stream) {
+                return;
+            }
+            int ret = stream->deflating ? deflateReset(&stream->zs) : inflateReset(&stream->zs);
+            auto& idle = localPool().idle;
+            if (ret != Z_OK || idle.size() >= MAX_POOLED_STREAMS) {
+                destroyStream(stream);
+                return;
+            }
+            idle.push_back(stream);
+        }
+        
+        int toZlibFlush(Deflater::Flush flush) {
+            switch (flush) {
+                case Deflater::Flush::SYNC:
+                    return Z_SYNC_FLUSH;
+                case Deflater::Flush::FINISH:
+                    return Z_FINISH;
+                default:
+                    return Z_NO_FLUSH;
+            }
+        }
+    }
+    
+    // ==================== Deflater ====================
+    
+    Deflater::Deflater(int level, StreamFormat format)
+        : stream(acquireStream(true, level, format)) {}
+    
+    Deflater::~Deflater() {
+        releaseStream(stream);
+    }
+    
+    Deflater::Deflater(Deflater&& other) noexcept : stream(other.stream) {
+        other.stream = nullptr;
+    }
+    
+    Deflater& Deflater::operator=(Deflater&& other) noexcept {
+        if (this != &other) {
+            releaseStream(stream);
+            stream = other.stream;
+            other.stream = nullptr;
+        }
+        return *this;
+    }
+    
+    CodecStatus Deflater::process(const char*& in, size_t& inSize, char*& out, size_t& outSize,
+                                  Flush flush) {
+        if (!stream) {
+            return CodecStatus::FAILED;
+        }
+        z_stream& zs = stream->zs;
+        
+        while (true) {
+            size_t inWindow = min(inSize, MAX_WINDOW);
+            size_t outWindow = min(outSize, MAX_WINDOW);
+            bool lastWindow = inWindow == inSize;
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+            zs.avail_in = static_cast<uInt>(inWindow);
+            zs.next_out = reinterpret_cast<Bytef*>(out);
+            zs.avail_out = static_cast<uInt>(outWindow);
+            
+            int ret = deflate(&zs, lastWindow ? toZlibFlush(flush) : Z_NO_FLUSH);
+            size_t consumed = inWindow - zs.avail_in;
+            size_t produced = outWindow - zs.avail_out;
+            in += consumed;
+            inSize -= consumed;
+            out += produced;
+            outSize -= produced;
+            
+            if (ret == Z_STREAM_END) {
+                return CodecStatus::STREAM_END;
+            }
+            if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                return CodecStatus::FAILED;
+            }
+            // 输出空间用尽，或输入已处理完且刷新完成，或无法继续推进
+            if (outSize == 0 || (inSize == 0 && zs.avail_out > 0) || (consumed == 0 && produced == 0)) {
+                return CodecStatus::OK;
+            }
+        }
+    }
+    
+    bool Deflater::write(const char* data, size_t size, Flush flush, string& output) {
+        const char* in = data;
+        size_t inSize = data ? size : 0;
+        while (true) {
+            size_t used = output.size();
+            size_t room = max(WRITE_STEP, min(inSize, MAX_WINDOW));
+            output.resize(used + room);
+            char* out = &output[used];
+            size_t outSize = room;
+            CodecStatus status = process(in, inSize, out, outSize, flush);
+            output.resize(used + room - outSize);
+            if (status == CodecStatus::FAILED) {
+                return false;
+            }
+            if (status == CodecStatus::STREAM_END || outSize > 0) {
+                return inSize == 0;
+            }
+        }
+    }
+    
+    bool Deflater::setDictionary(const char* data, size_t size) {
+        if (!stream || size > MAX_WINDOW) {
+            return false;
+        }
+        return deflateSetDictionary(&stream->zs, reinterpret_cast<const Bytef*>(data),
+                                    static_cast<uInt>(size)) == Z_OK;
+    }
+    
+    void Deflater::reset() {
+        if (stream) {
+            deflateReset(&stream->zs);
+        }
+    }
+    
+    size_t Deflater::bound(size_t size) const {
+        if (!stream) {
+            return compressBound(static_cast<uLong>(size));
+        }
+        return deflateBound(&stream->zs, static_cast<uLong>(size));
+    }
+    
+    uint64_t Deflater::totalIn() const {
+        return stream ? stream->zs.total_in : 0;
+    }
+    
+    uint64_t Deflater::totalOut() const {
+        return stream ? stream->zs.total_out : 0;
+    }
+    
+    // ==================== Inflater ====================
+    
+    Inflater::Inflater(StreamFormat format)
+        : stream(acquireStream(false, Z_DEFAULT_COMPRESSION, format)) {}
+    
+    Inflater::~Inflater() {
+        releaseStream(stream);
+    }
+    
+    Inflater::Inflater(Inflater&& other) noexcept : stream(other.stream) {
+        other.stream = nullptr;
+    }
+    
+    Inflater& Inflater::operator=(Inflater&& other) noexcept {
+        if (this != &other) {
+            releaseStream(stream);
+            stream = other.stream;
+            other.stream = nullptr;
+        }
+        return *this;
+    }
+    
+    CodecStatus Inflater::process(const char*& in, size_t& inSize, char*& out, size_t& outSize) {
+        if (!stream) {
+            return CodecStatus::FAILED;
+        }
+        z_stream& zs = stream->zs;
+        
+        while (true) {
+            size_t inWindow = min(inSize, MAX_WINDOW);
+            size_t outWindow = min(outSize, MAX_WINDOW);
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+            zs.avail_in = static_cast<uInt>(inWindow);
+            zs.next_out = reinterpret_cast<Bytef*>(out);
+            zs.avail_out = static_cast<uInt>(outWindow);
+            
+            int ret = inflate(&zs, Z_NO_FLUSH);
+            size_t consumed = inWindow - zs.avail_in;
+            size_t produced = outWindow - zs.avail_out;
+            in += consumed;
+            inSize -= consumed;
+            out += produced;
+            outSize -= produced;
+            
+            if (ret == Z_STREAM_END) {
+                return CodecStatus::STREAM_END;
+            }
+            if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                return CodecStatus::FAILED;
+            }
+            if (inSize == 0 || outSize == 0 || (consumed == 0 && produced == 0)) {
+                return CodecStatus::OK;
+            }
+        }
+    }
+    
+    CodecStatus Inflater::write(const char* data, size_t size, string& output) {
+        const char* in = data;
+        size_t inSize = data ? size : 0;
+        while (true) {
+            size_t used = output.size();
+            size_t room = max(WRITE_STEP, min(inSize * 2, MAX_WINDOW));
+            output.resize(used + room);
+            char* out = &output[used];
+            size_t outSize = room;
+            CodecStatus status = process(in, inSize, out, outSize);
+            output.resize(used + room - outSize);
+            // 输出空间仍有剩余说明输入已全部处理
+            if (status != CodecStatus::OK || outSize > 0) {
+                return status;
+            }
+        }
+    }
+    
+    void Inflater::reset() {
+        if (stream) {
+            inflateReset(&stream->zs);
+        }
+    }
+    
+    uint64_t Inflater::totalIn() const {
+        return stream ? stream->zs.total_in : 0;
+    }
+    
+    uint64_t Inflater::totalOut() const {
+        return stream ? stream->zs.total_out : 0;
+    }
+    
+    // ==================== 一次性接口 ====================
+    
+    // 压缩为zlib格式（与compress()输出兼容）
+    string compressString(const string& str) {
+        Deflater deflater(Z_DEFAULT_COMPRESSION, StreamFormat::ZLIB);
+        string compressed;
+        compressed.reserve(deflater.bound(str.size()));
+        if (!deflater.write(str.data(), str.size(), Deflater::Flush::FINISH, compressed)) {
+            return "";
+        }
+        return compressed;
+    }
+    
+    // 解压zlib格式数据，originalSize只用于预分配
+    string decompressString(const string& compressedStr, size_t originalSize) {
+        Inflater inflater(StreamFormat::ZLIB);
+        string decompressed;
+        decompressed.reserve(originalSize);
+        if (inflater.write(compressedStr.data(), compressedStr.size(), decompressed) !=
+            CodecStatus::STREAM_END) {
+            return "";
+        }
+        return decompressed;
+    }
     
     vector<unsigned char> compressData(const vector<unsigned char>& data) {
         vector<unsigned char> compressed;
-        
         if (data.empty()) {
             return compressed;
         }
         
-        // 计算压缩后的大小上限
-        uLongf compressed_size = compressBound(data.size());
-        compressed.resize(compressed_size);
-        
-        // 压缩数据
-        if (compress(compressed.data(), &compressed_size, 
-                     data.data(), data.size()) == Z_OK) {
-            compressed.resize(compressed_size);
-        } else {
+        Deflater deflater(Z_DEFAULT_COMPRESSION, StreamFormat::ZLIB);
+        compressed.resize(deflater.bound(data.size()));
+        const char* in = reinterpret_cast<const char*>(data.data());
+        size_t inSize = data.size();
+        char* out = reinterpret_cast<char*>(compressed.data());
+        size_t outSize = compressed.size();
+        if (deflater.process(in, inSize, out, outSize, Deflater::Flush::FINISH) != CodecStatus::STREAM_END) {
             compressed.clear();
+            return compressed;
         }
-        
+        compressed.resize(compressed.size() - outSize);
         return compressed;
     }
     
     vector<unsigned char> decompressData(const vector<unsigned char>& compressed, 
                                         size_t original_size) {
         vector<unsigned char> decompressed(original_size);
-        
         if (compressed.empty() || original_size == 0) {
             return decompressed;
         }
         
-        uLongf dest_len = original_size;
-        
-        // 解压数据
-        if (uncompress(decompressed.data(), &dest_len, 
-                       compressed.data(), compressed.size()) == Z_OK) {
-            decompressed.resize(dest_len);
-        } else {
+        Inflater inflater(StreamFormat::ZLIB);
+        const char* in = reinterpret_cast<const char*>(compressed.data());
+        size_t inSize = compressed.size();
+        char* out = reinterpret_cast<char*>(decompressed.data());
+        size_t outSize = decompressed.size();
+        if (inflater.process(in, inSize, out, outSize) != CodecStatus::STREAM_END) {
             decompressed.clear();
+            return decompressed;
         }
-        
+        decompressed.resize(decompressed.size() - outSize);
         return decompressed;
     }
     
-    // 压缩字符串
-    string compressString(const string& str) {
-        vector<unsigned char> data(str.begin(), str.end());
-        vector<unsigned char> compressed = compressData(data);
-        
-        if (compressed.empty()) {
-            return "";
+    // 解压原始deflate数据（ZIP条目格式，无zlib头和校验）
+    bool inflateRaw(const unsigned char* data, size_t size,
+                    string& output, uint64_t expectedSize) {
+        // 声明的大小来自归档，不可信：deflate的压缩比最大约为1032:1，初始缓冲区
+        // 不超过输入可能展开的大小，之后随解压增大，但不超过声明的大小
+        uint64_t inflateBound = static_cast<uint64_t>(size) * 1032 + 64;
+        output.clear();
+        output.resize(static_cast<size_t>(min(expectedSize, inflateBound)));
+
+        Inflater inflater(StreamFormat::RAW);
+        const char* in = reinterpret_cast<const char*>(data);
+        size_t inSize = size;
+        size_t produced = 0;
+        CodecStatus status = CodecStatus::OK;
+        while (status == CodecStatus::OK) {
+            if (produced == output.size()) {
+                if (output.size() < expectedSize) {
+                    uint64_t grown = max<uint64_t>(output.size() * 2, output.size() + 64 * 1024);
+                    output.resize(static_cast<size_t>(min(expectedSize, grown)));
+                    continue;
+                }
+                // 已达到声明的大小，再确认剩余数据只是流结束标记
+                char probe = 0;
+                char* probeOut = &probe;
+                size_t probeSize = 1;
+                status = inflater.process(in, inSize, probeOut, probeSize);
+                if (probeSize == 0) {
+                    status = CodecStatus::FAILED;
+                }
+                break;
+            }
+
+            char* out = &output[produced];
+            size_t room = output.size() - produced;
+            status = inflater.process(in, inSize, out, room);
+            produced = output.size() - room;
+            // 输出仍有空间却没有结束：输入不完整
+            if (status == CodecStatus::OK && room > 0) {
+                status = CodecStatus::FAILED;
+            }
         }
-        
-        return string(compressed.begin(), compressed.end());
+
+        if (status != CodecStatus::STREAM_END || produced != expectedSize) {
+            output.clear();
+            return false;
+        }
+
+        return true;
     }
-    
-    // 解压字符串
-    string decompressString(const string& compressed_str, size_t original_size) {
-        vector<unsigned char> compressed(compressed_str.begin(), compressed_str.end());
-        vector<unsigned char> decompressed = decompressData(compressed, original_size);
-        
-        if (decompressed.empty()) {
-            return "";
+
+    uint32_t updateCRC32(uint32_t crc, const void* data, size_t size) {
+        const Bytef* bytes = static_cast<const Bytef*>(data);
+        uLong value = crc;
+        while (size > 0) {
+            uInt piece = static_cast<uInt>(min<size_t>(size, 0x40000000));
+            value = crc32(value, bytes, piece);
+            bytes += piece;
+            size -= piece;
         }
-        
-        return string(decompressed.begin(), decompressed.end());
+        return static_cast<uint32_t>(value);
     }
-    
+
     // 计算数据的CRC32校验和
     uint32_t calculateCRC32(const vector<unsigned char>& data) {
         if (data.empty()) {
@@ -0,0 +1,121 @@
+// 批量处理基准：大小悬殊的书混在一起时，对比逐本串行处理与并行处理
+// （工作窃取线程池，最大的书最先开始）的总耗时
+//
+// 用法: bench_batch [线程数] [大书章节数] [小书数量]
+//   线程数为0时使用硬件并发数
+
+#include "epub_processor.h"
+#include "file_utils.h"
+#include "thread_pool.h"
+#include "zip_utils.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+
+#ifdef HAVE_ZLIB
+
+// 生成一章内容：正文段落中夹杂广告
+static string makeChapter(size_t paragraphs, size_t seed) {
+    string chapter = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<html><body>\n";
+    for (size_t i = 0; i < paragraphs; ++i) {
+        chapter += "<p>第" + to_string(seed) + "章的第" + to_string(i) + "段正文，内容只用于测试批量处理的耗时。</p>\n";
+        if ((i + seed) % 40 == 0) {
+            chapter += "<p>【本书由某某网站整理下载】</p>\n";
+        }
+    }
+    chapter += "</body></html>\n";
+    return chapter;
+}
+
+static bool writeBook(const fs::path& path, size_t chapters, size_t paragraphs) {
+    ZipUtils::ZipWriter writer;
+    if (!writer.open(path).success()) {
+        return false;
+    }
+    string mimetype = "application/epub+zip";
+    if (!writer.addEntry("mimetype", mimetype.data(), mimetype.size(), false).success()) {
+        return false;
+    }
+    for (size_t c = 0; c < chapters; ++c) {
+        string chapter = makeChapter(paragraphs, c);
+        if (!writer.addEntry("OEBPS/ch" + to_string(c) + ".xhtml", chapter.data(), chapter.size()).success()) {
+            return false;
+        }
+    }
+    return writer.close().success();
+}
+
+// 处理整个目录，返回耗时(ms)
+static double runBatch(const fs::path& inputDir, size_t jobs, EpubProcessor::ProcessingMode mode, int& adsRemoved) {
+    FileUtils::TempDirectory outputDir("bench_batch_out_");
+    EpubProcessor processor(false, false);
+    processor.setProcessingMode(mode);
+    processor.setJobs(jobs);
+    
+    auto begin = chrono::steady_clock::now();
+    bool success = processor.processDirectory(inputDir, outputDir.getPath());
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+    if (!success) {
+        cerr << "错误: 批量处理失败" << endl;
+        exit(1);
+    }
+    adsRemoved = processor.getStats().adsRemoved;
+    return ms;
+}
+
+int main(int argc, char* argv[]) {
+    size_t jobs = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 0;
+    size_t largeChapters = argc > 2 ? static_cast<size_t>(atoi(argv[2])) : 600;
+    size_t smallBooks = argc > 3 ? static_cast<size_t>(atoi(argv[3])) : 40;
+    jobs = ThreadPool::resolveThreadCount(jobs);
+    
+    // 一本大书和许多小书：大书按文件名排在最后，逐本分配时它会成为批次末尾唯一在处理的书
+    FileUtils::TempDirectory inputDir("bench_batch_in_");
+    for (size_t i = 0; i < smallBooks; ++i) {
+        if (!writeBook(inputDir.getPath() / ("a_small_" + to_string(i) + ".epub"), 10, 100)) {
+            cerr << "错误: 无法生成测试书籍" << endl;
+            return 1;
+        }
+    }
+    if (!writeBook(inputDir.getPath() / "z_large.epub", largeChapters, 400)) {
+        cerr << "错误: 无法生成测试书籍" << endl;
+        return 1;
+    }
+    
+    cout << "批量处理基准: " << smallBooks << " 本小书 + 1 本 " << largeChapters << " 章的大书, "
+         << jobs << " 个线程" << endl;
+    
+    struct ModeInfo {
+        const char* name;
+        EpubProcessor::ProcessingMode mode;
+    };
+    for (const ModeInfo& info : {ModeInfo{"extract", EpubProcessor::ProcessingMode::EXTRACT},
+                                 ModeInfo{"rewrite", EpubProcessor::ProcessingMode::REWRITE}}) {
+        int serialAds = 0;
+        int parallelAds = 0;
+        double serial = runBatch(inputDir.getPath(), 1, info.mode, serialAds);
+        double parallel = runBatch(inputDir.getPath(), jobs, info.mode, parallelAds);
+        if (serialAds != parallelAds) {
+            cerr << "错误: 串行与并行移除的广告数不一致" << endl;
+            return 1;
+        }
+        cout << fixed << setprecision(1)
+             << "  " << info.name << ": 串行 " << serial << " ms, 并行 " << parallel << " ms, 加速 "
+             << setprecision(2) << serial / parallel << "x (移除广告 " << parallelAds << " 处)" << endl;
+    }
+    return 0;
+}
+
+#else
+
+int main() {
+    cerr << "批量处理基准需要ZLIB支持" << endl;
+    return 1;
+}
+
+#endif
@@ -1,11 +1,27 @@
 #include "file_utils.h"
 #include "ad_patterns.h"
+#include "pattern_engine.h"
+#include "simd_scan.h"
 #include "zip_utils.h"
 #include "logger.h"
+#include "epub_processor.h"
+#include "thread_pool.h"
+#include "bounded_queue.h"
+#include "async_io.h"
 #include <iostream>
 #include <string>
 #include <vector>
 #include <cassert>
+#include <fstream>
+#include <regex>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <chrono>
+#include <sstream>
 
 using namespace std;
 
@@ -43,6 +59,35 @@ void testFileUtils() {
     cout << "✓ 清理测试文件" << endl;
 }
 
+// 测试只读文件映射
+void testMappedFile() {
+    cout << "\n=== 测试文件映射 ===" << endl;
+    
+    FileUtils::TempDirectory tempDir("test_mapped_");
+    assert(tempDir.isValid());
+    
+    fs::path dataPath = tempDir.getPath() / "data.bin";
+    string payload(100000, 'a');
+    payload[99999] = 'z';
+    ofstream(dataPath, ios::binary) << payload;
+    
+    FileUtils::MappedFile mapped;
+    assert(mapped.open(dataPath));
+    assert(mapped.size() == payload.size());
+    assert(string(reinterpret_cast<const char*>(mapped.data()), mapped.size()) == payload);
+    cout << "✓ 映射文件内容一致" << (mapped.isMapped() ? " (mmap)" : " (缓冲读取)") << endl;
+    
+    // 空文件无法映射，回退到缓冲读取
+    fs::path emptyPath = tempDir.getPath() / "empty.bin";
+    ofstream(emptyPath, ios::binary).close();
+    FileUtils::MappedFile empty;
+    assert(empty.open(emptyPath));
+    assert(!empty.isMapped() && empty.size() == 0);
+    
+    assert(!FileUtils::MappedFile().open(tempDir.getPath() / "missing.bin"));
+    cout << "✓ 空文件和不存在的文件" << endl;
+}
+
 // 测试广告模式
 void testAdPatterns() {
     cout << "\n=== 测试广告模式 ===" << endl;
@@ -71,6 +116,1470 @@ void testAdPatterns() {
     cout << "✓ 广告检测" << endl;
 }
 
+// 测试单次扫描的模式集合
+void testPatternSet() {
+    cout << "\n=== 测试模式集合 ===" << endl;
+    
+    AdPatterns::PatternSet set({regex("bc"), regex("abcd"), regex("b"), regex("x*")});
+    auto matches = set.findAll("xabcdbcb");
+    // 位置0的"x"只能被x*匹配；位置1起abcd最靠左；其后bc优先于同起点的b
+    assert(matches.size() == 4);
+    assert(matches[0].offset == 0 && matches[0].length == 1 && matches[0].patternIndex == 3);
+    assert(matches[1].offset == 1 && matches[1].length == 4 && matches[1].patternIndex == 1);
+    assert(matches[2].offset == 5 && matches[2].length == 2 && matches[2].patternIndex == 0);
+    assert(matches[3].offset == 7 && matches[3].length == 1 && matches[3].patternIndex == 2);
+    cout << "✓ 最左优先，同起点按模式顺序" << endl;
+    
+    assert(AdPatterns::PatternSet::removeMatches("xabcdbcb!", matches) == "!");
+    assert(set.findAll("nothing").empty());
+    cout << "✓ 一次复制删除所有匹配，空匹配不计" << endl;
+    
+    // 同一模式的多处匹配分别计数
+    AdPatterns::PatternMatcher matcher;
+    matcher.addPattern("\\[AD\\]");
+    assert(matcher.cleanContent("a[AD]b[AD]c[ad]") == "abc");
+    assert(matcher.getMatchStats().totalMatches == 3);
+    cout << "✓ 按实际匹配数统计" << endl;
+}
+
+static unsigned nextRandom(unsigned& seed, unsigned bound) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % bound;
+}
+
+// 随机生成DFA引擎支持的语法组合：字符、字符类、断言、非捕获分组、选择和（非贪婪）重复
+static string randomPattern(unsigned& seed, int depth) {
+    static const vector<string> atoms = {"a", "b", "c", " ", "[ab]", "[^a]", ".", "\\b", "\\B", "^", "$"};
+    static const vector<string> quantifiers = {"*", "+", "?", "{0,2}", "{1,2}", "{2}", "{1,}"};
+    string result;
+    size_t items = 1 + nextRandom(seed, 3);
+    for (size_t i = 0; i < items; ++i) {
+        string item;
+        if (depth < 2 && nextRandom(seed, 3) == 0) {
+            item = "(?:" + randomPattern(seed, depth + 1);
+            while (nextRandom(seed, 3) == 0) {
+                item += "|" + randomPattern(seed, depth + 1);
+            }
+            item += ")";
+        } else {
+            item = atoms[nextRandom(seed, static_cast<unsigned>(atoms.size()))];
+        }
+        bool assertion = item == "\\b" || item == "\\B" || item == "^" || item == "$";
+        if (!assertion && nextRandom(seed, 2) == 0) {
+            item += quantifiers[nextRandom(seed, static_cast<unsigned>(quantifiers.size()))];
+            if (nextRandom(seed, 3) == 0) {
+                item += "?";
+            }
+        }
+        result += item;
+    }
+    return result;
+}
+
+// 测试DFA正则表达式引擎
+void testPatternEngine() {
+    cout << "\n=== 测试DFA正则表达式引擎 ===" << endl;
+    
+    // 与std::regex对比：同一起点上的贪婪/非贪婪和选择顺序必须一致
+    vector<string> patterns = {"a+b", "(a|ab)(c|bcd)", "a*?b", "[^b]*b", "\\bab\\b", "(ab|a)*c",
+                               "^a", "b$", "a{2,3}", "(?:a|b)+?c", "\\w+ \\w+", "ab|abc|c", "a.c"};
+    const string alphabet = "ab c";
+    unsigned seed = 12345;
+    for (const auto& pattern : patterns) {
+        string error;
+        auto dfa = PatternEngine::Regex::compile(pattern, false, error);
+        assert(dfa && error.empty());
+        regex reference(pattern);
+        for (int round = 0; round < 500; ++round) {
+            string text;
+            seed = seed * 1103515245 + 12345;
+            size_t length = (seed >> 16) % 12;
+            for (size_t i = 0; i < length; ++i) {
+                seed = seed * 1103515245 + 12345;
+                text += alphabet[(seed >> 16) % alphabet.size()];
+            }
+            smatch expected;
+            bool found = regex_search(text, expected, reference, regex_constants::match_not_null);
+            size_t start = 0;
+            size_t end = 0;
+            assert(dfa->search(text.data(), text.size(), 0, text.size(), false, start, end) == found);
+            if (found) {
+                assert(start == static_cast<size_t>(expected.position(0)));
+                assert(end - start == static_cast<size_t>(expected.length(0)));
+            }
+        }
+    }
+    cout << "✓ 匹配位置与std::regex一致" << endl;
+    
+    // 随机模式的差分测试：DFA接受的模式在随机文本上必须与std::regex给出相同的匹配
+    size_t accepted = 0;
+    for (int round = 0; round < 400; ++round) {
+        string pattern = randomPattern(seed, 0);
+        string error;
+        auto dfa = PatternEngine::Regex::compile(pattern, false, error);
+        if (!dfa) {
+            continue;
+        }
+        ++accepted;
+        regex reference(pattern);
+        for (int sample = 0; sample < 20; ++sample) {
+            string text;
+            size_t length = nextRandom(seed, 10);
+            for (size_t i = 0; i < length; ++i) {
+                text += alphabet[nextRandom(seed, static_cast<unsigned>(alphabet.size()))];
+            }
+            smatch expected;
+            bool found = regex_search(text, expected, reference, regex_constants::match_not_null);
+            size_t start = 0;
+            size_t end = 0;
+            bool matched = dfa->search(text.data(), text.size(), 0, text.size(), false, start, end);
+            if (matched != found || (found && (start != static_cast<size_t>(expected.position(0)) ||
+                                               end - start != static_cast<size_t>(expected.length(0))))) {
+                cerr << "模式 " << pattern << " 在 \"" << text << "\" 上与std::regex不一致" << endl;
+                assert(false);
+            }
+        }
+    }
+    assert(accepted > 200);
+    cout << "✓ 随机模式与std::regex一致（" << accepted << " 个）" << endl;
+    
+    // 循环体能匹配空串时ECMAScript有特殊规则，DFA拒绝，AUTO回退到std::regex
+    for (const char* pattern : {"(?:(?:b){0,2}?)+", "(?:a|\\B)+", "(?:b{0,1}?)*", "(?:x|)+?"}) {
+        string error;
+        assert(!PatternEngine::Regex::compile(pattern, false, error) && !error.empty());
+        AdPatterns::PatternSet fallback;
+        assert(fallback.add(pattern, AdPatterns::Engine::AUTO));
+        assert(fallback.engineOf(0) == AdPatterns::Engine::STD_REGEX);
+    }
+    string repeatError;
+    assert(PatternEngine::Regex::compile("(?:a?){2}", false, repeatError));
+    cout << "✓ 拒绝循环体能匹配空串的重复" << endl;
+    
+    // 字符类按UTF-8字符而不是按字节匹配：零宽字符类不能匹配汉字的某个字节
+    AdPatterns::PatternSet set;
+    assert(set.add(AdPatterns::getBuiltinPatterns()[4].pattern, AdPatterns::Engine::DFA));
+    string content = "【正文】\u200b\u200b内容\ufeff";
+    assert(AdPatterns::PatternSet::removeMatches(content, set.findAll(content)) == "【正文】内容");
+    cout << "✓ 多字节字符类" << endl;
+    
+    // DFA不支持的语法：AUTO回退到std::regex，DFA直接拒绝
+    string error;
+    assert(!PatternEngine::Regex::compile("(a)\\1", false, error) && !error.empty());
+    assert(!set.add("(a)\\1", AdPatterns::Engine::DFA));
+    assert(set.add("(a)\\1", AdPatterns::Engine::AUTO));
+    assert(set.engineOf(0) == AdPatterns::Engine::DFA && set.engineOf(1) == AdPatterns::Engine::STD_REGEX);
+    assert(set.withEngine(AdPatterns::Engine::STD_REGEX).engineOf(0) == AdPatterns::Engine::STD_REGEX);
+    cout << "✓ 不支持的语法回退到std::regex" << endl;
+    
+    // 大小写不敏感和流式扫描中的单词边界
+    AdPatterns::PatternSet words;
+    assert(words.add("\\bSPAM\\b", AdPatterns::Engine::DFA));
+    assert(AdPatterns::PatternSet::removeMatches("spam spammer Spam", words.findAll("spam spammer Spam")) ==
+           " spammer ");
+    vector<AdPatterns::MatchSpan> partial;
+    words.scan("a spam", 6, 0, 6, true, partial);
+    assert(partial.empty());
+    cout << "✓ 忽略大小写和数据末尾的单词边界" << endl;
+}
+
+// 测试必需字面量预过滤
+void testLiteralPrefilter() {
+    cout << "\n=== 测试字面量预过滤 ===" << endl;
+    
+    string error;
+    auto download = PatternEngine::Regex::compile(AdPatterns::getBuiltinPatterns()[3].pattern, true, error);
+    assert(download && download->requiredLiterals() == vector<string>({"下载"}));
+    assert(download->maxMatchLength() == PatternEngine::Regex::UNBOUNDED);
+    auto bounded = PatternEngine::Regex::compile("(foo|bar)BAZ", true, error);
+    assert(bounded->requiredLiterals() == vector<string>({"barbaz", "foobaz"}));
+    assert(bounded->maxMatchLength() == 6);
+    cout << "✓ 提取必需字面量和最大匹配长度" << endl;
+    
+    PatternEngine::LiteralMatcher matcher;
+    matcher.add("he");
+    matcher.add("she");
+    matcher.add("hers");
+    matcher.build();
+    vector<PatternEngine::LiteralMatcher::Hit> hits;
+    matcher.findAll("uSHErs", 6, hits);
+    assert(hits.size() == 3);
+    assert(hits[0].position == 1 && hits[0].literal == 1);
+    assert(hits[1].position == 2 && hits[1].literal == 0);
+    assert(hits[2].position == 2 && hits[2].literal == 2);
+    cout << "✓ 多字面量查找（忽略ASCII大小写）" << endl;
+    
+    // 没有字面量的文档整体跳过；有字面量时结果与std::regex一致
+    AdPatterns::PatternSet set = AdPatterns::createPatternSet({"【[^】]*下载[^】]*】", "x(foo|bar)baz"});
+    AdPatterns::ScanStats stats;
+    string plain = "普通正文，没有广告。";
+    assert(set.findAll(plain, &stats).empty() && stats.bytesSkipped == plain.size());
+    
+    string content = "正文【点此下载】正文xfoobaz尾部没有候选";
+    AdPatterns::ScanStats partial;
+    auto matches = set.findAll(content, &partial);
+    auto expected = set.withEngine(AdPatterns::Engine::STD_REGEX).findAll(content);
+    assert(matches.size() == 2 && matches.size() == expected.size());
+    for (size_t i = 0; i < matches.size(); ++i) {
+        assert(matches[i].offset == expected[i].offset && matches[i].length == expected[i].length);
+    }
+    assert(partial.bytesSkipped == content.size() - content.find("foobaz"));
+    cout << "✓ 跳过没有候选的文档和区域" << endl;
+}
+
+// 测试字节扫描内核
+void testSimdScan() {
+    cout << "\n=== 测试字节扫描内核 ===" << endl;
+    
+    // 各级实现与标量实现结果一致（包括块边界和末尾不完整的前缀）
+    SimdScan::PrefixSet prefixes;
+    assert(prefixes.add("\xE2\x80", 2));
+    assert(prefixes.add("\xE3\x80", 2));
+    assert(prefixes.add("gi", 2));
+    assert(prefixes.add("<", 1));
+    const string alphabet = "abgiGI<x\xE2\xE3\x80\x8B";
+    unsigned seed = 99;
+    SimdScan::Level detected = SimdScan::detectedLevel();
+    for (int round = 0; round < 300; ++round) {
+        string data;
+        seed = seed * 1103515245 + 12345;
+        size_t length = (seed >> 16) % 200;
+        for (size_t i = 0; i < length; ++i) {
+            seed = seed * 1103515245 + 12345;
+            data += alphabet[(seed >> 16) % alphabet.size()];
+        }
+        for (size_t from = 0; from <= length; from += 7) {
+            SimdScan::setLevel(SimdScan::Level::SCALAR);
+            size_t expected = prefixes.find(data.data(), data.size(), from);
+            for (auto level : {SimdScan::Level::SSE2, SimdScan::Level::AVX2}) {
+                SimdScan::setLevel(level);
+                assert(prefixes.find(data.data(), data.size(), from) == expected);
+            }
+        }
+    }
+    SimdScan::setLevel(detected);
+    cout << "✓ " << SimdScan::levelName(detected) << " 与标量实现结果一致" << endl;
+    
+    // [...]+形式的零宽字符模式走扫描内核，结果与逐个码点匹配一致
+    string error;
+    auto zeroWidth = PatternEngine::Regex::compile(AdPatterns::getBuiltinPatterns()[4].pattern, true, error);
+    string content = "【正文】\u200b\u200c内容\u2060\ufeff\u180e结尾\u200d";
+    AdPatterns::PatternSet set;
+    assert(set.add(AdPatterns::getBuiltinPatterns()[4].pattern, AdPatterns::Engine::DFA));
+    auto matches = set.findAll(content);
+    assert(matches.size() == 3);
+    size_t start = 0;
+    size_t end = 0;
+    assert(zeroWidth->search(content.data(), content.size(), 0, content.size(), false, start, end));
+    assert(start == matches[0].offset && end == start + 6);
+    
+    // 原地删除与复制删除结果一致
+    string erased = content;
+    AdPatterns::PatternSet::eraseMatches(erased, matches);
+    assert(erased == "【正文】内容结尾");
+    assert(erased == AdPatterns::PatternSet::removeMatches(content, matches));
+    cout << "✓ 零宽字符查找和原地删除" << endl;
+}
+
+// 测试编译结果的共享和多线程扫描
+void testSharedPatternSet() {
+    cout << "\n=== 测试共享模式集合 ===" << endl;
+    
+    // 内置模式每种引擎只编译一次，复制集合只共享编译结果
+    const auto& builtin = AdPatterns::builtinPatternSet();
+    assert(builtin.compiled() == AdPatterns::builtinPatternSet().compiled());
+    AdPatterns::PatternSet copy = builtin;
+    assert(copy.compiled() == builtin.compiled());
+    assert(copy.add("\\[AD\\]"));
+    assert(copy.compiled() != builtin.compiled());
+    assert(copy.size() == builtin.size() + 1);
+    cout << "✓ 复制共享编译结果，修改时写时复制" << endl;
+    
+    // 多个线程各用自己的ScanScratch同时扫描同一个集合
+    string content;
+    for (int i = 0; i < 200; ++i) {
+        content += "<p>第" + to_string(i) + "章\u200b正文[AD]</p>";
+        if (i % 7 == 0) {
+            content += "【请使用某项目进行下载：https://github.com/x】\n";
+        }
+    }
+    auto expected = copy.findAll(content);
+    assert(expected.size() > 200);
+    vector<thread> workers;
+    vector<int> same(4, 0);
+    for (size_t t = 0; t < same.size(); ++t) {
+        workers.emplace_back([&, t]() {
+            AdPatterns::ScanScratch scratch;
+            bool ok = true;
+            for (int round = 0; round < 20; ++round) {
+                auto matches = copy.findAll(content, scratch);
+                ok = ok && matches.size() == expected.size();
+                for (size_t i = 0; ok && i < matches.size(); ++i) {
+                    ok = matches[i].offset == expected[i].offset && matches[i].length == expected[i].length &&
+                         matches[i].patternIndex == expected[i].patternIndex;
+                }
+            }
+            same[t] = ok;
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    assert(count(same.begin(), same.end(), 1) == static_cast<int>(same.size()));
+    cout << "✓ 多线程共享扫描结果一致" << endl;
+}
+
+// 测试预编译模式包的保存和加载
+void testPatternBundle() {
+    cout << "\n=== 测试预编译模式包 ===" << endl;
+    
+    AdPatterns::PatternSet set = AdPatterns::builtinPatternSet();
+    assert(set.add("\\bspam\\w*"));
+    assert(set.add("(ad)\\1"));     // 反向引用只能由std::regex匹配
+    string path = "test_patterns.bin";
+    string error;
+    assert(AdPatterns::savePatternBundle(set, path, &error));
+    assert(AdPatterns::isPatternBundle(path));
+    
+    AdPatterns::PatternSet loaded;
+    assert(AdPatterns::loadPatternBundle(path, loaded, &error));
+    assert(loaded.size() == set.size());
+    assert(loaded.engineOf(set.size() - 1) == AdPatterns::Engine::STD_REGEX);
+    string content = "正文【请使用本项目进行下载：x】\u200bspammer adad Spam【 】结尾";
+    auto expected = set.findAll(content);
+    auto actual = loaded.findAll(content);
+    assert(expected.size() == 6 && actual.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        assert(actual[i].offset == expected[i].offset && actual[i].length == expected[i].length &&
+               actual[i].patternIndex == expected[i].patternIndex);
+    }
+    cout << "✓ 加载后的匹配结果与编译结果一致" << endl;
+    
+    string original = FileUtils::readFileToString(path);
+    assert(!original.empty());
+    auto rejects = [&](const string& data) {
+        ofstream(path, ios::binary | ios::trunc) << data;
+        AdPatterns::PatternSet broken;
+        return !AdPatterns::loadPatternBundle(path, broken, &error) && broken.empty();
+    };
+    string corrupted = original;
+    corrupted[corrupted.size() / 2] ^= 0x01;
+    assert(rejects(corrupted));
+    string otherVersion = original;
+    otherVersion[8] = 99;
+    assert(rejects(otherVersion));
+    assert(rejects(original.substr(0, original.size() - 1)));
+    assert(!AdPatterns::isPatternBundle("nonexistent_patterns.bin"));
+    FileUtils::removeFile(path);
+    cout << "✓ 拒绝损坏、版本不符和被截断的文件" << endl;
+}
+
+// 测试模式集合的静态分析
+void testPatternAnalysis() {
+    cout << "\n=== 测试模式集合分析 ===" << endl;
+    
+    // 默认不启用的内置模式正好是分析器在全部内置模式中找出的冗余模式（修改内置模式后需要同步enabled），
+    // 启用的内置模式之间没有冗余
+    auto builtins = AdPatterns::getBuiltinPatterns();
+    vector<string> builtinStrings;
+    set<size_t> disabled;
+    for (size_t i = 0; i < builtins.size(); ++i) {
+        builtinStrings.push_back(builtins[i].pattern);
+        if (!builtins[i].enabled) {
+            disabled.insert(i);
+        }
+    }
+    auto full = AdPatterns::createPatternSet(builtinStrings);
+    auto analysis = AdPatterns::analyzePatternSet(full);
+    set<size_t> redundant;
+    for (const auto& item : analysis.redundant) {
+        redundant.insert(item.index);
+    }
+    assert(!redundant.empty() && redundant == disabled);
+    assert(AdPatterns::builtinPatternSet().size() == full.size() - redundant.size());
+    vector<string> enabledStrings;
+    for (const auto& pattern : AdPatterns::getBuiltinPatterns()) {
+        if (pattern.enabled) {
+            enabledStrings.push_back(pattern.pattern);
+        }
+    }
+    assert(AdPatterns::analyzePatternSet(AdPatterns::createPatternSet(enabledStrings)).redundant.empty());
+    string content = "正文 \n【请使用本项目进行下载：x】\n【项目下载】【https://github.com/a】\u200b【 】【本章完】";
+    auto expected = full.findAll(content);
+    auto actual = AdPatterns::builtinPatternSet().findAll(content);
+    assert(expected.size() == 5 && actual.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        assert(actual[i].offset == expected[i].offset && actual[i].length == expected[i].length);
+    }
+    cout << "✓ 启用的内置模式没有冗余，停用冗余模式后匹配结果不变" << endl;
+    
+    // 排在前面的模式覆盖；排在后面的模式以相同的终点覆盖；选择的先后顺序不同时终点可能不同
+    auto redundantOf = [](const vector<string>& patterns) {
+        vector<size_t> indices;
+        for (const auto& item : AdPatterns::analyzePatternSet(AdPatterns::createPatternSet(patterns)).redundant) {
+            indices.push_back(item.index);
+        }
+        return indices;
+    };
+    assert(redundantOf({"fo+", "foo\\b"}) == vector<size_t>{1});
+    assert(redundantOf({"ab+c", "ab*c"}) == vector<size_t>{0});
+    assert(redundantOf({"ab+", "ab*c"}).empty());
+    assert(redundantOf({"x(ab|abc)", "x(abc|ab)"}) == vector<size_t>{1});
+    assert(redundantOf({"xab", "xa[a-z]*"}).empty());
+    assert(redundantOf({"ab", "a[bc]"}) == vector<size_t>{0});
+    assert(redundantOf({"ab", "(ad)\\1", "a[bc]"}).empty());     // 反向引用无法分析，挡住后面的模式
+    cout << "✓ 只删去不改变扫描结果的模式" << endl;
+    
+    // std::regex按字节匹配：[^】]能匹配"告"（E5 91 8A）中与"】"（E3 80 91）相同的字节，
+    // 后一个模式在std::regex上匹配不到【广告】，不能用来删去前一个模式
+    string patternFile = "test_redundant_patterns.txt";
+    ofstream(patternFile) << "【广告】\n【[^】]*】\n";
+    string text = "正文【广告】正文";
+    assert(AdPatterns::loadPatternSetFromFile(patternFile, AdPatterns::Engine::DFA).size() == 1);
+    auto stdPatterns = AdPatterns::loadPatternSetFromFile(patternFile, AdPatterns::Engine::STD_REGEX);
+    assert(stdPatterns.size() == 2);
+    assert(stdPatterns.findAll(text).size() == 1);
+    assert(AdPatterns::analyzePatternSet(AdPatterns::createPatternSet({"【广告】", "【[^】]*】"},
+                                                                      AdPatterns::Engine::STD_REGEX)).redundant.empty());
+    FileUtils::removeFile(patternFile);
+    cout << "✓ std::regex执行的模式不参与冗余判断" << endl;
+    
+    auto hazardsOf = [](const string& pattern) {
+        return AdPatterns::analyzePatternSet(AdPatterns::createPatternSet({pattern})).hazards.size();
+    };
+    assert(hazardsOf("(a+)+b") == 1);
+    assert(hazardsOf("【[^】]*下载[^】]*】") == 1);
+    assert(hazardsOf("[\\s\\r\\n]*【") == 1);
+    assert(hazardsOf("[a-z]+") == 0);
+    assert(hazardsOf("^\\s*x\\d+y") == 0);
+    cout << "✓ 报告嵌套量词、相连的无界重复和开头的无界重复" << endl;
+}
+
+// 测试按模式统计
+void testPatternProfile() {
+    cout << "\n=== 测试按模式统计 ===" << endl;
+    
+    AdPatterns::PatternMatcher matcher;
+    matcher.addPattern(string("\\[AD\\]"));
+    matcher.addPattern(string("x+"));
+    matcher.addPattern(string("never"));
+    string result = matcher.cleanContent("a[AD]bxx[AD]c");
+    assert(result == "abc");
+    auto stats = matcher.getMatchStats();
+    assert(stats.totalMatches == 3 && stats.patterns.size() == 3);
+    assert(stats.patterns[0].matches == 2 && stats.patterns[0].bytesRemoved == 8);
+    assert(stats.patterns[0].invocations == 0 && stats.patterns[0].nanoseconds == 0);     // 默认不计时
+    
+    matcher.resetMatchStats();
+    matcher.setProfiling(true);
+    assert(matcher.cleanContent("a[AD]bxx[AD]c") == "abc");
+    stats = matcher.getMatchStats();
+    assert(stats.totalMatches == 3);
+    assert((stats.matchedPatterns == vector<string>{"\\[AD\\]", "x+"}));
+    assert(stats.patterns.size() == 3);
+    assert(stats.patterns[0].matches == 2 && stats.patterns[0].bytesRemoved == 8);
+    assert(stats.patterns[1].matches == 1 && stats.patterns[1].bytesRemoved == 2);
+    assert(stats.patterns[2].matches == 0 && stats.patterns[2].bytesRemoved == 0);
+    assert(stats.patterns[0].invocations > 0 && stats.patterns[0].bytesScanned > 0);
+    cout << "✓ 每个模式的匹配数和移除字节数正确" << endl;
+    
+    // 多个线程各自扫描，计数合并到同一个统计对象
+    auto set = AdPatterns::createPatternSet({"\\[AD\\]", "x+"});
+    AdPatterns::PatternProfile profile(set);
+    assert(profile.size() == 2 && profile.source(1) == "x+");
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&set, &profile]() {
+            for (int i = 0; i < 50; ++i) {
+                AdPatterns::ScanStats scanStats;
+                scanStats.profile = true;
+                set.findAll("a[AD]bxx[AD]c", &scanStats);
+                profile.merge(scanStats.patterns);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    assert(profile.get(0).matches == 400 && profile.get(0).bytesRemoved == 1600);
+    assert(profile.get(1).matches == 200 && profile.get(1).bytesRemoved == 400);
+    profile.reset();
+    assert(profile.get(0).matches == 0 && profile.get(0).invocations == 0);
+    
+    // 不开启统计时不收集计数
+    AdPatterns::ScanStats plain;
+    set.findAll("a[AD]b", &plain);
+    assert(plain.patterns.empty());
+    cout << "✓ 多线程合并计数" << endl;
+}
+
+// 测试工作窃取线程池
+void testThreadPool() {
+    cout << "\n=== 测试线程池 ===" << endl;
+    
+    // 外部提交的任务按提交顺序执行
+    {
+        ThreadPool pool(1);
+        vector<int> order;
+        vector<future<void>> done;
+        for (int i = 0; i < 5; ++i) {
+            done.push_back(pool.submit([&order, i]() { order.push_back(i); }));
+        }
+        for (auto& task : done) {
+            task.get();
+        }
+        assert((order == vector<int>{0, 1, 2, 3, 4}));
+    }
+    cout << "✓ 外部任务按提交顺序执行" << endl;
+    
+    // 工作线程拆出的子任务放在自己的队列中，等待期间由空闲线程窃取执行
+    {
+        ThreadPool pool(4);
+        vector<future<pair<int, bool>>> outer;
+        for (int t = 0; t < 2; ++t) {
+            outer.push_back(pool.submit([&pool, t]() {
+                thread::id parent = this_thread::get_id();
+                vector<future<pair<int, bool>>> parts;
+                for (int i = 0; i < 8; ++i) {
+                    parts.push_back(pool.submit([parent, i]() {
+                        return make_pair(i, this_thread::get_id() != parent);
+                    }));
+                }
+                int sum = 0;
+                bool stolen = false;
+                for (auto& part : parts) {
+                    auto result = part.get();
+                    sum += result.first;
+                    stolen = stolen || result.second;
+                }
+                return make_pair(sum + t * 100, stolen);
+            }));
+        }
+        for (int t = 0; t < 2; ++t) {
+            auto result = outer[t].get();
+            assert(result.first == 28 + t * 100);
+            assert(result.second);
+        }
+    }
+    cout << "✓ 空闲线程窃取其他线程拆出的子任务" << endl;
+}
+
+// 测试文件读写后端：小缓冲区和浅队列使大文件拆成多块并重复使用缓冲区
+void testAsyncIO() {
+    cout << "\n=== 测试文件读写后端 ===" << endl;
+    
+    FileUtils::TempDirectory tempDir("test_async_io_");
+    assert(tempDir.isValid());
+    AsyncIO::Config& config = AsyncIO::getConfig();
+    AsyncIO::Config saved = config;
+    config.queueDepth = 4;
+    config.bufferSize = 4096;
+    
+    for (AsyncIO::Backend backend : {AsyncIO::Backend::SYNC, AsyncIO::Backend::AUTO}) {
+        config.backend = backend;
+        for (size_t size : {0, 1, 4095, 4096, 4097, 100000}) {
+            string content(size, '\0');
+            for (size_t i = 0; i < size; ++i) {
+                content[i] = static_cast<char>((i * 131 + size) & 0xFF);
+            }
+            fs::path file = tempDir.getPath() / ("data_" + to_string(size) + ".bin");
+            fs::path copy = tempDir.getPath() / ("copy_" + to_string(size) + ".bin");
+            assert(AsyncIO::writeFile(file, {"head", content}));
+            assert(FileUtils::getFileSize(file) == size + 4);
+            string read;
+            assert(AsyncIO::readFile(file, read));
+            assert(read == "head" + content);
+            assert(AsyncIO::copyFile(file, copy));
+            assert(AsyncIO::readFile(copy, read));
+            assert(read == "head" + content);
+        }
+        
+        string missing;
+        assert(!AsyncIO::readFile(tempDir.getPath() / "missing.bin", missing));
+        assert(!AsyncIO::writeFile(tempDir.getPath() / "no_dir" / "x.bin", "x"));
+        cout << "✓ " << AsyncIO::backendName(AsyncIO::activeBackend()) << " 后端读写和复制正确" << endl;
+    }
+    
+    config = saved;
+}
+
+// 测试流式清理（匹配跨越块边界）
+void testStreamingCleaner() {
+    cout << "\n=== 测试流式清理 ===" << endl;
+    
+    vector<regex> patterns = {regex("\\[AD:[^\\]]*\\] ?"), regex("\\bspam\\b")};
+    string content;
+    for (int i = 0; i < 200; ++i) {
+        content += "line " + to_string(i) + " [AD: visit example.com " + to_string(i) + "] spam spammer\n";
+    }
+    string expected = content;
+    for (const auto& pattern : patterns) {
+        expected = regex_replace(expected, pattern, "");
+    }
+    
+    AdPatterns::PatternSet set(patterns);
+    for (size_t chunk : {size_t(1), size_t(7), size_t(100), content.size()}) {
+        AdPatterns::StreamingCleaner cleaner(set, 64);
+        string output;
+        for (size_t pos = 0; pos < content.size(); pos += chunk) {
+            size_t size = min(chunk, content.size() - pos);
+            cleaner.write(content.data() + pos, size, false, output);
+        }
+        cleaner.write(nullptr, 0, true, output);
+        assert(output == expected);
+        assert(cleaner.modified());
+        assert(cleaner.removalCounts() == vector<size_t>({200, 200}));
+        assert(output == AdPatterns::PatternSet::removeMatches(content, set.findAll(content)));
+    }
+    cout << "✓ 分块输出与整体替换结果一致" << endl;
+    
+    AdPatterns::StreamingCleaner clean(set, 64);
+    string output;
+    clean.write("nothing to remove", 17, true, output);
+    assert(output == "nothing to remove" && !clean.modified());
+    cout << "✓ 无广告内容原样输出" << endl;
+}
+
+#ifdef HAVE_ZLIB
+// 构造畸形归档用：查找签名位置，按小端序改写字段
+size_t findSignature(const string& data, uint32_t signature) {
+    string bytes;
+    for (int i = 0; i < 4; ++i) {
+        bytes += static_cast<char>((signature >> (8 * i)) & 0xFF);
+    }
+    return data.find(bytes);
+}
+
+void putLE(string& data, size_t pos, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        data[pos + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+// 单个压缩条目的内存归档
+string buildSingleEntryArchive(const string& name, const string& content) {
+    ZipUtils::ZipWriter writer;
+    assert(writer.openMemory().success());
+    assert(writer.addEntry(name, content.data(), content.size()).success());
+    assert(writer.close().success());
+    return writer.takeBuffer();
+}
+
+// 测试用EPUB：不压缩的mimetype在前，其余条目按顺序压缩
+string buildTestBook(const vector<pair<string, string>>& entries) {
+    ZipUtils::ZipWriter writer;
+    assert(writer.openMemory().success());
+    string mimetype = "application/epub+zip";
+    assert(writer.addEntry("mimetype", mimetype.data(), mimetype.size(), false).success());
+    for (const auto& entry : entries) {
+        assert(writer.addEntry(entry.first, entry.second.data(), entry.second.size()).success());
+    }
+    assert(writer.close().success());
+    return writer.takeBuffer();
+}
+
+void writeTestBook(const fs::path& path, const vector<pair<string, string>>& entries) {
+    assert(FileUtils::writeStringToFile(path, buildTestBook(entries)));
+}
+
+// 测试内置ZIP读取器
+void testZipReader() {
+    cout << "\n=== 测试ZIP读取器 ===" << endl;
+    
+    // 条目路径安全检查
+    assert(ZipUtils::isSafeEntryName("OEBPS/chapter1.xhtml"));
+    assert(ZipUtils::isSafeEntryName("mimetype"));
+    assert(!ZipUtils::isSafeEntryName("../evil.txt"));
+    assert(!ZipUtils::isSafeEntryName("OEBPS/../../evil.txt"));
+    assert(!ZipUtils::isSafeEntryName("/etc/passwd"));
+    assert(!ZipUtils::isSafeEntryName("C:\\evil.txt"));
+    cout << "✓ 条目路径安全检查" << endl;
+    
+    // 非ZIP文件应被拒绝
+    string testFile = "test_not_zip.epub";
+    assert(FileUtils::writeStringToFile(testFile, "this is not a zip archive at all"));
+    ZipUtils::ZipReader reader;
+    assert(!reader.open(testFile).success());
+    assert(!reader.isOpen());
+    assert(FileUtils::removeFile(testFile));
+    cout << "✓ 拒绝无效ZIP文件" << endl;
+    
+    // 中央目录声明的解压大小远大于实际数据：解压失败，不按声明大小分配
+    string archive = buildSingleEntryArchive("ch1.xhtml", string(1000, 'a'));
+    size_t central = findSignature(archive, 0x02014b50);
+    assert(central != string::npos);
+    for (uint64_t declared : {uint64_t(0xF0000000), uint64_t(1001), uint64_t(999)}) {
+        string patched = archive;
+        putLE(patched, central + 24, declared, 4);
+        ZipUtils::ZipReader bomb;
+        assert(bomb.openMemory(patched.data(), patched.size()).success());
+        string content;
+        assert(!bomb.readEntry(bomb.entries()[0], content).success());
+        assert(content.empty());
+    }
+    ZipUtils::ZipReader exact;
+    assert(exact.openMemory(archive.data(), archive.size()).success());
+    string content;
+    assert(exact.readEntry(exact.entries()[0], content).success() && content == string(1000, 'a'));
+    cout << "✓ 声明的解压大小与实际不符时解压失败" << endl;
+    
+    // 偏移0xFFFFFFFFFFFFFFF0回绕后指向数据之前16字节：在那里放上对应的签名，
+    // 边界检查有误时读取会越过数据开头并继续解析，而不是碰巧因签名不符而失败
+    auto withSignatureBefore = [](const string& data, uint32_t signature) {
+        string buffer(16, '\0');
+        putLE(buffer, 0, signature, 4);
+        return buffer + data;
+    };
+    
+    // ZIP64定位器中接近2^64的结束记录偏移：相加回绕后不能通过边界检查
+    {
+        string evil = archive;
+        size_t eocd = findSignature(evil, 0x06054b50);
+        assert(eocd != string::npos);
+        string locator(20, '\0');
+        putLE(locator, 0, 0x07064b50, 4);
+        putLE(locator, 8, 0xFFFFFFFFFFFFFFF0ULL, 8);
+        putLE(locator, 16, 1, 4);
+        evil.insert(eocd, locator);
+        string buffer = withSignatureBefore(evil, 0x06064b50);
+        ZipUtils::ZipReader reader;
+        ZipUtils::ZipResult result = reader.openMemory(buffer.data() + 16, evil.size());
+        assert(!result.success() && result.status == ZipUtils::ZipStatus::INVALID_ARCHIVE);
+    }
+    
+    // ZIP64扩展字段中接近2^64的本地文件头偏移
+    {
+        string evil = archive;
+        size_t entry = findSignature(evil, 0x02014b50);
+        size_t nameLength = static_cast<unsigned char>(evil[entry + 28]);
+        string extra(12, '\0');
+        putLE(extra, 0, 0x0001, 2);
+        putLE(extra, 2, 8, 2);
+        putLE(extra, 4, 0xFFFFFFFFFFFFFFF0ULL, 8);
+        evil.insert(entry + 46 + nameLength, extra);
+        putLE(evil, entry + 30, extra.size(), 2);
+        putLE(evil, entry + 42, 0xFFFFFFFF, 4);
+        size_t eocd = findSignature(evil, 0x06054b50);
+        putLE(evil, eocd + 12, static_cast<uint64_t>(eocd - entry), 4);
+        
+        // 回绕后读到的名称和扩展字段长度来自真实本地头的时间和日期，置零使其不越界
+        putLE(evil, 10, 0, 4);
+        string buffer = withSignatureBefore(evil, 0x04034b50);
+        ZipUtils::ZipReader reader;
+        assert(reader.openMemory(buffer.data() + 16, evil.size()).success());
+        assert(reader.entries()[0].localHeaderOffset == 0xFFFFFFFFFFFFFFF0ULL);
+        const unsigned char* data = nullptr;
+        assert(!reader.rawData(reader.entries()[0], data).success());
+        string content;
+        assert(!reader.readEntry(reader.entries()[0], content).success());
+    }
+    cout << "✓ 回绕的ZIP64偏移被拒绝" << endl;
+}
+
+// 测试内置ZIP写入器（与读取器往返）
+void testZipWriter() {
+    cout << "\n=== 测试ZIP写入器 ===" << endl;
+    
+    FileUtils::TempDirectory tempDir("test_zip_");
+    assert(tempDir.isValid());
+    
+    fs::path sourceDir = tempDir.getPath() / "book";
+    string chapter = "<html><body><p>正文内容</p></body></html>";
+    string bigText(200000, 'a');
+    assert(FileUtils::createDirectory(sourceDir / "OEBPS"));
+    {
+        ofstream(sourceDir / "mimetype", ios::binary) << "application/epub+zip";
+        ofstream(sourceDir / "OEBPS" / "ch1.xhtml", ios::binary) << chapter;
+        ofstream(sourceDir / "OEBPS" / "big.txt", ios::binary) << bigText;
+        ofstream(sourceDir / "OEBPS" / "chapter two.xhtml", ios::binary) << chapter;
+    }
+    
+    fs::path zipPath = tempDir.getPath() / "book.epub";
+    assert(ZipUtils::createZip(sourceDir, zipPath).success());
+    cout << "✓ 创建EPUB文件" << endl;
+    
+    ZipUtils::ZipReader reader;
+    assert(reader.open(zipPath).success());
+    assert(!reader.entries().empty());
+    
+    // mimetype必须是第一个条目且不压缩
+    const auto& first = reader.entries().front();
+    assert(first.name == "mimetype");
+    assert(first.method == 0);
+    cout << "✓ mimetype为第一个存储条目" << endl;
+    
+    string content;
+    assert(reader.readEntry(*reader.findEntry("OEBPS/ch1.xhtml"), content).success());
+    assert(content == chapter);
+    assert(reader.readEntry(*reader.findEntry("OEBPS/big.txt"), content).success());
+    assert(content == bigText);
+    assert(reader.findEntry("OEBPS/big.txt")->compressedSize < bigText.size());
+    cout << "✓ 条目内容往返一致" << endl;
+    
+    // 列表和信息只读取中央目录，文件名可包含空格
+    auto names = ZipUtils::listZipContents(zipPath);
+    assert(names.size() == reader.entries().size());
+    assert(find(names.begin(), names.end(), "OEBPS/chapter two.xhtml") != names.end());
+    
+    auto info = ZipUtils::getZipFileInfo(zipPath);
+    assert(info.fileCount == reader.entries().size());
+    assert(info.uncompressedSize >= bigText.size() + 2 * chapter.size());
+    assert(info.compressedSize < info.uncompressedSize);
+    const auto& bigInfo = *find_if(info.entries.begin(), info.entries.end(),
+        [](const ZipUtils::ZipEntry& entry) { return entry.name == "OEBPS/big.txt"; });
+    assert(bigInfo.uncompressedSize == bigText.size() && bigInfo.method == 8);
+    assert(bigInfo.crc32 == reader.findEntry("OEBPS/big.txt")->crc32);
+    cout << "✓ 从中央目录读取条目列表和信息" << endl;
+    
+    fs::path extractDir = tempDir.getPath() / "extracted";
+    assert(ZipUtils::extractZip(zipPath, extractDir).success());
+    assert(FileUtils::getFileSize(extractDir / "OEBPS" / "big.txt") == bigText.size());
+    cout << "✓ 解压到目录" << endl;
+    
+    // 内存输出：支持回写已写出的内容，takeBuffer移出整个缓冲区
+    ZipUtils::StringOutputBuffer buffer;
+    ostream stream(&buffer);
+    stream << "abcdef";
+    stream.seekp(2);
+    stream.write("XY", 2);
+    assert(stream.tellp() == streampos(4));
+    stream.seekp(0, ios::end);
+    stream << 'g';
+    assert(stream.good() && buffer.take() == "abXYefg" && buffer.take().empty());
+    
+    ZipUtils::ZipWriter memoryWriter;
+    assert(memoryWriter.openMemory(1024).success());
+    assert(memoryWriter.beginStream("OEBPS/stream.txt", 0).success());
+    assert(memoryWriter.writeStream(bigText.data(), bigText.size()).success());
+    assert(memoryWriter.finishStream().success());
+    assert(memoryWriter.close().success());
+    string archive = memoryWriter.takeBuffer();
+    assert(memoryWriter.takeBuffer().empty());
+    ZipUtils::ZipReader memoryReader;
+    assert(memoryReader.openMemory(archive.data(), archive.size()).success());
+    assert(memoryReader.readEntry(memoryReader.entries().front(), content).success() && content == bigText);
+    cout << "✓ 内存输出回写头部字段并移出缓冲区" << endl;
+    
+    // 预先压缩：只保留要写出的一份数据（压缩后释放原文，压缩无收益时退回存储）
+    ZipUtils::PrecompressedEntry packed = ZipUtils::ZipWriter::precompress(string(bigText));
+    assert(packed.ok && packed.compressed && packed.content.empty() && packed.size == bigText.size());
+    assert(!packed.deflated.empty() && packed.deflated.size() < bigText.size());
+    ZipUtils::PrecompressedEntry tiny = ZipUtils::ZipWriter::precompress(string("x"));
+    assert(tiny.ok && !tiny.compressed && tiny.deflated.empty() && tiny.content == "x");
+    
+    ZipUtils::ZipWriter packedWriter;
+    assert(packedWriter.openMemory(0).success());
+    assert(packedWriter.addPrecompressed("big.txt", std::move(packed)).success());
+    assert(packedWriter.addPrecompressed("tiny.txt", std::move(tiny)).success());
+    assert(packedWriter.close().success());
+    string packedArchive = packedWriter.takeBuffer();
+    ZipUtils::ZipReader packedReader;
+    assert(packedReader.openMemory(packedArchive.data(), packedArchive.size()).success());
+    assert(packedReader.entries().size() == 2);
+    assert(packedReader.entries()[0].method == 8 && packedReader.entries()[1].method == 0);
+    assert(packedReader.readEntry(packedReader.entries()[0], content).success() && content == bigText);
+    assert(packedReader.readEntry(packedReader.entries()[1], content).success() && content == "x");
+    cout << "✓ 预先压缩的条目只保留写出的数据" << endl;
+}
+
+// 测试ZIP到ZIP重写（未修改条目直接复制）
+void testZipRewrite() {
+    cout << "\n=== 测试ZIP重写 ===" << endl;
+    
+    FileUtils::TempDirectory tempDir("test_rewrite_");
+    assert(tempDir.isValid());
+    
+    fs::path sourceDir = tempDir.getPath() / "book";
+    assert(FileUtils::createDirectory(sourceDir));
+    {
+        ofstream(sourceDir / "mimetype", ios::binary) << "application/epub+zip";
+        ofstream(sourceDir / "a.xhtml", ios::binary) << "<p>keep AD here</p>";
+        ofstream(sourceDir / "b.xhtml", ios::binary) << "<p>no change</p>";
+        ofstream(sourceDir / "image.bin", ios::binary) << string(5000, 'x');
+    }
+    fs::path inputPath = tempDir.getPath() / "in.epub";
+    fs::path outputPath = tempDir.getPath() / "out.epub";
+    assert(ZipUtils::createZip(sourceDir, inputPath).success());
+    
+    auto needsContent = [](const ZipUtils::ZipEntry& entry) {
+        return fs::path(entry.name).extension() == ".xhtml";
+    };
+    auto transform = [](const ZipUtils::ZipEntry&, string& content) {
+        size_t pos = content.find(" AD");
+        if (pos == string::npos) {
+            return false;
+        }
+        content.erase(pos, 3);
+        return true;
+    };
+    
+    ZipUtils::RewriteStats stats;
+    assert(ZipUtils::rewriteZip(inputPath, outputPath, needsContent, transform, &stats).success());
+    assert(stats.entriesRecompressed == 1);
+    assert(stats.entriesCopied == 3);
+    cout << "✓ 只重新压缩被修改的条目" << endl;
+    
+    ZipUtils::ZipReader in, out;
+    assert(in.open(inputPath).success());
+    assert(out.open(outputPath).success());
+    assert(out.entries().front().name == "mimetype");
+    
+    string content;
+    assert(out.readEntry(*out.findEntry("a.xhtml"), content).success());
+    assert(content == "<p>keep here</p>");
+    
+    const auto* before = in.findEntry("image.bin");
+    const auto* after = out.findEntry("image.bin");
+    assert(before->crc32 == after->crc32);
+    assert(before->compressedSize == after->compressedSize);
+    assert(out.readEntry(*after, content).success());
+    assert(content == string(5000, 'x'));
+    cout << "✓ 未修改条目的压缩数据和CRC32保持不变" << endl;
+}
+
+// 测试ZIP64（超过65535个条目）
+void testZip64() {
+    cout << "\n=== 测试ZIP64 ===" << endl;
+    
+    const size_t count = 70000;
+    ZipUtils::ZipWriter writer;
+    assert(writer.openMemory().success());
+    for (size_t i = 0; i < count; ++i) {
+        string content = to_string(i);
+        assert(writer.addEntry("p/" + to_string(i), content.data(), content.size(), false).success());
+    }
+    assert(writer.close().success());
+    string archive = writer.takeBuffer();
+    
+    // 应写出ZIP64结束记录，传统结束记录中的条目数为0xFFFF
+    assert(archive.find(string("PK\x06\x06", 4)) != string::npos);
+    assert(archive.find(string("PK\x06\x07", 4)) != string::npos);
+    cout << "✓ 写入ZIP64结束记录" << endl;
+    
+    ZipUtils::ZipReader reader;
+    assert(reader.openMemory(archive.data(), archive.size()).success());
+    assert(reader.entries().size() == count);
+    string content;
+    assert(reader.readEntry(reader.entries().back(), content).success());
+    assert(content == to_string(count - 1));
+    cout << "✓ 读取 " << count << " 个条目" << endl;
+}
+
+// 测试多线程和分块压缩（输出与线程数无关）
+void testParallelDeflate() {
+    cout << "\n=== 测试并行压缩 ===" << endl;
+    
+    string big;
+    for (int i = 0; big.size() < 300000; ++i) {
+        big += "<p>第" + to_string(i) + "段 chapter text " + to_string(i * 7919 % 1000) + "</p>\n";
+    }
+    
+    auto build = [&](size_t threads, size_t chunkSize) {
+        ZipUtils::ZipWriter writer;
+        writer.setCompressionThreads(threads);
+        writer.setChunkSize(chunkSize);
+        assert(writer.openMemory().success());
+        // 存储条目在第一个压缩条目之前写出（此时线程池尚未创建），顺序不变
+        assert(writer.addEntry("mimetype", string("application/epub+zip"), false).success());
+        for (int i = 0; i < 20; ++i) {
+            assert(writer.addEntry("OEBPS/ch" + to_string(i) + ".xhtml",
+                                   big.substr(static_cast<size_t>(i) * 1000)).success());
+        }
+        assert(writer.close().success());
+        return writer.takeBuffer();
+    };
+    
+    // 比较各条目的压缩数据（时间戳可能不同）
+    auto sameEntries = [](const string& a, const string& b) {
+        ZipUtils::ZipReader ra, rb;
+        assert(ra.openMemory(a.data(), a.size()).success());
+        assert(rb.openMemory(b.data(), b.size()).success());
+        if (ra.entries().size() != rb.entries().size()) {
+            return false;
+        }
+        for (size_t i = 0; i < ra.entries().size(); ++i) {
+            const auto& ea = ra.entries()[i];
+            const auto& eb = rb.entries()[i];
+            const unsigned char* da = nullptr;
+            const unsigned char* db = nullptr;
+            assert(ra.rawData(ea, da).success() && rb.rawData(eb, db).success());
+            if (ea.name != eb.name || ea.crc32 != eb.crc32 || ea.compressedSize != eb.compressedSize ||
+                memcmp(da, db, static_cast<size_t>(ea.compressedSize)) != 0) {
+                return false;
+            }
+        }
+        return true;
+    };
+    
+    string serial = build(1, 0);
+    assert(sameEntries(serial, build(4, 0)));
+    cout << "✓ 多线程输出与单线程一致" << endl;
+    
+    string chunkedSerial = build(1, 16 * 1024);
+    string chunkedParallel = build(4, 16 * 1024);
+    assert(sameEntries(chunkedSerial, chunkedParallel));
+    
+    ZipUtils::ZipReader reader;
+    assert(reader.openMemory(chunkedParallel.data(), chunkedParallel.size()).success());
+    string content;
+    assert(reader.entries().front().name == "mimetype" && reader.entries().front().method == 0);
+    assert(reader.readEntry(reader.entries()[1], content).success());
+    assert(content == big);
+    cout << "✓ 分块压缩可正确解压并校验CRC32" << endl;
+}
+
+// 测试流式压缩/解压接口
+void testCodecStreams() {
+    cout << "\n=== 测试流式压缩接口 ===" << endl;
+    
+    string text;
+    for (int i = 0; i < 20000; ++i) {
+        text += "chunk " + to_string(i % 97) + " of streaming data\n";
+    }
+    
+    for (auto format : {ZipUtils::StreamFormat::RAW, ZipUtils::StreamFormat::ZLIB}) {
+        // 同一线程上反复创建，复用缓存池中的流
+        for (int round = 0; round < 3; ++round) {
+            ZipUtils::Deflater deflater(6, format);
+            assert(deflater.valid());
+            string compressed;
+            for (size_t pos = 0; pos < text.size(); pos += 4096) {
+                size_t size = min<size_t>(4096, text.size() - pos);
+                assert(deflater.write(text.data() + pos, size, ZipUtils::Deflater::Flush::NONE, compressed));
+            }
+            assert(deflater.write(nullptr, 0, ZipUtils::Deflater::Flush::FINISH, compressed));
+            assert(deflater.totalIn() == text.size());
+            assert(compressed.size() < text.size() / 4);
+            
+            // 用很小的输出缓冲区逐段解压
+            ZipUtils::Inflater inflater(format);
+            string restored;
+            const char* in = compressed.data();
+            size_t inSize = compressed.size();
+            auto status = ZipUtils::CodecStatus::OK;
+            while (status == ZipUtils::CodecStatus::OK) {
+                char buffer[333];
+                char* out = buffer;
+                size_t outSize = sizeof(buffer);
+                status = inflater.process(in, inSize, out, outSize);
+                restored.append(buffer, sizeof(buffer) - outSize);
+            }
+            assert(status == ZipUtils::CodecStatus::STREAM_END);
+            assert(restored == text);
+        }
+    }
+    cout << "✓ 原始deflate和zlib格式分块往返一致" << endl;
+    
+    ZipUtils::Inflater inflater;
+    string output;
+    assert(inflater.write("not deflate data", 16, output) == ZipUtils::CodecStatus::FAILED);
+    inflater.reset();
+    ZipUtils::Deflater deflater;
+    string compressed;
+    assert(deflater.write("abc", 3, ZipUtils::Deflater::Flush::FINISH, compressed));
+    output.clear();
+    assert(inflater.write(compressed.data(), compressed.size(), output) == ZipUtils::CodecStatus::STREAM_END);
+    assert(output == "abc");
+    cout << "✓ 损坏数据报错，复位后可继续使用" << endl;
+}
+
+// 测试内存处理流程（不使用临时目录）
+void testMemoryPipeline() {
+    cout << "\n=== 测试内存处理流程 ===" << endl;
+    
+    string input = buildTestBook({{"OEBPS/ch1.xhtml", "<p>text [AD: buy now] end</p>"},
+                                  {"OEBPS/image.bin", string(3000, 'x')}});
+    
+    EpubProcessor processor;
+    processor.setAdPatterns({regex("\\[AD:[^\\]]*\\] ")});
+    string output;
+    assert(processor.processBuffer(input, output));
+    assert(processor.getStats().adsRemoved == 1);
+    // 指定了自定义模式，内置模式不会被编译
+    assert(processor.getStartupProfile().documentStarted);
+    assert(processor.getStartupProfile().patternCompileMs == 0);
+    cout << "✓ 处理内存中的EPUB" << endl;
+    
+    ZipUtils::ZipReader in, out;
+    assert(in.openMemory(input.data(), input.size()).success());
+    assert(out.openMemory(output.data(), output.size()).success());
+    assert(out.entries().size() == 3);
+    assert(out.entries().front().name == "mimetype");
+    
+    string content;
+    assert(out.readEntry(*out.findEntry("OEBPS/ch1.xhtml"), content).success());
+    assert(content == "<p>text end</p>");
+    assert(in.findEntry("OEBPS/image.bin")->compressedSize ==
+           out.findEntry("OEBPS/image.bin")->compressedSize);
+    cout << "✓ 输出内容正确，未修改条目直接复制" << endl;
+    
+    assert(!processor.processBuffer("not a zip", output));
+    cout << "✓ 拒绝无效输入" << endl;
+}
+
+// 测试大文档的流式清理流程
+void testStreamingRewrite() {
+    cout << "\n=== 测试流式重写 ===" << endl;
+    
+    string chapter = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<html><body>";
+    for (int i = 0; i < 5000; ++i) {
+        chapter += "<p>paragraph " + to_string(i) + (i % 100 == 0 ? " [AD: buy now]" : "") + "</p>\n";
+    }
+    chapter += "</body></html>";
+    string expected = regex_replace(chapter, regex(" \\[AD:[^\\]]*\\]"), "");
+    expected.replace(expected.find("utf-8"), 5, "UTF-8");
+    
+    string inputPath = "test_streaming.epub";
+    string plain = "<p>nothing here</p>";
+    writeTestBook(inputPath, {{"OEBPS/ch1.xhtml", chapter}, {"OEBPS/ch2.xhtml", plain}});
+    
+    for (auto mode : {EpubProcessor::ProcessingMode::REWRITE, EpubProcessor::ProcessingMode::EXTRACT}) {
+        EpubProcessor processor(false, false);
+        processor.setProcessingMode(mode);
+        processor.setAdPatterns({regex(" \\[AD:[^\\]]*\\]")});
+        processor.setStreamingThreshold(1);
+        processor.setStreamingWindow(256);
+        string outputPath = "test_streaming_out.epub";
+        assert(processor.processFile(inputPath, outputPath));
+        assert(processor.getStats().adsRemoved == 50);
+        
+        {
+            ZipUtils::ZipReader reader;
+            assert(reader.open(outputPath).success());
+            string content;
+            assert(reader.readEntry(*reader.findEntry("OEBPS/ch1.xhtml"), content).success());
+            assert(content == expected);
+            assert(reader.readEntry(*reader.findEntry("OEBPS/ch2.xhtml"), content).success());
+            assert(content == plain);
+        }
+        FileUtils::removeFile(outputPath);
+    }
+    cout << "✓ 重写和解压模式流式清理结果正确" << endl;
+    
+    FileUtils::removeFile(inputPath);
+}
+
+// 测试输出到输入文件本身（只有文件名，没有目录部分）
+void testInPlaceOutput() {
+    cout << "\n=== 测试原地输出 ===" << endl;
+    
+    string path = "test_in_place.epub";
+    for (auto mode : {EpubProcessor::ProcessingMode::EXTRACT, EpubProcessor::ProcessingMode::REWRITE,
+                      EpubProcessor::ProcessingMode::MEMORY, EpubProcessor::ProcessingMode::PIPELINE}) {
+        writeTestBook(path, {{"OEBPS/ch1.xhtml", "<p>text [AD: buy now] end</p>"}});
+        
+        ostringstream captured;
+        Logger::Config& config = Logger::getConfig();
+        ostream* savedErrors = config.errorOutput;
+        config.errorOutput = &captured;
+        streambuf* savedCerr = cerr.rdbuf(captured.rdbuf());
+        
+        EpubProcessor processor(false, false);
+        processor.setProcessingMode(mode);
+        processor.setAdPatterns({regex(" \\[AD:[^\\]]*\\]")});
+        bool success = processor.processFile(path, path);
+        
+        cerr.rdbuf(savedCerr);
+        config.errorOutput = savedErrors;
+        
+        assert(success);
+        assert(captured.str().empty());
+        assert(processor.getStats().adsRemoved == 1);
+        ZipUtils::ZipReader reader;
+        assert(reader.open(path).success());
+        string content;
+        assert(reader.readEntry(*reader.findEntry("OEBPS/ch1.xhtml"), content).success());
+        assert(content == "<p>text end</p>");
+    }
+    FileUtils::removeFile(path);
+    cout << "✓ 各模式原地输出，不输出错误信息" << endl;
+}
+
+// 测试并行批量处理目录
+void testParallelDirectory() {
+    cout << "\n=== 测试并行批量处理 ===" << endl;
+    
+    FileUtils::TempDirectory inputDir("test_batch_in_");
+    FileUtils::TempDirectory outputDir("test_batch_out_");
+    assert(inputDir.isValid() && outputDir.isValid());
+    const int books = 12;
+    int expectedAds = 0;
+    for (int i = 0; i < books; ++i) {
+        string chapter = "<p>";
+        for (int j = 0; j <= i; ++j) {
+            chapter += "text [AD: buy now] ";
+        }
+        chapter += "</p>";
+        expectedAds += i + 1;
+        writeTestBook(inputDir.getPath() / ("book" + to_string(i) + ".epub"), {{"OEBPS/ch1.xhtml", chapter}});
+    }
+    assert(FileUtils::writeStringToFile((inputDir.getPath() / "broken.epub").string(), "not a zip"));
+    
+    // 捕获控制台输出，检查每本书的输出连续出现
+    ostringstream captured, capturedErrors;
+    Logger::Config& config = Logger::getConfig();
+    ostream* savedOutput = config.output;
+    ostream* savedErrors = config.errorOutput;
+    config.output = &captured;
+    config.errorOutput = &capturedErrors;
+    
+    EpubProcessor processor(true, false);
+    processor.setAdPatterns({regex("\\[AD:[^\\]]*\\] ")});
+    processor.setJobs(4);
+    bool success = processor.processDirectory(inputDir.getPath(), outputDir.getPath());
+    
+    config.output = savedOutput;
+    config.errorOutput = savedErrors;
+    
+    assert(!success);
+    const auto& stats = processor.getStats();
+    assert(stats.filesProcessed == books);
+    assert(stats.adsRemoved == expectedAds);
+    assert(stats.errors >= 1);
+    assert(is_sorted(stats.processedFiles.begin(), stats.processedFiles.end()));
+    assert(capturedErrors.str().find("broken.epub") != string::npos);
+    cout << "✓ 合并各工作线程的统计" << endl;
+    
+    string text = captured.str();
+    const string heading = "\n--- 处理文件 ";
+    const string footer = "=== 文件处理完成 ===";
+    size_t blocks = 0;
+    for (size_t pos = text.find(heading); pos != string::npos; ) {
+        size_t next = text.find(heading, pos + heading.size());
+        string block = text.substr(pos, next == string::npos ? string::npos : next - pos);
+        size_t footers = 0;
+        for (size_t f = block.find(footer); f != string::npos; f = block.find(footer, f + 1)) {
+            footers++;
+        }
+        assert(footers <= 1);
+        blocks += footers;
+        pos = next;
+    }
+    assert(blocks == books);
+    cout << "✓ 每本书的输出不与其他书交错" << endl;
+    
+    for (int i = 0; i < books; ++i) {
+        ZipUtils::ZipReader reader;
+        assert(reader.open(outputDir.getPath() / ("book" + to_string(i) + ".epub")).success());
+        string content;
+        assert(reader.readEntry(*reader.findEntry("OEBPS/ch1.xhtml"), content).success());
+        assert(content.find("[AD:") == string::npos);
+    }
+    cout << "✓ 输出文件内容正确" << endl;
+}
+
+// 测试解压流程中同一本书的内容文档并行清理
+void testParallelExtract() {
+    cout << "\n=== 测试书内并行清理 ===" << endl;
+    
+    FileUtils::TempDirectory inputDir("test_extract_in_");
+    FileUtils::TempDirectory outputDir("test_extract_out_");
+    assert(inputDir.isValid() && outputDir.isValid());
+    const int books = 3;
+    const int chapters = 40;
+    vector<pair<string, string>> entries;
+    for (int c = 0; c < chapters; ++c) {
+        entries.emplace_back("OEBPS/ch" + to_string(c) + ".xhtml",
+                             "<p>chapter " + to_string(c) + (c % 2 == 0 ? " [AD: buy now]" : "") + "</p>");
+    }
+    for (int b = 0; b < books; ++b) {
+        writeTestBook(inputDir.getPath() / ("book" + to_string(b) + ".epub"), entries);
+    }
+    
+    // 单本书：解压、重写和内存流程都把文档分给线程池清理，结果与逐个清理一致
+    const vector<EpubProcessor::ProcessingMode> modes = {EpubProcessor::ProcessingMode::EXTRACT,
+                                                         EpubProcessor::ProcessingMode::REWRITE,
+                                                         EpubProcessor::ProcessingMode::MEMORY};
+    auto process = [&](EpubProcessor::ProcessingMode mode, size_t jobs, const fs::path& input,
+                       const fs::path& output) {
+        EpubProcessor processor(false, false);
+        processor.setProcessingMode(mode);
+        processor.setAdPatterns({regex(" \\[AD:[^\\]]*\\]")});
+        processor.setJobs(jobs);
+        assert(processor.processFile(input, output));
+        return processor.getStats().adsRemoved;
+    };
+    fs::path book = inputDir.getPath() / "book0.epub";
+    for (auto mode : modes) {
+        assert(process(mode, 1, book, outputDir.getPath() / "serial.epub") == chapters / 2);
+        
+        // 第一个文档等到另一个线程也开始清理文档后才继续，确认文档确实分给了多个线程
+        mutex threadsMutex;
+        condition_variable threadsChanged;
+        set<thread::id> threads;
+        auto onDocument = [&](const string&) {
+            unique_lock<mutex> lock(threadsMutex);
+            threads.insert(this_thread::get_id());
+            threadsChanged.notify_all();
+            threadsChanged.wait_for(lock, chrono::seconds(10), [&] { return threads.size() > 1; });
+        };
+        EpubProcessor processor(false, false);
+        processor.setProcessingMode(mode);
+        processor.setAdPatterns({regex(" \\[AD:[^\\]]*\\]")});
+        processor.setJobs(4);
+        processor.setDocumentCallback(onDocument);
+        assert(processor.processFile(book, outputDir.getPath() / "parallel.epub"));
+        assert(processor.getStats().adsRemoved == chapters / 2);
+        assert(threads.size() > 1);
+        
+        ZipUtils::ZipReader serial, parallel;
+        assert(serial.open(outputDir.getPath() / "serial.epub").success());
+        assert(parallel.open(outputDir.getPath() / "parallel.epub").success());
+        assert(serial.entries().size() == parallel.entries().size());
+        for (const auto& entry : serial.entries()) {
+            string expected, actual;
+            assert(serial.readEntry(entry, expected).success());
+            assert(parallel.readEntry(*parallel.findEntry(entry.name), actual).success());
+            assert(expected == actual && expected.find("[AD:") == string::npos);
+        }
+    }
+    cout << "✓ 单本书的文档分给多个线程清理，结果与逐个清理一致" << endl;
+    
+    // 工作处理器不持有线程池：处理器在工作线程释放自己的工作处理器前析构，线程池也只在调用线程中析构
+    string small = buildTestBook(vector<pair<string, string>>(entries.begin(), entries.begin() + 4));
+    for (int i = 0; i < 3000; ++i) {
+        EpubProcessor processor(false, false);
+        processor.setProcessingMode(EpubProcessor::ProcessingMode::MEMORY);
+        processor.setAdPatterns({regex(" \\[AD:[^\\]]*\\]")});
+        processor.setJobs(8);
+        string output;
+        assert(processor.processBuffer(small, output));
+    }
+    cout << "✓ 反复创建和析构并行处理器" << endl;
+    
+    // 批量处理：书和书内文档共用一个线程池
+    for (auto mode : modes) {
+        FileUtils::TempDirectory batchOutput("test_extract_batch_");
+        EpubProcessor processor(false, false);
+        processor.setProcessingMode(mode);
+        processor.setAdPatterns({regex(" \\[AD:[^\\]]*\\]")});
+        processor.setJobs(3);
+        assert(processor.processDirectory(inputDir.getPath(), batchOutput.getPath()));
+        assert(processor.getStats().filesProcessed == books);
+        assert(processor.getStats().adsRemoved == books * chapters / 2);
+        assert(processor.getStats().errors == 0);
+    }
+    cout << "✓ 批量处理与书内并行共用线程池" << endl;
+}
+
+// 测试分阶段流水线：有界队列、单本书与内存模式一致、批量处理
+void testPipeline() {
+    cout << "\n=== 测试分阶段流水线 ===" << endl;
+    
+    {
+        BoundedQueue<int> queue(2);
+        long long total = 0;
+        thread consumer([&] {
+            int value;
+            while (queue.pop(value)) {
+                assert(queue.size() <= 2);
+                total += value;
+            }
+        });
+        for (int i = 1; i <= 1000; ++i) {
+            assert(queue.push(i));
+        }
+        queue.close();
+        consumer.join();
+        assert(total == 500500);
+        assert(!queue.push(1));
+    }
+    cout << "✓ 有界队列在关闭前取完所有元素" << endl;
+    
+    FileUtils::TempDirectory inputDir("test_pipeline_in_");
+    FileUtils::TempDirectory outputDir("test_pipeline_out_");
+    assert(inputDir.isValid() && outputDir.isValid());
+    const int books = 6;
+    const int chapters = 8;
+    for (int b = 0; b < books; ++b) {
+        vector<pair<string, string>> entries;
+        for (int c = 0; c < chapters; ++c) {
+            string chapter = "<p>book " + to_string(b) + " chapter " + to_string(c);
+            for (int r = 0; r <= b; ++r) {
+                chapter += c % 2 == 0 ? " text [AD: buy now]" : " text";
+            }
+            entries.emplace_back("OEBPS/ch" + to_string(c) + ".xhtml", chapter + "</p>");
+        }
+        entries.emplace_back("OEBPS/style.css", "p { margin: 0; }");
+        writeTestBook(inputDir.getPath() / ("book" + to_string(b) + ".epub"), entries);
+    }
+    
+    EpubProcessor::PipelineOptions options;
+    options.readThreads = 2;
+    options.decodeThreads = 2;
+    options.cleanThreads = 3;
+    options.compressThreads = 2;
+    options.writeThreads = 2;
+    options.readAhead = 1;
+    options.queueCapacity = 2;
+    
+    // 单本书：与内存模式输出相同的条目和统计
+    auto process = [&](EpubProcessor::ProcessingMode mode, const fs::path& output) {
+        EpubProcessor processor(false, false);
+        processor.setProcessingMode(mode);
+        processor.setPipelineOptions(options);
+        processor.setAdPatterns({regex(" text \\[AD:[^\\]]*\\]")});
+        assert(processor.processFile(inputDir.getPath() / "book3.epub", output));
+        return processor.getStats().adsRemoved;
+    };
+    fs::path memoryOutput = outputDir.getPath() / "memory.epub";
+    fs::path pipelineOutput = outputDir.getPath() / "pipeline.epub";
+    assert(process(EpubProcessor::ProcessingMode::MEMORY, memoryOutput) == 4 * chapters / 2);
+    assert(process(EpubProcessor::ProcessingMode::PIPELINE, pipelineOutput) == 4 * chapters / 2);
+    {
+        ZipUtils::ZipReader expected, actual;
+        assert(expected.open(memoryOutput).success());
+        assert(actual.open(pipelineOutput).success());
+        assert(expected.entries().size() == actual.entries().size());
+        for (size_t i = 0; i < expected.entries().size(); ++i) {
+            assert(expected.entries()[i].name == actual.entries()[i].name);
+            string a, b;
+            assert(expected.readEntry(expected.entries()[i], a).success());
+            assert(actual.readEntry(actual.entries()[i], b).success());
+            assert(a == b && a.find("[AD:") == string::npos);
+        }
+    }
+    cout << "✓ 单本书的流水线输出与内存模式一致" << endl;
+    
+    // 批量处理：多本书同时处于不同阶段，统计合并，失败的书单独报告
+    assert(FileUtils::writeStringToFile((inputDir.getPath() / "broken.epub").string(), "not a zip"));
+    FileUtils::TempDirectory batchOutput("test_pipeline_batch_");
+    ostringstream captured, capturedErrors;
+    Logger::Config& config = Logger::getConfig();
+    ostream* savedOutput = config.output;
+    ostream* savedErrors = config.errorOutput;
+    config.output = &captured;
+    config.errorOutput = &capturedErrors;
+    
+    EpubProcessor processor(false, false);
+    processor.setProcessingMode(EpubProcessor::ProcessingMode::PIPELINE);
+    processor.setPipelineOptions(options);
+    processor.setAdPatterns({regex(" text \\[AD:[^\\]]*\\]")});
+    bool success = processor.processDirectory(inputDir.getPath(), batchOutput.getPath());
+    
+    config.output = savedOutput;
+    config.errorOutput = savedErrors;
+    
+    assert(!success);
+    const auto& stats = processor.getStats();
+    assert(stats.filesProcessed == books);
+    assert(stats.adsRemoved == books * (books + 1) / 2 * chapters / 2);
+    assert(stats.errors >= 1);
+    assert(is_sorted(stats.processedFiles.begin(), stats.processedFiles.end()));
+    assert(capturedErrors.str().find("broken.epub") != string::npos);
+    for (int b = 0; b < books; ++b) {
+        ZipUtils::ZipReader reader;
+        assert(reader.open(batchOutput.getPath() / ("book" + to_string(b) + ".epub")).success());
+        assert(reader.entries().size() == static_cast<size_t>(chapters + 2));
+        for (const auto& entry : reader.entries()) {
+            string content;
+            assert(reader.readEntry(entry, content).success());
+            assert(content.find("[AD:") == string::npos);
+        }
+    }
+    cout << "✓ 批量处理的统计合并、失败报告和输出内容正确" << endl;
+}
+#endif
+
 // 测试临时目录
 void testTempDirectory() {
     cout << "\n=== 测试临时目录 ===" << endl;
@@ -104,6 +1613,22 @@ void testLogger() {
     LOG_ERROR << "错误信息";
     
     cout << "✓ 日志输出测试完成" << endl;
+    
+    // 库函数的错误写入当前线程的错误输出目标，没有目标时写到errorOutput
+    ostringstream captured, bookErrors;
+    Logger::Config& config = Logger::getConfig();
+    ostream* savedErrors = config.errorOutput;
+    config.errorOutput = &captured;
+    {
+        Logger::ScopedErrorTarget target(bookErrors);
+        assert(FileUtils::readFileToString("test_missing_file.txt").empty());
+    }
+    assert(bookErrors.str() == "文件不存在: \"test_missing_file.txt\"\n");
+    assert(captured.str().empty());
+    assert(FileUtils::readFileToString("test_missing_file.txt").empty());
+    config.errorOutput = savedErrors;
+    assert(captured.str() == bookErrors.str());
+    cout << "✓ 错误信息写入当前线程的输出目标" << endl;
 }
 
 int main() {
@@ -111,7 +1636,33 @@ int main() {
     
     try {
         testFileUtils();
+        testMappedFile();
         testAdPatterns();
+        testPatternSet();
+        testPatternEngine();
+        testLiteralPrefilter();
+        testSimdScan();
+        testSharedPatternSet();
+        testPatternBundle();
+        testPatternAnalysis();
+        testPatternProfile();
+        testThreadPool();
+        testAsyncIO();
+        testStreamingCleaner();
+#ifdef HAVE_ZLIB
+        testZipReader();
+        testZipWriter();
+        testZipRewrite();
+        testZip64();
+        testParallelDeflate();
+        testCodecStreams();
+        testMemoryPipeline();
+        testStreamingRewrite();
+        testInPlaceOutput();
+        testParallelDirectory();
+        testParallelExtract();
+        testPipeline();
+#endif
         testTempDirectory();
         testLogger();
         